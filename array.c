@@ -0,0 +1,242 @@
+#include "array.h"
+
+#include <stdlib.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "common.h"
+#include "panic.h"
+#include "parallel.h"
+
+#define BIT_BYTES(length) (((length) + 7) / 8)
+
+STATIC ArrayStorage storageFor(ObjType type) {
+    switch (type) {
+        case ObjType_Nil: return ArrayStorage_Nil;
+        case ObjType_Int: return ArrayStorage_Int;
+        case ObjType_Float: return ArrayStorage_Float;
+        case ObjType_Bool: return ArrayStorage_Bool;
+        default: return ArrayStorage_Boxed;
+    }
+}
+
+STATIC size_t storageSize(ArrayStorage storage, int length) {
+    switch (storage) {
+        case ArrayStorage_Nil: return 0;
+        case ArrayStorage_Int: return sizeof(int) * length;
+        case ArrayStorage_Float: return sizeof(float) * length;
+        case ArrayStorage_Bool: return BIT_BYTES(length);
+        case ArrayStorage_Boxed: return sizeof(InterpreterObj) * length;
+    }
+}
+
+//* zeroed - see the note on ObjType in generate.yaml
+//
+// Anonymous mappings come zeroed for free, and untouched pages don't cost
+// anything, so big arrays get their own.
+STATIC void* allocStorage(ArrayStorage storage, int length, bool* mapped) {
+    size_t size = storageSize(storage, length);
+    *mapped = false;
+    if (size == 0) return NULL;
+#ifndef _WIN32
+    if (size >= ARRAY_MMAP_THRESHOLD) {
+        void* out = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (out == MAP_FAILED) panic(Panic_Interpreter, "Couldn't allocate %zu bytes for an array!", size);
+        *mapped = true;
+        return out;
+    }
+#endif
+    return calloc(1, size);
+}
+
+STATIC void freeStorage(ArrayObj* array) {
+#ifndef _WIN32
+    if (array->mapped) {
+        munmap(array->data, storageSize(array->storage, array->length));
+        return;
+    }
+#endif
+    free(array->data);
+}
+
+ArrayObj* newArray(int rank, int* dims) {
+    if (rank < 1 || rank > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Arrays must have between 1 and %i dimensions!", ARRAY_MAX_RANK);
+
+    ArrayObj* out = malloc(sizeof(ArrayObj));
+    out->refCount = 1;
+    out->storage = ArrayStorage_Nil;
+    out->rank = rank;
+    out->mapped = false;
+    out->parallelWrites = false;
+    out->data = NULL;
+
+    long long length = 1;
+    for (int i = 0; i < rank; i++) {
+        if (dims[i] < 1) panic(Panic_Interpreter, "Array dimensions must be positive! (got %i)", dims[i]);
+        out->dims[i] = dims[i];
+        length *= dims[i];
+        if (length > INT_MAX) panic(Panic_Interpreter, "Array is too big!");
+    }
+    out->length = length;
+
+    // row-major, so the last dimension is contiguous
+    int stride = 1;
+    for (int i = rank - 1; i >= 0; i--) {
+        out->strides[i] = stride;
+        stride *= dims[i];
+    }
+
+    return out;
+}
+
+void destroyArray(ArrayObj* array) {
+    if (array->storage == ArrayStorage_Boxed) {
+        for (int i = 0; i < array->length; i++) freeObj(array->boxed[i]);
+    }
+    freeStorage(array);
+    free(array);
+}
+
+ArrayObj* cloneArray(ArrayObj* array) {
+    ArrayObj* out = malloc(sizeof(ArrayObj));
+    memcpy(out, array, sizeof(ArrayObj));
+    out->refCount = 1;
+    out->parallelWrites = false;
+    out->data = allocStorage(array->storage, array->length, &out->mapped);
+    if (array->storage == ArrayStorage_Boxed) {
+        for (int i = 0; i < array->length; i++) out->boxed[i] = copyObj(array->boxed[i]);
+    } else if (out->data != NULL) {
+        memcpy(out->data, array->data, storageSize(array->storage, array->length));
+    }
+    return out;
+}
+
+void retainArray(ArrayObj* array) {
+    retainCount(&array->refCount);
+}
+
+void releaseArray(ArrayObj* array) {
+    if (releaseCount(&array->refCount) == 0) destroyArray(array);
+}
+
+ArrayObj* arrayForWrite(ArrayObj** array) {
+    if ((*array)->refCount > 1) {
+        ArrayObj* copy = cloneArray(*array);
+        releaseArray(*array);
+        *array = copy;
+    }
+    return *array;
+}
+
+ArrayObj* concatArrays(ArrayObj* a, ArrayObj* b) {
+    if (a->rank != 1 || b->rank != 1) panic(Panic_Interpreter, "Can only join 1-dimensional arrays!");
+    int length = a->length + b->length;
+    ArrayObj* out = newArray(1, &length);
+    for (int i = 0; i < a->length; i++) {
+        InterpreterObj elem = arrayGet(a, i);
+        while (elem.tag == ObjType_Ref) elem = *elem.reference;
+        arraySet(out, i, copyObj(elem));
+    }
+    for (int i = 0; i < b->length; i++) {
+        InterpreterObj elem = arrayGet(b, i);
+        while (elem.tag == ObjType_Ref) elem = *elem.reference;
+        arraySet(out, a->length + i, copyObj(elem));
+    }
+    return out;
+}
+
+int arrayOffset(ArrayObj* array, int* indices, int count, int uncheckedDims) {
+    if (count != array->rank) panic(Panic_Interpreter, "Expected %i array indices but got %i!", array->rank, count);
+    int offset = 0;
+    for (int i = 0; i < count; i++) {
+        if (!(uncheckedDims & (1 << i)) && (indices[i] < 0 || indices[i] >= array->dims[i]))
+            panic(Panic_Interpreter, "Index %i is out of bounds for dimension %i (size %i)!", indices[i], i + 1, array->dims[i]);
+        offset += indices[i] * array->strides[i];
+    }
+    return offset;
+}
+
+InterpreterObj arrayGet(ArrayObj* array, int offset) {
+    switch (array->storage) {
+        case ArrayStorage_Nil: return (InterpreterObj){.tag = ObjType_Nil};
+        case ArrayStorage_Int: return (InterpreterObj){.tag = ObjType_Int, .int_ = array->ints[offset]};
+        case ArrayStorage_Float: return (InterpreterObj){.tag = ObjType_Float, .float_ = array->floats[offset]};
+        case ArrayStorage_Bool: return (InterpreterObj){
+            .tag = ObjType_Bool,
+            .bool_ = (array->bits[offset >> 3] >> (offset & 7)) & 1
+        };
+        case ArrayStorage_Boxed: return (InterpreterObj){.tag = ObjType_Ref, .reference = &array->boxed[offset]};
+    }
+}
+
+// Heterogeneous store - box up everything that's already there
+void promoteArray(ArrayObj* array) {
+    bool mapped;
+    InterpreterObj* boxed = allocStorage(ArrayStorage_Boxed, array->length, &mapped);
+    if (array->storage != ArrayStorage_Nil) {
+        for (int i = 0; i < array->length; i++) boxed[i] = arrayGet(array, i);
+    }
+    freeStorage(array);
+    array->boxed = boxed;
+    array->mapped = mapped;
+    array->storage = ArrayStorage_Boxed;
+}
+
+// Make sure the storage can hold wanted
+STATIC void fitStorage(ArrayObj* array, ArrayStorage wanted) {
+    if (array->storage == ArrayStorage_Nil) {
+        array->data = allocStorage(wanted, array->length, &array->mapped);
+        array->storage = wanted;
+    } else if (array->storage != wanted && array->storage != ArrayStorage_Boxed) {
+        promoteArray(array);
+    }
+}
+
+void arraySet(ArrayObj* array, int offset, InterpreterObj value) {
+    ArrayStorage wanted = storageFor(value.tag);
+
+    // nothing to do - it's already nil!
+    if (array->storage == ArrayStorage_Nil && wanted == ArrayStorage_Nil) return;
+    if (array->storage != wanted && array->storage != ArrayStorage_Boxed) {
+        if (array->parallelWrites) {
+            stopOtherThreads();
+            // someone else might've beaten us to it
+            fitStorage(array, wanted);
+            restartOtherThreads();
+        } else {
+            fitStorage(array, wanted);
+        }
+    }
+
+    value._nameAllocated = false;
+
+    switch (array->storage) {
+        case ArrayStorage_Int: {
+            array->ints[offset] = value.int_;
+            break;
+        }
+        case ArrayStorage_Float: {
+            array->floats[offset] = value.float_;
+            break;
+        }
+        case ArrayStorage_Bool: {
+            uint8_t bit = 1 << (offset & 7);
+            // neighbouring elements share a byte, & another thread could be
+            // writing to one of them
+            if (array->parallelWrites) {
+                if (value.bool_) __atomic_fetch_or(&array->bits[offset >> 3], bit, __ATOMIC_RELAXED);
+                else __atomic_fetch_and(&array->bits[offset >> 3], (uint8_t)~bit, __ATOMIC_RELAXED);
+            } else if (value.bool_) array->bits[offset >> 3] |= bit;
+            else array->bits[offset >> 3] &= ~bit;
+            break;
+        }
+        case ArrayStorage_Boxed: {
+            freeObj(array->boxed[offset]);
+            array->boxed[offset] = value;
+            break;
+        }
+    }
+}
\ No newline at end of file
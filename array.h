@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "interpreter.h"
+
+#define ARRAY_MAX_RANK 8
+// Storage bigger than this comes straight from mmap, so it's only committed
+// as pages get written to - huge arrays which are mostly left alone are cheap.
+#define ARRAY_MMAP_THRESHOLD (1 << 20)
+
+// Arrays are a single contiguous block, stored row-major. Homogeneous int,
+// float and bool arrays are kept unboxed (bools are bit-packed) - the first
+// store picks the storage, and storing anything else promotes the whole block
+// to boxed InterpreterObjs.
+//
+// Until that first store every element reads as nil. Elements of a typed
+// array which haven't been written yet read as that type's zero value - &
+// still do once it's been promoted, since nothing records which elements
+// were written.
+//
+// Arrays are reference counted & copy-on-write, so copying one (passing it
+// byVal, b = a) is O(1) - the copy happens on the first write through a
+// shared reference (see arrayForWrite).
+struct ArrayObj {
+    int refCount;
+    ArrayStorage storage;
+    int rank;
+    int dims[ARRAY_MAX_RANK];
+    // strides[i] is the distance between consecutive indices in dimension i
+    int strides[ARRAY_MAX_RANK];
+    int length;
+    // data came from mmap, not malloc
+    bool mapped;
+    // a parallel loop's writing to it from more than one thread - its
+    // storage can only change once they've all stopped (see parallel.h)
+    bool parallelWrites;
+    union {
+        void* data;
+        int* ints;
+        float* floats;
+        uint8_t* bits;
+        InterpreterObj* boxed;
+    };
+};
+
+ArrayObj* newArray(int rank, int* dims);
+void destroyArray(ArrayObj* array);
+// always a new, unshared array - usually you want arrayForWrite
+ArrayObj* cloneArray(ArrayObj* array);
+
+void retainArray(ArrayObj* array);
+// destroys the array when the last reference goes
+void releaseArray(ArrayObj* array);
+// Call before writing to *array! If anything else can see the array,
+// *array is replaced with a private copy.
+ArrayObj* arrayForWrite(ArrayObj** array);
+// only for 1-dimensional arrays!
+ArrayObj* concatArrays(ArrayObj* a, ArrayObj* b);
+
+// Bounds-checked flat offset of the element at indices. Bit n of
+// uncheckedDims skips the check for indices[n] - only for indices which
+// have already been proven to be in-bounds!
+int arrayOffset(ArrayObj* array, int* indices, int count, int uncheckedDims);
+
+// Boxed elements come back as a reference to the element, everything
+// else comes back by value.
+InterpreterObj arrayGet(ArrayObj* array, int offset);
+// Box up every element, so it can hold anything - it mustn't be boxed
+// already
+void promoteArray(ArrayObj* array);
+// Takes ownership of value, which must not be a reference. Doesn't copy on
+// write - see arrayForWrite.
+void arraySet(ArrayObj* array, int offset, InterpreterObj value);
\ No newline at end of file
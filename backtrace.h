@@ -5,6 +5,7 @@
 #if defined(OCRPI_DEBUG) && defined(__linux__)
 
 #include <execinfo.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -30,9 +30,19 @@ def all_with_extension(*exts: str) -> list[str]:
 COMPILER = 'gcc'
 DEBUG_DEFINES: dict[str, str] = {'OCRPI_DEBUG': '1'}
 TEST_DEFINES: dict[str, str] = {**DEBUG_DEFINES, 'OCRPI_TEST': '1'}
-LIBS: dict[str, list[str]] = {'Linux': ['m']}
+LIBS: dict[str, list[str]] = {'Linux': ['m', 'pthread', 'dl']}
 EXECUTABLE = 'ocrpi'
+# what programs from --emit-c link against - everything but main, optimised
+RUNTIME_LIB = 'libocrpi-runtime.a'
+RUNTIME_EXCLUDE = ['./main.c']
+# what programs embedding ocrpi link against (see ocrpi_vm.h) - the same
+# objects as the runtime, & a position independent build of them
+LIBRARY = 'libocrpi'
 SOURCE_EXTS = ['.c']
+# native extension modules (see ocrpi_ext.h) - built as shared objects, not
+# linked into ocrpi
+EXTENSIONS_DIR = './extensions'
+EXTENSION_EXT = '.so'
 HEADER_EXTS = ['.h']
 PYTHON = 'python'
 CLOC = 'C:/Users/jjadd/Downloads/cloc-1.92.exe' if system() == 'Windows' else 'cloc'
@@ -70,6 +80,8 @@ def main():
         exit(0)
     
     source_files = all_with_extension(*SOURCE_EXTS)
+    extension_sources = [file for file in source_files if file.startswith(f'{EXTENSIONS_DIR}/')]
+    source_files = [file for file in source_files if file not in extension_sources]
     headers = {path.splitext(header)[0]: header for header in all_with_extension(*HEADER_EXTS)}
 
     makefile = ''
@@ -77,6 +89,8 @@ def main():
     objects: list[str] = []
     debug_objects: list[str] = []
     test_objects: list[str] = []
+    runtime_objects: list[str] = []
+    pic_objects: list[str] = []
 
     debug_defines = defines_str(DEBUG_DEFINES)
     test_defines  = defines_str(TEST_DEFINES)
@@ -91,6 +105,8 @@ def main():
         obj_name       = f'build/objects/{base}.o'
         debug_obj_name = f'build/objects/{base}-debug.o'
         test_obj_name  = f'build/objects/{base}-test.o'
+        runtime_obj_name = f'build/objects/{base}-runtime.o'
+        pic_obj_name = f'build/objects/{base}-pic.o'
         dependencies = [file]
         if base in headers: dependencies.append(headers[base])
         dependencies += COMMON_DEPENDENCIES
@@ -98,15 +114,26 @@ def main():
         makefile += makefile_item(obj_name,       dependencies, [fs_cmd('mkdir', dirname), f'{COMPILER} -c {file} -I. -o {obj_name}'])
         makefile += makefile_item(debug_obj_name, dependencies, [fs_cmd('mkdir', dirname), f'{COMPILER} -g {debug_defines} -c {file} -I. -o {debug_obj_name}'])
         makefile += makefile_item(test_obj_name,  dependencies, [fs_cmd('mkdir', dirname), f'{COMPILER} -g {test_defines} -c {file} -I. -o {test_obj_name}'])
+        makefile += makefile_item(runtime_obj_name, dependencies, [fs_cmd('mkdir', dirname), f'{COMPILER} -O2 -c {file} -I. -o {runtime_obj_name}'])
+        makefile += makefile_item(pic_obj_name, dependencies, [fs_cmd('mkdir', dirname), f'{COMPILER} -O2 -fPIC -c {file} -I. -o {pic_obj_name}'])
 
         objects.append(obj_name)
         debug_objects.append(debug_obj_name)
         test_objects.append(test_obj_name)
+        if file not in RUNTIME_EXCLUDE:
+            runtime_objects.append(runtime_obj_name)
+            pic_objects.append(pic_obj_name)
     
     
     libs_str = ' -l'.join(LIBS.get(system(), []))
     if libs_str: libs_str = ' -l' + libs_str
 
+    extensions: list[str] = []
+    for file in extension_sources:
+        extension = f'{path.splitext(file)[0]}{EXTENSION_EXT}'
+        makefile += makefile_item(extension, [file, 'ocrpi_ext.h'], [f'{COMPILER} -shared -fPIC -O2 -I. {file} -o {extension}{libs_str}'])
+        extensions.append(extension)
+
     # can't modify a constant or mypy will murder my family
     executable = EXECUTABLE
     if system() == 'Windows' and not executable.endswith('.exe'): executable = f'{executable}.exe'
@@ -118,15 +145,32 @@ def main():
     + makefile_item(
         'all',
         ['codegen'] + objects,
-        [f'{COMPILER} {" ".join(objects)} -o {executable}{libs_str}']
+        # -rdynamic so extension modules can call back into ocrpi
+        [f'{COMPILER} -rdynamic {" ".join(objects)} -o {executable}{libs_str}']
     ) + makefile_item(
         'debug',
         ['codegen'] + debug_objects,
         [f'{COMPILER} -g -rdynamic {" ".join(debug_objects)} -o {executable}{libs_str}']
     ) + makefile_item(
         'test',
-        ['codegen'] + test_objects,
+        ['codegen', 'extensions'] + test_objects,
         [f'{COMPILER} -g -rdynamic {" ".join(test_objects)} -o {executable}{libs_str}']
+    ) + makefile_item(
+        'runtime',
+        ['codegen'] + runtime_objects,
+        [fs_cmd('rm_file', RUNTIME_LIB), f'ar rcs {RUNTIME_LIB} {" ".join(runtime_objects)}']
+    ) + makefile_item(
+        'library',
+        ['codegen'] + runtime_objects + pic_objects,
+        [
+            fs_cmd('rm_file', f'{LIBRARY}.a'),
+            f'ar rcs {LIBRARY}.a {" ".join(runtime_objects)}',
+            f'{COMPILER} -shared {" ".join(pic_objects)} -o {LIBRARY}.so{libs_str}'
+        ]
+    ) + makefile_item(
+        'extensions',
+        extensions,
+        []
     ) + run_item(
         'run', 'all'
     ) + run_item(
@@ -151,6 +195,10 @@ def main():
         [
             fs_cmd('rm_dir', 'build/objects'),
             fs_cmd('rm_file', executable),
+            fs_cmd('rm_file', RUNTIME_LIB),
+            fs_cmd('rm_file', f'{LIBRARY}.a'),
+            fs_cmd('rm_file', f'{LIBRARY}.so'),
+            *[fs_cmd('rm_file', extension) for extension in extensions],
             fs_cmd('rm_file', 'generated.c'),
             fs_cmd('rm_file', 'generated.h')
         ]
@@ -0,0 +1,736 @@
+#include "checker.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "runtime.h"
+
+// Types are IRTypes (see ir.h) - None means nothing's been seen yet, Any
+// means it could be more than one thing.
+typedef struct {
+    IRType type;
+    // Array - the type of its elements
+    IRType element;
+    // Func - which function it is, if it's only ever one
+    FunDecl* function;
+    // could be nil even though type says otherwise - it came out of an array,
+    // & elements nobody's written to yet are nil
+    bool mayBeNil;
+} CheckType;
+
+typedef struct {
+    // NULL at the top level
+    FunDecl* owner;
+    char* name;
+    CheckType type;
+    // what it was first assigned, for the error when it's assigned something
+    // else too
+    IRType first;
+    bool reported;
+} CheckVar;
+
+DECL_VEC(CheckVar, CheckVarList)
+DECL_VEC(char*, CheckNameList)
+
+typedef struct {
+    FunDecl* decl;
+    // its params, & everything it assigns to that isn't a global
+    CheckNameList locals;
+    CheckType result;
+    // it's been stored somewhere along with another function, so calls to
+    // it can't be seen - nothing's known about its parameters
+    bool escaped;
+} CheckFunction;
+
+DECL_VEC(CheckFunction, CheckFunctionList)
+
+static CheckVarList vars;
+static CheckFunctionList checkFunctions;
+// everything assigned at the top level, & everything declared global
+static CheckNameList globals;
+// the function whose body is being checked - NULL at the top level
+static CheckFunction* currentFunction;
+// set if anything's type got wider on this pass
+static bool changed;
+// on the last pass, once the types have settled - report errors & annotate
+// the AST
+static bool reporting;
+static CheckErrList* errors;
+
+#define UNKNOWN ((CheckType){.type = IRType_None})
+#define TYPE(t) ((CheckType){.type = IRType_##t})
+
+STATIC void typeError(Token tok, char* fmt, ...) {
+    if (!reporting) return;
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    char* msg = malloc(length + 1);
+    va_start(args, fmt);
+    vsnprintf(msg, length + 1, fmt, args);
+    va_end(args);
+
+    char* text = tokText(tok);
+    printf("Type error (line %i, column %i)\n'%s':\n\x1b[31m%s\x1b[0m\n", tok.line, tok.col, text, msg);
+    free(text);
+    APPEND(*errors, ((CheckError){.tok = tok, .msg = msg}));
+}
+
+//* ---------------- types ----------------
+
+// Known to be exactly one type
+STATIC bool definite(CheckType type) {
+    return type.type != IRType_None && type.type != IRType_Any;
+}
+
+STATIC bool proven(CheckType type) {
+    return definite(type) && !type.mayBeNil;
+}
+
+STATIC bool numeric(CheckType type) {
+    return type.type == IRType_Int || type.type == IRType_Float;
+}
+
+STATIC CheckFunction* findCheckFunction(FunDecl* decl) {
+    FOREACH(CheckFunctionList, checkFunctions, func) {
+        if (func->decl == decl) return func;
+    }
+    return NULL;
+}
+
+STATIC void escape(FunDecl* decl) {
+    if (decl == NULL) return;
+    CheckFunction* func = findCheckFunction(decl);
+    if (!func->escaped) changed = true;
+    func->escaped = true;
+}
+
+STATIC IRType joinElements(IRType a, IRType b) {
+    if (a == IRType_None) return b;
+    if (b == IRType_None) return a;
+    return a == b ? a : IRType_Any;
+}
+
+STATIC CheckType joinCheckTypes(CheckType a, CheckType b) {
+    if (a.type == IRType_None) return b;
+    if (b.type == IRType_None) return a;
+    CheckType out = a;
+    out.mayBeNil |= b.mayBeNil;
+    if (a.type != b.type) {
+        escape(a.function);
+        escape(b.function);
+        return (CheckType){.type = IRType_Any, .mayBeNil = out.mayBeNil};
+    }
+    out.element = joinElements(a.element, b.element);
+    if (a.function != b.function) {
+        escape(a.function);
+        escape(b.function);
+        out.function = NULL;
+    }
+    return out;
+}
+
+STATIC bool sameType(CheckType a, CheckType b) {
+    return a.type == b.type && a.element == b.element && a.function == b.function && a.mayBeNil == b.mayBeNil;
+}
+
+// Widen *into to cover type too
+STATIC void widen(CheckType* into, CheckType type) {
+    CheckType joined = joinCheckTypes(*into, type);
+    if (!sameType(joined, *into)) changed = true;
+    *into = joined;
+}
+
+STATIC IRType fromObjType(ObjType type) {
+    switch (type) {
+        case ObjType_Nil: return IRType_Nil;
+        case ObjType_Bool: return IRType_Bool;
+        case ObjType_Int: return IRType_Int;
+        case ObjType_Float: return IRType_Float;
+        case ObjType_String: return IRType_String;
+        case ObjType_Array: return IRType_Array;
+        default: return IRType_Any;
+    }
+}
+
+// False if values of type could be more than one ObjType
+STATIC bool toObjType(IRType type, ObjType* out) {
+    switch (type) {
+        case IRType_Nil: *out = ObjType_Nil; return true;
+        case IRType_Bool: *out = ObjType_Bool; return true;
+        case IRType_Int: *out = ObjType_Int; return true;
+        case IRType_Float: *out = ObjType_Float; return true;
+        case IRType_String: *out = ObjType_String; return true;
+        case IRType_Array: *out = ObjType_Array; return true;
+        default: return false;
+    }
+}
+
+//* ---------------- variables ----------------
+
+STATIC bool hasName(CheckNameList* names, char* name) {
+    FOREACH(CheckNameList, *names, existing) {
+        if (strcmp(*existing, name) == 0) return true;
+    }
+    return false;
+}
+
+STATIC void addName(CheckNameList* names, Token name) {
+    char* text = tokText(name);
+    if (hasName(names, text)) free(text);
+    else APPEND(*names, text);
+}
+
+// A function's own variable, or else a global - see assign in interpreter.c
+STATIC CheckVar* findCheckVar(char* name) {
+    FunDecl* owner = currentFunction != NULL && hasName(&currentFunction->locals, name) ? currentFunction->decl : NULL;
+    FOREACH(CheckVarList, vars, var) {
+        if (var->owner == owner && strcmp(var->name, name) == 0) return var;
+    }
+    APPEND(vars, ((CheckVar){.owner = owner, .name = strdup(name), .type = UNKNOWN, .first = IRType_None}));
+    return &vars.root[vars.len - 1];
+}
+
+STATIC void assignCheckVar(Token name, CheckType type) {
+    char* text = tokText(name);
+    CheckVar* var = findCheckVar(text);
+    free(text);
+    if (var->first == IRType_None) var->first = type.type;
+    if (
+        var->type.type == IRType_Any && definite(type) && type.type != var->first &&
+        var->first != IRType_Any && !var->reported && reporting
+    ) {
+        typeError(name, "%s is %s here, but it's %s elsewhere!", var->name, IRTypeToString(type.type), IRTypeToString(var->first));
+        var->reported = true;
+    }
+    widen(&var->type, type);
+}
+
+STATIC bool isParam(FunDecl* func, char* name) {
+    FOREACH(ParamList, func->params, param) {
+        if (param->name.length == strlen(name) && strncmp(param->name.start, name, param->name.length) == 0) return true;
+    }
+    return false;
+}
+
+STATIC CheckType readVar(Token name) {
+    char* text = tokText(name);
+    CheckVar* var = findCheckVar(text);
+    CheckType out = var->type;
+    if (out.type == IRType_None) {
+        STLSignature signature;
+        if (stlSignature(text, &signature)) out = signature.returns == ObjType_Nil ? TYPE(Proc) : TYPE(Func);
+        // a parameter of a function which is never called
+        else if (var->owner == NULL || !isParam(var->owner, text)) typeError(name, "Unknown variable %s!", text);
+    }
+    free(text);
+    return out;
+}
+
+//* ---------------- expressions ----------------
+
+STATIC CheckType checkExpr(Expression* expr);
+
+// Where to point at for an error about expr
+STATIC Token exprToken(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Binary: return expr->binary.operator;
+        case ExprTag_Call: return exprToken(expr->call.callee);
+        case ExprTag_Grouping: return exprToken(expr->grouping);
+        case ExprTag_Cached: return exprToken(expr->cached.expr);
+        case ExprTag_Primary: return expr->primary;
+        case ExprTag_Unary: return expr->unary.operator;
+        case ExprTag_Super: return expr->super.memberName;
+    }
+}
+
+STATIC char* operatorVerb(TokType operator) {
+    switch (operator) {
+        case Tok_Plus: return "add";
+        case Tok_Minus: return "subtract";
+        case Tok_Star: return "multiply";
+        case Tok_Slash: return "divide";
+        case Tok_Exp: return "exponentiate";
+        default: return "compare";
+    }
+}
+
+// The type of a op b, for anything but an assignment or AND/OR
+STATIC CheckType operationType(Token operator, CheckType a, CheckType b) {
+    bool mayBeNil = a.mayBeNil || b.mayBeNil;
+    switch (operator.type) {
+        case Tok_EqualEqual:
+        case Tok_BangEqual: {
+            if (a.type == IRType_Func || a.type == IRType_Proc || b.type == IRType_Func || b.type == IRType_Proc)
+                typeError(operator, "Can't check %s and %s for equality!", IRTypeToString(a.type), IRTypeToString(b.type));
+            return TYPE(Bool);
+        }
+        case Tok_Less:
+        case Tok_LessEqual:
+        case Tok_Greater:
+        case Tok_GreaterEqual: {
+            bool strings = a.type == IRType_String && b.type == IRType_String;
+            if (definite(a) && definite(b) && !(numeric(a) && numeric(b)) && !strings)
+                typeError(operator, "Can't compare %s and %s!", IRTypeToString(a.type), IRTypeToString(b.type));
+            return TYPE(Bool);
+        }
+        case Tok_Plus:
+        case Tok_Minus:
+        case Tok_Star:
+        case Tok_Slash:
+        case Tok_Exp: {
+            if (!definite(a) || !definite(b)) return (CheckType){.type = a.type == IRType_None || b.type == IRType_None ? IRType_None : IRType_Any};
+            if (operator.type == Tok_Plus && a.type == b.type && (a.type == IRType_String || a.type == IRType_Array)) {
+                return (CheckType){.type = a.type, .element = joinElements(a.element, b.element), .mayBeNil = mayBeNil};
+            }
+            if (numeric(a) && numeric(b)) return (CheckType){.type = a.type, .mayBeNil = mayBeNil};
+            typeError(operator, "Can't %s %s and %s!", operatorVerb(operator.type), IRTypeToString(a.type), IRTypeToString(b.type));
+            return TYPE(Any);
+        }
+        default: return TYPE(Any);
+    }
+}
+
+// The operator a compound assignment applies (+ for +=), or Tok_Equal
+STATIC TokType compoundOp(TokType operator) {
+    switch (operator) {
+        case Tok_ExpEqual: return Tok_Exp;
+        case Tok_StarEqual: return Tok_Star;
+        case Tok_SlashEqual: return Tok_Slash;
+        case Tok_PlusEqual: return Tok_Plus;
+        case Tok_MinusEqual: return Tok_Minus;
+        default: return Tok_Equal;
+    }
+}
+
+STATIC void checkIndices(CallExpr* access) {
+    FOREACH(ExprList, access->arguments, index) {
+        CheckType type = checkExpr(index);
+        if (definite(type) && type.type != IRType_Int)
+            typeError(exprToken(index), "Array indices must be Int, not %s!", IRTypeToString(type.type));
+    }
+}
+
+// The array an element access is indexing
+STATIC CheckType checkIndexed(CallExpr* access) {
+    CheckType array = checkExpr(access->callee);
+    checkIndices(access);
+    if (definite(array) && array.type != IRType_Array) typeError(exprToken(access->callee), "Can't index %s!", IRTypeToString(array.type));
+    return array;
+}
+
+STATIC CheckType checkAssignment(BinaryExpr* binary) {
+    TokType operator = binary->operator.type;
+    CheckType value = checkExpr(binary->b);
+    Expression* target = binary->a;
+    if (target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier) {
+        if (operator != Tok_Equal) {
+            Token applied = binary->operator;
+            applied.type = compoundOp(operator);
+            value = operationType(applied, readVar(target->primary), value);
+        }
+        assignCheckVar(target->primary, value);
+    } else if (target->tag == ExprTag_Call && target->call.tag == Call_Array) {
+        CheckType array = checkIndexed(&target->call);
+        if (operator != Tok_Equal) {
+            Token applied = binary->operator;
+            applied.type = compoundOp(operator);
+            value = operationType(applied, (CheckType){.type = array.type == IRType_Array ? array.element : IRType_Any, .mayBeNil = true}, value);
+        }
+        // the element type lives with the variable holding the array
+        Expression* root = target->call.callee;
+        if (root->tag == ExprTag_Primary && root->primary.type == Tok_Identifier && array.type == IRType_Array) {
+            assignCheckVar(root->primary, (CheckType){.type = IRType_Array, .element = value.type});
+        }
+    } else {
+        checkExpr(target);
+    }
+    return value;
+}
+
+STATIC CheckType checkCallExpr(CallExpr* call, Token at) {
+    CheckType callee = checkExpr(call->callee);
+    CheckType arguments[call->arguments.len];
+    for (int i = 0; i < call->arguments.len; i++) arguments[i] = checkExpr(&call->arguments.root[i]);
+
+    // natives
+    if (call->callee->tag == ExprTag_Primary && callee.function == NULL && (callee.type == IRType_Func || callee.type == IRType_Proc)) {
+        char* name = tokText(call->callee->primary);
+        STLSignature signature;
+        bool native = stlSignature(name, &signature) && findCheckVar(name)->type.type == IRType_None;
+        free(name);
+        if (native) {
+            // it calls the functions it's given with whatever it likes, which
+            // can't be seen from here
+            if (callsBack(signature)) {
+                for (int i = 0; i < call->arguments.len; i++) escape(arguments[i].function);
+            }
+            if (signature.arity != -1 && signature.arity != call->arguments.len) {
+                typeError(at, "Called %.*s with %i args instead of %i!", at.length, at.start, call->arguments.len, signature.arity);
+                return (CheckType){.type = fromObjType(signature.returns)};
+            }
+            // proven if every argument's definitely something the native takes
+            bool proven = true;
+            for (int i = 0; signature.arity != -1 && i < call->arguments.len; i++) {
+                int accepts = signature.params[i];
+                if (accepts == 0) continue;
+                ObjType type;
+                if (!toObjType(arguments[i].type, &type)) proven = false;
+                else if (!(accepts & (1 << type)))
+                    typeError(at, "Can't pass %s to %.*s!", IRTypeToString(arguments[i].type), at.length, at.start);
+                else if (arguments[i].mayBeNil && !(accepts & ACCEPTS(Nil))) proven = false;
+            }
+            call->arityProven = proven;
+            return (CheckType){.type = fromObjType(signature.returns)};
+        }
+    }
+
+    switch (callee.type) {
+        case IRType_Func: {
+            if (callee.function == NULL) return TYPE(Any);
+            FunDecl* decl = callee.function;
+            CheckFunction* func = findCheckFunction(decl);
+            if (call->arguments.len != decl->params.len) {
+                typeError(at, "Called function %.*s with %i args instead of %i!", decl->name.length, decl->name.start, call->arguments.len, decl->params.len);
+                return func->result;
+            }
+            // the parameters are the callee's own variables
+            CheckFunction* caller = currentFunction;
+            currentFunction = func;
+            CheckType byRef[call->arguments.len];
+            for (int i = 0; i < call->arguments.len; i++) {
+                assignCheckVar(decl->params.root[i].name, arguments[i]);
+                byRef[i] = readVar(decl->params.root[i].name);
+            }
+            currentFunction = caller;
+            // writes to the elements of an array passed by reference go
+            // through to the caller's
+            for (int i = 0; i < call->arguments.len; i++) {
+                Expression* argument = &call->arguments.root[i];
+                if (
+                    decl->params.root[i].passMode == Param_byRef &&
+                    argument->tag == ExprTag_Primary && argument->primary.type == Tok_Identifier
+                ) assignCheckVar(argument->primary, byRef[i]);
+            }
+            if (reporting) call->arityProven = true;
+            return func->result;
+        }
+        case IRType_Proc: return TYPE(Nil);
+        case IRType_None:
+        case IRType_Any: return callee;
+        default: {
+            typeError(at, "Can't call %s!", IRTypeToString(callee.type));
+            return TYPE(Any);
+        }
+    }
+}
+
+STATIC CheckType checkExpr(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Binary: {
+            BinaryExpr* binary = &expr->binary;
+            TokType operator = binary->operator.type;
+            if (operator == Tok_Equal || compoundOp(operator) != Tok_Equal) return checkAssignment(binary);
+            CheckType a = checkExpr(binary->a);
+            CheckType b = checkExpr(binary->b);
+            if (operator == Tok_And || operator == Tok_Or) return TYPE(Bool);
+            CheckType out = operationType(binary->operator, a, b);
+            if (
+                reporting && operator != Tok_Exp && proven(a) && proven(b) &&
+                a.type == b.type && numeric(a)
+            ) binary->operandType = a.type == IRType_Int ? ObjType_Int : ObjType_Float;
+            return out;
+        }
+        case ExprTag_Call: {
+            switch (expr->call.tag) {
+                case Call_Call: return checkCallExpr(&expr->call, exprToken(expr));
+                case Call_Array: {
+                    CheckType array = checkIndexed(&expr->call);
+                    if (array.type != IRType_Array) return array.type == IRType_None ? UNKNOWN : TYPE(Any);
+                    return (CheckType){.type = array.element == IRType_None ? IRType_Any : array.element, .mayBeNil = true};
+                }
+                case Call_GetMember: {
+                    checkExpr(expr->call.callee);
+                    return TYPE(Any);
+                }
+            }
+        }
+        case ExprTag_Unary: {
+            checkExpr(expr->unary.operand);
+            return TYPE(Any);
+        }
+        case ExprTag_Super: return TYPE(Any);
+        case ExprTag_Grouping: return checkExpr(expr->grouping);
+        case ExprTag_Cached: return checkExpr(expr->cached.expr);
+        case ExprTag_Primary: {
+            switch (expr->primary.type) {
+                case Tok_Identifier: return readVar(expr->primary);
+                case Tok_Nil: return TYPE(Nil);
+                case Tok_True:
+                case Tok_False: return TYPE(Bool);
+                case Tok_StringLit: return TYPE(String);
+                case Tok_IntLit: return TYPE(Int);
+                case Tok_FloatLit: return TYPE(Float);
+                default: return TYPE(Any);
+            }
+        }
+    }
+}
+
+//* ---------------- statements ----------------
+
+STATIC void checkBlock(DeclList* decls);
+
+STATIC void checkCondition(ConditionalBlock* conditional) {
+    checkExpr(&conditional->condition);
+    checkBlock(conditional->block);
+}
+
+STATIC void checkStmt(Statement* stmt) {
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            checkExpr(&stmt->expr);
+            break;
+        }
+        case StmtTag_Global: {
+            CheckFunction* outer = currentFunction;
+            currentFunction = NULL;
+            CheckType value = checkExpr(&stmt->global.initializer);
+            assignCheckVar(stmt->global.name, value);
+            currentFunction = outer;
+            break;
+        }
+        case StmtTag_For: {
+            CheckType min = checkExpr(&stmt->for_.min);
+            CheckType max = checkExpr(&stmt->for_.max);
+            if (definite(min) && !numeric(min)) typeError(stmt->for_.iterator, "Can't loop from %s!", IRTypeToString(min.type));
+            if (definite(max) && !numeric(max)) typeError(stmt->for_.iterator, "Can't loop to %s!", IRTypeToString(max.type));
+            assignCheckVar(stmt->for_.iterator, min);
+            checkBlock(stmt->for_.block);
+            break;
+        }
+        case StmtTag_While: {
+            checkCondition(&stmt->while_);
+            break;
+        }
+        case StmtTag_Do: {
+            checkCondition(&stmt->do_);
+            break;
+        }
+        case StmtTag_If: {
+            checkCondition(&stmt->if_.primary);
+            FOREACH(ElseIfList, stmt->if_.secondary, elseIf) checkCondition(elseIf);
+            if (stmt->if_.hasElse) checkCondition(&stmt->if_.else_);
+            break;
+        }
+        // not implemented by the interpreter
+        case StmtTag_Switch: break;
+        case StmtTag_Array: {
+            FOREACH(ArrayDimensions, stmt->array.dimensions, dim) {
+                CheckType type = checkExpr(dim);
+                if (definite(type) && type.type != IRType_Int)
+                    typeError(stmt->array.name, "Array dimensions must be Int, not %s!", IRTypeToString(type.type));
+            }
+            assignCheckVar(stmt->array.name, TYPE(Array));
+            break;
+        }
+    }
+}
+
+STATIC void checkDecl(Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            assignCheckVar(decl->fun.name, (CheckType){.type = IRType_Func, .function = &decl->fun});
+            break;
+        }
+        case DeclTag_Proc: {
+            assignCheckVar(decl->proc.name, TYPE(Proc));
+            break;
+        }
+        case DeclTag_Stmt: {
+            checkStmt(&decl->stmt);
+            break;
+        }
+        case DeclTag_Class: break;
+    }
+}
+
+STATIC void checkBlock(DeclList* decls) {
+    for (int i = 0; i < decls->len; i++) checkDecl(&decls->root[i]);
+}
+
+STATIC void checkFunctionBody(CheckFunction* func) {
+    currentFunction = func;
+    FunDecl* decl = func->decl;
+    if (func->escaped) {
+        FOREACH(ParamList, decl->params, param) assignCheckVar(param->name, TYPE(Any));
+    }
+    bool returns = false;
+    FOREACH(FuncDeclList, decl->block, currentDOR) {
+        if (currentDOR->tag == DOR_return) {
+            widen(&func->result, checkExpr(&currentDOR->return_));
+            returns = true;
+            break;
+        }
+        checkDecl(currentDOR->declaration);
+    }
+    if (!returns) typeError(decl->name, "Function %.*s must return a value!", decl->name.length, decl->name.start);
+    currentFunction = NULL;
+}
+
+//* ---------------- names ----------------
+
+STATIC void collectBlock(DeclList* decls, CheckNameList* assigned);
+
+STATIC void collectExpr(Expression* expr, CheckNameList* assigned) {
+    switch (expr->tag) {
+        case ExprTag_Binary: {
+            Expression* target = expr->binary.a;
+            TokType operator = expr->binary.operator.type;
+            if (
+                (operator == Tok_Equal || compoundOp(operator) != Tok_Equal) &&
+                target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier
+            ) addName(assigned, target->primary);
+            collectExpr(expr->binary.a, assigned);
+            collectExpr(expr->binary.b, assigned);
+            break;
+        }
+        case ExprTag_Call: {
+            collectExpr(expr->call.callee, assigned);
+            if (expr->call.tag != Call_GetMember) {
+                FOREACH(ExprList, expr->call.arguments, arg) collectExpr(arg, assigned);
+            }
+            break;
+        }
+        case ExprTag_Unary: collectExpr(expr->unary.operand, assigned); break;
+        case ExprTag_Grouping: collectExpr(expr->grouping, assigned); break;
+        case ExprTag_Cached: collectExpr(expr->cached.expr, assigned); break;
+        default: break;
+    }
+}
+
+// Everything a block assigns to, & every function declared in it (at any
+// depth) - global statements always go into globals
+STATIC void collectDecl(Declaration* decl, CheckNameList* assigned) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            addName(assigned, decl->fun.name);
+            CheckNameList locals;
+            INIT(locals);
+            FOREACH(ParamList, decl->fun.params, param) addName(&locals, param->name);
+            FOREACH(FuncDeclList, decl->fun.block, currentDOR) {
+                if (currentDOR->tag == DOR_return) collectExpr(&currentDOR->return_, &locals);
+                else collectDecl(currentDOR->declaration, &locals);
+            }
+            APPEND(checkFunctions, ((CheckFunction){.decl = &decl->fun, .locals = locals, .result = UNKNOWN}));
+            break;
+        }
+        case DeclTag_Proc: addName(assigned, decl->proc.name); break;
+        case DeclTag_Class: break;
+        case DeclTag_Stmt: {
+            Statement* stmt = &decl->stmt;
+            switch (stmt->tag) {
+                case StmtTag_Expr: collectExpr(&stmt->expr, assigned); break;
+                case StmtTag_Global: {
+                    addName(&globals, stmt->global.name);
+                    collectExpr(&stmt->global.initializer, assigned);
+                    break;
+                }
+                case StmtTag_For: {
+                    addName(assigned, stmt->for_.iterator);
+                    collectExpr(&stmt->for_.min, assigned);
+                    collectExpr(&stmt->for_.max, assigned);
+                    collectBlock(stmt->for_.block, assigned);
+                    break;
+                }
+                case StmtTag_While:
+                case StmtTag_Do: {
+                    ConditionalBlock* loop = stmt->tag == StmtTag_While ? &stmt->while_ : &stmt->do_;
+                    collectExpr(&loop->condition, assigned);
+                    collectBlock(loop->block, assigned);
+                    break;
+                }
+                case StmtTag_If: {
+                    collectExpr(&stmt->if_.primary.condition, assigned);
+                    collectBlock(stmt->if_.primary.block, assigned);
+                    FOREACH(ElseIfList, stmt->if_.secondary, elseIf) {
+                        collectExpr(&elseIf->condition, assigned);
+                        collectBlock(elseIf->block, assigned);
+                    }
+                    if (stmt->if_.hasElse) {
+                        collectExpr(&stmt->if_.else_.condition, assigned);
+                        collectBlock(stmt->if_.else_.block, assigned);
+                    }
+                    break;
+                }
+                case StmtTag_Switch: break;
+                case StmtTag_Array: addName(assigned, stmt->array.name); break;
+            }
+            break;
+        }
+    }
+}
+
+STATIC void collectBlock(DeclList* decls, CheckNameList* assigned) {
+    for (int i = 0; i < decls->len; i++) collectDecl(&decls->root[i], assigned);
+}
+
+//* ---------------- driver ----------------
+
+// Check everything once
+STATIC void checkProgram(DeclList* program) {
+    currentFunction = NULL;
+    checkBlock(program);
+    for (int i = 0; i < checkFunctions.len; i++) checkFunctionBody(&checkFunctions.root[i]);
+}
+
+CheckOutput check(DeclList* program) {
+    CheckOutput out;
+    INIT(out.errors);
+    errors = &out.errors;
+    INIT(vars);
+    INIT(checkFunctions);
+    INIT(globals);
+
+    collectBlock(program, &globals);
+    // a function's locals are whatever it assigns to which isn't a global -
+    // its parameters always are though
+    FOREACH(CheckFunctionList, checkFunctions, func) {
+        int kept = 0;
+        for (int i = 0; i < func->locals.len; i++) {
+            char* name = func->locals.root[i];
+            if (i < func->decl->params.len || !hasName(&globals, name)) func->locals.root[kept++] = name;
+            else free(name);
+        }
+        func->locals.len = kept;
+    }
+
+    // types only ever get wider, so this settles
+    reporting = false;
+    do {
+        changed = false;
+        checkProgram(program);
+    } while (changed);
+    reporting = true;
+    checkProgram(program);
+    reporting = false;
+
+    FOREACH(CheckVarList, vars, var) free(var->name);
+    DESTROY(vars);
+    FOREACH(CheckFunctionList, checkFunctions, func) {
+        FOREACH(CheckNameList, func->locals, name) free(*name);
+        DESTROY(func->locals);
+    }
+    DESTROY(checkFunctions);
+    FOREACH(CheckNameList, globals, name) free(*name);
+    DESTROY(globals);
+    return out;
+}
+
+void destroyCheckOutput(CheckOutput co) {
+    FOREACH(CheckErrList, co.errors, error) free(error->msg);
+    DESTROY(co.errors);
+}
\ No newline at end of file
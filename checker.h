@@ -0,0 +1,29 @@
+#pragma once
+
+#include "parser.h"
+#include "vector.h"
+
+// The "check" step for extended (.ocrx) programs - infers a type for every
+// variable, function parameter & return value, & reports anything which
+// would be a type error at runtime before the program ever starts.
+//
+// Inference is flow-insensitive: a variable has one type, which is whatever
+// it's ever assigned, so assigning it something else is an error. Where
+// types are proven it annotates the AST (see BinaryExpr & CallExpr) so the
+// interpreter can skip its tag & arity checks.
+
+typedef struct {
+    Token tok;
+    // allocated
+    char* msg;
+} CheckError;
+
+DECL_VEC(CheckError, CheckErrList)
+
+typedef struct {
+    CheckErrList errors;
+} CheckOutput;
+
+// Errors are printed as they're found
+CheckOutput check(DeclList* program);
+void destroyCheckOutput(CheckOutput co);
\ No newline at end of file
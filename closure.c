@@ -0,0 +1,800 @@
+#include "closure.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "panic.h"
+#include "runtime.h"
+#include "array.h"
+#include "jit.h"
+#include "parallel.h"
+
+#define NEW_CLOSURE(fn) newClosure(fn, #fn)
+
+STATIC Closure* newClosure(ClosureFn fn, char* name) {
+    Closure* out = calloc(1, sizeof(Closure));
+    out->fn = fn;
+    out->name = name;
+    return out;
+}
+
+#define RUN(closure) runClosure(closure)
+
+// Run a whole block in the current scope
+STATIC INLINE void runDecls(Closure* block) {
+    for (int i = 0; i < block->childCount; i++) RUN(block->children[i]);
+}
+
+STATIC INLINE bool runCondition(Closure* condition) {
+    newCacheGeneration();
+    InterpreterObj value = RUN(condition);
+    bool out = isTruthy(value);
+    freeObj(value);
+    return out;
+}
+
+// Overwrite a variable, keeping hold of whether its name needs freeing
+STATIC INLINE void storeInSlot(InterpreterObj* slot, InterpreterObj value) {
+    value._nameAllocated = slot->_nameAllocated;
+    freeObj(*slot);
+    *slot = value;
+}
+
+// What an assignment actually stores - never a reference, & b = a means
+// both names share the array until one of them writes to it
+STATIC INLINE InterpreterObj valueToStore(InterpreterObj value) {
+    if (value.tag == ObjType_Ref) return copyObj(IOAbs(value));
+    return value;
+}
+
+//* ---------------- values ----------------
+
+STATIC InterpreterObj load_const(Closure* self) {
+    return self->constant;
+}
+
+STATIC InterpreterObj load_var(Closure* self) {
+    InterpreterObj* obj = findObj(self->text);
+    if (obj == NULL) panic(PANIC_CATCHABLE(Panic_Interpreter, PCC_InterpreterUnknownVar), "Unknown variable %s!", self->text);
+    return IOBJ(.tag = ObjType_Ref, .reference = obj);
+}
+
+STATIC InterpreterObj cached_value(Closure* self) {
+    InterpreterObj out;
+    if (cacheGet(self->slot, &out)) return out;
+    out = RUN(self->a);
+    cacheSet(self->slot, out);
+    return out;
+}
+
+// self->text is the whole message
+STATIC InterpreterObj unsupported(Closure* self) {
+    panic(Panic_Interpreter, "%s", self->text);
+}
+
+//* ---------------- operators ----------------
+
+STATIC InterpreterObj binary_any(Closure* self) {
+    InterpreterObj a = RUN(self->a);
+    InterpreterObj b = RUN(self->b);
+    InterpreterObj out = self->op(a, b);
+    freeObj(a);
+    freeObj(b);
+    return out;
+}
+
+// same as NUMERIC_OP for an int & an int - the arithmetic goes through floats
+#define INT_CONST_OP(name, op, generic) STATIC InterpreterObj name(Closure* self) { \
+    InterpreterObj a = RUN(self->a); \
+    InterpreterObj aAbs = IOAbs(a); \
+    if (aAbs.tag == ObjType_Int) { \
+        float aNum = aAbs.int_; \
+        int bNum = self->constant.int_; \
+        return IOBJ(.tag = ObjType_Int, .int_ = op); \
+    } \
+    InterpreterObj out = generic(a, self->constant); \
+    freeObj(a); \
+    return out; \
+}
+
+INT_CONST_OP(add_int_const, aNum + bNum, add)
+INT_CONST_OP(subtract_int_const, aNum - bNum, subtract)
+INT_CONST_OP(multiply_int_const, aNum * bNum, multiply)
+
+#define COMPARISON(name, fn) \
+STATIC InterpreterObj name##_any(Closure* self) { \
+    InterpreterObj a = RUN(self->a); \
+    InterpreterObj b = RUN(self->b); \
+    bool out = fn(a, b); \
+    freeObj(a); \
+    freeObj(b); \
+    return IOBJ(.tag = ObjType_Bool, .bool_ = out); \
+}
+
+COMPARISON(equal, equal)
+COMPARISON(less, less)
+COMPARISON(lessEqual, lessEqual)
+COMPARISON(greater, greater)
+COMPARISON(greaterEqual, greaterEqual)
+
+STATIC InterpreterObj notEqual_any(Closure* self) {
+    InterpreterObj out = equal_any(self);
+    out.bool_ = !out.bool_;
+    return out;
+}
+
+#define INT_CONST_COMPARISON(name, op, generic) STATIC InterpreterObj name(Closure* self) { \
+    InterpreterObj a = RUN(self->a); \
+    InterpreterObj aAbs = IOAbs(a); \
+    if (aAbs.tag == ObjType_Int) return IOBJ(.tag = ObjType_Bool, .bool_ = aAbs.int_ op self->constant.int_); \
+    bool out = generic(a, self->constant); \
+    freeObj(a); \
+    return IOBJ(.tag = ObjType_Bool, .bool_ = out); \
+}
+
+INT_CONST_COMPARISON(equal_int_const, ==, equal)
+INT_CONST_COMPARISON(less_int_const, <, less)
+INT_CONST_COMPARISON(lessEqual_int_const, <=, lessEqual)
+INT_CONST_COMPARISON(greater_int_const, >, greater)
+INT_CONST_COMPARISON(greaterEqual_int_const, >=, greaterEqual)
+
+STATIC InterpreterObj logical_and(Closure* self) {
+    InterpreterObj a = RUN(self->a);
+    bool out = isTruthy(a);
+    freeObj(a);
+    if (out) {
+        InterpreterObj b = RUN(self->b);
+        out = isTruthy(b);
+        freeObj(b);
+    }
+    return IOBJ(.tag = ObjType_Bool, .bool_ = out);
+}
+
+STATIC InterpreterObj logical_or(Closure* self) {
+    InterpreterObj a = RUN(self->a);
+    bool out = isTruthy(a);
+    freeObj(a);
+    if (!out) {
+        InterpreterObj b = RUN(self->b);
+        out = isTruthy(b);
+        freeObj(b);
+    }
+    return IOBJ(.tag = ObjType_Bool, .bool_ = out);
+}
+
+//* ---------------- arrays ----------------
+
+// children are the indices, call has the optimiser's annotations
+STATIC int elementOffset(ArrayObj* array, Closure* access) {
+    if (access->childCount > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Too many array indices! (%i)", access->childCount);
+    int uncheckedDims = access->call->uncheckedDims;
+    int evaluated[ARRAY_MAX_RANK];
+    for (int i = 0; i < access->childCount; i++) {
+        InterpreterObj index = IOAbs(RUN(access->children[i]));
+        if (!(uncheckedDims & (1 << i)) && index.tag != ObjType_Int)
+            panic(Panic_Interpreter, "Array indices must be ints, not %s!", ObjTypeToString(index.tag));
+        evaluated[i] = index.int_;
+    }
+    return arrayOffset(array, evaluated, access->childCount, uncheckedDims);
+}
+
+STATIC InterpreterObj load_element(Closure* self) {
+    InterpreterObj obj = IOAbs(RUN(self->a));
+    if (obj.tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(obj.tag));
+    return arrayGet(obj.array, elementOffset(obj.array, self));
+}
+
+// see arrayForWriteFromExpr
+STATIC ArrayObj* arrayForWriteFromClosure(Closure* target) {
+    InterpreterObj* slot;
+    if (target->fn == load_element) {
+        ArrayObj* outer = arrayForWriteFromClosure(target->a);
+        InterpreterObj elem = arrayGet(outer, elementOffset(outer, target));
+        if (elem.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(elem.tag));
+        slot = elem.reference;
+    } else {
+        InterpreterObj obj = RUN(target);
+        if (obj.tag != ObjType_Ref) {
+            if (obj.tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(obj.tag));
+            return obj.array;
+        }
+        slot = obj.reference;
+    }
+    while (slot->tag == ObjType_Ref) slot = slot->reference;
+    if (slot->tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(slot->tag));
+    return arrayForWrite(&slot->array);
+}
+
+//* ---------------- assignment ----------------
+
+// a = b, for a variable a (which might not exist yet)
+STATIC InterpreterObj store_var(Closure* self) {
+    InterpreterObj value = valueToStore(RUN(self->b));
+    InterpreterObj* slot = findObj(self->text);
+    // like the interpreter, this rebinds a by-reference parameter rather
+    // than writing to the caller's variable - only writes to its elements go
+    // through
+    if (slot != NULL) {
+        storeInSlot(slot, value);
+    } else {
+        value._nameAllocated = true;
+        slot = ObjNSSet(&currentScope->objects, strdup(self->text), value);
+    }
+    return IOBJ(.tag = ObjType_Ref, .reference = slot);
+}
+
+// a[i] = b - self->a is the load_element for a[i]
+STATIC InterpreterObj store_element(Closure* self) {
+    InterpreterObj value = valueToStore(RUN(self->b));
+    ArrayObj* array = arrayForWriteFromClosure(self->a->a);
+    int offset = elementOffset(array, self->a);
+    arraySet(array, offset, value);
+    return arrayGet(array, offset);
+}
+
+// anything else which evaluates to a reference
+STATIC InterpreterObj store_ref(Closure* self) {
+    InterpreterObj target = RUN(self->a);
+    if (target.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't assign - not an lvalue!");
+    storeInSlot(target.reference, valueToStore(RUN(self->b)));
+    return target;
+}
+
+//* ---------------- calls ----------------
+
+// function bodies - children are the declarations before the return, a is
+// the return value & names are the parameter names
+STATIC InterpreterObj call_function(Closure* self, FunDecl func) {
+    if (self->childCount != func.params.len)
+        panic(Panic_Interpreter, "Called function %s with %i args instead of %i", tokText(func.name), self->childCount, func.params.len);
+
+    // arguments are evaluated in the caller's scope
+    InterpreterObj args[self->childCount];
+    for (int i = 0; i < self->childCount; i++) args[i] = RUN(self->children[i]);
+
+    Closure* body = func.compiled;
+    // declared by the interpreter - this is a tiered program (see tier.h)
+    if (body == NULL) return interpretCall(func, self->call, args);
+
+    InterpreterObj out;
+    if (jitCall(func, args, self->childCount, &out)) {
+        for (int i = 0; i < self->childCount; i++) freeObj(args[i]);
+        return out;
+    }
+
+    Scope* executionScope = newScope();
+    // no closures for you!! (not that kind, anyway)
+    executionScope->parent = globalScope;
+
+    for (int i = 0; i < self->childCount; i++) {
+        InterpreterObj arg = args[i];
+        if (func.params.root[i].passMode == Param_byRef) {
+            if (arg.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't pass a temporary by reference!");
+        } else {
+            InterpreterObj value = copyObj(IOAbs(arg));
+            freeObj(arg);
+            arg = value;
+        }
+        arg._nameAllocated = true;
+        ObjNSSet(&executionScope->objects, strdup(body->names[i]), arg);
+    }
+
+    Scope* outerScope = currentScope;
+    currentScope = executionScope;
+
+    out = runFunctionBody(body, func);
+
+    destroyScope(executionScope);
+    currentScope = outerScope;
+    return out;
+}
+
+InterpreterObj runFunctionBody(Closure* body, FunDecl func) {
+    runDecls(body);
+    if (body->a == NULL) panic(Panic_Interpreter, "Function %s must return a value!", tokText(func.name));
+    newCacheGeneration();
+    InterpreterObj out = RUN(body->a);
+    // returning a local - it needs to outlive the scope!
+    if (out.tag == ObjType_Ref) out = copyObj(IOAbs(out));
+    return out;
+}
+
+STATIC InterpreterObj call_any(Closure* self) {
+    InterpreterObj callee = IOAbs(RUN(self->a));
+    switch (callee.tag) {
+        case ObjType_Func: return call_function(self, callee.func);
+        case ObjType_Proc: return IOBJ(.tag = ObjType_Nil);
+        case ObjType_NativeFunc:
+        case ObjType_NativeProc: {
+            int argc = self->childCount;
+            InterpreterObj stackArgs[NATIVE_STACK_ARGS];
+            InterpreterObj* args = argc <= NATIVE_STACK_ARGS ? stackArgs : malloc(argc * sizeof(InterpreterObj));
+            for (int i = 0; i < argc; i++) args[i] = RUN(self->children[i]);
+            InterpreterObj out = callNative(callee, args, argc, self->call->arityProven);
+            if (args != stackArgs) free(args);
+            return out;
+        }
+        default: panic(Panic_Interpreter, "Can't call a %s!", ObjTypeToString(callee.tag));
+    }
+}
+
+// receiver.name(...) - self->a is the receiver, & self->text the name
+STATIC InterpreterObj call_method(Closure* self) {
+    int argc = self->childCount + 1;
+    InterpreterObj stackArgs[NATIVE_STACK_ARGS];
+    InterpreterObj* args = argc <= NATIVE_STACK_ARGS ? stackArgs : malloc(argc * sizeof(InterpreterObj));
+    args[0] = RUN(self->a);
+    for (int i = 1; i < argc; i++) args[i] = RUN(self->children[i - 1]);
+    InterpreterObj out = callMethod(self->text, strlen(self->text), args, argc);
+    if (args != stackArgs) free(args);
+    return out;
+}
+
+//* ---------------- statements ----------------
+
+STATIC InterpreterObj expr_stmt(Closure* self) {
+    newCacheGeneration();
+    freeObj(RUN(self->a));
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj global_stmt(Closure* self) {
+    newCacheGeneration();
+    InterpreterObj value = RUN(self->a);
+    ObjNSSet(&globalScope->objects, strdup(self->text), value);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+// One iteration of a parallel loop, on one of its threads
+STATIC void runParallelBody(void* block) {
+    runDecls(block);
+}
+
+STATIC InterpreterObj for_loop(Closure* self) {
+    if (self->for_->parallel && parallelFor(self->for_, runParallelBody, self->children[0])) return IOBJ(.tag = ObjType_Nil);
+    pushScope();
+    InterpreterObj min = RUN(self->a);
+    InterpreterObj* iterator = setVar(strdup(self->text), valueToStore(min), true);
+
+    InterpreterObj max = RUN(self->b);
+    proveIndices(*self->for_, *iterator, max);
+    freeObj(max);
+
+    while (true) {
+        // declarations in the block can move the iterator - look it up again
+        iterator = findObj(self->text);
+        max = RUN(self->b);
+        bool inRange = less(*iterator, max);
+        freeObj(max);
+        if (!inRange) break;
+
+        runDecls(self->children[0]);
+
+        iterator = findObj(self->text);
+        while (iterator->tag == ObjType_Ref) iterator = iterator->reference;
+        if (iterator->tag == ObjType_Int) {
+            float aNum = iterator->int_;
+            iterator->int_ = aNum + 1;
+        } else {
+            storeInSlot(iterator, add(*iterator, IOBJ(.tag = ObjType_Int, .int_ = 1)));
+        }
+    }
+
+    forgetIndices(*self->for_);
+    popScope();
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj while_loop(Closure* self) {
+    while (runCondition(self->a)) runDecls(self->children[0]);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+//* yikes!! not a do-while but a do-until!
+STATIC InterpreterObj do_loop(Closure* self) {
+    while (!runCondition(self->a)) runDecls(self->children[0]);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+// children alternate condition, block, condition, block... - the else is
+// just the last pair
+STATIC InterpreterObj if_stmt(Closure* self) {
+    for (int i = 0; i < self->childCount; i += 2) {
+        if (runCondition(self->children[i])) {
+            runDecls(self->children[i + 1]);
+            break;
+        }
+    }
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj array_decl(Closure* self) {
+    if (self->childCount > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Arrays can have at most %i dimensions!", ARRAY_MAX_RANK);
+    int dims[ARRAY_MAX_RANK];
+    for (int i = 0; i < self->childCount; i++) {
+        InterpreterObj dim = IOAbs(RUN(self->children[i]));
+        if (dim.tag != ObjType_Int) panic(Panic_Interpreter, "Array dimensions must be ints, not %s!", ObjTypeToString(dim.tag));
+        dims[i] = dim.int_;
+    }
+    // redeclaring - get rid of the old one
+    InterpreterObj* existing = findObj(self->text);
+    if (existing != NULL) freeObj(*existing);
+    setVar(strdup(self->text), IOBJ(
+        .tag = ObjType_Array,
+        .array = newArray(self->childCount, dims)
+    ), true);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj nop(Closure* self) {
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj fun_decl(Closure* self) {
+    setVar(strdup(self->text), IOBJ(.tag = ObjType_Func, .func = *self->fun), true);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj proc_decl(Closure* self) {
+    setVar(strdup(self->text), IOBJ(.tag = ObjType_Proc, .proc = *self->proc), true);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+STATIC InterpreterObj decl_block(Closure* self) {
+    runDecls(self);
+    return IOBJ(.tag = ObjType_Nil);
+}
+
+//* ---------------- compiler ----------------
+
+STATIC void compileChildren(Closure* closure, ExprList exprs) {
+    closure->childCount = exprs.len;
+    closure->children = malloc(exprs.len * sizeof(Closure*));
+    for (int i = 0; i < exprs.len; i++) closure->children[i] = compileExpr(&exprs.root[i]);
+}
+
+STATIC bool isIntLiteral(Expression* expr) {
+    while (expr->tag == ExprTag_Grouping) expr = expr->grouping;
+    return expr->tag == ExprTag_Primary && expr->primary.type == Tok_IntLit;
+}
+
+STATIC int intLiteral(Expression* expr) {
+    while (expr->tag == ExprTag_Grouping) expr = expr->grouping;
+    char* text = tokText(expr->primary);
+    int out = atoi(text);
+    free(text);
+    return out;
+}
+
+STATIC Closure* compileAssignment(Expression* target, Closure* value) {
+    Closure* out;
+    while (target->tag == ExprTag_Grouping) target = target->grouping;
+    if (target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier) {
+        out = NEW_CLOSURE(store_var);
+        out->text = tokText(target->primary);
+    } else if (target->tag == ExprTag_Call && target->call.tag == Call_Array) {
+        out = NEW_CLOSURE(store_element);
+        out->a = compileExpr(target);
+    } else {
+        out = NEW_CLOSURE(store_ref);
+        out->a = compileExpr(target);
+    }
+    out->b = value;
+    return out;
+}
+
+// The operator a compound assignment applies (+ for +=), or just operator
+STATIC TokType appliedOperator(TokType operator) {
+    switch (operator) {
+        case Tok_ExpEqual: return Tok_Exp;
+        case Tok_StarEqual: return Tok_Star;
+        case Tok_SlashEqual: return Tok_Slash;
+        case Tok_PlusEqual: return Tok_Plus;
+        case Tok_MinusEqual: return Tok_Minus;
+        default: return operator;
+    }
+}
+
+// NULL if there's no specialised node for this operator
+STATIC Closure* intConstClosure(TokType operator) {
+    switch (operator) {
+        case Tok_Plus: return NEW_CLOSURE(add_int_const);
+        case Tok_Minus: return NEW_CLOSURE(subtract_int_const);
+        case Tok_Star: return NEW_CLOSURE(multiply_int_const);
+        case Tok_EqualEqual: return NEW_CLOSURE(equal_int_const);
+        case Tok_Less: return NEW_CLOSURE(less_int_const);
+        case Tok_LessEqual: return NEW_CLOSURE(lessEqual_int_const);
+        case Tok_Greater: return NEW_CLOSURE(greater_int_const);
+        case Tok_GreaterEqual: return NEW_CLOSURE(greaterEqual_int_const);
+        default: return NULL;
+    }
+}
+
+STATIC Closure* genericClosure(TokType operator) {
+    Closure* out;
+    switch (operator) {
+        case Tok_Or: return NEW_CLOSURE(logical_or);
+        case Tok_And: return NEW_CLOSURE(logical_and);
+
+        case Tok_EqualEqual: return NEW_CLOSURE(equal_any);
+        case Tok_BangEqual: return NEW_CLOSURE(notEqual_any);
+        case Tok_Less: return NEW_CLOSURE(less_any);
+        case Tok_LessEqual: return NEW_CLOSURE(lessEqual_any);
+        case Tok_Greater: return NEW_CLOSURE(greater_any);
+        case Tok_GreaterEqual: return NEW_CLOSURE(greaterEqual_any);
+
+        case Tok_Exp: out = NEW_CLOSURE(binary_any); out->op = iExponent; return out;
+        case Tok_Star: out = NEW_CLOSURE(binary_any); out->op = multiply; return out;
+        case Tok_Slash: out = NEW_CLOSURE(binary_any); out->op = divide; return out;
+        case Tok_Plus: out = NEW_CLOSURE(binary_any); out->op = add; return out;
+        case Tok_Minus: out = NEW_CLOSURE(binary_any); out->op = subtract; return out;
+
+        default: panic(Panic_Interpreter, "Unknown binary operator!");
+    }
+}
+
+STATIC Closure* compileBinary(BinaryExpr binary) {
+    if (binary.operator.type == Tok_Equal) return compileAssignment(binary.a, compileExpr(binary.b));
+
+    TokType operator = appliedOperator(binary.operator.type);
+    Closure* out = isIntLiteral(binary.b) ? intConstClosure(operator) : NULL;
+    if (out != NULL) {
+        out->a = compileExpr(binary.a);
+        out->constant = IOBJ(.tag = ObjType_Int, .int_ = intLiteral(binary.b));
+    } else {
+        out = genericClosure(operator);
+        out->a = compileExpr(binary.a);
+        out->b = compileExpr(binary.b);
+    }
+
+    // a += b is a = a + b
+    if (operator != binary.operator.type) return compileAssignment(binary.a, out);
+    return out;
+}
+
+STATIC Closure* compilePrimary(Token primary) {
+    if (primary.type == Tok_Identifier) {
+        Closure* out = NEW_CLOSURE(load_var);
+        out->text = tokText(primary);
+        return out;
+    }
+
+    Closure* out = NEW_CLOSURE(load_const);
+    switch (primary.type) {
+        case Tok_Nil: out->constant = IOBJ(.tag = ObjType_Nil); break;
+        case Tok_True:
+        case Tok_False: out->constant = IOBJ(.tag = ObjType_Bool, .bool_ = primary.type == Tok_True); break;
+        case Tok_StringLit: {
+            // strip leading & trailing quotes!
+            out->constant = IOBJ(
+                .tag = ObjType_String,
+                .string = (StringObj){
+                    .start = primary.start + 1,
+                    .length = primary.length - 2
+                }
+            );
+            break;
+        }
+        case Tok_IntLit:
+        case Tok_FloatLit: {
+            char* text = tokText(primary);
+            if (primary.type == Tok_IntLit) out->constant = IOBJ(.tag = ObjType_Int, .int_ = atoi(text));
+            else out->constant = IOBJ(.tag = ObjType_Float, .float_ = strtof(text, NULL));
+            free(text);
+            break;
+        }
+        // todo: handle self
+        default: {
+            out->fn = unsupported;
+            out->name = "unsupported";
+            out->text = malloc(primary.length + sizeof(" isn't supported yet!"));
+            sprintf(out->text, "%.*s isn't supported yet!", primary.length, primary.start);
+            break;
+        }
+    }
+    return out;
+}
+
+STATIC Closure* unsupportedClosure(char* what) {
+    Closure* out = NEW_CLOSURE(unsupported);
+    out->text = strdup(what);
+    return out;
+}
+
+STATIC Closure* compileMethodCall(CallExpr* member) {
+    Closure* out = NEW_CLOSURE(call_method);
+    out->a = compileExpr(member->callee);
+    out->text = tokText(member->memberName);
+    return out;
+}
+
+Closure* compileExpr(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: return unsupportedClosure(UNARY_UNSUPPORTED);
+        case ExprTag_Binary: return compileBinary(expr->binary);
+        case ExprTag_Call: {
+            switch (expr->call.tag) {
+                case Call_Call: {
+                    if (expr->call.callee->tag == ExprTag_Call && expr->call.callee->call.tag == Call_GetMember) {
+                        Closure* out = compileMethodCall(&expr->call.callee->call);
+                        compileChildren(out, expr->call.arguments);
+                        return out;
+                    }
+                    Closure* out = NEW_CLOSURE(call_any);
+                    out->a = compileExpr(expr->call.callee);
+                    compileChildren(out, expr->call.arguments);
+                    out->call = &expr->call;
+                    return out;
+                }
+                case Call_Array: {
+                    Closure* out = NEW_CLOSURE(load_element);
+                    out->a = compileExpr(expr->call.callee);
+                    compileChildren(out, expr->call.arguments);
+                    out->call = &expr->call;
+                    return out;
+                }
+                case Call_GetMember: return compileMethodCall(&expr->call);
+            }
+        }
+        case ExprTag_Super: return unsupportedClosure("super isn't supported yet!");
+        case ExprTag_Grouping: return compileExpr(expr->grouping);
+        case ExprTag_Cached: {
+            Closure* out = NEW_CLOSURE(cached_value);
+            out->a = compileExpr(expr->cached.expr);
+            out->slot = expr->cached.slot;
+            return out;
+        }
+        case ExprTag_Primary: return compilePrimary(expr->primary);
+    }
+}
+
+STATIC Closure* compileDecl(Declaration* decl);
+
+STATIC Closure* compileStmt(Statement* stmt) {
+    Closure* out;
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            out = NEW_CLOSURE(expr_stmt);
+            out->a = compileExpr(&stmt->expr);
+            break;
+        }
+        case StmtTag_Global: {
+            out = NEW_CLOSURE(global_stmt);
+            out->text = tokText(stmt->global.name);
+            out->a = compileExpr(&stmt->global.initializer);
+            break;
+        }
+        case StmtTag_For: {
+            out = NEW_CLOSURE(for_loop);
+            out->text = tokText(stmt->for_.iterator);
+            out->a = compileExpr(&stmt->for_.min);
+            out->b = compileExpr(&stmt->for_.max);
+            out->childCount = 1;
+            out->children = malloc(sizeof(Closure*));
+            out->children[0] = compileBlock(stmt->for_.block);
+            out->for_ = &stmt->for_;
+            break;
+        }
+        case StmtTag_While:
+        case StmtTag_Do: {
+            ConditionalBlock* loop = stmt->tag == StmtTag_While ? &stmt->while_ : &stmt->do_;
+            out = stmt->tag == StmtTag_While ? NEW_CLOSURE(while_loop) : NEW_CLOSURE(do_loop);
+            out->a = compileExpr(&loop->condition);
+            out->childCount = 1;
+            out->children = malloc(sizeof(Closure*));
+            out->children[0] = compileBlock(loop->block);
+            break;
+        }
+        case StmtTag_If: {
+            IfStmt if_ = stmt->if_;
+            out = NEW_CLOSURE(if_stmt);
+            out->childCount = 2 * (1 + if_.secondary.len + if_.hasElse);
+            out->children = malloc(out->childCount * sizeof(Closure*));
+            int i = 0;
+            out->children[i++] = compileExpr(&stmt->if_.primary.condition);
+            out->children[i++] = compileBlock(stmt->if_.primary.block);
+            FOREACH(ElseIfList, stmt->if_.secondary, branch) {
+                out->children[i++] = compileExpr(&branch->condition);
+                out->children[i++] = compileBlock(branch->block);
+            }
+            if (if_.hasElse) {
+                out->children[i++] = compileExpr(&stmt->if_.else_.condition);
+                out->children[i++] = compileBlock(stmt->if_.else_.block);
+            }
+            break;
+        }
+        case StmtTag_Switch: {
+            out = NEW_CLOSURE(nop);
+            break;
+        }
+        case StmtTag_Array: {
+            out = NEW_CLOSURE(array_decl);
+            out->text = tokText(stmt->array.name);
+            out->childCount = stmt->array.dimensions.len;
+            out->children = malloc(out->childCount * sizeof(Closure*));
+            for (int i = 0; i < out->childCount; i++) out->children[i] = compileExpr(&stmt->array.dimensions.root[i]);
+            break;
+        }
+    }
+    return out;
+}
+
+Closure* compileFunctionBody(FunDecl* func) {
+    Closure* body = NEW_CLOSURE(decl_block);
+    body->nameCount = func->params.len;
+    body->names = malloc(func->params.len * sizeof(char*));
+    for (int i = 0; i < func->params.len; i++) body->names[i] = tokText(func->params.root[i].name);
+
+    body->children = malloc(func->block.len * sizeof(Closure*));
+    body->childCount = 0;
+    FOREACH(FuncDeclList, func->block, currentDOR) {
+        // nothing after the first return can ever run
+        if (currentDOR->tag == DOR_return) {
+            body->a = compileExpr(&currentDOR->return_);
+            break;
+        }
+        body->children[body->childCount++] = compileDecl(currentDOR->declaration);
+    }
+    return body;
+}
+
+STATIC Closure* compileFunction(FunDecl* func) {
+    Closure* body = compileFunctionBody(func);
+    // this can happen on the tier compiler's thread, while the interpreter's
+    // copying the declaration
+    __atomic_store_n(&func->compiled, body, __ATOMIC_RELEASE);
+    return body;
+}
+
+STATIC Closure* compileDecl(Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            Closure* out = NEW_CLOSURE(fun_decl);
+            out->text = tokText(decl->fun.name);
+            // owned by the declaration
+            out->a = compileFunction(&decl->fun);
+            out->fun = &decl->fun;
+            return out;
+        }
+        case DeclTag_Proc: {
+            Closure* out = NEW_CLOSURE(proc_decl);
+            out->text = tokText(decl->proc.name);
+            out->proc = &decl->proc;
+            return out;
+        }
+        case DeclTag_Stmt: return compileStmt(&decl->stmt);
+        case DeclTag_Class: return NEW_CLOSURE(nop);
+    }
+}
+
+Closure* compileBlock(DeclList* block) {
+    Closure* out = NEW_CLOSURE(decl_block);
+    out->childCount = block->len;
+    out->children = malloc(block->len * sizeof(Closure*));
+    for (int i = 0; i < block->len; i++) out->children[i] = compileDecl(&block->root[i]);
+    return out;
+}
+
+void destroyClosure(Closure* closure) {
+    if (closure->a != NULL) destroyClosure(closure->a);
+    if (closure->b != NULL) destroyClosure(closure->b);
+    for (int i = 0; i < closure->childCount; i++) destroyClosure(closure->children[i]);
+    free(closure->children);
+    free(closure->text);
+    for (int i = 0; i < closure->nameCount; i++) free(closure->names[i]);
+    free(closure->names);
+    if (closure->fn == fun_decl) closure->fun->compiled = NULL;
+    free(closure);
+}
+
+void runClosures(ParseOutput po) {
+    Closure* program = compileBlock(&po.ast);
+    pushScope();
+    setupSTL();
+    RUN(program);
+    parallelShutdown();
+    popScope();
+    destroyClosure(program);
+}
\ No newline at end of file
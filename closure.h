@@ -0,0 +1,63 @@
+#pragma once
+
+#include "parser.h"
+#include "interpreter.h"
+
+typedef InterpreterObj (*ClosureFn)(Closure* self);
+typedef InterpreterObj (*BinaryOp)(InterpreterObj a, InterpreterObj b);
+
+// The closure compiler turns the AST into a tree of these, once, before
+// running anything. Each node's fn already knows what kind of node it is &
+// what its operands are - there's no switching on tags or operators at
+// runtime, & nodes can be specialised for common shapes (x + 1 runs
+// add_int_const, which skips straight to int arithmetic).
+//
+// Not every node uses every field - see the compile* functions in
+// closure.c for what each fn expects.
+struct Closure {
+    ClosureFn fn;
+    // the name of fn - for debugging
+    char* name;
+
+    // operands
+    Closure* a;
+    Closure* b;
+    // arguments, indices or the declarations in a block
+    Closure** children;
+    int childCount;
+
+    // literals, & the constant operand of specialised nodes
+    InterpreterObj constant;
+    BinaryOp op;
+    // variable names
+    char* text;
+    // function parameters
+    char** names;
+    int nameCount;
+
+    // the AST node, for anything the optimiser annotated
+    union {
+        CallExpr* call;
+        ForStmt* for_;
+        FunDecl* fun;
+        ProcDecl* proc;
+        // cache slot, for ExprTag_Cached
+        int slot;
+    };
+};
+
+Closure* compileExpr(Expression* expr);
+Closure* compileBlock(DeclList* block);
+// Compile a function's body without attaching it to func - see tier.h
+Closure* compileFunctionBody(FunDecl* func);
+// Run a compiled function body in the current scope, which should already
+// have the arguments in it
+InterpreterObj runFunctionBody(Closure* body, FunDecl func);
+void destroyClosure(Closure* closure);
+
+static inline InterpreterObj runClosure(Closure* closure) {
+    return closure->fn(closure);
+}
+
+// Alternative to interpret() - compile the whole program, then run it
+void runClosures(ParseOutput po);
\ No newline at end of file
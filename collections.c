@@ -0,0 +1,224 @@
+#include "collections.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "panic.h"
+#include "parallel.h"
+#include "runtime.h"
+
+//* ---------------- dictionaries ----------------
+
+// murmur3's finaliser, so ints which are close together spread out
+STATIC INLINE uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return hash ^ (hash >> 33);
+}
+
+STATIC uint32_t hashKey(InterpreterObj key) {
+    uint64_t hash;
+    switch (key.tag) {
+        case ObjType_Nil: hash = 0; break;
+        case ObjType_Bool: hash = key.bool_; break;
+        case ObjType_Int: hash = (uint32_t)key.int_; break;
+        case ObjType_Float: {
+            // 0.0 == -0.0
+            uint32_t bits = 0;
+            if (key.float_ != 0) memcpy(&bits, &key.float_, sizeof(bits));
+            hash = bits;
+            break;
+        }
+        case ObjType_String: {
+            // FNV-1a
+            hash = 0xcbf29ce484222325ull;
+            for (int i = 0; i < key.string.length; i++) hash = (hash ^ (unsigned char)key.string.start[i]) * 0x100000001b3ull;
+            break;
+        }
+        default: panic(Panic_Stdlib, "Can't use a %s as a dictionary key!", ObjTypeToString(key.tag));
+    }
+    // 1 & 2 are the same key otherwise
+    uint32_t out = mix(hash ^ ((uint64_t)key.tag << 56));
+    return out > DICTIONARY_REMOVED ? out : out + 2;
+}
+
+// Where key is, or the best place to put it if it isn't there
+STATIC DictionaryEntry* findEntry(DictionaryEntry* entries, int capacity, InterpreterObj key, uint32_t hash) {
+    DictionaryEntry* removed = NULL;
+    for (uint32_t i = hash & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        DictionaryEntry* entry = &entries[i];
+        if (entry->hash == DICTIONARY_EMPTY) return removed != NULL ? removed : entry;
+        if (entry->hash == DICTIONARY_REMOVED) {
+            if (removed == NULL) removed = entry;
+        } else if (entry->hash == hash && equal(entry->key, key)) {
+            return entry;
+        }
+    }
+}
+
+// Twice as big if it's filling up, or the same size if it's mostly removed
+// entries
+STATIC void rebuild(DictionaryObj* dictionary) {
+    int capacity = (dictionary->count + 1) * 2 > dictionary->capacity ? dictionary->capacity * 2 : dictionary->capacity;
+    DictionaryEntry* entries = calloc(capacity, sizeof(DictionaryEntry));
+    for (int i = 0; i < dictionary->capacity; i++) {
+        DictionaryEntry* entry = &dictionary->entries[i];
+        if (entry->hash > DICTIONARY_REMOVED) *findEntry(entries, capacity, entry->key, entry->hash) = *entry;
+    }
+    free(dictionary->entries);
+    dictionary->entries = entries;
+    dictionary->capacity = capacity;
+    dictionary->used = dictionary->count;
+}
+
+DictionaryObj* newDictionary() {
+    DictionaryObj* out = malloc(sizeof(DictionaryObj));
+    out->refCount = 1;
+    out->count = 0;
+    out->used = 0;
+    out->capacity = COLLECTION_MIN_CAPACITY;
+    out->entries = calloc(out->capacity, sizeof(DictionaryEntry));
+    return out;
+}
+
+void retainDictionary(DictionaryObj* dictionary) {
+    retainCount(&dictionary->refCount);
+}
+
+void releaseDictionary(DictionaryObj* dictionary) {
+    if (releaseCount(&dictionary->refCount) != 0) return;
+    for (int i = 0; i < dictionary->capacity; i++) {
+        DictionaryEntry* entry = &dictionary->entries[i];
+        if (entry->hash <= DICTIONARY_REMOVED) continue;
+        freeObj(entry->key);
+        freeObj(entry->value);
+    }
+    free(dictionary->entries);
+    free(dictionary);
+}
+
+void dictionarySet(DictionaryObj* dictionary, InterpreterObj key, InterpreterObj value) {
+    uint32_t hash = hashKey(key);
+    if ((dictionary->used + 1) * 4 > dictionary->capacity * 3) rebuild(dictionary);
+    DictionaryEntry* entry = findEntry(dictionary->entries, dictionary->capacity, key, hash);
+    value = copyObj(value);
+    value._nameAllocated = false;
+    if (entry->hash > DICTIONARY_REMOVED) {
+        freeObj(entry->value);
+        entry->value = value;
+        return;
+    }
+    if (entry->hash == DICTIONARY_EMPTY) dictionary->used++;
+    dictionary->count++;
+    key = copyObj(key);
+    key._nameAllocated = false;
+    *entry = (DictionaryEntry){.hash = hash, .key = key, .value = value};
+}
+
+InterpreterObj* dictionaryGet(DictionaryObj* dictionary, InterpreterObj key) {
+    DictionaryEntry* entry = findEntry(dictionary->entries, dictionary->capacity, key, hashKey(key));
+    return entry->hash > DICTIONARY_REMOVED ? &entry->value : NULL;
+}
+
+bool dictionaryRemove(DictionaryObj* dictionary, InterpreterObj key) {
+    DictionaryEntry* entry = findEntry(dictionary->entries, dictionary->capacity, key, hashKey(key));
+    if (entry->hash <= DICTIONARY_REMOVED) return false;
+    freeObj(entry->key);
+    freeObj(entry->value);
+    // still counts towards used - anything after it has to stay reachable
+    entry->hash = DICTIONARY_REMOVED;
+    dictionary->count--;
+    return true;
+}
+
+//* ---------------- stacks ----------------
+
+StackObj* newStack() {
+    StackObj* out = malloc(sizeof(StackObj));
+    out->refCount = 1;
+    INIT(out->items);
+    return out;
+}
+
+void retainStack(StackObj* stack) {
+    retainCount(&stack->refCount);
+}
+
+void releaseStack(StackObj* stack) {
+    if (releaseCount(&stack->refCount) != 0) return;
+    FOREACH(ObjList, stack->items, item) freeObj(*item);
+    DESTROY(stack->items);
+    free(stack);
+}
+
+void stackPush(StackObj* stack, InterpreterObj value) {
+    value = copyObj(value);
+    value._nameAllocated = false;
+    APPEND(stack->items, value);
+}
+
+InterpreterObj stackPop(StackObj* stack) {
+    if (stack->items.len == 0) panic(Panic_Stdlib, "Can't pop from an empty stack!");
+    return stack->items.root[--stack->items.len];
+}
+
+InterpreterObj* stackPeek(StackObj* stack) {
+    if (stack->items.len == 0) panic(Panic_Stdlib, "Can't peek at an empty stack!");
+    return &stack->items.root[stack->items.len - 1];
+}
+
+//* ---------------- queues ----------------
+
+QueueObj* newQueue() {
+    QueueObj* out = malloc(sizeof(QueueObj));
+    out->refCount = 1;
+    out->head = 0;
+    out->count = 0;
+    out->capacity = COLLECTION_MIN_CAPACITY;
+    out->items = malloc(out->capacity * sizeof(InterpreterObj));
+    return out;
+}
+
+void retainQueue(QueueObj* queue) {
+    retainCount(&queue->refCount);
+}
+
+void releaseQueue(QueueObj* queue) {
+    if (releaseCount(&queue->refCount) != 0) return;
+    for (int i = 0; i < queue->count; i++) freeObj(queue->items[(queue->head + i) & (queue->capacity - 1)]);
+    free(queue->items);
+    free(queue);
+}
+
+void queuePush(QueueObj* queue, InterpreterObj value) {
+    if (queue->count == queue->capacity) {
+        // unwrapped into the new one, so the front's at 0 again
+        InterpreterObj* items = malloc(queue->capacity * 2 * sizeof(InterpreterObj));
+        int first = queue->capacity - queue->head;
+        memcpy(items, queue->items + queue->head, first * sizeof(InterpreterObj));
+        memcpy(items + first, queue->items, queue->head * sizeof(InterpreterObj));
+        free(queue->items);
+        queue->items = items;
+        queue->head = 0;
+        queue->capacity *= 2;
+    }
+    value = copyObj(value);
+    value._nameAllocated = false;
+    queue->items[(queue->head + queue->count++) & (queue->capacity - 1)] = value;
+}
+
+InterpreterObj queuePop(QueueObj* queue) {
+    if (queue->count == 0) panic(Panic_Stdlib, "Can't dequeue from an empty queue!");
+    InterpreterObj out = queue->items[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
+    return out;
+}
+
+InterpreterObj* queueFront(QueueObj* queue) {
+    if (queue->count == 0) panic(Panic_Stdlib, "Can't look at the front of an empty queue!");
+    return &queue->items[queue->head];
+}
\ No newline at end of file
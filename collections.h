@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "interpreter.h"
+
+// The objects from newDictionary, newStack & newQueue - everything else is a
+// method on one (see stl_methods in runtime.c). Unlike arrays they aren't
+// copied on write: b = a, or passing one byVal, gives another reference to
+// the same collection, like a file.
+//
+// Everything that goes in is copied in (so strings & arrays are shared, not
+// duplicated), & everything that comes out is the caller's.
+
+#define COLLECTION_MIN_CAPACITY 8
+
+typedef struct {
+    // DICTIONARY_EMPTY, DICTIONARY_REMOVED, or the key's hash
+    uint32_t hash;
+    InterpreterObj key;
+    InterpreterObj value;
+} DictionaryEntry;
+
+#define DICTIONARY_EMPTY 0
+#define DICTIONARY_REMOVED 1
+
+// Open addressing with linear probing - capacity's a power of 2, & it's
+// rebuilt once 3/4 of the entries have been used (removed ones included).
+// Keys can be nil, bools, numbers or strings.
+struct DictionaryObj {
+    int refCount;
+    int count;
+    // live & removed entries
+    int used;
+    int capacity;
+    DictionaryEntry* entries;
+};
+
+struct StackObj {
+    int refCount;
+    ObjList items;
+};
+
+// A ring buffer - the front's at head, & the rest follow it round
+struct QueueObj {
+    int refCount;
+    int head;
+    int count;
+    int capacity;
+    InterpreterObj* items;
+};
+
+DictionaryObj* newDictionary();
+void retainDictionary(DictionaryObj* dictionary);
+void releaseDictionary(DictionaryObj* dictionary);
+void dictionarySet(DictionaryObj* dictionary, InterpreterObj key, InterpreterObj value);
+// NULL if key isn't there
+InterpreterObj* dictionaryGet(DictionaryObj* dictionary, InterpreterObj key);
+// false if key wasn't there
+bool dictionaryRemove(DictionaryObj* dictionary, InterpreterObj key);
+
+StackObj* newStack();
+void retainStack(StackObj* stack);
+void releaseStack(StackObj* stack);
+void stackPush(StackObj* stack, InterpreterObj value);
+// Panics if the stack's empty
+InterpreterObj stackPop(StackObj* stack);
+InterpreterObj* stackPeek(StackObj* stack);
+
+QueueObj* newQueue();
+void retainQueue(QueueObj* queue);
+void releaseQueue(QueueObj* queue);
+void queuePush(QueueObj* queue, InterpreterObj value);
+// Panics if the queue's empty
+InterpreterObj queuePop(QueueObj* queue);
+InterpreterObj* queueFront(QueueObj* queue);
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "extension.h"
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#include "ocrpi_ext.h"
+#include "panic.h"
+#include "vector.h"
+
+DECL_VEC(char*, ExtensionPathList)
+
+static ExtensionPathList loaded;
+
+void loadExtension(char* path) {
+    if (loaded.root == NULL) INIT(loaded);
+
+    char* absolute = realpath(path, NULL);
+    if (absolute == NULL) panic(Panic_Extension, "Can't find module %s!", path);
+    // importing it twice is fine - it's only loaded once
+    FOREACH(ExtensionPathList, loaded, existing) {
+        if (strcmp(*existing, absolute) == 0) {
+            free(absolute);
+            return;
+        }
+    }
+
+    void* handle = dlopen(absolute, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) panic(Panic_Extension, "Can't load module %s! (%s)", path, dlerror());
+    OcrpiExtension* extension = dlsym(handle, "ocrpi_extension");
+    if (extension == NULL) panic(Panic_Extension, "%s isn't an ocrpi module - it doesn't export ocrpi_extension!", path);
+    if (extension->abi != OCRPI_EXTENSION_ABI || extension->objSize != sizeof(InterpreterObj))
+        panic(Panic_Extension, "%s was built for a different version of ocrpi! (ABI %i, this is %i)", path, extension->abi, OCRPI_EXTENSION_ABI);
+
+    addNatives(extension->funcs, extension->procs);
+    APPEND(loaded, absolute);
+}
+
+int extensionCount() {
+    return loaded.root == NULL ? 0 : loaded.len;
+}
+
+char* extensionPath(int i) {
+    return loaded.root[i];
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+// Load the native extension module at path (see ocrpi_ext.h) - its natives
+// are declared alongside the standard library's from then on. Modules stay
+// loaded until ocrpi exits.
+void loadExtension(char* path);
+
+// Every module that's been loaded, in order - absolute paths
+int extensionCount();
+char* extensionPath(int i);
\ No newline at end of file
@@ -0,0 +1,42 @@
+// An example extension module - the statistics over 1-dimensional arrays of
+// numbers which the standard library doesn't have (it has sum & mean). Build
+// with make extensions, then import "extensions/stats.so".
+
+#include <math.h>
+
+#include "ocrpi_ext.h"
+
+// Every element as a float - panics on anything that isn't a number
+static float elementAt(ArrayObj* array, int i) {
+    InterpreterObj elem = IOAbs(arrayGet(array, i));
+    switch (elem.tag) {
+        case ObjType_Int: return elem.int_;
+        case ObjType_Float: return elem.float_;
+        default: panic(Panic_Extension, "Can't do statistics on a %s!", ObjTypeToString(elem.tag));
+    }
+}
+
+static float total(ArrayObj* array) {
+    float out = 0;
+    for (int i = 0; i < array->length; i++) out += elementAt(array, i);
+    return out;
+}
+
+static InterpreterObj stats_stddev(InterpreterObj* args, int argc) {
+    ArrayObj* array = args[0].array;
+    if (array->length == 0) panic(Panic_Extension, "Can't take the standard deviation of an empty array!");
+    float mean = total(array) / array->length;
+    float squares = 0;
+    for (int i = 0; i < array->length; i++) {
+        float difference = elementAt(array, i) - mean;
+        squares += difference * difference;
+    }
+    return IOBJ(.tag = ObjType_Float, .float_ = sqrtf(squares / array->length));
+}
+
+static STLFuncDef funcs[] = {
+    {"stddev", stats_stddev, {1, ObjType_Float, {ACCEPTS(Array)}, true}},
+    {"", NULL}
+};
+
+OCRPI_EXTENSION(funcs, NULL)
\ No newline at end of file
@@ -0,0 +1,274 @@
+// mremap
+#define _GNU_SOURCE
+
+#include "file.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "panic.h"
+#include "parallel.h"
+#include "stringObj.h"
+
+// written files that haven't been closed get flushed at exit - any thread
+// running a program (see ocrpi_vm.h) can open & close them, so hold
+// openFilesLock
+static FileObj* openFiles = NULL;
+static pthread_mutex_t openFilesLock = PTHREAD_MUTEX_INITIALIZER;
+
+STATIC void closeOpenFiles() {
+    while (openFiles != NULL) closeFile(openFiles);
+}
+
+// Every mapping that anything's still looking at, & which file it's of -
+// mapping a file doesn't copy it, so writing to it would change the lines
+// already read (or take them away, if it gets shorter)
+typedef struct Mapping {
+    StringBuffer* contents;
+    dev_t device;
+    ino_t inode;
+    struct Mapping* next;
+} Mapping;
+
+static Mapping* mappings = NULL;
+static pthread_mutex_t mappingsLock = PTHREAD_MUTEX_INITIALIZER;
+
+STATIC void addMapping(StringBuffer* contents, struct stat* info) {
+    Mapping* mapping = malloc(sizeof(Mapping));
+    *mapping = (Mapping){contents, info->st_dev, info->st_ino, NULL};
+    pthread_mutex_lock(&mappingsLock);
+    mapping->next = mappings;
+    mappings = mapping;
+    pthread_mutex_unlock(&mappingsLock);
+}
+
+void forgetMapping(StringBuffer* contents) {
+    pthread_mutex_lock(&mappingsLock);
+    for (Mapping** current = &mappings; *current != NULL; current = &(*current)->next) {
+        if ((*current)->contents == contents) {
+            Mapping* found = *current;
+            *current = found->next;
+            free(found);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mappingsLock);
+}
+
+// Swap the file's pages for a private copy, at the same address - the views
+// of it can't tell. False if there isn't the memory.
+STATIC bool detachMapping(StringBuffer* contents) {
+    size_t size = contents->mappedSize;
+    char* copy = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (copy == MAP_FAILED) return false;
+    memcpy(copy, contents->chars, size);
+    mprotect(copy, size, PROT_READ);
+    if (mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, contents->chars) != MAP_FAILED) return true;
+    munmap(copy, size);
+    return false;
+}
+
+// Before path is truncated - every mapping of it gets its own copy
+STATIC void detachMappings(char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0) return;
+    bool detached = true;
+    pthread_mutex_lock(&mappingsLock);
+    for (Mapping** current = &mappings; *current != NULL;) {
+        Mapping* mapping = *current;
+        if (mapping->device == info.st_dev && mapping->inode == info.st_ino) {
+            detached = detachMapping(mapping->contents);
+            if (!detached) break;
+            *current = mapping->next;
+            free(mapping);
+        } else current = &mapping->next;
+    }
+    pthread_mutex_unlock(&mappingsLock);
+    if (!detached) panic(Panic_Stdlib, "Can't write %s - there isn't the memory to keep the lines already read from it!", path);
+}
+
+// Regular files are mapped in, everything else is streamed - either way,
+// reading starts wherever fd's up to
+STATIC void startReading(FileObj* file, int fd) {
+    file->fd = -1;
+    struct stat info;
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > offset) {
+        char* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            file->contents = mappedBuffer(data, info.st_size);
+            addMapping(file->contents, &info);
+            file->size = info.st_size;
+            file->position = offset;
+            // the mapping doesn't need it
+            close(fd);
+            return;
+        }
+    }
+    file->fd = fd;
+}
+
+STATIC void openForReading(FileObj* file) {
+    int fd = open(file->path, O_RDONLY);
+    if (fd < 0) panic(Panic_Stdlib, "Can't open %s for reading!", file->path);
+    startReading(file, fd);
+}
+
+// Streams the next chunk in after whatever's left of this one - false once
+// there's nothing more to read
+STATIC bool refill(FileObj* file) {
+    if (file->fd < 0) return false;
+    size_t left = file->size - file->position;
+    StringBuffer* chunk = file->contents;
+    if (chunk != NULL && chunk->refCount == 1 && left <= file->capacity / 2) {
+        // no lines are looking at it, so it can be reused
+        memmove(chunk->chars, chunk->chars + file->position, left);
+    } else {
+        // a line that's longer than a chunk needs a bigger one
+        size_t capacity = left * 2 > FILE_CHUNK_SIZE ? left * 2 : FILE_CHUNK_SIZE;
+        chunk = newString(capacity).owner;
+        if (left > 0) memcpy(chunk->chars, file->contents->chars + file->position, left);
+        if (file->contents != NULL) releaseBuffer(file->contents);
+        file->contents = chunk;
+        file->capacity = capacity;
+    }
+    file->size = left;
+    file->position = 0;
+
+    ssize_t count = read(file->fd, chunk->chars + left, file->capacity - left);
+    if (count < 0) panic(Panic_Stdlib, "Can't read %s!", file->path);
+    if (count == 0) {
+        close(file->fd);
+        file->fd = -1;
+        return false;
+    }
+    file->size += count;
+    return true;
+}
+
+STATIC void openForWriting(FileObj* file) {
+    detachMappings(file->path);
+    FILE* target = fopen(file->path, "wb");
+    if (target == NULL) panic(Panic_Stdlib, "Can't open %s for writing!", file->path);
+    // everything goes through out instead
+    setvbuf(target, NULL, _IONBF, 0);
+    file->out = (OutputBuffer){
+        .data = malloc(FILE_WRITE_BUFFER_SIZE),
+        .size = FILE_WRITE_BUFFER_SIZE,
+        .target = target
+    };
+
+    pthread_mutex_lock(&openFilesLock);
+    static bool registered = false;
+    if (!registered) atexit(closeOpenFiles);
+    registered = true;
+    file->nextOpen = openFiles;
+    openFiles = file;
+    pthread_mutex_unlock(&openFilesLock);
+}
+
+FileObj* openFile(char* path, int length, bool writing) {
+    FileObj* out = calloc(1, sizeof(FileObj));
+    out->refCount = 1;
+    out->writing = writing;
+    out->path = strndup(path, length);
+    out->fd = -1;
+    if (writing) openForWriting(out);
+    else openForReading(out);
+    return out;
+}
+
+// opened by whichever thread asks for it first
+static FileObj* input = NULL;
+static pthread_once_t inputOnce = PTHREAD_ONCE_INIT;
+
+STATIC void openStandardInput() {
+    input = calloc(1, sizeof(FileObj));
+    input->refCount = 1;
+    input->path = strdup("stdin");
+    // its own descriptor, so finishing with it leaves the real one alone
+    int fd = dup(STDIN_FILENO);
+    if (fd < 0) panic(Panic_Stdlib, "Can't read stdin!");
+    startReading(input, fd);
+}
+
+FileObj* standardInput() {
+    pthread_once(&inputOnce, openStandardInput);
+    return input;
+}
+
+void retainFile(FileObj* file) {
+    retainCount(&file->refCount);
+}
+
+void releaseFile(FileObj* file) {
+    if (releaseCount(&file->refCount) != 0) return;
+    if (!file->closed) closeFile(file);
+    free(file->path);
+    free(file);
+}
+
+STATIC INLINE void checkOpen(FileObj* file, bool writing) {
+    if (file->closed) panic(Panic_Stdlib, "%s has been closed!", file->path);
+    if (file->writing != writing) panic(Panic_Stdlib, "%s was opened for %s!", file->path, file->writing ? "writing" : "reading");
+}
+
+bool endOfFile(FileObj* file) {
+    checkOpen(file, false);
+    return file->position >= file->size && !refill(file);
+}
+
+StringObj readLine(FileObj* file) {
+    checkOpen(file, false);
+    if (file->position >= file->size && !refill(file)) panic(Panic_Stdlib, "Can't read past the end of %s!", file->path);
+    // a line that runs off the end of the chunk needs the next one
+    size_t scanned = 0;
+    char* newline;
+    while ((newline = memchr(file->contents->chars + file->position + scanned, '\n', file->size - file->position - scanned)) == NULL) {
+        scanned = file->size - file->position;
+        if (!refill(file)) break;
+    }
+    char* start = file->contents->chars + file->position;
+    size_t left = file->size - file->position;
+    size_t length = newline == NULL ? left : (size_t)(newline - start);
+    file->position += newline == NULL ? length : length + 1;
+    // \r\n
+    if (length > 0 && start[length - 1] == '\r') length--;
+    return stringView(file->contents, start, length);
+}
+
+void writeLine(FileObj* file, InterpreterObj value) {
+    checkOpen(file, true);
+    writeObj(&file->out, value);
+    writeNewline(&file->out);
+}
+
+void closeFile(FileObj* file) {
+    if (file->closed) panic(Panic_Stdlib, "%s has already been closed!", file->path);
+    file->closed = true;
+    if (!file->writing) {
+        if (file->contents != NULL) releaseBuffer(file->contents);
+        file->contents = NULL;
+        if (file->fd >= 0) close(file->fd);
+        file->fd = -1;
+        return;
+    }
+
+    flushBuffer(&file->out);
+    fclose(file->out.target);
+    free(file->out.data);
+    pthread_mutex_lock(&openFilesLock);
+    for (FileObj** current = &openFiles; *current != NULL; current = &(*current)->nextOpen) {
+        if (*current == file) {
+            *current = file->nextOpen;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&openFilesLock);
+}
\ No newline at end of file
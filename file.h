@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "interpreter.h"
+#include "output.h"
+
+#define FILE_WRITE_BUFFER_SIZE (1 << 18)
+// Files that can't be mapped are read this much at a time (or more, for a
+// line that doesn't fit)
+#define FILE_CHUNK_SIZE (1 << 16)
+
+// The files from openRead & openWrite - everything else is a method on
+// one (see stl_methods in runtime.c).
+//
+// A file that's being read is mapped in whole (or streamed in big chunks, if
+// it can't be mapped - a pipe), & readLine gives views of it, so lines are
+// never copied. They keep the mapping (or their chunk) alive, even after the
+// file's closed - & if the file's opened for writing while they're around,
+// the mapping's swapped for a copy first, so they don't change.
+// A file that's being written collects lines in a big buffer, which goes
+// out when it's full or the file's closed.
+struct FileObj {
+    int refCount;
+    bool writing;
+    bool closed;
+    char* path;
+
+    // reading - the file's contents (or the current chunk of them), & where
+    // the next line starts
+    StringBuffer* contents;
+    size_t size;
+    size_t position;
+    // what's still to be streamed in, or -1 once it's all in contents
+    int fd;
+    // how big the current chunk is
+    size_t capacity;
+
+    // writing
+    OutputBuffer out;
+    // files being written which are still open
+    FileObj* nextOpen;
+};
+
+// path isn't terminated - panics if the file can't be opened
+FileObj* openFile(char* path, int length, bool writing);
+// The program's stdin, as a file - it's only opened the first time it's
+// asked for, & it's never closed
+FileObj* standardInput();
+void retainFile(FileObj* file);
+// Closes it too, once nothing's using it
+void releaseFile(FileObj* file);
+
+bool endOfFile(FileObj* file);
+// The next line, without its line ending
+StringObj readLine(FileObj* file);
+void writeLine(FileObj* file, InterpreterObj value);
+void closeFile(FileObj* file);
+// Called by releaseBuffer as the last view of a mapped file goes
+void forgetMapping(StringBuffer* contents);
\ No newline at end of file
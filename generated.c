@@ -0,0 +1,39 @@
+// GENERATED FILE - DO NOT EDIT
+
+#include "./generated.h"
+
+char* ExprTagToString(ExprTag theEnum) {
+    char* values[] = {"Unary", "Binary", "Call", "Super", "Grouping", "Primary", "Cached"};
+    return values[theEnum];
+}
+
+char* StmtTagToString(StmtTag theEnum) {
+    char* values[] = {"Expr", "Global", "For", "While", "Do", "If", "Switch", "Array"};
+    return values[theEnum];
+}
+
+char* DeclTagToString(DeclTag theEnum) {
+    char* values[] = {"Stmt", "Fun", "Proc", "Class"};
+    return values[theEnum];
+}
+
+char* ObjTypeToString(ObjType theEnum) {
+    char* values[] = {"Nil", "Ref", "Class", "Func", "Proc", "NativeFunc", "NativeProc", "Bool", "Int", "String", "Float", "Array", "Instance", "File", "Dictionary", "Stack", "Queue"};
+    return values[theEnum];
+}
+
+char* ArrayStorageToString(ArrayStorage theEnum) {
+    char* values[] = {"Nil", "Int", "Float", "Bool", "Boxed"};
+    return values[theEnum];
+}
+
+char* IROpToString(IROp theEnum) {
+    char* values[] = {"Const", "Param", "Undef", "Phi", "LoadVar", "StoreVar", "Global", "Add", "Subtract", "Multiply", "Divide", "Exponent", "Equal", "NotEqual", "Less", "LessEqual", "Greater", "GreaterEqual", "Truthy", "Call", "LoadElement", "StoreElement", "NewArray", "Function", "Procedure", "Jump", "Branch", "Return", "Trap"};
+    return values[theEnum];
+}
+
+char* IRTypeToString(IRType theEnum) {
+    char* values[] = {"None", "Any", "Nil", "Bool", "Int", "Float", "String", "Array", "Func", "Proc"};
+    return values[theEnum];
+}
+
@@ -0,0 +1,120 @@
+// GENERATED FILE - DO NOT EDIT
+#ifndef GENERATED_H
+#define GENERATED_H
+
+typedef enum {
+    ExprTag_Unary = 0,
+    ExprTag_Binary = 1,
+    ExprTag_Call = 2,
+    ExprTag_Super = 3,
+    ExprTag_Grouping = 4,
+    ExprTag_Primary = 5,
+    ExprTag_Cached = 6,
+} ExprTag;
+
+char* ExprTagToString(ExprTag theEnum);
+
+typedef enum {
+    StmtTag_Expr = 0,
+    StmtTag_Global = 1,
+    StmtTag_For = 2,
+    StmtTag_While = 3,
+    StmtTag_Do = 4,
+    StmtTag_If = 5,
+    StmtTag_Switch = 6,
+    StmtTag_Array = 7,
+} StmtTag;
+
+char* StmtTagToString(StmtTag theEnum);
+
+typedef enum {
+    DeclTag_Stmt = 0,
+    DeclTag_Fun = 1,
+    DeclTag_Proc = 2,
+    DeclTag_Class = 3,
+} DeclTag;
+
+char* DeclTagToString(DeclTag theEnum);
+
+typedef enum {
+    ObjType_Nil = 0,
+    ObjType_Ref = 1,
+    ObjType_Class = 2,
+    ObjType_Func = 3,
+    ObjType_Proc = 4,
+    ObjType_NativeFunc = 5,
+    ObjType_NativeProc = 6,
+    ObjType_Bool = 7,
+    ObjType_Int = 8,
+    ObjType_String = 9,
+    ObjType_Float = 10,
+    ObjType_Array = 11,
+    ObjType_Instance = 12,
+    ObjType_File = 13,
+    ObjType_Dictionary = 14,
+    ObjType_Stack = 15,
+    ObjType_Queue = 16,
+} ObjType;
+
+char* ObjTypeToString(ObjType theEnum);
+
+typedef enum {
+    ArrayStorage_Nil = 0,
+    ArrayStorage_Int = 1,
+    ArrayStorage_Float = 2,
+    ArrayStorage_Bool = 3,
+    ArrayStorage_Boxed = 4,
+} ArrayStorage;
+
+char* ArrayStorageToString(ArrayStorage theEnum);
+
+typedef enum {
+    IROp_Const = 0,
+    IROp_Param = 1,
+    IROp_Undef = 2,
+    IROp_Phi = 3,
+    IROp_LoadVar = 4,
+    IROp_StoreVar = 5,
+    IROp_Global = 6,
+    IROp_Add = 7,
+    IROp_Subtract = 8,
+    IROp_Multiply = 9,
+    IROp_Divide = 10,
+    IROp_Exponent = 11,
+    IROp_Equal = 12,
+    IROp_NotEqual = 13,
+    IROp_Less = 14,
+    IROp_LessEqual = 15,
+    IROp_Greater = 16,
+    IROp_GreaterEqual = 17,
+    IROp_Truthy = 18,
+    IROp_Call = 19,
+    IROp_LoadElement = 20,
+    IROp_StoreElement = 21,
+    IROp_NewArray = 22,
+    IROp_Function = 23,
+    IROp_Procedure = 24,
+    IROp_Jump = 25,
+    IROp_Branch = 26,
+    IROp_Return = 27,
+    IROp_Trap = 28,
+} IROp;
+
+char* IROpToString(IROp theEnum);
+
+typedef enum {
+    IRType_None = 0,
+    IRType_Any = 1,
+    IRType_Nil = 2,
+    IRType_Bool = 3,
+    IRType_Int = 4,
+    IRType_Float = 5,
+    IRType_String = 6,
+    IRType_Array = 7,
+    IRType_Func = 8,
+    IRType_Proc = 9,
+} IRType;
+
+char* IRTypeToString(IRType theEnum);
+
+#endif // GENERATED_H
\ No newline at end of file
@@ -1,92 +1,17 @@
 #include "interpreter.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "common.h"
 #include "panic.h"
-#include "ocrpi_stdlib.h"
-
-DECL_MAP(InterpreterObj, ObjNS);
-
-typedef struct Scope Scope;
-
-#define IOBJ(...) (InterpreterObj){__VA_ARGS__}
-
-struct Scope {
-    ObjNS objects;
-    Scope* parent;
-};
-
-static Scope* currentScope = NULL;
-static Scope* globalScope = NULL;
-
-//* if it's a temporary, get rid!!
-//* this doesn't free references so you're ok to call it on var names etc
-//* but if you've called IOAbs on an object then make sure you're ok to free it!!
-STATIC void freeObj(InterpreterObj obj) {
-    switch (obj.tag) {
-        case ObjType_String: {
-            if (obj.string.allocated) free(obj.string.start);
-            break;
-        }
-    }
-}
-
-STATIC InterpreterObj copyObj(InterpreterObj obj) {
-    switch (obj.tag) {
-        case ObjType_String: {
-            char* copy = malloc(obj.string.length);
-            memcpy(copy, obj.string.start, obj.string.length);
-            return IOBJ(
-                .tag = ObjType_String,
-                .string = (StringObj){
-                    .start = copy,
-                    .length = obj.string.length,
-                    .allocated = true
-                }
-            );
-        }
-        case ObjType_Bool:
-        case ObjType_Int:
-        case ObjType_Float:
-        {
-            return obj;
-        }
-        default: panic(Panic_Interpreter, "Unable to copy object of type %s!", ObjTypeToString(obj.tag));
-    }
-}
-
-STATIC Scope* newScope() {
-    Scope* out = malloc(sizeof(Scope));
-    out->objects = NewObjNS();
-    return out;
-}
-
-STATIC void destroyScope(Scope* scope) {
-    FOREACH(ObjNS, scope->objects, object) {
-        if (object->value._nameAllocated) {
-            free(object->key);
-        }
-        freeObj(object->value);
-    }
-    DESTROY(scope->objects);
-    free(scope);
-}
-
-STATIC void pushScope() {
-    Scope* oldScope = currentScope;
-    currentScope = newScope();
-    currentScope->parent = oldScope;
-    if (oldScope == NULL) globalScope = currentScope;
-}
-
-STATIC void popScope() {
-    if (currentScope == NULL) panic(Panic_Interpreter, "Can't exit the root scope!");
-    Scope* parentScope = currentScope->parent;
-    destroyScope(currentScope);
-    currentScope = parentScope;
-}
+#include "runtime.h"
+#include "array.h"
+#include "jit.h"
+#include "closure.h"
+#include "tier.h"
+#include "parallel.h"
 
 #define _EXPR_SHORTCUT(returnType, name) STATIC returnType name##Exprs(Expression a, Expression b) { \
     InterpreterObj aObj = interpretExpr(a); \
@@ -106,39 +31,68 @@ STATIC void popScope() {
 
 // Interpret the expression & return the result
 InterpreterObj interpretExpr(Expression expr);
-STATIC INLINE InterpreterObj IOAbs(InterpreterObj obj);
-bool isTruthy(InterpreterObj obj);
 _SINGLE_EXPR_SHORTCUT(bool, isTruthy)
 STATIC void interpretDecl(Declaration decl);
 STATIC void interpretBlock(DeclList block);
 
-#define MAKE_ABS(obj) obj = IOAbs(obj);
-
-STATIC INLINE InterpreterObj* findObj(char* name) {
-    Scope* searchScope = currentScope;
-    InterpreterObj* obj = NULL;
-    while (searchScope != NULL) {
-        obj = ObjNSFind(&searchScope->objects, name);
-        if (obj != NULL) break;
-        searchScope = searchScope->parent;
+// Evaluate the indices of an array access & find the element's offset
+STATIC int arrayIndex(ArrayObj* array, CallExpr access) {
+    ExprList indices = access.arguments;
+    if (indices.len > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Too many array indices! (%i)", indices.len);
+    int evaluated[ARRAY_MAX_RANK];
+    for (int i = 0; i < indices.len; i++) {
+        InterpreterObj index = IOAbs(interpretExpr(indices.root[i]));
+        // proven indices are for loop iterators - definitely ints
+        if (!(access.uncheckedDims & (1 << i)) && index.tag != ObjType_Int)
+            panic(Panic_Interpreter, "Array indices must be ints, not %s!", ObjTypeToString(index.tag));
+        evaluated[i] = index.int_;
     }
-    return obj;
+    return arrayOffset(array, evaluated, indices.len, access.uncheckedDims);
+}
+
+STATIC ArrayObj* arrayFromExpr(Expression expr) {
+    InterpreterObj obj = IOAbs(interpretExpr(expr));
+    if (obj.tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(obj.tag));
+    return obj.array;
 }
 
-STATIC INLINE InterpreterObj* setVar(char* name, InterpreterObj value, bool nameAllocated) {
-    value._nameAllocated = nameAllocated;
-    InterpreterObj* obj = findObj(name);
-    if (obj != NULL) {
-        *obj = value;
-        return obj;
+// Find the array to write to for an assignment to expr[...], making sure we've
+// got our own copy of it - and of everything it's nested in (a[i][j] = x).
+STATIC ArrayObj* arrayForWriteFromExpr(Expression expr) {
+    InterpreterObj* slot;
+    if (expr.tag == ExprTag_Call && expr.call.tag == Call_Array) {
+        ArrayObj* outer = arrayForWriteFromExpr(*expr.call.callee);
+        InterpreterObj elem = arrayGet(outer, arrayIndex(outer, expr.call));
+        // arrays can only live in boxed storage
+        if (elem.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(elem.tag));
+        slot = elem.reference;
+    } else {
+        InterpreterObj obj = interpretExpr(expr);
+        // a temporary - nobody else can see it
+        if (obj.tag != ObjType_Ref) {
+            if (obj.tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(obj.tag));
+            return obj.array;
+        }
+        slot = obj.reference;
     }
-    // todo: searches, we already know it won't find anthing
-    else return ObjNSSet(&currentScope->objects, name, value);
+    while (slot->tag == ObjType_Ref) slot = slot->reference;
+    if (slot->tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(slot->tag));
+    return arrayForWrite(&slot->array);
 }
 
 STATIC INLINE InterpreterObj assign(Expression a, InterpreterObj b) {
+    // b = a - both names now share the string, or the array until one of them writes to it
+    if (b.tag == ObjType_Ref && isShared(IOAbs(b).tag)) b = copyObj(IOAbs(b));
     MAKE_ABS(b);
 
+    // array elements aren't (necessarily) InterpreterObjs, so they can't be refs
+    if (a.tag == ExprTag_Call && a.call.tag == Call_Array) {
+        ArrayObj* array = arrayForWriteFromExpr(*a.call.callee);
+        int offset = arrayIndex(array, a.call);
+        arraySet(array, offset, b);
+        return arrayGet(array, offset);
+    }
+
     InterpreterObj* ref;
 
     // assignment or initialization!!
@@ -173,130 +127,12 @@ STATIC INLINE InterpreterObj assign(Expression a, InterpreterObj b) {
     };
 }
 
-STATIC bool equal(InterpreterObj a, InterpreterObj b) {
-    MAKE_ABS(a)
-    MAKE_ABS(b)
-
-    if (a.tag != b.tag) return false;
-    switch (a.tag) {
-        case ObjType_Class:
-        case ObjType_Func:
-        case ObjType_Proc:
-        case ObjType_NativeFunc:
-        case ObjType_NativeProc:
-        case ObjType_Instance: panic(Panic_Interpreter, "Can't check %s for equality yet!", ObjTypeToString(a.tag));
-
-        case ObjType_Nil: return true;
-        case ObjType_Bool: return a.bool_ == b.bool_;
-        case ObjType_Int: return a.int_ == b.int_;
-        case ObjType_String: {
-            if (a.string.length != b.string.length) return false;
-            return strncmp(a.string.start, b.string.start, a.string.length) == 0;
-        }
-        case ObjType_Float: return a.float_ == b.float_;
-        case ObjType_Array: {
-            if (a.array.len != b.array.len) return false;
-            for (int i = 0; i < a.array.len; i++) {
-                if (!equal(a.array.root[i], b.array.root[i])) return false;
-            }
-            return true;
-        }
-    }
-}
-
 _EXPR_SHORTCUT(bool, equal)
-
-#define NUMERIC_OP(name, op) STATIC InterpreterObj name(InterpreterObj a, InterpreterObj b) { \
-    MAKE_ABS(a); \
-    MAKE_ABS(b); \
-    if (a.tag == ObjType_Float) { \
-        float aNum = a.float_; \
-        if (b.tag == ObjType_Float) { \
-            float bNum = b.float_; \
-            return (InterpreterObj){.tag = ObjType_Float, .float_ = op}; \
-        } else if (b.tag == ObjType_Int) { \
-            int bNum = b.int_; \
-            return (InterpreterObj){.tag = ObjType_Float, .float_ = op}; \
-        } \
-    } else if (a.tag == ObjType_Int) { \
-        float aNum = a.int_; \
-        if (b.tag == ObjType_Float) { \
-            float bNum = b.float_; \
-            return (InterpreterObj){.tag = ObjType_Int, .int_ = op}; \
-        } else if (b.tag == ObjType_Int) { \
-            int bNum = b.int_; \
-            return (InterpreterObj){.tag = ObjType_Int, .int_ = op}; \
-        } \
-    } \
-    panic(Panic_Interpreter, "Invalid operator between %s and %s", ObjTypeToString(a.tag), ObjTypeToString(b.tag)); \
-} \
-_EXPR_SHORTCUT(InterpreterObj, name)
-
-NUMERIC_OP(iExponent, pow(aNum, bNum))
-NUMERIC_OP(multiply, aNum * bNum)
-NUMERIC_OP(divide, aNum / bNum)
-NUMERIC_OP(subtract, aNum - bNum)
-NUMERIC_OP(_addNum, aNum + bNum)
-
-STATIC InterpreterObj add(InterpreterObj a, InterpreterObj b) {
-    MAKE_ABS(a);
-    MAKE_ABS(b);
-
-    if (a.tag == ObjType_String && b.tag == ObjType_String) {
-        char* out = malloc(a.string.length + b.string.length);
-        memcpy(out, a.string.start, a.string.length);
-        memcpy(out + a.string.length, b.string.start, b.string.length);
-        return (InterpreterObj){
-            .tag = ObjType_String,
-            .string = (StringObj){
-                .start = out,
-                .length = a.string.length + b.string.length,
-                .allocated = true
-            }
-        };
-    } else if (a.tag == ObjType_Array && b.tag == ObjType_Array) {
-        ObjList out;
-        INIT(out);
-
-        APPEND_ALL(ObjList, out, a.array);
-        APPEND_ALL(ObjList, out, b.array);
-        
-        return (InterpreterObj){
-            .tag = ObjType_Array,
-            .array = out
-        };
-    }
-    return _addNum(a, b);
-}
-
+_EXPR_SHORTCUT(InterpreterObj, iExponent)
+_EXPR_SHORTCUT(InterpreterObj, multiply)
+_EXPR_SHORTCUT(InterpreterObj, divide)
+_EXPR_SHORTCUT(InterpreterObj, subtract)
 _EXPR_SHORTCUT(InterpreterObj, add)
-
-STATIC bool less(InterpreterObj a, InterpreterObj b) {
-    MAKE_ABS(a);
-    MAKE_ABS(b);
-
-    if (a.tag == ObjType_Float) {
-        if (b.tag == ObjType_Float) return a.float_ < b.float_;
-        else if (b.tag == ObjType_Int) return a.float_ < b.int_;
-    } else if (a.tag == ObjType_Int) {
-        if (b.tag == ObjType_Float) return a.int_ < b.float_;
-        else if (b.tag == ObjType_Int) return a.int_ < b.int_;
-    }
-    panic(Panic_Interpreter, "Invalid operator between %s and %s", ObjTypeToString(a.tag), ObjTypeToString(b.tag));
-}
-
-STATIC INLINE bool greaterEqual(InterpreterObj a, InterpreterObj b) {
-    return !less(a, b);
-}
-
-STATIC INLINE bool lessEqual(InterpreterObj a, InterpreterObj b) {
-    return less(a, b) || equal(a, b);
-}
-
-STATIC INLINE bool greater(InterpreterObj a, InterpreterObj b) {
-    return !lessEqual(a, b);
-}
-
 _EXPR_SHORTCUT(bool, less)
 _EXPR_SHORTCUT(bool, greater)
 _EXPR_SHORTCUT(bool, lessEqual)
@@ -354,16 +190,103 @@ InterpreterObj binaryExpr(TokType operator, Expression a, Expression b) {
 #undef BOOLOBJ
 }
 
-//* needs destroy!
-//
-// everything is a VALUE NOT A REFERENCE!!
-STATIC ObjList parseArgsForNative(CallExpr call) {
-    ObjList out;
-    INIT(out);
-    FOREACH(ExprList, call.arguments, current) {
-        // freed after native func call!!
-        APPEND(out, copyObj(IOAbs(interpretExpr(*current))));
+// Both sides have been proven to be ints or floats by the checker
+STATIC INLINE InterpreterObj typedBinaryExpr(BinaryExpr binary) {
+    InterpreterObj a = interpretExpr(*binary.a);
+    InterpreterObj b = interpretExpr(*binary.b);
+    return typedBinary(binary.operator.type, binary.operandType, a, b);
+}
+
+STATIC InterpreterObj interpretCached(CachedExpr cached) {
+    InterpreterObj out;
+    if (cacheGet(cached.slot, &out)) return out;
+    out = interpretExpr(*cached.expr);
+    cacheSet(cached.slot, out);
+    return out;
+}
+
+// Evaluate the whole expression of a statement
+STATIC INLINE InterpreterObj interpretRootExpr(Expression expr) {
+    newCacheGeneration();
+    return interpretExpr(expr);
+}
+
+STATIC INLINE bool isTruthyRootExpr(Expression expr) {
+    newCacheGeneration();
+    return isTruthyExpr(expr);
+}
+
+InterpreterObj interpretCall(FunDecl func, CallExpr* call, InterpreterObj* args) {
+    int argc = func.params.len;
+    InterpreterObj out;
+    if (jitCall(func, args, argc, &out)) {
+        for (int i = 0; i < argc; i++) freeObj(args[i]);
+        return out;
+    }
+
+    // Create a new scope as the function's context
+    Scope* executionScope = newScope();
+    // no closures for you!!
+    executionScope->parent = globalScope;
+
+    // adding the arguments to the NEW SCOPE
+    for (int i = 0; i < argc; i++) {
+        // essentially an assign so freed when the scope is destroyed!!!!!!!
+        InterpreterObj arg = args[i];
+        if (func.params.root[i].passMode == Param_byRef) {
+            if (arg.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't pass a %s by reference!", call == NULL ? "temporary" : ExprTagToString(call->arguments.root[i].tag));
+            ObjNSSet(&executionScope->objects, tokText(func.params.root[i].name), (InterpreterObj){
+                .tag = ObjType_Ref,
+                .reference = arg.reference,
+                ._nameAllocated = true
+            });
+        } else {
+            InterpreterObj* newObj = ObjNSSet(&executionScope->objects, tokText(func.params.root[i].name), copyObj(IOAbs(arg)));
+            newObj->_nameAllocated = true;
+            freeObj(arg);
+        }
+    }
+
+    // Now we've evaluated the arguments, we can setup the scope as the
+    // function's execution context.
+    Scope* outerScope = currentScope;
+    currentScope = executionScope;
+
+    // hot enough to have been compiled
+    Closure* body = tierFunction(func);
+    if (body != NULL) {
+        out = runFunctionBody(body, func);
+        goto returned;
+    }
+
+    FOREACH(FuncDeclList, func.block, currentDOR) {
+        if (currentDOR->tag == DOR_return) {
+            out = interpretRootExpr(currentDOR->return_);
+            // returning a local - it needs to outlive the scope!
+            if (out.tag == ObjType_Ref) out = copyObj(IOAbs(out));
+            goto returned;
+        }
+        interpretDecl(*currentDOR->declaration);
     }
+
+    // we've interpreted everything in the func - why haven't we returned!!
+    panic(Panic_Interpreter, "Function %s must return a value!", tokText(func.name));
+
+    returned:
+    destroyScope(executionScope);
+    currentScope = outerScope;
+    return out;
+}
+
+// receiver.name(arguments) - see callMethod
+STATIC InterpreterObj methodCall(CallExpr* member, ExprList arguments) {
+    int argc = arguments.len + 1;
+    InterpreterObj stackArgs[NATIVE_STACK_ARGS];
+    InterpreterObj* args = argc <= NATIVE_STACK_ARGS ? stackArgs : malloc(argc * sizeof(InterpreterObj));
+    args[0] = interpretExpr(*member->callee);
+    for (int i = 1; i < argc; i++) args[i] = interpretExpr(arguments.root[i - 1]);
+    InterpreterObj out = callMethod(member->memberName.start, member->memberName.length, args, argc);
+    if (args != stackArgs) free(args);
     return out;
 }
 
@@ -381,12 +304,17 @@ InterpreterObj interpretExpr(Expression expr) {
             break;
         }
         case ExprTag_Binary: {
-            out = binaryExpr(expr.binary.operator.type, *expr.binary.a, *expr.binary.b);
+            if (expr.binary.operandType != ObjType_Nil) out = typedBinaryExpr(expr.binary);
+            else out = binaryExpr(expr.binary.operator.type, *expr.binary.a, *expr.binary.b);
             break;
         }
         case ExprTag_Call: {
             switch (expr.call.tag) {
                 case Call_Call: {
+                    if (expr.call.callee->tag == ExprTag_Call && expr.call.callee->call.tag == Call_GetMember) {
+                        out = methodCall(&expr.call.callee->call, expr.call.arguments);
+                        break;
+                    }
                     // won't allocate - it's a lookup i think?
                     InterpreterObj calleeObj = IOAbs(interpretExpr(*expr.call.callee));
 
@@ -400,85 +328,40 @@ InterpreterObj interpretExpr(Expression expr) {
 
                     switch (calleeObj.tag) {
                         case ObjType_Func: {
-                            // Create a new scope as the function's context
-                            Scope* executionScope = newScope();
-                            // no closures for you!!
-                            executionScope->parent = globalScope;
-
-                            if (expr.call.arguments.len != calleeObj.func.params.len)
+                            if (!expr.call.arityProven && expr.call.arguments.len != calleeObj.func.params.len)
                                 panic(Panic_Interpreter, "Called function %s with %i args instead of %i", tokText(calleeObj.func.name), expr.call.arguments.len, calleeObj.func.params.len);
 
-                            ObjList referenceArgs;
-                            INIT(referenceArgs);
-
-                            // Evaluate function arguments in the CURRENT SCOPE, adding results to the NEW SCOPE
-                            for (int i = 0; i < expr.call.arguments.len; i++) {
-                                // essentially an assign so freed when the scope is destroyed!!!!!!!
-                                InterpreterObj arg = interpretExpr(expr.call.arguments.root[i]);
-                                if (calleeObj.func.params.root[i].passMode == Param_byRef) {
-                                    if (!arg.tag == ObjType_Ref) panic(Panic_Interpreter, "Can't pass a %s by reference!", ExprTagToString(expr.call.arguments.root[i].tag));
-                                    ObjNSSet(&executionScope->objects, tokText(calleeObj.func.params.root[i].name), (InterpreterObj){
-                                        .tag = ObjType_Ref,
-                                        .reference = &arg,
-                                        ._nameAllocated = true
-                                    });
-                                } else {
-                                    InterpreterObj* newObj = ObjNSSet(&executionScope->objects, tokText(calleeObj.func.params.root[i].name), copyObj(IOAbs(arg)));
-                                    newObj->_nameAllocated = true;
-                                }
-                            }
-
-                            // Now we've evaluated the arguments, we can setup the scope as the
-                            // function's execution context.
-                            Scope* outerScope = currentScope;
-                            currentScope = executionScope;
-
-                            FOREACH(FuncDeclList, calleeObj.func.block, currentDOR) {
-                                if (currentDOR->tag == DOR_return) {
-                                    out = IOAbs(interpretExpr(currentDOR->return_));
-                                    destroyScope(executionScope);
-                                    currentScope = outerScope;
-                                    // boo!
-                                    // (double break)
-                                    goto returned;
-                                }
-                                interpretDecl(*currentDOR->declaration);
-                            }
-
-                            // we've interpreted everything in the func - why haven't we returned!!
-                            panic(Panic_Interpreter, "Function %s must return a value!", tokText(calleeObj.func.name));
-
-                            returned: break;
-                        }
-                        case ObjType_Proc: {
+                            // Evaluate function arguments in the CURRENT SCOPE
+                            ObjList args;
+                            INIT(args);
+                            FOREACH(ExprList, expr.call.arguments, arg) APPEND(args, interpretExpr(*arg));
+                            out = interpretCall(calleeObj.func, &expr.call, args.root);
+                            DESTROY(args);
                             break;
                         }
-                        case ObjType_NativeFunc: {
-                            ObjList args = parseArgsForNative(expr.call);
-                            out = calleeObj.nativeFunc(args);
-                            FOREACH(ObjList, args, obj) {
-                                freeObj(*obj);
-                            }
-                            DESTROY(args);
+                        case ObjType_Proc: {
                             break;
                         }
+                        case ObjType_NativeFunc:
                         case ObjType_NativeProc: {
-                            ObjList args = parseArgsForNative(expr.call);
-                            calleeObj.nativeProc(args);
-                            FOREACH(ObjList, args, obj) {
-                                freeObj(*obj);
-                            }
-                            DESTROY(args);
-                            out = IOBJ(.tag = ObjType_Nil);
+                            int argc = expr.call.arguments.len;
+                            InterpreterObj stackArgs[NATIVE_STACK_ARGS];
+                            InterpreterObj* args = argc <= NATIVE_STACK_ARGS ? stackArgs : malloc(argc * sizeof(InterpreterObj));
+                            for (int i = 0; i < argc; i++) args[i] = interpretExpr(expr.call.arguments.root[i]);
+                            out = callNative(calleeObj, args, argc, expr.call.arityProven);
+                            if (args != stackArgs) free(args);
                             break;
                         }
                     }
                     break;
                 }
                 case Call_GetMember: {
+                    out = methodCall(&expr.call, (ExprList){0});
                     break;
                 }
                 case Call_Array: {
+                    ArrayObj* array = arrayFromExpr(*expr.call.callee);
+                    out = arrayGet(array, arrayIndex(array, expr.call));
                     break;
                 }
             }
@@ -491,6 +374,10 @@ InterpreterObj interpretExpr(Expression expr) {
             out = interpretExpr(*expr.grouping);
             break;
         }
+        case ExprTag_Cached: {
+            out = interpretCached(expr.cached);
+            break;
+        }
         case ExprTag_Primary: {
             char* text = tokText(expr.primary);
             switch (expr.primary.type) {
@@ -510,8 +397,7 @@ InterpreterObj interpretExpr(Expression expr) {
                         .tag = ObjType_String,
                         .string = (StringObj){
                             .start = expr.primary.start + 1,
-                            .length = expr.primary.length - 2,
-                            .allocated = false
+                            .length = expr.primary.length - 2
                         }
                     );
                     break;
@@ -541,41 +427,30 @@ InterpreterObj interpretExpr(Expression expr) {
     return out;
 }
 
-STATIC INLINE InterpreterObj IOAbs(InterpreterObj obj) {
-    while (obj.tag == ObjType_Ref) obj = *obj.reference;
-    return obj;
+// One iteration of a loop - on the closures, once it's hot enough
+STATIC INLINE void interpretLoopBody(TierLoop* tier, DeclList* block) {
+    Closure* body = tierLoop(tier);
+    if (body != NULL) runClosure(body);
+    else interpretBlock(*block);
 }
 
-bool isTruthy(InterpreterObj obj) {
-    MAKE_ABS(obj);
-    switch (obj.tag) {
-        case ObjType_Class:
-        case ObjType_Func:
-        case ObjType_Proc:
-        case ObjType_NativeFunc:
-        case ObjType_NativeProc:
-        case ObjType_Instance: panic(Panic_Interpreter, "Can't (yet) use a %s as a boolean!", ObjTypeToString(obj.tag));
-
-        case ObjType_Nil: return false;
-        case ObjType_Bool: return obj.bool_;
-        case ObjType_Int: return obj.int_ > 0;
-        case ObjType_String: return obj.string.length > 0;
-        case ObjType_Float: return obj.float_ > 0;
-        case ObjType_Array: return obj.array.len > 0;
-    }
+// One iteration of a parallel loop, on one of its threads
+STATIC void interpretParallelBody(void* loop) {
+    interpretLoopBody(((ForStmt*)loop)->tier, ((ForStmt*)loop)->block);
 }
 
 STATIC void interpretStmt(Statement stmt) {
     switch (stmt.tag) {
         case StmtTag_Expr: {
-            interpretExpr(stmt.expr);
+            interpretRootExpr(stmt.expr);
             break;
         }
         case StmtTag_Global: {
-            ObjNSSet(&globalScope->objects, tokText(stmt.global.name), interpretExpr(stmt.global.initializer));
+            ObjNSSet(&globalScope->objects, tokText(stmt.global.name), interpretRootExpr(stmt.global.initializer));
             break;
         }
         case StmtTag_For: {
+            if (stmt.for_.parallel && parallelFor(&stmt.for_, interpretParallelBody, &stmt.for_)) break;
             pushScope();
             InterpreterObj* iteratorObj = setVar(tokText(stmt.for_.iterator), interpretExpr(stmt.for_.min), true);
             Expression iterator = (Expression){
@@ -619,38 +494,42 @@ STATIC void interpretStmt(Statement stmt) {
                     }
                 }
             };
+            InterpreterObj max = interpretExpr(stmt.for_.max);
+            proveIndices(stmt.for_, *iteratorObj, max);
+            freeObj(max);
             while (isTruthyExpr(cond)) {
-                interpretBlock(*stmt.for_.block);
+                interpretLoopBody(stmt.for_.tier, stmt.for_.block);
                 interpretExpr(incr);
             }
+            forgetIndices(stmt.for_);
             free(incr.binary.b);
             popScope();
             break;
         }
         case StmtTag_While: {
-            while (isTruthyExpr(stmt.while_.condition)) {
-                interpretBlock(*stmt.while_.block);
+            while (isTruthyRootExpr(stmt.while_.condition)) {
+                interpretLoopBody(stmt.while_.tier, stmt.while_.block);
             }
             break;
         }
         case StmtTag_Do: {
             //* yikes!! not a do-while but a do-until!
-            while (!isTruthyExpr(stmt.do_.condition)) {
-                interpretBlock(*stmt.do_.block);
+            while (!isTruthyRootExpr(stmt.do_.condition)) {
+                interpretLoopBody(stmt.do_.tier, stmt.do_.block);
             }
             break;
         }
         case StmtTag_If: {
-            if (isTruthyExpr(stmt.if_.primary.condition)) {
+            if (isTruthyRootExpr(stmt.if_.primary.condition)) {
                 interpretBlock(*stmt.if_.primary.block);
             } else {
                 FOREACH(ElseIfList, stmt.if_.secondary, currentBranch) {
-                    if (isTruthyExpr(currentBranch->condition)) {
+                    if (isTruthyRootExpr(currentBranch->condition)) {
                         interpretBlock(*currentBranch->block);
                         break;
                     }
                 }
-                if (stmt.if_.hasElse && isTruthyExpr(stmt.if_.else_.condition)) {
+                if (stmt.if_.hasElse && isTruthyRootExpr(stmt.if_.else_.condition)) {
                     interpretBlock(*stmt.if_.else_.block);
                 }
             }
@@ -660,6 +539,22 @@ STATIC void interpretStmt(Statement stmt) {
             break;
         }
         case StmtTag_Array: {
+            ArrayDimensions dimensions = stmt.array.dimensions;
+            if (dimensions.len > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Arrays can have at most %i dimensions!", ARRAY_MAX_RANK);
+            int dims[ARRAY_MAX_RANK];
+            for (int i = 0; i < dimensions.len; i++) {
+                InterpreterObj dim = IOAbs(interpretExpr(dimensions.root[i]));
+                if (dim.tag != ObjType_Int) panic(Panic_Interpreter, "Array dimensions must be ints, not %s!", ObjTypeToString(dim.tag));
+                dims[i] = dim.int_;
+            }
+            char* name = tokText(stmt.array.name);
+            // redeclaring - get rid of the old one
+            InterpreterObj* existing = findObj(name);
+            if (existing != NULL) freeObj(*existing);
+            setVar(name, (InterpreterObj){
+                .tag = ObjType_Array,
+                .array = newArray(dimensions.len, dims)
+            }, true);
             break;
         }
     }
@@ -710,49 +605,11 @@ STATIC void interpretBlock(DeclList block) {
     }
 }
 
-typedef struct {
-    char* name;
-    NativeFunc func;
-} STLFuncDef;
-
-typedef struct {
-    char* name;
-    NativeProc proc;
-} STLProcDef;
-
-STATIC STLFuncDef stl_funcs[] = {
-    {"typeof", stl_typeof},
-    {"bool", stl_bool},
-    {"string", stl_string},
-    {"float", stl_float},
-    {"int", stl_int},
-    {"", NULL}
-};
-
-STATIC STLProcDef stl_procs[] = {
-    {"print", stl_print},
-    {"", NULL}
-};
-
-STATIC void setupSTL() {
-    for (int i = 0; stl_funcs[i].name[0] != '\0'; i++) {
-        setVar(stl_funcs[i].name, (InterpreterObj){
-            .tag = ObjType_NativeFunc,
-            .nativeFunc = stl_funcs[i].func
-        }, false);
-    }
-
-    for (int i = 0; stl_procs[i].name[0] != '\0'; i++) {
-        setVar(stl_procs[i].name, (InterpreterObj){
-            .tag = ObjType_NativeProc,
-            .nativeProc = stl_procs[i].proc
-        }, false);
-    }
-}
-
 void interpret(ParseOutput po) {
     pushScope();
     setupSTL();
     interpretBlock(po.ast);
+    tierShutdown();
+    parallelShutdown();
     popScope();
 }
\ No newline at end of file
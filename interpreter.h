@@ -8,11 +8,57 @@
 typedef struct InterpreterObj InterpreterObj;
 DECL_VEC(InterpreterObj, ObjList);
 
+// see array.h
+typedef struct ArrayObj ArrayObj;
+// see stringObj.h
+typedef struct StringBuffer StringBuffer;
+// see file.h
+typedef struct FileObj FileObj;
+// see collections.h
+typedef struct DictionaryObj DictionaryObj;
+typedef struct StackObj StackObj;
+typedef struct QueueObj QueueObj;
+
 DECL_MAP(FunDecl, FuncNS)
 DECL_MAP(ProcDecl, ProcNS)
 
-typedef void (*NativeProc)(ObjList);
-typedef InterpreterObj (*NativeFunc)(ObjList);
+// Natives borrow their arguments - args are values (never references) which
+// belong to the caller, so a native mustn't free them or hang on to them.
+// Anything it returns has to be its own (see copyObj).
+typedef void (*NativeProc)(InterpreterObj* args, int argc);
+typedef InterpreterObj (*NativeFunc)(InterpreterObj* args, int argc);
+
+#define STL_MAX_PARAMS 4
+// The types a native parameter accepts - ACCEPTS(Int) | ACCEPTS(Float)
+#define ACCEPTS(type) (1 << ObjType_##type)
+
+// What a native takes & gives back. Arguments are checked against it by
+// whoever calls the native (or once & for all by the checker), so the
+// native itself can trust them.
+typedef struct {
+    // -1 if it takes any number of arguments, of any type
+    int arity;
+    // ObjType_Ref if it depends on the arguments (natives never give back
+    // an actual reference)
+    ObjType returns;
+    // a mask of ACCEPTS() for each parameter - 0 for anything
+    int params[STL_MAX_PARAMS];
+    // it only reads its arguments (& anything it keeps for itself is per
+    // thread), so it can be called from a parallel loop - see parallel.h
+    bool threadSafe;
+} STLSignature;
+
+typedef struct {
+    char* name;
+    NativeFunc func;
+    STLSignature signature;
+} STLFuncDef;
+
+typedef struct {
+    char* name;
+    NativeProc proc;
+    STLSignature signature;
+} STLProcDef;
 
 typedef struct {
     FuncNS funcs;
@@ -26,7 +72,8 @@ typedef struct {
 typedef struct {
     char* start;
     int length;
-    bool allocated;
+    // where the chars live - NULL if they're never freed (literals)
+    StringBuffer* owner;
 } StringObj;
 
 struct InterpreterObj {
@@ -39,15 +86,26 @@ struct InterpreterObj {
         float float_;
         FunDecl func;
         ProcDecl proc;
-        NativeFunc nativeFunc;
-        NativeProc nativeProc;
+        STLFuncDef* nativeFunc;
+        STLProcDef* nativeProc;
         ClassObj class;
-        ObjList array;
+        ArrayObj* array;
+        FileObj* file;
+        DictionaryObj* dictionary;
+        StackObj* stack;
+        QueueObj* queue;
         InstanceObj instance;
         InterpreterObj* reference;
     };
 };
 
+void freeObj(InterpreterObj obj);
+InterpreterObj copyObj(InterpreterObj obj);
+
 InterpreterObj interpretExpr(Expression expr);
+// Call func with args, which have already been evaluated (& are consumed) -
+// call is where it's being called from, or NULL for a call from a native.
+// The caller's already checked there's one arg per parameter.
+InterpreterObj interpretCall(FunDecl func, CallExpr* call, InterpreterObj* args);
 bool isTruthy(InterpreterObj obj);
 void interpret(ParseOutput po);
\ No newline at end of file
@@ -0,0 +1,1065 @@
+#include "ir.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "panic.h"
+
+// SSA construction follows Braun et al, "Simple and Efficient Construction of
+// Static Single Assignment Form" - locals are renamed on the fly as the AST is
+// lowered. A block is sealed once all its predecessors are known; reading a
+// local in an unsealed block leaves a phi to be filled in when it's sealed.
+
+DECL_VEC(char*, NameList)
+
+// the function being built & the block instructions are going into
+static IRFunction* function;
+static IRBlock* block;
+// the function's locals - NULL at the top level
+static NameList* locals;
+static IRFunctionList* functions;
+
+//* ---------------- instructions & blocks ----------------
+
+STATIC IRBlock* newBlock() {
+    IRBlock* out = calloc(1, sizeof(IRBlock));
+    out->id = function->blocks.len;
+    out->function = function;
+    INIT(out->instrs);
+    INIT(out->preds);
+    INIT(out->incompletePhis);
+    out->defs = NewIRDefs();
+    APPEND(function->blocks, out);
+    return out;
+}
+
+STATIC IRInstr* newInstr(IROp op, IRBlock* in) {
+    IRInstr* out = calloc(1, sizeof(IRInstr));
+    out->op = op;
+    out->type = IRType_None;
+    out->id = function->valueCount++;
+    out->block = in;
+    INIT(out->operands);
+    return out;
+}
+
+// phis & undefs go before everything else in the block
+STATIC void insertAtStart(IRBlock* in, IRInstr* instr) {
+    APPEND(in->instrs, instr);
+    memmove(in->instrs.root + 1, in->instrs.root, (in->instrs.len - 1) * sizeof(IRInstr*));
+    in->instrs.root[0] = instr;
+}
+
+STATIC bool isTerminator(IROp op) {
+    return op == IROp_Jump || op == IROp_Branch || op == IROp_Return || op == IROp_Trap;
+}
+
+STATIC bool terminated(IRBlock* in) {
+    return in->instrs.len > 0 && isTerminator(in->instrs.root[in->instrs.len - 1]->op);
+}
+
+// Add an instruction to the end of the current block
+STATIC IRInstr* emit(IROp op) {
+    IRInstr* out = newInstr(op, block);
+    APPEND(block->instrs, out);
+    return out;
+}
+
+STATIC IRInstr* emitUnaryOp(IROp op, IRInstr* operand) {
+    IRInstr* out = emit(op);
+    APPEND(out->operands, operand);
+    return out;
+}
+
+STATIC IRInstr* emitBinaryOp(IROp op, IRInstr* a, IRInstr* b) {
+    IRInstr* out = emit(op);
+    APPEND(out->operands, a);
+    APPEND(out->operands, b);
+    return out;
+}
+
+STATIC IRInstr* emitConst(IRType type) {
+    IRInstr* out = emit(IROp_Const);
+    out->type = type;
+    return out;
+}
+
+STATIC void jump(IRBlock* target) {
+    if (terminated(block)) return;
+    IRInstr* instr = emit(IROp_Jump);
+    instr->targets[0] = target;
+    APPEND(target->preds, block);
+}
+
+STATIC void branch(IRInstr* condition, IRBlock* ifTrue, IRBlock* ifFalse) {
+    IRInstr* instr = emitUnaryOp(IROp_Branch, condition);
+    instr->targets[0] = ifTrue;
+    instr->targets[1] = ifFalse;
+    APPEND(ifTrue->preds, block);
+    APPEND(ifFalse->preds, block);
+}
+
+//* ---------------- SSA ----------------
+
+STATIC IRInstr* readVariable(char* name, IRBlock* in);
+
+STATIC void writeVariable(char* name, IRBlock* in, IRInstr* value) {
+    IRDefsSet(&in->defs, name, value);
+}
+
+STATIC IRInstr* newPhi(IRBlock* in, char* name) {
+    IRInstr* phi = newInstr(IROp_Phi, in);
+    phi->variable = name;
+    insertAtStart(in, phi);
+    return phi;
+}
+
+STATIC IRInstr* addPhiOperands(IRInstr* phi) {
+    FOREACH(IRBlockList, phi->block->preds, pred) APPEND(phi->operands, readVariable(phi->variable, *pred));
+    return phi;
+}
+
+STATIC IRInstr* readVariable(char* name, IRBlock* in) {
+    IRInstr** def = IRDefsFind(&in->defs, name);
+    if (def != NULL) return *def;
+
+    IRInstr* out;
+    if (!in->sealed) {
+        out = newPhi(in, name);
+        APPEND(in->incompletePhis, out);
+    } else if (in->preds.len == 0) {
+        // never assigned on the way here
+        IRBlock* entry = function->blocks.root[0];
+        out = newInstr(IROp_Undef, entry);
+        insertAtStart(entry, out);
+    } else if (in->preds.len == 1) {
+        out = readVariable(name, in->preds.root[0]);
+    } else {
+        out = newPhi(in, name);
+        // a loop back to here finds the phi instead of looking forever
+        writeVariable(name, in, out);
+        addPhiOperands(out);
+    }
+    writeVariable(name, in, out);
+    return out;
+}
+
+STATIC void seal(IRBlock* in) {
+    FOREACH(IRInstrList, in->incompletePhis, phi) addPhiOperands(*phi);
+    in->incompletePhis.len = 0;
+    in->sealed = true;
+}
+
+STATIC IRInstr* resolve(IRInstr* value) {
+    while (value->replacement != NULL) value = value->replacement;
+    return value;
+}
+
+// A phi whose operands are all the same value (or the phi itself) is just that
+// value. Removing one can make others trivial, so go until nothing changes.
+STATIC void removeTrivialPhis() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        FOREACH(IRBlockList, function->blocks, b) {
+            FOREACH(IRInstrList, (*b)->instrs, instr) {
+                IRInstr* phi = *instr;
+                if (phi->op != IROp_Phi || phi->replacement != NULL) continue;
+                IRInstr* same = NULL;
+                bool trivial = true;
+                FOREACH(IRInstrList, phi->operands, operand) {
+                    IRInstr* value = resolve(*operand);
+                    if (value == same || value == phi) continue;
+                    if (same != NULL) {
+                        trivial = false;
+                        break;
+                    }
+                    same = value;
+                }
+                // only the phi itself - it's unreachable, or never assigned
+                if (trivial && same == NULL) {
+                    same = newInstr(IROp_Undef, function->blocks.root[0]);
+                    insertAtStart(function->blocks.root[0], same);
+                }
+                if (trivial) {
+                    phi->replacement = same;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    FOREACH(IRBlockList, function->blocks, b) {
+        IRInstrList* instrs = &(*b)->instrs;
+        int kept = 0;
+        for (int i = 0; i < instrs->len; i++) {
+            IRInstr* instr = instrs->root[i];
+            FOREACH(IRInstrList, instr->operands, operand) *operand = resolve(*operand);
+            if (instr->replacement == NULL) instrs->root[kept++] = instr;
+        }
+        instrs->len = kept;
+    }
+    // the replaced phis are still referenced by replacement chains until now
+    FOREACH(IRBlockList, function->blocks, b) {
+        FOREACH(IRDefs, (*b)->defs, def) def->value = resolve(def->value);
+    }
+}
+
+//* ---------------- types ----------------
+
+STATIC IRType joinTypes(IRType a, IRType b) {
+    if (a == IRType_None) return b;
+    if (b == IRType_None) return a;
+    return a == b ? a : IRType_Any;
+}
+
+STATIC bool isNumeric(IRType type) {
+    return type == IRType_Int || type == IRType_Float;
+}
+
+// see NUMERIC_OP - the result has the type of the left operand
+STATIC IRType numericType(IRType a, IRType b) {
+    if (a == IRType_None || b == IRType_None) return IRType_None;
+    if (isNumeric(a) && isNumeric(b)) return a;
+    return IRType_Any;
+}
+
+STATIC IRType inferType(IRInstr* instr) {
+    switch (instr->op) {
+        case IROp_Const: return instr->type;
+        case IROp_Param:
+        case IROp_Undef:
+        case IROp_LoadVar:
+        case IROp_Call:
+        case IROp_LoadElement: return IRType_Any;
+        case IROp_Phi: {
+            IRType out = IRType_None;
+            FOREACH(IRInstrList, instr->operands, operand) out = joinTypes(out, (*operand)->type);
+            return out;
+        }
+        case IROp_Add: {
+            IRType a = instr->operands.root[0]->type;
+            IRType b = instr->operands.root[1]->type;
+            if (a == b && (a == IRType_String || a == IRType_Array)) return a;
+            return numericType(a, b);
+        }
+        case IROp_Subtract:
+        case IROp_Multiply:
+        case IROp_Divide:
+        case IROp_Exponent: return numericType(instr->operands.root[0]->type, instr->operands.root[1]->type);
+        case IROp_Equal:
+        case IROp_NotEqual:
+        case IROp_Less:
+        case IROp_LessEqual:
+        case IROp_Greater:
+        case IROp_GreaterEqual:
+        case IROp_Truthy: return IRType_Bool;
+        case IROp_NewArray: return IRType_Array;
+        case IROp_Function: return IRType_Func;
+        case IROp_Procedure: return IRType_Proc;
+        default: return IRType_Nil;
+    }
+}
+
+// Everything starts at None & only moves towards Any, so this always settles
+STATIC void inferTypes() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        FOREACH(IRBlockList, function->blocks, b) {
+            FOREACH(IRInstrList, (*b)->instrs, instr) {
+                IRType type = inferType(*instr);
+                if (type != (*instr)->type) {
+                    (*instr)->type = type;
+                    changed = true;
+                }
+            }
+        }
+    }
+    // nothing ever flows into it
+    FOREACH(IRBlockList, function->blocks, b) {
+        FOREACH(IRInstrList, (*b)->instrs, instr) {
+            if ((*instr)->type == IRType_None) (*instr)->type = IRType_Any;
+        }
+    }
+}
+
+//* ---------------- lowering ----------------
+
+STATIC void cantLower(char* what) {
+    panic(Panic_IR, "%s can't be lowered to IR yet!", what);
+}
+
+// The interned name if it's a local, or NULL
+STATIC char* findLocal(char* name) {
+    if (locals == NULL) return NULL;
+    FOREACH(NameList, *locals, local) {
+        if (strcmp(*local, name) == 0) return *local;
+    }
+    return NULL;
+}
+
+STATIC IRInstr* loadVariable(Token name) {
+    char* text = tokText(name);
+    char* local = findLocal(text);
+    if (local != NULL) {
+        free(text);
+        return readVariable(local, block);
+    }
+    IRInstr* out = emit(IROp_LoadVar);
+    out->name = text;
+    return out;
+}
+
+STATIC void storeVariable(Token name, IRInstr* value) {
+    char* text = tokText(name);
+    char* local = findLocal(text);
+    if (local != NULL) {
+        free(text);
+        writeVariable(local, block, value);
+        return;
+    }
+    IRInstr* out = emitUnaryOp(IROp_StoreVar, value);
+    out->name = text;
+}
+
+STATIC IRInstr* lowerExpr(Expression* expr);
+
+STATIC IRInstr* lowerPrimary(Token primary) {
+    switch (primary.type) {
+        case Tok_Identifier: return loadVariable(primary);
+        case Tok_Nil: return emitConst(IRType_Nil);
+        case Tok_True:
+        case Tok_False: {
+            IRInstr* out = emitConst(IRType_Bool);
+            out->constant.bool_ = primary.type == Tok_True;
+            return out;
+        }
+        case Tok_StringLit: {
+            // strip leading & trailing quotes!
+            IRInstr* out = emitConst(IRType_String);
+            out->constant.string.start = primary.start + 1;
+            out->constant.string.length = primary.length - 2;
+            return out;
+        }
+        case Tok_IntLit:
+        case Tok_FloatLit: {
+            char* text = tokText(primary);
+            IRInstr* out;
+            if (primary.type == Tok_IntLit) {
+                out = emitConst(IRType_Int);
+                out->constant.int_ = atoi(text);
+            } else {
+                out = emitConst(IRType_Float);
+                out->constant.float_ = strtof(text, NULL);
+            }
+            free(text);
+            return out;
+        }
+        // todo: handle self
+        default: cantLower("self");
+    }
+}
+
+STATIC IROp operatorOp(TokType operator) {
+    switch (operator) {
+        case Tok_Plus: return IROp_Add;
+        case Tok_Minus: return IROp_Subtract;
+        case Tok_Star: return IROp_Multiply;
+        case Tok_Slash: return IROp_Divide;
+        case Tok_Exp: return IROp_Exponent;
+        case Tok_EqualEqual: return IROp_Equal;
+        case Tok_BangEqual: return IROp_NotEqual;
+        case Tok_Less: return IROp_Less;
+        case Tok_LessEqual: return IROp_LessEqual;
+        case Tok_Greater: return IROp_Greater;
+        case Tok_GreaterEqual: return IROp_GreaterEqual;
+        default: panic(Panic_IR, "Unknown binary operator!");
+    }
+}
+
+// The operator a compound assignment applies (+ for +=), or Tok_Equal
+STATIC TokType assignedOperator(TokType operator) {
+    switch (operator) {
+        case Tok_ExpEqual: return Tok_Exp;
+        case Tok_StarEqual: return Tok_Star;
+        case Tok_SlashEqual: return Tok_Slash;
+        case Tok_PlusEqual: return Tok_Plus;
+        case Tok_MinusEqual: return Tok_Minus;
+        default: return Tok_Equal;
+    }
+}
+
+STATIC IRInstr* lowerCall(CallExpr call, IROp op) {
+    IRInstr* callee = lowerExpr(call.callee);
+    IRInstr* arguments[call.arguments.len];
+    for (int i = 0; i < call.arguments.len; i++) arguments[i] = lowerExpr(&call.arguments.root[i]);
+    IRInstr* out = emitUnaryOp(op, callee);
+    for (int i = 0; i < call.arguments.len; i++) APPEND(out->operands, arguments[i]);
+    return out;
+}
+
+// An assignment's value is the value assigned
+STATIC IRInstr* lowerAssignment(BinaryExpr binary) {
+    TokType operator = binary.operator.type;
+    IRInstr* value = operator == Tok_Equal
+        ? lowerExpr(binary.b)
+        : emitBinaryOp(operatorOp(assignedOperator(operator)), lowerExpr(binary.a), lowerExpr(binary.b));
+
+    Expression* target = binary.a;
+    if (target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier) {
+        storeVariable(target->primary, value);
+    } else if (target->tag == ExprTag_Call && target->call.tag == Call_Array) {
+        IRInstr* store = lowerCall(target->call, IROp_StoreElement);
+        APPEND(store->operands, value);
+    } else {
+        cantLower("Assignment to anything but a variable or an array element");
+    }
+    return value;
+}
+
+// AND & OR only evaluate b if they need to
+STATIC IRInstr* lowerLogical(BinaryExpr binary) {
+    IRInstr* a = emitUnaryOp(IROp_Truthy, lowerExpr(binary.a));
+    IRBlock* aEnd = block;
+    IRBlock* rhs = newBlock();
+    IRBlock* join = newBlock();
+    if (binary.operator.type == Tok_And) branch(a, rhs, join);
+    else branch(a, join, rhs);
+    seal(rhs);
+
+    block = rhs;
+    IRInstr* b = emitUnaryOp(IROp_Truthy, lowerExpr(binary.b));
+    jump(join);
+    seal(join);
+
+    block = join;
+    IRInstr* out = newPhi(join, NULL);
+    // in the same order as join's preds
+    APPEND(out->operands, join->preds.root[0] == aEnd ? a : b);
+    APPEND(out->operands, join->preds.root[0] == aEnd ? b : a);
+    return out;
+}
+
+STATIC IRInstr* lowerExpr(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: cantLower("Unary expressions");
+        case ExprTag_Binary: {
+            TokType operator = expr->binary.operator.type;
+            if (operator == Tok_Equal || assignedOperator(operator) != Tok_Equal) return lowerAssignment(expr->binary);
+            if (operator == Tok_And || operator == Tok_Or) return lowerLogical(expr->binary);
+            IRInstr* a = lowerExpr(expr->binary.a);
+            IRInstr* b = lowerExpr(expr->binary.b);
+            return emitBinaryOp(operatorOp(operator), a, b);
+        }
+        case ExprTag_Call: {
+            switch (expr->call.tag) {
+                case Call_Call: return lowerCall(expr->call, IROp_Call);
+                case Call_Array: return lowerCall(expr->call, IROp_LoadElement);
+                case Call_GetMember: cantLower("Member access");
+            }
+        }
+        case ExprTag_Super: cantLower("super");
+        case ExprTag_Grouping: return lowerExpr(expr->grouping);
+        // SSA values are only computed once anyway
+        case ExprTag_Cached: return lowerExpr(expr->cached.expr);
+        case ExprTag_Primary: return lowerPrimary(expr->primary);
+    }
+}
+
+STATIC void lowerBlock(DeclList* decls);
+STATIC IRFunction* lowerFunction(FunDecl* func);
+
+// Lower a block into a new block which follows on from the current one,
+// leaving the current block at its end
+STATIC void lowerBody(DeclList* decls, IRBlock* start) {
+    seal(start);
+    block = start;
+    lowerBlock(decls);
+}
+
+STATIC void lowerFor(ForStmt* for_) {
+    IRInstr* min = lowerExpr(&for_->min);
+    storeVariable(for_->iterator, min);
+    // the interpreter evaluates max once up front, to check array bounds
+    lowerExpr(&for_->max);
+
+    IRBlock* header = newBlock();
+    jump(header);
+    block = header;
+    IRInstr* inRange = emitBinaryOp(IROp_Less, loadVariable(for_->iterator), lowerExpr(&for_->max));
+    IRBlock* body = newBlock();
+    IRBlock* exit = newBlock();
+    branch(inRange, body, exit);
+
+    lowerBody(for_->block, body);
+    IRInstr* one = emitConst(IRType_Int);
+    one->constant.int_ = 1;
+    storeVariable(for_->iterator, emitBinaryOp(IROp_Add, loadVariable(for_->iterator), one));
+    jump(header);
+
+    seal(header);
+    seal(exit);
+    block = exit;
+}
+
+STATIC void lowerLoop(ConditionalBlock* loop, bool until) {
+    IRBlock* header = newBlock();
+    jump(header);
+    block = header;
+    IRInstr* condition = emitUnaryOp(IROp_Truthy, lowerExpr(&loop->condition));
+    IRBlock* body = newBlock();
+    IRBlock* exit = newBlock();
+    //* yikes!! not a do-while but a do-until!
+    if (until) branch(condition, exit, body);
+    else branch(condition, body, exit);
+
+    lowerBody(loop->block, body);
+    jump(header);
+
+    seal(header);
+    seal(exit);
+    block = exit;
+}
+
+// Same shape as interpretStmt - the else is checked even if an elseif ran
+STATIC void lowerIf(IfStmt* if_) {
+    IRBlock* join = newBlock();
+    IRBlock* then = newBlock();
+    IRBlock* otherwise = newBlock();
+    branch(emitUnaryOp(IROp_Truthy, lowerExpr(&if_->primary.condition)), then, otherwise);
+    lowerBody(if_->primary.block, then);
+    jump(join);
+
+    seal(otherwise);
+    block = otherwise;
+    if (if_->secondary.len > 0) {
+        IRBlock* elseIfsDone = newBlock();
+        FOREACH(ElseIfList, if_->secondary, elseIf) {
+            IRBlock* elseIfBody = newBlock();
+            IRBlock* next = newBlock();
+            branch(emitUnaryOp(IROp_Truthy, lowerExpr(&elseIf->condition)), elseIfBody, next);
+            lowerBody(elseIf->block, elseIfBody);
+            jump(elseIfsDone);
+            seal(next);
+            block = next;
+        }
+        jump(elseIfsDone);
+        seal(elseIfsDone);
+        block = elseIfsDone;
+    }
+    if (if_->hasElse) {
+        IRBlock* elseBody = newBlock();
+        branch(emitUnaryOp(IROp_Truthy, lowerExpr(&if_->else_.condition)), elseBody, join);
+        lowerBody(if_->else_.block, elseBody);
+    }
+    jump(join);
+
+    seal(join);
+    block = join;
+}
+
+STATIC void lowerStmt(Statement* stmt) {
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            lowerExpr(&stmt->expr);
+            break;
+        }
+        case StmtTag_Global: {
+            IRInstr* out = emitUnaryOp(IROp_Global, lowerExpr(&stmt->global.initializer));
+            out->name = tokText(stmt->global.name);
+            break;
+        }
+        case StmtTag_For: {
+            lowerFor(&stmt->for_);
+            break;
+        }
+        case StmtTag_While: {
+            lowerLoop(&stmt->while_, false);
+            break;
+        }
+        case StmtTag_Do: {
+            lowerLoop(&stmt->do_, true);
+            break;
+        }
+        case StmtTag_If: {
+            lowerIf(&stmt->if_);
+            break;
+        }
+        case StmtTag_Switch: {
+            break;
+        }
+        case StmtTag_Array: {
+            ArrayDimensions dimensions = stmt->array.dimensions;
+            IRInstr* sizes[dimensions.len];
+            for (int i = 0; i < dimensions.len; i++) sizes[i] = lowerExpr(&dimensions.root[i]);
+            IRInstr* out = emit(IROp_NewArray);
+            for (int i = 0; i < dimensions.len; i++) APPEND(out->operands, sizes[i]);
+            storeVariable(stmt->array.name, out);
+            break;
+        }
+    }
+}
+
+STATIC void lowerDecl(Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            IRInstr* out = emit(IROp_Function);
+            out->function = lowerFunction(&decl->fun);
+            storeVariable(decl->fun.name, out);
+            break;
+        }
+        case DeclTag_Proc: {
+            IRInstr* out = emit(IROp_Procedure);
+            out->name = tokText(decl->proc.name);
+            storeVariable(decl->proc.name, out);
+            break;
+        }
+        case DeclTag_Stmt: {
+            lowerStmt(&decl->stmt);
+            break;
+        }
+        case DeclTag_Class: break;
+    }
+}
+
+STATIC void lowerBlock(DeclList* decls) {
+    for (int i = 0; i < decls->len; i++) lowerDecl(&decls->root[i]);
+}
+
+//* ---------------- locals ----------------
+
+STATIC void addLocal(NameList* names, Token name) {
+    char* text = tokText(name);
+    FOREACH(NameList, *names, existing) {
+        if (strcmp(*existing, text) == 0) {
+            free(text);
+            return;
+        }
+    }
+    APPEND(*names, text);
+}
+
+STATIC void collectLocalsInExpr(NameList* names, Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: {
+            collectLocalsInExpr(names, expr->unary.operand);
+            break;
+        }
+        case ExprTag_Binary: {
+            Expression* target = expr->binary.a;
+            if (
+                (expr->binary.operator.type == Tok_Equal || assignedOperator(expr->binary.operator.type) != Tok_Equal) &&
+                target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier
+            ) addLocal(names, target->primary);
+            collectLocalsInExpr(names, expr->binary.a);
+            collectLocalsInExpr(names, expr->binary.b);
+            break;
+        }
+        case ExprTag_Call: {
+            collectLocalsInExpr(names, expr->call.callee);
+            if (expr->call.tag != Call_GetMember) {
+                FOREACH(ExprList, expr->call.arguments, arg) collectLocalsInExpr(names, arg);
+            }
+            break;
+        }
+        case ExprTag_Grouping: {
+            collectLocalsInExpr(names, expr->grouping);
+            break;
+        }
+        case ExprTag_Cached: {
+            collectLocalsInExpr(names, expr->cached.expr);
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void collectLocalsInBlock(NameList* names, DeclList* decls);
+
+STATIC void collectLocalsInDecl(NameList* names, Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: addLocal(names, decl->fun.name); break;
+        case DeclTag_Proc: addLocal(names, decl->proc.name); break;
+        case DeclTag_Class: break;
+        case DeclTag_Stmt: {
+            Statement* stmt = &decl->stmt;
+            switch (stmt->tag) {
+                case StmtTag_Expr: collectLocalsInExpr(names, &stmt->expr); break;
+                case StmtTag_Global: collectLocalsInExpr(names, &stmt->global.initializer); break;
+                case StmtTag_For: {
+                    addLocal(names, stmt->for_.iterator);
+                    collectLocalsInExpr(names, &stmt->for_.min);
+                    collectLocalsInExpr(names, &stmt->for_.max);
+                    collectLocalsInBlock(names, stmt->for_.block);
+                    break;
+                }
+                case StmtTag_While:
+                case StmtTag_Do: {
+                    ConditionalBlock* loop = stmt->tag == StmtTag_While ? &stmt->while_ : &stmt->do_;
+                    collectLocalsInExpr(names, &loop->condition);
+                    collectLocalsInBlock(names, loop->block);
+                    break;
+                }
+                case StmtTag_If: {
+                    collectLocalsInExpr(names, &stmt->if_.primary.condition);
+                    collectLocalsInBlock(names, stmt->if_.primary.block);
+                    FOREACH(ElseIfList, stmt->if_.secondary, elseIf) {
+                        collectLocalsInExpr(names, &elseIf->condition);
+                        collectLocalsInBlock(names, elseIf->block);
+                    }
+                    if (stmt->if_.hasElse) {
+                        collectLocalsInExpr(names, &stmt->if_.else_.condition);
+                        collectLocalsInBlock(names, stmt->if_.else_.block);
+                    }
+                    break;
+                }
+                case StmtTag_Switch: break;
+                case StmtTag_Array: {
+                    addLocal(names, stmt->array.name);
+                    FOREACH(ArrayDimensions, stmt->array.dimensions, dim) collectLocalsInExpr(names, dim);
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+STATIC void collectLocalsInBlock(NameList* names, DeclList* decls) {
+    for (int i = 0; i < decls->len; i++) collectLocalsInDecl(names, &decls->root[i]);
+}
+
+//* ---------------- functions ----------------
+
+STATIC IRFunction* newFunction(char* name) {
+    IRFunction* out = calloc(1, sizeof(IRFunction));
+    out->name = name;
+    INIT(out->blocks);
+    APPEND(*functions, out);
+    return out;
+}
+
+// Everything which only matters while building
+STATIC void finishFunction() {
+    removeTrivialPhis();
+    inferTypes();
+    FOREACH(IRBlockList, function->blocks, b) {
+        DestroyIRDefs(&(*b)->defs);
+        DESTROY((*b)->incompletePhis);
+    }
+}
+
+STATIC IRFunction* lowerFunction(FunDecl* func) {
+    IRFunction* outerFunction = function;
+    IRBlock* outerBlock = block;
+    NameList* outerLocals = locals;
+
+    function = newFunction(tokText(func->name));
+    function->paramCount = func->params.len;
+    NameList names;
+    INIT(names);
+    FOREACH(ParamList, func->params, param) addLocal(&names, param->name);
+    FOREACH(FuncDeclList, func->block, currentDOR) {
+        if (currentDOR->tag == DOR_return) collectLocalsInExpr(&names, &currentDOR->return_);
+        else collectLocalsInDecl(&names, currentDOR->declaration);
+    }
+    locals = &names;
+
+    block = newBlock();
+    seal(block);
+    for (int i = 0; i < func->params.len; i++) {
+        IRInstr* param = emit(IROp_Param);
+        param->index = i;
+        writeVariable(names.root[i], block, param);
+    }
+
+    bool returns = false;
+    FOREACH(FuncDeclList, func->block, currentDOR) {
+        // nothing after the first return can ever run
+        if (currentDOR->tag == DOR_return) {
+            emitUnaryOp(IROp_Return, lowerExpr(&currentDOR->return_));
+            returns = true;
+            break;
+        }
+        lowerDecl(currentDOR->declaration);
+    }
+    // "Function must return a value!"
+    if (!returns) emit(IROp_Trap);
+
+    finishFunction();
+    IRFunction* out = function;
+    FOREACH(NameList, names, name) free(*name);
+    DESTROY(names);
+
+    function = outerFunction;
+    block = outerBlock;
+    locals = outerLocals;
+    return out;
+}
+
+IRProgram buildIR(DeclList* program) {
+    IRProgram out;
+    INIT(out.functions);
+    functions = &out.functions;
+    locals = NULL;
+
+    function = newFunction(NULL);
+    block = newBlock();
+    seal(block);
+    lowerBlock(program);
+    emit(IROp_Return);
+    finishFunction();
+
+    function = NULL;
+    block = NULL;
+    return out;
+}
+
+void destroyIR(IRProgram program) {
+    FOREACH(IRFunctionList, program.functions, func) {
+        FOREACH(IRBlockList, (*func)->blocks, b) {
+            FOREACH(IRInstrList, (*b)->instrs, instr) {
+                switch ((*instr)->op) {
+                    case IROp_LoadVar:
+                    case IROp_StoreVar:
+                    case IROp_Global:
+                    case IROp_Procedure: free((*instr)->name); break;
+                    default: break;
+                }
+                DESTROY((*instr)->operands);
+                free(*instr);
+            }
+            DESTROY((*b)->instrs);
+            DESTROY((*b)->preds);
+            free(*b);
+        }
+        DESTROY((*func)->blocks);
+        free((*func)->name);
+        free(*func);
+    }
+    DESTROY(program.functions);
+}
+
+//* ---------------- verifier ----------------
+
+STATIC char* functionName(IRFunction* func) {
+    return func->name == NULL ? "<top level>" : func->name;
+}
+
+// How many operands each op takes - -1 if it varies
+STATIC int operandCount(IROp op) {
+    switch (op) {
+        case IROp_Const:
+        case IROp_Param:
+        case IROp_Undef:
+        case IROp_LoadVar:
+        case IROp_Function:
+        case IROp_Procedure:
+        case IROp_Jump:
+        case IROp_Trap: return 0;
+        case IROp_StoreVar:
+        case IROp_Global:
+        case IROp_Truthy:
+        case IROp_Branch: return 1;
+        case IROp_Add:
+        case IROp_Subtract:
+        case IROp_Multiply:
+        case IROp_Divide:
+        case IROp_Exponent:
+        case IROp_Equal:
+        case IROp_NotEqual:
+        case IROp_Less:
+        case IROp_LessEqual:
+        case IROp_Greater:
+        case IROp_GreaterEqual: return 2;
+        default: return -1;
+    }
+}
+
+STATIC int targetCount(IROp op) {
+    if (op == IROp_Jump) return 1;
+    if (op == IROp_Branch) return 2;
+    return 0;
+}
+
+int verifyIR(IRFunction* func) {
+    int problems = 0;
+#define PROBLEM(...) do { \
+    printf("IR error in %s: ", functionName(func)); \
+    printf(__VA_ARGS__); \
+    printf("\n"); \
+    problems++; \
+} while (0)
+
+    int blockCount = func->blocks.len;
+    if (blockCount == 0) {
+        PROBLEM("no entry block");
+        return problems;
+    }
+
+    // where each value is defined
+    IRInstr** values = calloc(func->valueCount, sizeof(IRInstr*));
+    int* positions = calloc(func->valueCount, sizeof(int));
+
+    for (int i = 0; i < blockCount; i++) {
+        IRBlock* b = func->blocks.root[i];
+        if (b->id != i || b->function != func) PROBLEM("bb%i is in the wrong place", b->id);
+        if (b->instrs.len == 0 || !isTerminator(b->instrs.root[b->instrs.len - 1]->op))
+            PROBLEM("bb%i doesn't end in a terminator", b->id);
+
+        for (int j = 0; j < b->instrs.len; j++) {
+            IRInstr* instr = b->instrs.root[j];
+            if (instr->id < 0 || instr->id >= func->valueCount || values[instr->id] != NULL) {
+                PROBLEM("%%%i is defined more than once", instr->id);
+                continue;
+            }
+            values[instr->id] = instr;
+            positions[instr->id] = j;
+
+            if (instr->block != b) PROBLEM("%%%i doesn't know it's in bb%i", instr->id, b->id);
+            if (isTerminator(instr->op) && j != b->instrs.len - 1) PROBLEM("%%%i is a terminator in the middle of bb%i", instr->id, b->id);
+            if (instr->op == IROp_Phi) {
+                if (j > 0 && b->instrs.root[j - 1]->op != IROp_Phi && b->instrs.root[j - 1]->op != IROp_Undef)
+                    PROBLEM("phi %%%i isn't at the start of bb%i", instr->id, b->id);
+                if (instr->operands.len != b->preds.len)
+                    PROBLEM("phi %%%i has %i operands but bb%i has %i predecessors", instr->id, instr->operands.len, b->id, b->preds.len);
+            }
+            if (instr->op == IROp_Param && i != 0) PROBLEM("param %%%i isn't in the entry block", instr->id);
+            int expected = operandCount(instr->op);
+            if (expected != -1 && instr->operands.len != expected)
+                PROBLEM("%%%i (%s) has %i operands instead of %i", instr->id, IROpToString(instr->op), instr->operands.len, expected);
+            if (instr->op == IROp_Return && instr->operands.len != (func->name == NULL ? 0 : 1))
+                PROBLEM("return %%%i has the wrong number of operands", instr->id);
+            for (int t = 0; t < targetCount(instr->op); t++) {
+                IRBlock* target = instr->targets[t];
+                bool found = false;
+                FOREACH(IRBlockList, target->preds, pred) found |= *pred == b;
+                if (target->function != func) PROBLEM("%%%i jumps to another function", instr->id);
+                else if (!found) PROBLEM("bb%i jumps to bb%i, which doesn't list it as a predecessor", b->id, target->id);
+            }
+            if (instr->type == IRType_None) PROBLEM("%%%i doesn't have a type", instr->id);
+        }
+    }
+
+    // every predecessor has to actually jump here
+    FOREACH(IRBlockList, func->blocks, b) {
+        if (b == func->blocks.root && (*b)->preds.len > 0) PROBLEM("the entry block has predecessors");
+        FOREACH(IRBlockList, (*b)->preds, pred) {
+            IRInstr* last = (*pred)->instrs.len > 0 ? (*pred)->instrs.root[(*pred)->instrs.len - 1] : NULL;
+            bool found = false;
+            if (last != NULL) {
+                for (int t = 0; t < targetCount(last->op); t++) found |= last->targets[t] == *b;
+            }
+            if (!found) PROBLEM("bb%i lists bb%i as a predecessor, but it doesn't jump there", (*b)->id, (*pred)->id);
+        }
+    }
+
+    // dominators - dominators[b * blockCount + d] if d dominates b
+    bool* dominators = malloc(blockCount * blockCount * sizeof(bool));
+    for (int i = 0; i < blockCount * blockCount; i++) dominators[i] = i >= blockCount;
+    dominators[0] = true;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < blockCount; i++) {
+            IRBlock* b = func->blocks.root[i];
+            for (int d = 0; d < blockCount; d++) {
+                // unreachable blocks are dominated by everything
+                bool dominates = true;
+                FOREACH(IRBlockList, b->preds, pred) dominates &= dominators[(*pred)->id * blockCount + d];
+                dominates |= d == i;
+                if (dominates != dominators[i * blockCount + d]) {
+                    dominators[i * blockCount + d] = dominates;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    FOREACH(IRBlockList, func->blocks, b) {
+        for (int j = 0; j < (*b)->instrs.len; j++) {
+            IRInstr* instr = (*b)->instrs.root[j];
+            for (int k = 0; k < instr->operands.len; k++) {
+                IRInstr* operand = instr->operands.root[k];
+                if (operand->id < 0 || operand->id >= func->valueCount || values[operand->id] != operand) {
+                    PROBLEM("%%%i uses a value which isn't in the function", instr->id);
+                    continue;
+                }
+                int defBlock = operand->block->id;
+                bool ok;
+                if (instr->op == IROp_Phi) {
+                    // has to be available at the end of the predecessor
+                    if (k >= (*b)->preds.len) continue;
+                    ok = dominators[(*b)->preds.root[k]->id * blockCount + defBlock];
+                } else if (defBlock == (*b)->id) {
+                    ok = positions[operand->id] < j;
+                } else {
+                    ok = dominators[(*b)->id * blockCount + defBlock];
+                }
+                if (!ok) PROBLEM("%%%i uses %%%i, which doesn't dominate it", instr->id, operand->id);
+            }
+        }
+    }
+
+    free(dominators);
+    free(positions);
+    free(values);
+    return problems;
+#undef PROBLEM
+}
+
+//* ---------------- dump ----------------
+
+STATIC void dumpInstr(IRInstr* instr, FILE* out) {
+    fprintf(out, "    ");
+    bool hasValue = instr->type != IRType_Nil || instr->op == IROp_Const;
+    if (hasValue) fprintf(out, "%%%i = ", instr->id);
+    fprintf(out, "%s", IROpToString(instr->op));
+
+    switch (instr->op) {
+        case IROp_Const: {
+            switch (instr->type) {
+                case IRType_Nil: fprintf(out, " nil"); break;
+                case IRType_Bool: fprintf(out, " %s", instr->constant.bool_ ? "true" : "false"); break;
+                case IRType_Int: fprintf(out, " %i", instr->constant.int_); break;
+                case IRType_Float: fprintf(out, " %g", instr->constant.float_); break;
+                case IRType_String: fprintf(out, " \"%.*s\"", instr->constant.string.length, instr->constant.string.start); break;
+                default: break;
+            }
+            break;
+        }
+        case IROp_Param: fprintf(out, " %i", instr->index); break;
+        case IROp_LoadVar:
+        case IROp_StoreVar:
+        case IROp_Global:
+        case IROp_Procedure: fprintf(out, " %s%s", instr->name, instr->operands.len > 0 ? "," : ""); break;
+        case IROp_Function: fprintf(out, " %s", instr->function->name); break;
+        default: break;
+    }
+
+    for (int i = 0; i < instr->operands.len; i++) {
+        fprintf(out, "%s %%%i", i == 0 ? "" : ",", instr->operands.root[i]->id);
+        if (instr->op == IROp_Phi) fprintf(out, " [bb%i]", instr->block->preds.root[i]->id);
+    }
+    for (int t = 0; t < targetCount(instr->op); t++) {
+        fprintf(out, "%s bb%i", t == 0 && instr->operands.len == 0 ? "" : ",", instr->targets[t]->id);
+    }
+
+    if (hasValue) fprintf(out, " : %s", IRTypeToString(instr->type));
+    fprintf(out, "\n");
+}
+
+void dumpIR(IRProgram program, FILE* out) {
+    FOREACH(IRFunctionList, program.functions, func) {
+        if (func != program.functions.root) fprintf(out, "\n");
+        fprintf(out, "function %s:\n", functionName(*func));
+        FOREACH(IRBlockList, (*func)->blocks, b) {
+            fprintf(out, "  bb%i:", (*b)->id);
+            FOREACH(IRBlockList, (*b)->preds, pred) fprintf(out, "%s bb%i", pred == (*b)->preds.root ? " ; preds" : ",", (*pred)->id);
+            fprintf(out, "\n");
+            FOREACH(IRInstrList, (*b)->instrs, instr) dumpInstr(*instr, out);
+        }
+    }
+}
\ No newline at end of file
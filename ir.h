@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "parser.h"
+#include "vector.h"
+#include "map.h"
+#include "generated.h"
+
+// A mid-level IR for compiled (.ocrx) programs - each function is a control
+// flow graph of basic blocks, in SSA form, with types on every value where
+// they're known. Passes & backends work on this instead of the AST.
+//
+// Variables:
+//   - In a function, anything it assigns to (& its parameters) is a local,
+//     & lives in SSA values. This is the assumption the JIT guards on - a
+//     function which assigns to a global's name is really writing the global,
+//     which the IR doesn't model.
+//   - Anything else, & everything at the top level (which functions can see),
+//     is looked up by name at runtime with LoadVar/StoreVar, like the
+//     interpreter does.
+
+typedef struct IRInstr IRInstr;
+typedef struct IRBlock IRBlock;
+typedef struct IRFunction IRFunction;
+
+DECL_VEC(IRInstr*, IRInstrList)
+DECL_VEC(IRBlock*, IRBlockList)
+DECL_VEC(IRFunction*, IRFunctionList)
+// the value of each local at the end of a block
+DECL_MAP(IRInstr*, IRDefs)
+
+// Every instruction is a value (some just don't have a useful one).
+//
+// Const                                 constant
+// Param                                 index
+// Undef                                 a local read before it's assigned
+// Phi                                   one operand per predecessor, in order
+// LoadVar, StoreVar, Global             name; StoreVar & Global take the value
+// Add ... GreaterEqual                  two operands
+// Truthy                                the operand as a bool, for conditions
+// Call                                  callee, then the arguments
+// LoadElement                           array, then the indices
+// StoreElement                          array, the indices, then the value
+// NewArray                              the dimensions
+// Function                              function
+// Procedure                             name
+// Jump                                  targets[0]
+// Branch                                condition, targets[0] if true, else targets[1]
+// Return                                the value, or nothing at the top level
+// Trap                                  a runtime error - falling off the end of a function
+struct IRInstr {
+    IROp op;
+    IRType type;
+    // %id in dumps - unique within the function
+    int id;
+    IRBlock* block;
+    IRInstrList operands;
+
+    union {
+        // Const - type says which
+        union {
+            bool bool_;
+            int int_;
+            float float_;
+            struct {
+                char* start;
+                int length;
+            } string;
+        } constant;
+        int index;
+        char* name;
+        IRBlock* targets[2];
+        IRFunction* function;
+    };
+
+    // only used while building - the local a phi's for (NULL for the phis
+    // joining a short-circuiting AND/OR), & what a trivial phi turned into
+    char* variable;
+    IRInstr* replacement;
+};
+
+struct IRBlock {
+    int id;
+    IRFunction* function;
+    IRInstrList instrs;
+    IRBlockList preds;
+
+    // only used while building - see ir.c
+    bool sealed;
+    IRDefs defs;
+    IRInstrList incompletePhis;
+};
+
+struct IRFunction {
+    char* name;
+    int paramCount;
+    // blocks.root[0] is the entry
+    IRBlockList blocks;
+    int valueCount;
+};
+
+typedef struct {
+    // functions.root[0] is the top level
+    IRFunctionList functions;
+} IRProgram;
+
+IRProgram buildIR(DeclList* program);
+void destroyIR(IRProgram program);
+
+// Check the invariants everything else relies on - prints anything wrong &
+// returns how many problems it found.
+int verifyIR(IRFunction* function);
+
+void dumpIR(IRProgram program, FILE* out);
\ No newline at end of file
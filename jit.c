@@ -0,0 +1,521 @@
+#include "jit.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "runtime.h"
+#include "parallel.h"
+
+#ifdef JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//* ---------------- profiling ----------------
+
+STATIC void walkBlock(DeclList* block, void (*visit)(FunDecl*));
+
+// Every function in the program, however deeply it's nested
+STATIC void walkDecl(Declaration* decl, void (*visit)(FunDecl*)) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            visit(&decl->fun);
+            FOREACH(FuncDeclList, decl->fun.block, currentDOR) {
+                if (currentDOR->tag == DOR_decl) walkDecl(currentDOR->declaration, visit);
+            }
+            break;
+        }
+        case DeclTag_Proc: {
+            walkBlock(decl->proc.block, visit);
+            break;
+        }
+        case DeclTag_Stmt: {
+            Statement* stmt = &decl->stmt;
+            switch (stmt->tag) {
+                case StmtTag_For: walkBlock(stmt->for_.block, visit); break;
+                case StmtTag_While: walkBlock(stmt->while_.block, visit); break;
+                case StmtTag_Do: walkBlock(stmt->do_.block, visit); break;
+                case StmtTag_If: {
+                    walkBlock(stmt->if_.primary.block, visit);
+                    FOREACH(ElseIfList, stmt->if_.secondary, branch) walkBlock(branch->block, visit);
+                    if (stmt->if_.hasElse) walkBlock(stmt->if_.else_.block, visit);
+                    break;
+                }
+                case StmtTag_Switch: {
+                    FOREACH(SwitchCaseList, stmt->switch_.cases, currentCase) walkBlock(currentCase->block, visit);
+                    if (stmt->switch_.hasDefault) walkBlock(stmt->switch_.default_, visit);
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void walkBlock(DeclList* block, void (*visit)(FunDecl*)) {
+    FOREACH(DeclList, *block, decl) walkDecl(decl, visit);
+}
+
+STATIC void prepareFunction(FunDecl* func) {
+    func->jit = calloc(1, sizeof(JitFunction));
+}
+
+void jitPrepare(DeclList* program) {
+#ifdef JIT_SUPPORTED
+    walkBlock(program, prepareFunction);
+#endif
+}
+
+#ifdef JIT_SUPPORTED
+
+STATIC void releaseFunction(FunDecl* func) {
+    JitFunction* jit = func->jit;
+    if (jit == NULL) return;
+    if (jit->state == Jit_Compiled) {
+        munmap(jit->code, jit->codeSize);
+        for (int i = 0; i < jit->localCount; i++) free(jit->locals[i]);
+        free(jit->locals);
+    }
+    free(jit);
+    func->jit = NULL;
+}
+
+#endif
+
+void jitRelease(DeclList* program) {
+#ifdef JIT_SUPPORTED
+    walkBlock(program, releaseFunction);
+#endif
+}
+
+#ifdef JIT_SUPPORTED
+
+//* ---------------- code generation ----------------
+
+DECL_VEC(uint8_t, Code)
+
+// a variable & its slot in the stack frame
+typedef struct {
+    Token name;
+    int slot;
+} JitVar;
+
+DECL_VEC(JitVar, JitVars)
+
+typedef enum {
+    JitType_Invalid,
+    JitType_Int,
+    JitType_Bool
+} JitType;
+
+// one function at a time, on each thread
+static _Thread_local Code code;
+// everything in scope, innermost last
+static _Thread_local JitVars vars;
+static _Thread_local int slotCount;
+// the names of slotCount's non-parameter slots
+static _Thread_local JitVars locals;
+
+#define EMIT(...) do { \
+    uint8_t _bytes[] = {__VA_ARGS__}; \
+    for (int _i = 0; _i < (int)sizeof(_bytes); _i++) APPEND(code, _bytes[_i]); \
+} while (0)
+
+STATIC void emit32(int32_t value) {
+    for (int i = 0; i < 4; i++) APPEND(code, (uint8_t)(value >> (8 * i)));
+}
+
+STATIC void patch32(int at, int32_t value) {
+    memcpy(&code.root[at], &value, sizeof(int32_t));
+}
+
+// Emit a jump with the opcode given, returning where its target goes - see
+// patchJump
+STATIC int emitJump(uint8_t opcode) {
+    if (opcode == 0xE9) EMIT(0xE9);
+    else EMIT(0x0F, opcode);
+    emit32(0);
+    return code.len - 4;
+}
+
+// point the jump at the next instruction
+STATIC void patchJump(int at) {
+    patch32(at, code.len - (at + 4));
+}
+
+STATIC void emitJumpBack(int target) {
+    EMIT(0xE9);
+    emit32(target - (code.len + 4));
+}
+
+#define JMP 0xE9
+#define JE 0x84
+#define JNE 0x85
+#define JGE 0x8D
+
+STATIC INLINE int32_t slotOffset(int slot) {
+    return -4 * (slot + 1);
+}
+
+// mov eax, [rbp + slot]
+STATIC void emitLoad(int slot) {
+    EMIT(0x8B, 0x85);
+    emit32(slotOffset(slot));
+}
+
+// mov [rbp + slot], eax
+STATIC void emitStore(int slot) {
+    EMIT(0x89, 0x85);
+    emit32(slotOffset(slot));
+}
+
+STATIC bool sameToken(Token a, Token b) {
+    return a.length == b.length && strncmp(a.start, b.start, a.length) == 0;
+}
+
+STATIC JitVar* findVar(Token name) {
+    for (int i = vars.len - 1; i >= 0; i--) {
+        if (sameToken(vars.root[i].name, name)) return &vars.root[i];
+    }
+    return NULL;
+}
+
+STATIC int newLocal(Token name) {
+    JitVar var = {.name = name, .slot = slotCount++};
+    APPEND(vars, var);
+    APPEND(locals, var);
+    return var.slot;
+}
+
+STATIC Expression* skipWrappers(Expression* expr) {
+    while (expr->tag == ExprTag_Grouping || expr->tag == ExprTag_Cached) {
+        expr = expr->tag == ExprTag_Grouping ? expr->grouping : expr->cached.expr;
+    }
+    return expr;
+}
+
+STATIC JitType emitExpr(Expression* expr);
+
+// Leaves 1 or 0 in eax - ints are true if they're positive, like isTruthy
+STATIC bool emitCondition(Expression* expr) {
+    JitType type = emitExpr(expr);
+    if (type == JitType_Invalid) return false;
+    if (type == JitType_Int) {
+        // test eax, eax; setg al; movzx eax, al
+        EMIT(0x85, 0xC0, 0x0F, 0x9F, 0xC0, 0x0F, 0xB6, 0xC0);
+    }
+    return true;
+}
+
+// a in eax, b in ecx
+STATIC bool emitOperands(Expression* a, Expression* b) {
+    if (emitExpr(a) != JitType_Int) return false;
+    // push rax
+    EMIT(0x50);
+    if (emitExpr(b) != JitType_Int) return false;
+    // mov ecx, eax; pop rax
+    EMIT(0x89, 0xC1, 0x58);
+    return true;
+}
+
+STATIC JitType emitBinary(TokType operator, Expression* a, Expression* b) {
+    uint8_t sseOp = 0;
+    uint8_t setcc = 0;
+    switch (operator) {
+        case Tok_Plus: sseOp = 0x58; break;
+        case Tok_Star: sseOp = 0x59; break;
+        case Tok_Minus: sseOp = 0x5C; break;
+        case Tok_Slash: sseOp = 0x5E; break;
+
+        case Tok_EqualEqual: setcc = 0x94; break;
+        case Tok_BangEqual: setcc = 0x95; break;
+        case Tok_Less: setcc = 0x9C; break;
+        case Tok_GreaterEqual: setcc = 0x9D; break;
+        case Tok_LessEqual: setcc = 0x9E; break;
+        case Tok_Greater: setcc = 0x9F; break;
+
+        case Tok_And:
+        case Tok_Or: {
+            if (!emitCondition(a)) return JitType_Invalid;
+            // test eax, eax
+            EMIT(0x85, 0xC0);
+            int shortCircuit = emitJump(operator == Tok_And ? JE : JNE);
+            if (!emitCondition(b)) return JitType_Invalid;
+            int end = emitJump(JMP);
+            patchJump(shortCircuit);
+            // mov eax, 0 / 1
+            EMIT(0xB8);
+            emit32(operator == Tok_Or);
+            patchJump(end);
+            return JitType_Bool;
+        }
+
+        default: return JitType_Invalid;
+    }
+
+    if (!emitOperands(a, b)) return JitType_Invalid;
+    if (sseOp != 0) {
+        // cvtsi2ss xmm0, eax; cvtsi2ss xmm1, ecx; <op>ss xmm0, xmm1; cvttss2si eax, xmm0
+        EMIT(0xF3, 0x0F, 0x2A, 0xC0, 0xF3, 0x0F, 0x2A, 0xC9);
+        EMIT(0xF3, 0x0F, sseOp, 0xC1);
+        EMIT(0xF3, 0x0F, 0x2C, 0xC0);
+        return JitType_Int;
+    }
+    // cmp eax, ecx; set<cc> al; movzx eax, al
+    EMIT(0x39, 0xC8, 0x0F, setcc, 0xC0, 0x0F, 0xB6, 0xC0);
+    return JitType_Bool;
+}
+
+STATIC JitType emitExpr(Expression* expr) {
+    expr = skipWrappers(expr);
+    switch (expr->tag) {
+        case ExprTag_Primary: {
+            if (expr->primary.type == Tok_IntLit) {
+                char* text = tokText(expr->primary);
+                // mov eax, imm32
+                EMIT(0xB8);
+                emit32(atoi(text));
+                free(text);
+                return JitType_Int;
+            }
+            if (expr->primary.type == Tok_Identifier) {
+                JitVar* var = findVar(expr->primary);
+                if (var == NULL) return JitType_Invalid;
+                emitLoad(var->slot);
+                return JitType_Int;
+            }
+            return JitType_Invalid;
+        }
+        case ExprTag_Binary: return emitBinary(expr->binary.operator.type, expr->binary.a, expr->binary.b);
+        default: return JitType_Invalid;
+    }
+}
+
+STATIC TokType compoundOperator(TokType operator) {
+    switch (operator) {
+        case Tok_StarEqual: return Tok_Star;
+        case Tok_SlashEqual: return Tok_Slash;
+        case Tok_PlusEqual: return Tok_Plus;
+        case Tok_MinusEqual: return Tok_Minus;
+        default: return Tok_EOF;
+    }
+}
+
+STATIC bool emitBlock(DeclList* block);
+
+// Assigning to a new name declares a local. Locals declared in a block can
+// only be used in the rest of that block - afterwards whether they exist
+// depends on which way the program went, so that's left to the interpreter.
+STATIC bool emitAssignment(BinaryExpr assignment) {
+    Expression* target = skipWrappers(assignment.a);
+    if (target->tag != ExprTag_Primary || target->primary.type != Tok_Identifier) return false;
+    JitVar* var = findVar(target->primary);
+
+    if (assignment.operator.type == Tok_Equal) {
+        if (emitExpr(assignment.b) != JitType_Int) return false;
+        if (var == NULL) {
+            emitStore(newLocal(target->primary));
+        } else {
+            emitStore(var->slot);
+        }
+        return true;
+    }
+
+    TokType operator = compoundOperator(assignment.operator.type);
+    if (operator == Tok_EOF || var == NULL) return false;
+    int slot = var->slot;
+    if (emitBinary(operator, assignment.a, assignment.b) != JitType_Int) return false;
+    emitStore(slot);
+    return true;
+}
+
+STATIC bool emitFor(ForStmt* loop) {
+    if (emitExpr(&loop->min) != JitType_Int) return false;
+
+    // for loops declare their iterator in their own scope, unless it exists
+    JitVar* existing = findVar(loop->iterator);
+    int scopeStart = vars.len;
+    int slot = existing != NULL ? existing->slot : newLocal(loop->iterator);
+    emitStore(slot);
+
+    int top = code.len;
+    emitLoad(slot);
+    // push rax
+    EMIT(0x50);
+    if (emitExpr(&loop->max) != JitType_Int) return false;
+    // mov ecx, eax; pop rax; cmp eax, ecx
+    EMIT(0x89, 0xC1, 0x58, 0x39, 0xC8);
+    int exit = emitJump(JGE);
+
+    if (!emitBlock(loop->block)) return false;
+
+    // i += 1, through floats
+    emitLoad(slot);
+    // mov ecx, 1
+    EMIT(0xB9);
+    emit32(1);
+    EMIT(0xF3, 0x0F, 0x2A, 0xC0, 0xF3, 0x0F, 0x2A, 0xC9, 0xF3, 0x0F, 0x58, 0xC1, 0xF3, 0x0F, 0x2C, 0xC0);
+    emitStore(slot);
+    emitJumpBack(top);
+    patchJump(exit);
+
+    vars.len = scopeStart;
+    return true;
+}
+
+// while cond / do ... until cond - the interpreter checks both up front
+STATIC bool emitLoop(ConditionalBlock* loop, bool until) {
+    int top = code.len;
+    if (!emitCondition(&loop->condition)) return false;
+    // test eax, eax
+    EMIT(0x85, 0xC0);
+    int exit = emitJump(until ? JNE : JE);
+    if (!emitBlock(loop->block)) return false;
+    emitJumpBack(top);
+    patchJump(exit);
+    return true;
+}
+
+STATIC bool emitIf(IfStmt* if_) {
+    // the interpreter's else has a condition, & runs after a matching elseif
+    if (if_->hasElse) return false;
+
+    int ends[1 + if_->secondary.len];
+    int endCount = 0;
+    for (int i = -1; i < if_->secondary.len; i++) {
+        ConditionalBlock* branch = i == -1 ? &if_->primary : &if_->secondary.root[i];
+        if (!emitCondition(&branch->condition)) return false;
+        EMIT(0x85, 0xC0);
+        int next = emitJump(JE);
+        if (!emitBlock(branch->block)) return false;
+        ends[endCount++] = emitJump(JMP);
+        patchJump(next);
+    }
+    for (int i = 0; i < endCount; i++) patchJump(ends[i]);
+    return true;
+}
+
+STATIC bool emitStmt(Statement* stmt) {
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            Expression* expr = skipWrappers(&stmt->expr);
+            if (expr->tag == ExprTag_Binary && (expr->binary.operator.type == Tok_Equal || compoundOperator(expr->binary.operator.type) != Tok_EOF)) {
+                return emitAssignment(expr->binary);
+            }
+            // no side effects - but it still has to be something we can run
+            return emitExpr(expr) != JitType_Invalid;
+        }
+        case StmtTag_For: return emitFor(&stmt->for_);
+        case StmtTag_While: return emitLoop(&stmt->while_, false);
+        case StmtTag_Do: return emitLoop(&stmt->do_, true);
+        case StmtTag_If: return emitIf(&stmt->if_);
+        default: return false;
+    }
+}
+
+STATIC bool emitBlock(DeclList* block) {
+    int scopeStart = vars.len;
+    FOREACH(DeclList, *block, decl) {
+        if (decl->tag != DeclTag_Stmt || !emitStmt(&decl->stmt)) return false;
+    }
+    vars.len = scopeStart;
+    return true;
+}
+
+STATIC bool emitFunction(FunDecl* func) {
+    // push rbp; mov rbp, rsp; sub rsp, <frame size>
+    EMIT(0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC);
+    emit32(0);
+    int frameSize = code.len - 4;
+
+    // copy the parameters out of args (rdi)
+    FOREACH(ParamList, func->params, param) {
+        if (param->passMode == Param_byRef) return false;
+        JitVar var = {.name = param->name, .slot = slotCount++};
+        APPEND(vars, var);
+        // mov eax, [rdi + 4 * slot]
+        EMIT(0x8B, 0x87);
+        emit32(4 * var.slot);
+        emitStore(var.slot);
+    }
+
+    FOREACH(FuncDeclList, func->block, currentDOR) {
+        if (currentDOR->tag == DOR_return) {
+            if (emitExpr(&currentDOR->return_) != JitType_Int) return false;
+            // leave; ret
+            EMIT(0xC9, 0xC3);
+            patch32(frameSize, (4 * slotCount + 15) & ~15);
+            return true;
+        }
+        if (currentDOR->declaration->tag != DeclTag_Stmt || !emitStmt(&currentDOR->declaration->stmt)) return false;
+    }
+    // no return - the interpreter panics
+    return false;
+}
+
+STATIC bool compileNative(JitFunction* jit, FunDecl* func) {
+    if (func->params.len > JIT_MAX_ARGS) return false;
+
+    INIT(code);
+    INIT(vars);
+    INIT(locals);
+    slotCount = 0;
+
+    bool ok = emitFunction(func);
+    if (ok) {
+        long pageSize = sysconf(_SC_PAGESIZE);
+        size_t size = (code.len + pageSize - 1) & ~(pageSize - 1);
+        void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ok = memory != MAP_FAILED;
+        if (ok) {
+            memcpy(memory, code.root, code.len);
+            mprotect(memory, size, PROT_READ | PROT_EXEC);
+            jit->code = (int (*)(int*))memory;
+            jit->codeSize = size;
+
+            jit->localCount = locals.len;
+            jit->locals = malloc(locals.len * sizeof(char*));
+            for (int i = 0; i < locals.len; i++) jit->locals[i] = tokText(locals.root[i].name);
+        }
+    }
+
+    DESTROY(code);
+    DESTROY(vars);
+    DESTROY(locals);
+    return ok;
+}
+
+#endif
+
+bool jitCall(FunDecl func, InterpreterObj* args, int argc, InterpreterObj* out) {
+#ifdef JIT_SUPPORTED
+    JitFunction* jit = func.jit;
+    if (jit == NULL || jit->state == Jit_Unsupported) return false;
+    if (jit->state == Jit_Cold) {
+        // compiling isn't thread safe - wait until the parallel loop's done
+        if (parallelRunning || ++jit->calls < JIT_THRESHOLD) return false;
+        jit->state = compileNative(jit, &func) ? Jit_Compiled : Jit_Unsupported;
+        if (jit->state != Jit_Compiled) return false;
+    }
+
+    if (argc != func.params.len) return false;
+    int ints[JIT_MAX_ARGS];
+    for (int i = 0; i < argc; i++) {
+        InterpreterObj arg = IOAbs(args[i]);
+        if (arg.tag != ObjType_Int) return false;
+        ints[i] = arg.int_;
+    }
+    for (int i = 0; i < jit->localCount; i++) {
+        if (ObjNSFind(&globalScope->objects, jit->locals[i]) != NULL) return false;
+    }
+
+    *out = IOBJ(.tag = ObjType_Int, .int_ = jit->code(ints));
+    return true;
+#else
+    return false;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "parser.h"
+#include "interpreter.h"
+
+// A function is compiled once it's been called this many times
+#define JIT_THRESHOLD 16
+#define JIT_MAX_ARGS 16
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#endif
+
+typedef enum {
+    Jit_Cold,
+    Jit_Compiled,
+    // uses something the JIT can't compile - never try again
+    Jit_Unsupported
+} JitState;
+
+// Baseline JIT for hot functions. Only functions which work purely on ints
+// are compiled - their parameters & locals live in a native stack frame &
+// every operation is a fixed template of x86-64 instructions (including the
+// trip through floats which int arithmetic takes, see NUMERIC_OP).
+//
+// Each call checks the guards the compiled code relies on - every argument
+// is an int & no local is also a global (assigning to it would write to the
+// global). If one fails, that call runs on the interpreter instead.
+struct JitFunction {
+    int calls;
+    JitState state;
+    int (*code)(int* args);
+    size_t codeSize;
+    // every variable which isn't a parameter
+    char** locals;
+    int localCount;
+};
+
+// Give every function in the program a JitFunction to count its calls - if
+// this never runs, nothing gets compiled.
+void jitPrepare(DeclList* program);
+// Unmap the code compiled for the program's functions & free their
+// JitFunctions - nothing in it can be run on the JIT afterwards
+void jitRelease(DeclList* program);
+// Run func natively, if it's been compiled & the guards pass. args aren't
+// consumed either way.
+bool jitCall(FunDecl func, InterpreterObj* args, int argc, InterpreterObj* out);
\ No newline at end of file
@@ -3,10 +3,11 @@
 #include <stdbool.h>
 #include <string.h>
 
-static char* start;
-static char* current;
-static int line;
-static int col;
+// per thread, so programs can be lexed on several at once (see ocrpi_vm.h)
+static _Thread_local char* start;
+static _Thread_local char* current;
+static _Thread_local int line;
+static _Thread_local int col;
 
 void destroyLexOutput(LexOutput lo) {
     DESTROY(lo);
@@ -164,6 +165,7 @@ static Token identifier() {
         case 'g': return makeTok(checkKeyword(1, "lobal", Tok_Global));
         case 'i':
             if (current - start == 2 && start[1] == 'f') return makeTok(Tok_If);
+            if (current - start > 1 && start[1] == 'm') return makeTok(checkKeyword(2, "port", Tok_Import));
             if (current - start > 1) return makeTok(checkKeyword(1, "nherits", Tok_Inherits));
             break;
         case 'M': return makeTok(checkKeyword(1, "OD", Tok_Mod));
@@ -179,6 +181,7 @@ static Token identifier() {
         case 'p':
             if (current - start > 2) {
                 switch (start[1]) {
+                    case 'a': return makeTok(checkKeyword(2, "rallel", Tok_Parallel));
                     case 'r':
                         switch (start[2]) {
                             case 'i': return makeTok(checkKeyword(3, "vate", Tok_Private));
@@ -15,7 +15,7 @@ typedef enum {
     Tok_And, Tok_Or, Tok_Not, Tok_Mod, Tok_Div,
     Tok_Function, Tok_Return, Tok_EndFunction, Tok_Procedure, Tok_EndProcedure, Tok_ByVal, Tok_ByRef,
     Tok_Class, Tok_EndClass, Tok_Inherits, Tok_Public, Tok_Private, Tok_Super, Tok_Self, Tok_New,
-    Tok_Array,
+    Tok_Array, Tok_Import, Tok_Parallel,
 
     // Literals + identifiers
     Tok_True, Tok_False, Tok_StringLit, Tok_IntLit, Tok_FloatLit, Tok_Nil, Tok_Identifier,
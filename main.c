@@ -12,29 +12,118 @@ int main() {
 #include "panic.h"
 #include "lexer.h"
 #include "parser.h"
+#include "optimiser.h"
 #include "interpreter.h"
+#include "closure.h"
+#include "jit.h"
+#include "tier.h"
+#include "parallel.h"
+#include "stackless.h"
+#include "transpiler.h"
+#include "ir.h"
+#include "checker.h"
+#include "extension.h"
 
 static bool checkExtension(char* fname, char* ext) {
     return strncmp(ext, fname + strlen(fname) - strlen(ext), strlen(ext)) == 0;
 }
 
+// Load the modules a program imports - relative paths are relative to the
+// program
+static void loadImports(char* fname, TokList imports) {
+    char* slash = strrchr(fname, '/');
+    int dirLength = slash == NULL ? 0 : slash - fname + 1;
+    FOREACH(TokList, imports, import) {
+        // strip the quotes
+        char* module = import->start + 1;
+        int length = import->length - 2;
+        int prefix = module[0] == '/' ? 0 : dirLength;
+        char* path = malloc(prefix + length + 1);
+        memcpy(path, fname, prefix);
+        memcpy(path + prefix, module, length);
+        path[prefix + length] = '\0';
+        loadExtension(path);
+        free(path);
+    }
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) panic(Panic_Main, "Usage: ocrpi <source-file>");
+    char* usage = "Usage: ocrpi [--closures] [--stackless] [--load <module.so>]... [--no-jit] [--no-tier] [--threads <n>] [--emit-c] [--dump-ir] <source-file>";
+    char* fname = NULL;
+    // run on the closure compiler instead of walking the AST
+    bool closures = false;
+    // keep OCR calls off the C stack
+    bool stackless = false;
+    bool jit = true;
+    // compile hot functions & loops in the background
+    bool tier = true;
+    // print the program as C instead of running it
+    bool emitC = false;
+    // print the program's IR instead of running it
+    bool dumpIRFlag = false;
+    // native extension modules to load before running anything
+    char* modules[argc];
+    int moduleCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--closures") == 0) closures = true;
+        else if (strcmp(argv[i], "--stackless") == 0) stackless = true;
+        else if (strcmp(argv[i], "--load") == 0) {
+            if (++i == argc) panic(Panic_Main, usage);
+            modules[moduleCount++] = argv[i];
+        }
+        else if (strcmp(argv[i], "--no-jit") == 0) jit = false;
+        else if (strcmp(argv[i], "--no-tier") == 0) tier = false;
+        // how many threads parallel loops get - the number of cores otherwise
+        else if (strcmp(argv[i], "--threads") == 0) {
+            if (++i == argc || atoi(argv[i]) < 1) panic(Panic_Main, usage);
+            setParallelThreads(atoi(argv[i]));
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0) emitC = true;
+        else if (strcmp(argv[i], "--dump-ir") == 0) dumpIRFlag = true;
+        else if (fname == NULL) fname = argv[i];
+        else panic(Panic_Main, usage);
+    }
+    if (fname == NULL) panic(Panic_Main, usage);
     
-    if (checkExtension(argv[1], ".ocr")) {
-        char* source = readFile(argv[1]);
+    // extended mode - statically typed
+    bool extended = checkExtension(fname, ".ocrx");
+    if (extended || checkExtension(fname, ".ocr")) {
+        char* source = readFile(fname);
         LexOutput lo = lex(source);
         ParseOutput po = parse(lo);
         if (po.errors.len > 0) exit(1);
-        interpret(po);
+        for (int i = 0; i < moduleCount; i++) loadExtension(modules[i]);
+        loadImports(fname, po.imports);
+        optimise(&po.ast);
+        if (extended) {
+            CheckOutput co = check(&po.ast);
+            if (co.errors.len > 0) exit(1);
+            destroyCheckOutput(co);
+        }
+        if (dumpIRFlag) {
+            IRProgram ir = buildIR(&po.ast);
+            int problems = 0;
+            FOREACH(IRFunctionList, ir.functions, func) problems += verifyIR(*func);
+            if (problems > 0) panic(Panic_IR, "%i problems in the IR!", problems);
+            dumpIR(ir, stdout);
+            destroyIR(ir);
+        } else if (emitC) transpile(po, stdout);
+        else if (stackless) interpretStackless(po);
+        else {
+            if (jit) jitPrepare(&po.ast);
+            if (closures) runClosures(po);
+            else {
+                if (tier) tierPrepare(&po.ast);
+                interpret(po);
+            }
+            if (jit) jitRelease(&po.ast);
+        }
         destroyParseOutput(po);
         destroyLexOutput(lo);
         free(source);
-    } else if (checkExtension(argv[1], ".ocrx")) {
-        // lex, parse, check, compile
-        panic(Panic_Main, "Extended mode not supported yet!");
     } else {
-        panic(Panic_Main, "Unknown file extension! (%s)", argv[1]);
+        panic(Panic_Main, "Unknown file extension! (%s)", fname);
     }
 }
 
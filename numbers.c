@@ -0,0 +1,371 @@
+#include "numbers.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+//* ---------------- ints ----------------
+
+// "00", "01" ... "99" - two digits per division
+static const char digitPairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+STATIC INLINE int countDigits(uint32_t value) {
+    int count = 1;
+    while (value >= 10000) {
+        value /= 10000;
+        count += 4;
+    }
+    if (value >= 1000) return count + 3;
+    if (value >= 100) return count + 2;
+    if (value >= 10) return count + 1;
+    return count;
+}
+
+// Fills digits backwards from end
+STATIC INLINE void writeDigits(uint32_t value, char* end) {
+    while (value >= 100) {
+        int pair = (value % 100) * 2;
+        value /= 100;
+        *--end = digitPairs[pair + 1];
+        *--end = digitPairs[pair];
+    }
+    if (value >= 10) {
+        *--end = digitPairs[value * 2 + 1];
+        *--end = digitPairs[value * 2];
+    } else {
+        *--end = '0' + value;
+    }
+}
+
+int formatInt(int value, char* out) {
+    // unsigned, so INT_MIN negates
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    int length = countDigits(magnitude);
+    if (value < 0) {
+        *out++ = '-';
+        writeDigits(magnitude, out + length);
+        return length + 1;
+    }
+    writeDigits(magnitude, out + length);
+    return length;
+}
+
+int parseInt(char* start, int length) {
+    char* end = start + length;
+    char* c = start;
+    while (c < end && isspace((unsigned char)*c)) c++;
+    bool negative = false;
+    if (c < end && (*c == '+' || *c == '-')) negative = *c++ == '-';
+    // overflow wraps
+    uint32_t out = 0;
+    for (; c < end && *c >= '0' && *c <= '9'; c++) out = out * 10 + (*c - '0');
+    return (int)(negative ? -out : out);
+}
+
+//* ---------------- shortest float digits ----------------
+
+// Burger & Dybvig's free-format algorithm, which generates digits until the
+// ones so far can only read back as the float being printed. Everything's
+// exact, so it needs integers up to about 2^180 - floats never need more
+// than 8 limbs.
+
+#define BIG_LIMBS 8
+// float's max significant digits
+#define FLOAT_DIGITS 9
+
+typedef struct {
+    // least significant first, no leading zero limbs
+    uint32_t limbs[BIG_LIMBS];
+    int len;
+} BigInt;
+
+static const uint32_t smallPowers10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+STATIC void bigSet(BigInt* n, uint64_t value) {
+    n->len = 0;
+    for (; value != 0; value >>= 32) n->limbs[n->len++] = (uint32_t)value;
+}
+
+STATIC void bigMulSmall(BigInt* n, uint32_t factor) {
+    uint64_t carry = 0;
+    for (int i = 0; i < n->len; i++) {
+        uint64_t product = (uint64_t)n->limbs[i] * factor + carry;
+        n->limbs[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+    if (carry != 0) n->limbs[n->len++] = (uint32_t)carry;
+}
+
+STATIC void bigMulPow10(BigInt* n, int power) {
+    for (; power >= 9; power -= 9) bigMulSmall(n, smallPowers10[9]);
+    if (power > 0) bigMulSmall(n, smallPowers10[power]);
+}
+
+STATIC void bigShiftLeft(BigInt* n, int bits) {
+    if (n->len == 0) return;
+    int words = bits / 32;
+    int shift = bits % 32;
+    uint32_t out[BIG_LIMBS + 1] = {0};
+    for (int i = 0; i < n->len; i++) {
+        uint64_t shifted = (uint64_t)n->limbs[i] << shift;
+        out[i + words] |= (uint32_t)shifted;
+        out[i + words + 1] |= (uint32_t)(shifted >> 32);
+    }
+    n->len += words + 1;
+    if (out[n->len - 1] == 0) n->len--;
+    memcpy(n->limbs, out, n->len * sizeof(uint32_t));
+}
+
+STATIC int bigCompare(BigInt* a, BigInt* b) {
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    for (int i = a->len - 1; i >= 0; i--) {
+        if (a->limbs[i] != b->limbs[i]) return a->limbs[i] < b->limbs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+STATIC void bigAdd(BigInt* out, BigInt* a, BigInt* b) {
+    if (a->len < b->len) {
+        BigInt* swap = a;
+        a = b;
+        b = swap;
+    }
+    uint64_t carry = 0;
+    for (int i = 0; i < a->len; i++) {
+        uint64_t sum = (uint64_t)a->limbs[i] + (i < b->len ? b->limbs[i] : 0) + carry;
+        out->limbs[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+    out->len = a->len;
+    if (carry != 0) out->limbs[out->len++] = (uint32_t)carry;
+}
+
+// a -= b, where a >= b
+STATIC void bigSub(BigInt* a, BigInt* b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < a->len; i++) {
+        int64_t difference = (int64_t)a->limbs[i] - (i < b->len ? b->limbs[i] : 0) - borrow;
+        borrow = difference < 0;
+        a->limbs[i] = (uint32_t)(difference + (borrow << 32));
+    }
+    while (a->len > 0 && a->limbs[a->len - 1] == 0) a->len--;
+}
+
+// r + m > s, or >= s when inclusive
+STATIC INLINE bool reaches(BigInt* r, BigInt* m, BigInt* s, bool inclusive) {
+    BigInt sum;
+    bigAdd(&sum, r, m);
+    int cmp = bigCompare(&sum, s);
+    return inclusive ? cmp >= 0 : cmp > 0;
+}
+
+// mantissa * 2^exponent is 0.digits * 10^*point - returns how many digits
+STATIC int shortestDigits(uint32_t mantissa, int exponent, bool boundary, char* digits, int* point) {
+    // round half even on the way back in - an even mantissa owns the halfway points
+    bool inclusive = mantissa % 2 == 0;
+    // value = r / s, & anything within (r - mMinus, r + mPlus) / s reads back as it
+    BigInt r, s, mPlus, mMinus;
+    if (exponent >= 0) {
+        bigSet(&r, mantissa);
+        bigShiftLeft(&r, exponent + (boundary ? 2 : 1));
+        bigSet(&s, boundary ? 4 : 2);
+        bigSet(&mPlus, 1);
+        bigShiftLeft(&mPlus, exponent + (boundary ? 1 : 0));
+        bigSet(&mMinus, 1);
+        bigShiftLeft(&mMinus, exponent);
+    } else {
+        bigSet(&r, (uint64_t)mantissa << (boundary ? 2 : 1));
+        bigSet(&s, 1);
+        bigShiftLeft(&s, -exponent + (boundary ? 2 : 1));
+        bigSet(&mPlus, boundary ? 2 : 1);
+        bigSet(&mMinus, 1);
+    }
+
+    // value >= 2^floorLog2, so this is floor(log10(value)) + 1, or one under
+    int floorLog2 = exponent + 31 - __builtin_clz(mantissa);
+    // 78913 / 2^18 ~ log10(2)
+    int k = ((floorLog2 * 78913) >> 18) + 1;
+    if (k >= 0) {
+        bigMulPow10(&s, k);
+    } else {
+        bigMulPow10(&r, -k);
+        bigMulPow10(&mPlus, -k);
+        bigMulPow10(&mMinus, -k);
+    }
+    if (reaches(&r, &mPlus, &s, inclusive)) {
+        k++;
+        bigMulSmall(&s, 10);
+    }
+    *point = k;
+
+    int count = 0;
+    while (true) {
+        bigMulSmall(&r, 10);
+        bigMulSmall(&mPlus, 10);
+        bigMulSmall(&mMinus, 10);
+        int digit = 0;
+        while (bigCompare(&r, &s) >= 0) {
+            bigSub(&r, &s);
+            digit++;
+        }
+        int cmp = bigCompare(&r, &mMinus);
+        bool low = inclusive ? cmp <= 0 : cmp < 0;
+        bool high = reaches(&r, &mPlus, &s, inclusive);
+        if (!low && !high && count < FLOAT_DIGITS - 1) {
+            digits[count++] = '0' + digit;
+            continue;
+        }
+        // both work - take the closer one
+        if (low && high) {
+            BigInt twice;
+            bigAdd(&twice, &r, &r);
+            if (bigCompare(&twice, &s) >= 0) digit++;
+        } else if (high) {
+            digit++;
+        }
+        digits[count++] = '0' + digit;
+        return count;
+    }
+}
+
+STATIC INLINE int copyChars(char* out, char* chars) {
+    int length = strlen(chars);
+    memcpy(out, chars, length);
+    return length;
+}
+
+int formatFloat(float value, char* out) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int exponentBits = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponentBits == 0xff && mantissa != 0) return copyChars(out, "nan");
+
+    char* c = out;
+    if (bits >> 31) *c++ = '-';
+    if (exponentBits == 0xff) return c - out + copyChars(c, "inf");
+    if (exponentBits == 0 && mantissa == 0) return c - out + copyChars(c, "0.0");
+
+    char digits[FLOAT_DIGITS];
+    int point;
+    int count = exponentBits == 0
+        // subnormal
+        ? shortestDigits(mantissa, -149, false, digits, &point)
+        // the gap below a power of 2 is half the gap above it
+        : shortestDigits(mantissa | (1 << 23), exponentBits - 150, mantissa == 0 && exponentBits > 1, digits, &point);
+
+    int scientific = point - 1;
+    if (scientific < -4 || scientific >= 16) {
+        *c++ = digits[0];
+        if (count > 1) {
+            *c++ = '.';
+            memcpy(c, digits + 1, count - 1);
+            c += count - 1;
+        }
+        *c++ = 'e';
+        *c++ = scientific < 0 ? '-' : '+';
+        if (scientific < 0) scientific = -scientific;
+        *c++ = '0' + scientific / 10;
+        *c++ = '0' + scientific % 10;
+    } else if (point <= 0) {
+        // 0.00ddd
+        *c++ = '0';
+        *c++ = '.';
+        memset(c, '0', -point);
+        c += -point;
+        memcpy(c, digits, count);
+        c += count;
+    } else if (point < count) {
+        memcpy(c, digits, point);
+        c += point;
+        *c++ = '.';
+        memcpy(c, digits + point, count - point);
+        c += count - point;
+    } else {
+        // ddd00.0
+        memcpy(c, digits, count);
+        c += count;
+        memset(c, '0', point - count);
+        c += point - count;
+        *c++ = '.';
+        *c++ = '0';
+    }
+    return c - out;
+}
+
+//* ---------------- parsing floats ----------------
+
+// Exactly representable as doubles
+static const double powers10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Anything fastParseFloat can't do exactly - strtod needs a terminator
+STATIC float slowParseFloat(char* start, int length) {
+    char small[64];
+    char* text = length < (int)sizeof(small) ? small : malloc(length + 1);
+    memcpy(text, start, length);
+    text[length] = '\0';
+    double out = strtod(text, NULL);
+    if (text != small) free(text);
+    return out;
+}
+
+// Like atof, the double's rounded to a float afterwards
+float parseFloat(char* start, int length) {
+    char* end = start + length;
+    char* c = start;
+    while (c < end && isspace((unsigned char)*c)) c++;
+    bool negative = false;
+    if (c < end && (*c == '+' || *c == '-')) negative = *c++ == '-';
+
+    // the digits, less the point - exact while there are at most 19 of them
+    uint64_t digits = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; c < end && isdigit((unsigned char)*c); c++) {
+        any = true;
+        digits = digits * 10 + (*c - '0');
+        if (digits != 0) significant++;
+    }
+    if (c < end && *c == '.') {
+        for (c++; c < end && isdigit((unsigned char)*c); c++) {
+            any = true;
+            digits = digits * 10 + (*c - '0');
+            if (digits != 0) significant++;
+            exponent--;
+        }
+    }
+    // inf, nan, hex
+    if (!any || (c < end && (*c == 'x' || *c == 'X'))) return slowParseFloat(start, length);
+    if (c + 1 < end && (*c == 'e' || *c == 'E')) {
+        char* e = c + 1;
+        bool negativeExponent = false;
+        if (*e == '+' || *e == '-') negativeExponent = *e++ == '-';
+        if (e < end && isdigit((unsigned char)*e)) {
+            int written = 0;
+            for (; e < end && isdigit((unsigned char)*e); e++) {
+                if (written < 10000) written = written * 10 + (*e - '0');
+            }
+            exponent += negativeExponent ? -written : written;
+        }
+    }
+
+    // the double's only correctly rounded if one multiply or divide by an
+    // exact power of ten does it
+    if (significant > 19 || digits > (1ull << 53) || exponent < -22 || exponent > 22) return slowParseFloat(start, length);
+    double out = digits;
+    out = exponent < 0 ? out / powers10[-exponent] : out * powers10[exponent];
+    return negative ? -out : out;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+// Conversions between numbers & text for int(), float(), string() & print.
+// Parsing reads straight out of a slice (it doesn't need terminating), &
+// formatting writes into the caller's buffer - neither allocates.
+
+// Room formatInt/formatFloat need - they don't write a terminator
+#define INT_CHARS 11
+#define FLOAT_CHARS 24
+
+// The length written
+int formatInt(int value, char* out);
+// The shortest digits which read back as exactly value - 2.5, 0.1, 3.0,
+// 1e+20 - scientific below 1e-4 & from 1e16
+int formatFloat(float value, char* out);
+
+// Like atoi & atof: leading whitespace & a sign are skipped, & parsing
+// stops at the first character that doesn't fit (so "" is 0)
+int parseInt(char* start, int length);
+float parseFloat(char* start, int length);
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+// The header native extension modules build against.
+//
+// A module's a shared object which exports an OcrpiExtension called
+// ocrpi_extension, listing its natives in the same tables as the standard
+// library - STLFuncDef & STLProcDef, each ending with an entry whose name is
+// "". Natives get the ABI in interpreter.h: borrowed values which have
+// already been checked against the native's signature. Mark the ones which
+// are threadSafe, or parallel loops which call them won't run in parallel.
+//
+//     static InterpreterObj median(InterpreterObj* args, int argc) { ... }
+//     static STLFuncDef funcs[] = {
+//         {"median", median, {1, ObjType_Float, {ACCEPTS(Array)}, true}},
+//         {"", NULL}
+//     };
+//     OCRPI_EXTENSION(funcs, NULL)
+//
+// Build it with gcc -shared -fPIC -I<ocrpi> module.c -o module.so. Anything
+// declared in interpreter.h, runtime.h, array.h, stringObj.h & panic.h can be
+// called from a module - ocrpi exports it.
+
+#include "interpreter.h"
+#include "runtime.h"
+#include "array.h"
+#include "stringObj.h"
+#include "panic.h"
+
+// Bumped whenever InterpreterObj or the native ABI changes - ocrpi won't load
+// a module built against a different version
+#define OCRPI_EXTENSION_ABI 3
+
+typedef struct {
+    int abi;
+    // a second check on the layout of everything natives get passed
+    int objSize;
+    // either can be NULL
+    STLFuncDef* funcs;
+    STLProcDef* procs;
+} OcrpiExtension;
+
+#define OCRPI_EXTENSION(funcs, procs) OcrpiExtension ocrpi_extension = {OCRPI_EXTENSION_ABI, sizeof(InterpreterObj), funcs, procs};
\ No newline at end of file
@@ -1,182 +1,66 @@
 #include "ocrpi_stdlib.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "panic.h"
+#include "array.h"
+#include "output.h"
+#include "numbers.h"
+#include "stringObj.h"
+#include "stringSearch.h"
+#include "file.h"
+#include "sort.h"
+#include "reduce.h"
+#include "collections.h"
+#include "runtime.h"
 
-#define ANY -1
-
-static inline void checkTypes(int count, ObjType types[], ObjList arguments) {
-    if (arguments.len != count) panic(Panic_Stdlib, "Expected %i arguments but got %i!", count, arguments.len);
-    for (int i = 0; i < count; i++) {
-        if (types[i] == ANY) continue;
-        if (arguments.root[i].tag != types[i]) panic(Panic_Stdlib, "Expected argument of type %s, but got %s!", ObjTypeToString(types[i]), ObjTypeToString(arguments.root[i].tag));
-    }
-}
-
-#define TYPELIST(types) (ObjType[]){types}
-
-//* cheeky!! allocates!!
-STATIC INLINE char* forceString(InterpreterObj obj) {
-    if (obj.tag != ObjType_String) panic(Panic_Stdlib, "Can't force get a C String from a %s!", ObjTypeToString(obj.tag));
-    char* out = malloc(obj.string.length + 1);
-    memcpy(out, obj.string.start, obj.string.length);
-    out[obj.string.length] = '\0';
+// Whatever print would show - strings are shared, not copied
+STATIC StringObj objToString(InterpreterObj obj) {
+    if (obj.tag == ObjType_String) return stringView(obj.string.owner, obj.string.start, obj.string.length);
+    OutputBuffer text = {.data = malloc(32), .size = 32};
+    writeObj(&text, obj);
+    StringObj out = copyString(text.data, text.used);
+    free(text.data);
     return out;
 }
 
-static StringObj objToString(InterpreterObj obj) {
-    char* out;
-    bool allocated = false;
-    int length = -1;
-
-    switch (obj.tag) {
-        case ObjType_Ref: {
-            out = "<reference>";
-            // printf("<reference -> ");
-            // printObj(*obj.reference);
-            // printf(">");
-            break;
-        }
-        case ObjType_Class: {
-            out = "<class>";
-            // printf("<class at %p>", &obj);
-            break;
-        }
-        case ObjType_Func: {
-            out = "<func>";
-            // printf("<func at %p>", &obj);
-            break;
-        }
-        case ObjType_Proc: {
-            out = "<proc>";
-            // printf("<proc at %p>", &obj);
-            break;
-        }
-        case ObjType_NativeFunc: {
-            out = "<native func>";
-            // printf("<native func at %p>", &obj);
-            break;
-        }
-        case ObjType_NativeProc: {
-            out = "<native proc>";
-            // printf("<native proc at %p>", &obj);
-            break;
-        }
-        case ObjType_Nil: {
-            out = "nil";
-            break;
-        }
-        case ObjType_Bool: {
-            out = obj.bool_ ? "true" : "false";
-            break;
-        }
-        case ObjType_Int: {
-            // todo: enough?
-            out = malloc(20);
-            sprintf(out, "%i", obj.int_);
-            allocated = true;
-            break;
-        }
-        case ObjType_String: {
-            //* yeah okay basically the vibe is we're returning a strong independent young object, if it's allocated
-            //* it'll get freed at some point so it needs to own its string ref!!
-            if (obj.string.allocated) {
-                out = malloc(obj.string.length);
-                memcpy(out, obj.string.start, obj.string.length);
-                allocated = true;
-                length = obj.string.length;
-            } else {
-                return obj.string;
-            }
-            break;
-        }
-        case ObjType_Float: {
-            // todo: enough?
-            char* out = malloc(40);
-            sprintf(out, "%f", obj.float_);
-            allocated = true;
-            break;
-        }
-        case ObjType_Array: {
-            // todo: use length instead of null-term
-            int len = 1;
-            int cap = 1;
-            out = malloc(1);
-            out[0] = '[';
-            for (int i = 0; i < obj.array.len; i++) {
-                StringObj thisObj = objToString(obj.array.root[i]);
-                while (len + thisObj.length + 2 > cap) out = realloc(out, cap * 2);
-                memcpy(out + len, thisObj.start, thisObj.length);
-                len += thisObj.length;
-                if (i != obj.array.len - 1) memcpy(out + len, ", ", 2);
-                len += 2;
-            }
-            if (cap - len < 2) out = realloc(out, cap - (2 - (cap - len)));
-            out[len] = ']';
-            out[len + 1] = '\0';
-            break;
-        }
-        case ObjType_Instance: {
-            out = "<class instance>";
-            // printf("<class instance at %p>", &obj);
-            break;
-        }
-    }
-    return (StringObj){
-        .length = length == -1 ? strlen(out) : length,
-        .start = out,
-        .allocated = allocated
-    };
+void stl_print(InterpreterObj* args, int argc) {
+    for (int i = 0; i < argc; i++) outputObj(args[i]);
+    outputNewline();
 }
 
-void stl_print(ObjList args) {
-    for (int i = 0; i < args.len; i++) {
-        // todo: what the fuck!!
-        InterpreterObj strObj = (InterpreterObj){.tag = ObjType_String, .string = objToString(args.root[i])};
-        char* str = forceString(strObj);
-        printf("%s", str);
-        if (strObj.string.allocated) {
-            free(strObj.string.start);
-        }
-        free(str);
-    }
-    printf("\n");
-}
-
-InterpreterObj stl_typeof(ObjList args) {
-    checkTypes(1, TYPELIST(ANY), args);
+InterpreterObj stl_typeof(InterpreterObj* args, int argc) {
+    char* name = ObjTypeToString(args[0].tag);
     return (InterpreterObj){
         .tag = ObjType_String,
-        .string = ObjTypeToString(args.root[0].tag)
+        .string = (StringObj){
+            .start = name,
+            .length = strlen(name)
+        }
     };
 }
 
-InterpreterObj stl_bool(ObjList args) {
-    checkTypes(1, TYPELIST(ANY), args);
+InterpreterObj stl_bool(InterpreterObj* args, int argc) {
     return (InterpreterObj){
         .tag = ObjType_Bool,
-        .bool_ = isTruthy(args.root[0])
+        .bool_ = isTruthy(args[0])
     };
 }
 
-InterpreterObj stl_string(ObjList args) {
-    checkTypes(1, TYPELIST(ANY), args);
+InterpreterObj stl_string(InterpreterObj* args, int argc) {
     return (InterpreterObj){
         .tag = ObjType_String,
-        .string = objToString(args.root[0])
+        .string = objToString(args[0])
     };
 }
-
-InterpreterObj stl_float(ObjList args) {
-    checkTypes(1, TYPELIST(ANY), args);
+InterpreterObj stl_float(InterpreterObj* args, int argc) {
     float out;
-    InterpreterObj obj = args.root[0];
+    InterpreterObj obj = args[0];
     switch (obj.tag) {
         case ObjType_String: {
-            char* str = forceString(obj);
-            out = atof(str);
-            free(str);
+            out = parseFloat(obj.string.start, obj.string.length);
             break;
         }
         case ObjType_Int: {
@@ -199,15 +83,12 @@ InterpreterObj stl_float(ObjList args) {
     };
 }
 
-InterpreterObj stl_int(ObjList args) {
-    checkTypes(1, TYPELIST(ANY), args);
+InterpreterObj stl_int(InterpreterObj* args, int argc) {
     int out;
-    InterpreterObj obj = args.root[0];
+    InterpreterObj obj = args[0];
     switch (obj.tag) {
         case ObjType_String: {
-            char* str = forceString(obj);
-            out = atoi(str);
-            free(str);
+            out = parseInt(obj.string.start, obj.string.length);
             break;
         }
         case ObjType_Int: {
@@ -228,4 +109,384 @@ InterpreterObj stl_int(ObjList args) {
         .tag = ObjType_Int,
         .int_ = out
     };
+}
+
+// xorshift64* - seeded from the time the first time each thread asks, so
+// threads in a parallel loop don't all draw the same numbers
+static _Thread_local uint64_t randomState = 0;
+static uint64_t randomSeeds = 0;
+
+InterpreterObj stl_random(InterpreterObj* args, int argc) {
+    if (randomState == 0) {
+        // splitmix64
+        uint64_t seed = (uint64_t)time(NULL) + 0x9E3779B97F4A7C15ull * __atomic_add_fetch(&randomSeeds, 1, __ATOMIC_RELAXED);
+        seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+        seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+        randomState = (seed ^ (seed >> 31)) | 1;
+    }
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    // the top 24 bits, which is all a float can hold
+    return (InterpreterObj){
+        .tag = ObjType_Float,
+        .float_ = (float)((randomState * 0x2545F4914F6CDD1Dull) >> 40) / (1 << 24)
+    };
+}
+
+// A view of length chars of string from start - never copied
+STATIC InterpreterObj slice(StringObj string, int start, int length) {
+    if (start < 0 || length < 0 || length > string.length - start)
+        panic(Panic_Stdlib, "Can't take %i chars from position %i of a string that's %i long!", length, start, string.length);
+    return (InterpreterObj){
+        .tag = ObjType_String,
+        .string = stringView(string.owner, string.start + start, length)
+    };
+}
+
+STATIC int lengthOf(InterpreterObj obj) {
+    switch (obj.tag) {
+        case ObjType_String: return obj.string.length;
+        case ObjType_Dictionary: return obj.dictionary->count;
+        case ObjType_Stack: return obj.stack->items.len;
+        case ObjType_Queue: return obj.queue->count;
+        default: panic(Panic_Stdlib, "A %s doesn't have a length!", ObjTypeToString(obj.tag));
+    }
+}
+
+InterpreterObj stl_length(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Int,
+        .int_ = lengthOf(args[0])
+    };
+}
+
+InterpreterObj stl_isEmpty(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Bool,
+        .bool_ = lengthOf(args[0]) == 0
+    };
+}
+
+InterpreterObj stl_substring(InterpreterObj* args, int argc) {
+    return slice(args[0].string, args[1].int_, args[2].int_);
+}
+
+STATIC void checkEnd(StringObj string, int length, char* end) {
+    if (length < 0 || length > string.length) panic(Panic_Stdlib, "Can't take the %s %i chars of a string that's %i long!", end, length, string.length);
+}
+
+InterpreterObj stl_left(InterpreterObj* args, int argc) {
+    checkEnd(args[0].string, args[1].int_, "first");
+    return slice(args[0].string, 0, args[1].int_);
+}
+
+InterpreterObj stl_right(InterpreterObj* args, int argc) {
+    checkEnd(args[0].string, args[1].int_, "last");
+    return slice(args[0].string, args[0].string.length - args[1].int_, args[1].int_);
+}
+
+InterpreterObj stl_upper(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_String,
+        .string = changeCase(args[0].string, true)
+    };
+}
+
+InterpreterObj stl_lower(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_String,
+        .string = changeCase(args[0].string, false)
+    };
+}
+
+InterpreterObj stl_find(InterpreterObj* args, int argc) {
+    StringObj string = args[0].string, needle = args[1].string;
+    return (InterpreterObj){
+        .tag = ObjType_Int,
+        .int_ = findChars(string.start, string.length, needle.start, needle.length)
+    };
+}
+
+InterpreterObj stl_contains(InterpreterObj* args, int argc) {
+    StringObj string = args[0].string, needle = args[1].string;
+    return (InterpreterObj){
+        .tag = ObjType_Bool,
+        .bool_ = findChars(string.start, string.length, needle.start, needle.length) >= 0
+    };
+}
+
+// Non-overlapping, like Python's - "" is between every char
+STATIC int countChars(StringObj string, StringObj needle) {
+    if (needle.length == 0) return string.length + 1;
+    if (needle.length == 1) return countChar(string.start, string.length, needle.start[0]);
+    int out = 0;
+    for (int position = 0, found; (found = findChars(string.start + position, string.length - position, needle.start, needle.length)) >= 0; out++) {
+        position += found + needle.length;
+    }
+    return out;
+}
+
+InterpreterObj stl_count(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Int,
+        .int_ = countChars(args[0].string, args[1].string)
+    };
+}
+
+InterpreterObj stl_split(InterpreterObj* args, int argc) {
+    StringObj string = args[0].string, separator = args[1].string;
+    if (separator.length == 0) panic(Panic_Stdlib, "Can't split a string on \"\"!");
+    int pieces = countChars(string, separator) + 1;
+    ArrayObj* out = newArray(1, &pieces);
+    int position = 0;
+    for (int i = 0; i < pieces; i++) {
+        int found = i == pieces - 1 ? string.length - position : findChars(string.start + position, string.length - position, separator.start, separator.length);
+        arraySet(out, i, (InterpreterObj){
+            .tag = ObjType_String,
+            .string = stringView(string.owner, string.start + position, found)
+        });
+        position += found + separator.length;
+    }
+    return (InterpreterObj){
+        .tag = ObjType_Array,
+        .array = out
+    };
+}
+
+InterpreterObj stl_ASC(InterpreterObj* args, int argc) {
+    StringObj string = args[0].string;
+    if (string.length != 1) panic(Panic_Stdlib, "ASC takes a single character, not \"%.*s\"!", string.length, string.start);
+    return (InterpreterObj){
+        .tag = ObjType_Int,
+        .int_ = (unsigned char)string.start[0]
+    };
+}
+
+InterpreterObj stl_CHR(InterpreterObj* args, int argc) {
+    int code = args[0].int_;
+    if (code < 0 || code > 255) panic(Panic_Stdlib, "CHR takes a character code from 0 to 255, not %i!", code);
+    return (InterpreterObj){
+        .tag = ObjType_String,
+        .string = charString(code)
+    };
+}
+
+InterpreterObj stl_sort(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Array,
+        .array = sortedArray(args[0].array, NULL)
+    };
+}
+
+InterpreterObj stl_sortBy(InterpreterObj* args, int argc) {
+    checkCall(args[1], 2);
+    return (InterpreterObj){
+        .tag = ObjType_Array,
+        .array = sortedArray(args[0].array, &args[1])
+    };
+}
+
+InterpreterObj stl_binarySearch(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Int,
+        .int_ = searchArray(args[0].array, args[1])
+    };
+}
+
+InterpreterObj stl_sum(InterpreterObj* args, int argc) {
+    return arraySum(args[0].array);
+}
+
+InterpreterObj stl_min(InterpreterObj* args, int argc) {
+    return arrayMin(args[0].array);
+}
+
+InterpreterObj stl_max(InterpreterObj* args, int argc) {
+    return arrayMax(args[0].array);
+}
+
+InterpreterObj stl_mean(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Float,
+        .float_ = arrayMean(args[0].array)
+    };
+}
+
+InterpreterObj stl_dot(InterpreterObj* args, int argc) {
+    return arrayDot(args[0].array, args[1].array);
+}
+
+InterpreterObj stl_fill(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Array,
+        .array = filledArray(args[0].array, args[1])
+    };
+}
+
+InterpreterObj stl_openRead(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_File,
+        .file = openFile(args[0].string.start, args[0].string.length, false)
+    };
+}
+
+InterpreterObj stl_openWrite(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_File,
+        .file = openFile(args[0].string.start, args[0].string.length, true)
+    };
+}
+
+InterpreterObj stl_readLine(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_String,
+        .string = readLine(args[0].file)
+    };
+}
+
+InterpreterObj stl_endOfFile(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Bool,
+        .bool_ = endOfFile(args[0].file)
+    };
+}
+
+InterpreterObj stl_writeLine(InterpreterObj* args, int argc) {
+    writeLine(args[0].file, args[1]);
+    return (InterpreterObj){.tag = ObjType_Nil};
+}
+
+InterpreterObj stl_close(InterpreterObj* args, int argc) {
+    closeFile(args[0].file);
+    return (InterpreterObj){.tag = ObjType_Nil};
+}
+
+InterpreterObj stl_input(InterpreterObj* args, int argc) {
+    if (argc > 1) panic(Panic_Stdlib, "Called input with %i args instead of 0 or 1!", argc);
+    if (argc == 1) {
+        outputObj(args[0]);
+        // the prompt has to be up before anyone can answer it
+        outputFlush();
+    }
+    return (InterpreterObj){
+        .tag = ObjType_String,
+        .string = readLine(standardInput())
+    };
+}
+
+InterpreterObj stl_endOfInput(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Bool,
+        .bool_ = endOfFile(standardInput())
+    };
+}
+
+InterpreterObj stl_inputLines(InterpreterObj* args, int argc) {
+    FileObj* input = standardInput();
+    int count = 0, capacity = 1024;
+    StringObj* lines = malloc(capacity * sizeof(StringObj));
+    while (!endOfFile(input)) {
+        if (count == capacity) lines = realloc(lines, (capacity *= 2) * sizeof(StringObj));
+        lines[count++] = readLine(input);
+    }
+    // arrays can't be empty
+    if (count == 0) {
+        free(lines);
+        return (InterpreterObj){.tag = ObjType_Nil};
+    }
+
+    ArrayObj* out = newArray(1, &count);
+    for (int i = 0; i < count; i++) arraySet(out, i, (InterpreterObj){.tag = ObjType_String, .string = lines[i]});
+    free(lines);
+    return (InterpreterObj){
+        .tag = ObjType_Array,
+        .array = out
+    };
+}
+
+InterpreterObj stl_newDictionary(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Dictionary,
+        .dictionary = newDictionary()
+    };
+}
+
+InterpreterObj stl_newStack(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Stack,
+        .stack = newStack()
+    };
+}
+
+InterpreterObj stl_newQueue(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Queue,
+        .queue = newQueue()
+    };
+}
+
+InterpreterObj stl_set(InterpreterObj* args, int argc) {
+    dictionarySet(args[0].dictionary, args[1], args[2]);
+    return (InterpreterObj){.tag = ObjType_Nil};
+}
+
+InterpreterObj stl_get(InterpreterObj* args, int argc) {
+    InterpreterObj* value = dictionaryGet(args[0].dictionary, args[1]);
+    if (value == NULL) panic(Panic_Stdlib, "The dictionary doesn't have a %s key like that!", ObjTypeToString(args[1].tag));
+    return copyObj(*value);
+}
+
+InterpreterObj stl_has(InterpreterObj* args, int argc) {
+    return (InterpreterObj){
+        .tag = ObjType_Bool,
+        .bool_ = dictionaryGet(args[0].dictionary, args[1]) != NULL
+    };
+}
+
+InterpreterObj stl_remove(InterpreterObj* args, int argc) {
+    if (!dictionaryRemove(args[0].dictionary, args[1])) panic(Panic_Stdlib, "The dictionary doesn't have a %s key like that!", ObjTypeToString(args[1].tag));
+    return (InterpreterObj){.tag = ObjType_Nil};
+}
+
+InterpreterObj stl_keys(InterpreterObj* args, int argc) {
+    DictionaryObj* dictionary = args[0].dictionary;
+    // arrays can't be empty
+    if (dictionary->count == 0) return (InterpreterObj){.tag = ObjType_Nil};
+    ArrayObj* out = newArray(1, &dictionary->count);
+    int next = 0;
+    for (int i = 0; i < dictionary->capacity; i++) {
+        DictionaryEntry* entry = &dictionary->entries[i];
+        if (entry->hash > DICTIONARY_REMOVED) arraySet(out, next++, copyObj(entry->key));
+    }
+    return (InterpreterObj){
+        .tag = ObjType_Array,
+        .array = out
+    };
+}
+
+InterpreterObj stl_push(InterpreterObj* args, int argc) {
+    stackPush(args[0].stack, args[1]);
+    return (InterpreterObj){.tag = ObjType_Nil};
+}
+
+InterpreterObj stl_pop(InterpreterObj* args, int argc) {
+    return stackPop(args[0].stack);
+}
+
+InterpreterObj stl_peek(InterpreterObj* args, int argc) {
+    return copyObj(*stackPeek(args[0].stack));
+}
+
+InterpreterObj stl_enqueue(InterpreterObj* args, int argc) {
+    queuePush(args[0].queue, args[1]);
+    return (InterpreterObj){.tag = ObjType_Nil};
+}
+
+InterpreterObj stl_dequeue(InterpreterObj* args, int argc) {
+    return queuePop(args[0].queue);
+}
+
+InterpreterObj stl_front(InterpreterObj* args, int argc) {
+    return copyObj(*queueFront(args[0].queue));
 }
\ No newline at end of file
@@ -2,10 +2,83 @@
 
 #include "interpreter.h"
 
-void stl_print(ObjList args);
-InterpreterObj stl_typeof(ObjList args);
+void stl_print(InterpreterObj* args, int argc);
+InterpreterObj stl_typeof(InterpreterObj* args, int argc);
 
-InterpreterObj stl_bool(ObjList args);
-InterpreterObj stl_string(ObjList args);
-InterpreterObj stl_float(ObjList args);
-InterpreterObj stl_int(ObjList args);
\ No newline at end of file
+InterpreterObj stl_bool(InterpreterObj* args, int argc);
+InterpreterObj stl_string(InterpreterObj* args, int argc);
+InterpreterObj stl_float(InterpreterObj* args, int argc);
+InterpreterObj stl_int(InterpreterObj* args, int argc);
+// A float in [0, 1) - every thread has its own generator
+InterpreterObj stl_random(InterpreterObj* args, int argc);
+
+InterpreterObj stl_ASC(InterpreterObj* args, int argc);
+InterpreterObj stl_CHR(InterpreterObj* args, int argc);
+
+// sort & sortBy give a sorted copy - sortBy's function takes two elements &
+// says whether the first goes before the second. binarySearch's -1 if it
+// isn't there.
+InterpreterObj stl_sort(InterpreterObj* args, int argc);
+InterpreterObj stl_sortBy(InterpreterObj* args, int argc);
+InterpreterObj stl_binarySearch(InterpreterObj* args, int argc);
+
+// collections - see collections.h
+InterpreterObj stl_newDictionary(InterpreterObj* args, int argc);
+InterpreterObj stl_newStack(InterpreterObj* args, int argc);
+InterpreterObj stl_newQueue(InterpreterObj* args, int argc);
+
+// see reduce.h - fill gives a new array shaped like the one it's given
+InterpreterObj stl_sum(InterpreterObj* args, int argc);
+InterpreterObj stl_min(InterpreterObj* args, int argc);
+InterpreterObj stl_max(InterpreterObj* args, int argc);
+InterpreterObj stl_mean(InterpreterObj* args, int argc);
+InterpreterObj stl_dot(InterpreterObj* args, int argc);
+InterpreterObj stl_fill(InterpreterObj* args, int argc);
+
+InterpreterObj stl_openRead(InterpreterObj* args, int argc);
+InterpreterObj stl_openWrite(InterpreterObj* args, int argc);
+
+// stdin - input takes an optional prompt, & inputLines gives every line
+// that's left (or nil, if there aren't any)
+InterpreterObj stl_input(InterpreterObj* args, int argc);
+InterpreterObj stl_endOfInput(InterpreterObj* args, int argc);
+InterpreterObj stl_inputLines(InterpreterObj* args, int argc);
+
+// string methods - args[0]'s the string. substring, left & right give
+// views of it, so they never copy
+InterpreterObj stl_length(InterpreterObj* args, int argc);
+InterpreterObj stl_substring(InterpreterObj* args, int argc);
+InterpreterObj stl_left(InterpreterObj* args, int argc);
+InterpreterObj stl_right(InterpreterObj* args, int argc);
+InterpreterObj stl_upper(InterpreterObj* args, int argc);
+InterpreterObj stl_lower(InterpreterObj* args, int argc);
+// find's -1 if it isn't there, & split's pieces are views too
+InterpreterObj stl_find(InterpreterObj* args, int argc);
+InterpreterObj stl_contains(InterpreterObj* args, int argc);
+InterpreterObj stl_count(InterpreterObj* args, int argc);
+InterpreterObj stl_split(InterpreterObj* args, int argc);
+
+// length & isEmpty work on strings & every collection
+InterpreterObj stl_isEmpty(InterpreterObj* args, int argc);
+
+// dictionary methods - get & remove panic if the key isn't there, & keys
+// is nil if the dictionary's empty
+InterpreterObj stl_set(InterpreterObj* args, int argc);
+InterpreterObj stl_get(InterpreterObj* args, int argc);
+InterpreterObj stl_has(InterpreterObj* args, int argc);
+InterpreterObj stl_remove(InterpreterObj* args, int argc);
+InterpreterObj stl_keys(InterpreterObj* args, int argc);
+
+// stack & queue methods - taking from an empty one panics
+InterpreterObj stl_push(InterpreterObj* args, int argc);
+InterpreterObj stl_pop(InterpreterObj* args, int argc);
+InterpreterObj stl_peek(InterpreterObj* args, int argc);
+InterpreterObj stl_enqueue(InterpreterObj* args, int argc);
+InterpreterObj stl_dequeue(InterpreterObj* args, int argc);
+InterpreterObj stl_front(InterpreterObj* args, int argc);
+
+// file methods - args[0]'s the file
+InterpreterObj stl_readLine(InterpreterObj* args, int argc);
+InterpreterObj stl_endOfFile(InterpreterObj* args, int argc);
+InterpreterObj stl_writeLine(InterpreterObj* args, int argc);
+InterpreterObj stl_close(InterpreterObj* args, int argc);
\ No newline at end of file
@@ -0,0 +1,158 @@
+// fopencookie
+#define _GNU_SOURCE
+
+#include "ocrpi_vm.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "optimiser.h"
+#include "runtime.h"
+#include "closure.h"
+#include "jit.h"
+#include "output.h"
+#include "panic.h"
+
+// Everything that came out of one run - the VM's globals can point into any
+// of them (function declarations, string literals...)
+typedef struct {
+    char* source;
+    LexOutput lo;
+    ParseOutput po;
+    // NULL if it never got as far as compiling
+    Closure* program;
+} VMProgram;
+
+DECL_VEC(VMProgram, VMProgramList)
+
+struct OcrpiVM {
+    Scope* globals;
+    VMProgramList programs;
+};
+
+OcrpiVM* ocrpi_vm_new() {
+    OcrpiVM* vm = malloc(sizeof(OcrpiVM));
+    vm->globals = newScope();
+    vm->globals->parent = NULL;
+    INIT(vm->programs);
+
+    // the natives go in the current scope
+    Scope* callerScope = currentScope;
+    Scope* callerGlobals = globalScope;
+    currentScope = globalScope = vm->globals;
+    setupSTL();
+    currentScope = callerScope;
+    globalScope = callerGlobals;
+    return vm;
+}
+
+void ocrpi_vm_free(OcrpiVM* vm) {
+    destroyScope(vm->globals);
+    FOREACH(VMProgramList, vm->programs, program) {
+        if (program->program != NULL) destroyClosure(program->program);
+        jitRelease(&program->po.ast);
+        destroyParseOutput(program->po);
+        destroyLexOutput(program->lo);
+        free(program->source);
+    }
+    DESTROY(vm->programs);
+    free(vm);
+}
+
+// The output buffer's target - copies into the caller's buffer as far as it
+// fits, & counts everything
+STATIC ssize_t captureOutput(void* cookie, const char* chars, size_t length) {
+    OcrpiCapture* capture = cookie;
+    if (capture->outputSize > 0 && capture->outputLength < capture->outputSize - 1) {
+        size_t room = capture->outputSize - 1 - capture->outputLength;
+        memcpy(capture->output + capture->outputLength, chars, length < room ? length : room);
+    }
+    capture->outputLength += length;
+    return length;
+}
+
+// Anything in here can panic - the caller catches it
+STATIC OcrpiStatus runProgram(OcrpiVM* vm, const char* source, char* error, size_t errorSize) {
+    APPEND(vm->programs, ((VMProgram){.source = strdup(source)}));
+    VMProgram* program = &vm->programs.root[vm->programs.len - 1];
+    program->lo = lex(program->source);
+    program->po = parse(program->lo);
+    if (program->po.errors.len > 0) {
+        ParseError first = program->po.errors.root[0];
+        if (errorSize > 0) snprintf(error, errorSize, "Parse error at line %i, column %i: %s", first.tok.line, first.tok.col, first.msg);
+        return OCRPI_SYNTAX_ERROR;
+    }
+    // loading one changes the natives every VM sees
+    if (program->po.imports.len > 0) {
+        if (errorSize > 0) snprintf(error, errorSize, "Can't import modules into an embedded program!");
+        return OCRPI_IMPORT_ERROR;
+    }
+
+    optimise(&program->po.ast);
+    jitPrepare(&program->po.ast);
+    program->program = compileBlock(&program->po.ast);
+    runClosure(program->program);
+    return OCRPI_OK;
+}
+
+OcrpiStatus ocrpi_run_source(OcrpiVM* vm, const char* source, OcrpiCapture* capture) {
+    char* error = capture != NULL ? capture->error : NULL;
+    size_t errorSize = error != NULL ? capture->errorSize : 0;
+    if (errorSize > 0) error[0] = '\0';
+
+    OutputBuffer output;
+    FILE* target = NULL;
+    if (capture != NULL) {
+        capture->outputLength = 0;
+        target = fopencookie(capture, "w", (cookie_io_functions_t){.write = captureOutput});
+        setvbuf(target, NULL, _IONBF, 0);
+        output = (OutputBuffer){
+            .data = malloc(OUTPUT_BUFFER_SIZE),
+            .size = OUTPUT_BUFFER_SIZE,
+            .target = target
+        };
+        outputRedirect(&output);
+    }
+
+    Scope* callerScope = currentScope;
+    Scope* callerGlobals = globalScope;
+    currentScope = globalScope = vm->globals;
+
+    OcrpiStatus status;
+    jmp_buf panicked;
+    if (setjmp(panicked) == 0) {
+        panicReturnTo(&panicked, error, errorSize);
+        status = runProgram(vm, source, error, errorSize);
+    } else {
+        status = OCRPI_RUNTIME_ERROR;
+        // back out of whatever it was in the middle of - the scopes between
+        // here & the innermost one are lost, but the globals are fine. The
+        // loops it was in never got to turn their bounds checks back on, &
+        // the functions they're in can be called again.
+        while (currentScope != vm->globals) popScope();
+        forgetAllIndices();
+    }
+    panicReturnTo(NULL, NULL, 0);
+
+    currentScope = callerScope;
+    globalScope = callerGlobals;
+
+    if (capture != NULL) {
+        flushBuffer(&output);
+        outputRedirect(NULL);
+        fclose(target);
+        free(output.data);
+        if (capture->outputSize > 0) {
+            size_t end = capture->outputLength < capture->outputSize - 1 ? capture->outputLength : capture->outputSize - 1;
+            capture->output[end] = '\0';
+        }
+    } else {
+        outputFlush();
+    }
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+// Running OCR programs inside another program - link against libocrpi.a or
+// libocrpi.so (`make library`).
+//
+//     OcrpiVM* vm = ocrpi_vm_new();
+//     char output[4096], error[256];
+//     OcrpiCapture capture = {output, sizeof(output), 0, error, sizeof(error)};
+//     if (ocrpi_run_source(vm, "print(1 + 2)", &capture) != OCRPI_OK) ...
+//     ocrpi_vm_free(vm);
+//
+// A VM keeps its globals between runs, so a later program can use the
+// variables & functions an earlier one left behind - which means it also
+// keeps every program it's run until it's freed. Each VM's only used by one
+// thread at a time, but any number of them can run at once on different
+// threads.
+//
+// Programs run on the closure compiler (& the JIT). Parallel loops run one
+// iteration at a time, they can't import modules, & input() reads the
+// process's stdin, which every VM shares.
+
+#include <stddef.h>
+
+typedef struct OcrpiVM OcrpiVM;
+
+typedef enum {
+    OCRPI_OK = 0,
+    // it didn't parse - nothing's been run
+    OCRPI_SYNTAX_ERROR,
+    // it panicked part way through - the output has everything it printed
+    // up to then
+    OCRPI_RUNTIME_ERROR,
+    // it imports a module, which embedded programs can't - nothing's been run
+    OCRPI_IMPORT_ERROR
+} OcrpiStatus;
+
+// Where a run's output & error message go. Either buffer can be NULL (with
+// a size of 0) to throw it away, & whatever doesn't fit is cut off - both
+// are always NUL terminated.
+typedef struct {
+    char* output;
+    size_t outputSize;
+    // filled in by the run - how much it printed, including anything that
+    // didn't fit
+    size_t outputLength;
+    // empty unless the run fails
+    char* error;
+    size_t errorSize;
+} OcrpiCapture;
+
+OcrpiVM* ocrpi_vm_new();
+// Run source in vm - capture can be NULL, in which case the output goes to
+// stdout like ocrpi's does
+OcrpiStatus ocrpi_run_source(OcrpiVM* vm, const char* source, OcrpiCapture* capture);
+void ocrpi_vm_free(OcrpiVM* vm);
\ No newline at end of file
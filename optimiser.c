@@ -0,0 +1,645 @@
+#include "optimiser.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+
+STATIC bool isAssignment(TokType type) {
+    switch (type) {
+        case Tok_Equal:
+        case Tok_PlusEqual:
+        case Tok_MinusEqual:
+        case Tok_StarEqual:
+        case Tok_SlashEqual:
+        case Tok_ExpEqual:
+            return true;
+        default:
+            return false;
+    }
+}
+
+STATIC bool sameName(Token a, Token b) {
+    return a.length == b.length && strncmp(a.start, b.start, a.length) == 0;
+}
+
+STATIC bool containsName(TokList names, Token name) {
+    FOREACH(TokList, names, current) {
+        if (sameName(*current, name)) return true;
+    }
+    return false;
+}
+
+//* ---------------- effects ----------------
+
+// Everything a block might do which could invalidate what we know about a loop
+typedef struct {
+    // names which get assigned or (re)declared
+    TokList assigned;
+    // names which get called - only safe if they're native
+    TokList called;
+    // something we can't see through, eg. calling a function we can't name
+    bool opaque;
+    // declares an array, or stores something which might be one in a name -
+    // through a byRef parameter that can swap out an array under any other
+    // name, so nothing's bounds can be trusted
+    bool replacesArrays;
+} Effects;
+
+STATIC void exprEffects(Expression* expr, Effects* effects);
+STATIC void blockEffects(DeclList* block, Effects* effects);
+
+// Anything but a literal or arithmetic could evaluate to an array
+STATIC bool mightBeArray(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: return false;
+        case ExprTag_Binary: return isAssignment(expr->binary.operator.type) && mightBeArray(expr->binary.b);
+        case ExprTag_Grouping: return mightBeArray(expr->grouping);
+        case ExprTag_Cached: return mightBeArray(expr->cached.expr);
+        case ExprTag_Primary: return expr->primary.type == Tok_Identifier;
+        default: return true;
+    }
+}
+
+STATIC void exprListEffects(ExprList list, Effects* effects) {
+    FOREACH(ExprList, list, current) exprEffects(current, effects);
+}
+
+STATIC void exprEffects(Expression* expr, Effects* effects) {
+    switch (expr->tag) {
+        case ExprTag_Unary: {
+            exprEffects(expr->unary.operand, effects);
+            break;
+        }
+        case ExprTag_Binary: {
+            if (isAssignment(expr->binary.operator.type)) {
+                Expression* target = expr->binary.a;
+                // writes to array elements don't change the array's shape
+                if (target->tag == ExprTag_Primary) {
+                    APPEND(effects->assigned, target->primary);
+                    if (mightBeArray(expr->binary.b)) effects->replacesArrays = true;
+                } else if (!(target->tag == ExprTag_Call && target->call.tag == Call_Array)) effects->opaque = true;
+            }
+            exprEffects(expr->binary.a, effects);
+            exprEffects(expr->binary.b, effects);
+            break;
+        }
+        case ExprTag_Call: {
+            switch (expr->call.tag) {
+                case Call_Call: {
+                    if (expr->call.callee->tag == ExprTag_Primary && expr->call.callee->primary.type == Tok_Identifier) {
+                        APPEND(effects->called, expr->call.callee->primary);
+                    } else {
+                        effects->opaque = true;
+                    }
+                    exprListEffects(expr->call.arguments, effects);
+                    break;
+                }
+                case Call_Array: {
+                    exprEffects(expr->call.callee, effects);
+                    exprListEffects(expr->call.arguments, effects);
+                    break;
+                }
+                case Call_GetMember: {
+                    effects->opaque = true;
+                    break;
+                }
+            }
+            break;
+        }
+        case ExprTag_Super: {
+            effects->opaque = true;
+            break;
+        }
+        case ExprTag_Grouping: {
+            exprEffects(expr->grouping, effects);
+            break;
+        }
+        case ExprTag_Primary: {
+            break;
+        }
+        case ExprTag_Cached: {
+            exprEffects(expr->cached.expr, effects);
+            break;
+        }
+    }
+}
+
+STATIC void conditionalBlockEffects(ConditionalBlock* cb, Effects* effects) {
+    exprEffects(&cb->condition, effects);
+    blockEffects(cb->block, effects);
+}
+
+STATIC void stmtEffects(Statement* stmt, Effects* effects) {
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            exprEffects(&stmt->expr, effects);
+            break;
+        }
+        case StmtTag_Global: {
+            APPEND(effects->assigned, stmt->global.name);
+            exprEffects(&stmt->global.initializer, effects);
+            break;
+        }
+        case StmtTag_For: {
+            APPEND(effects->assigned, stmt->for_.iterator);
+            exprEffects(&stmt->for_.min, effects);
+            exprEffects(&stmt->for_.max, effects);
+            blockEffects(stmt->for_.block, effects);
+            break;
+        }
+        case StmtTag_While: {
+            conditionalBlockEffects(&stmt->while_, effects);
+            break;
+        }
+        case StmtTag_Do: {
+            conditionalBlockEffects(&stmt->do_, effects);
+            break;
+        }
+        case StmtTag_If: {
+            conditionalBlockEffects(&stmt->if_.primary, effects);
+            FOREACH(ElseIfList, stmt->if_.secondary, branch) conditionalBlockEffects(branch, effects);
+            if (stmt->if_.hasElse) conditionalBlockEffects(&stmt->if_.else_, effects);
+            break;
+        }
+        case StmtTag_Switch: {
+            exprEffects(&stmt->switch_.expr, effects);
+            FOREACH(SwitchCaseList, stmt->switch_.cases, currentCase) conditionalBlockEffects(currentCase, effects);
+            if (stmt->switch_.hasDefault) blockEffects(stmt->switch_.default_, effects);
+            break;
+        }
+        case StmtTag_Array: {
+            APPEND(effects->assigned, stmt->array.name);
+            effects->replacesArrays = true;
+            FOREACH(ArrayDimensions, stmt->array.dimensions, dim) exprEffects(dim, effects);
+            break;
+        }
+    }
+}
+
+STATIC void blockEffects(DeclList* block, Effects* effects) {
+    FOREACH(DeclList, *block, decl) {
+        switch (decl->tag) {
+            // declaring one doesn't run it, it just binds the name
+            case DeclTag_Fun: {
+                APPEND(effects->assigned, decl->fun.name);
+                break;
+            }
+            case DeclTag_Proc: {
+                APPEND(effects->assigned, decl->proc.name);
+                break;
+            }
+            case DeclTag_Class: {
+                effects->opaque = true;
+                break;
+            }
+            case DeclTag_Stmt: {
+                stmtEffects(&decl->stmt, effects);
+                break;
+            }
+        }
+    }
+}
+
+// Would evaluating expr give the same value on every iteration?
+STATIC bool isInvariant(Expression* expr, Effects* effects) {
+    switch (expr->tag) {
+        case ExprTag_Binary: return
+            !isAssignment(expr->binary.operator.type) &&
+            isInvariant(expr->binary.a, effects) &&
+            isInvariant(expr->binary.b, effects);
+        case ExprTag_Grouping: return isInvariant(expr->grouping, effects);
+        case ExprTag_Cached: return isInvariant(expr->cached.expr, effects);
+        case ExprTag_Primary: return
+            expr->primary.type != Tok_Identifier ||
+            !containsName(effects->assigned, expr->primary);
+        default: return false;
+    }
+}
+
+//* ---------------- bounds checks ----------------
+
+// iterator, iterator + n or iterator - n
+STATIC bool iteratorOffset(Expression* expr, Token iterator, int* offset) {
+    while (expr->tag == ExprTag_Grouping || expr->tag == ExprTag_Cached) {
+        expr = expr->tag == ExprTag_Grouping ? expr->grouping : expr->cached.expr;
+    }
+
+    if (expr->tag == ExprTag_Primary && sameName(expr->primary, iterator)) {
+        *offset = 0;
+        return true;
+    }
+
+    if (!(
+        expr->tag == ExprTag_Binary &&
+        (expr->binary.operator.type == Tok_Plus || expr->binary.operator.type == Tok_Minus) &&
+        expr->binary.a->tag == ExprTag_Primary &&
+        sameName(expr->binary.a->primary, iterator) &&
+        expr->binary.b->tag == ExprTag_Primary &&
+        expr->binary.b->primary.type == Tok_IntLit &&
+        expr->binary.b->primary.length < 9
+    )) return false;
+
+    int n = 0;
+    for (int i = 0; i < expr->binary.b->primary.length; i++) n = n * 10 + expr->binary.b->primary.start[i] - '0';
+    *offset = expr->binary.operator.type == Tok_Plus ? n : -n;
+    return true;
+}
+
+STATIC void findCandidates(Expression* expr, ForStmt* loop, Effects* effects);
+
+STATIC void findCandidatesInBlock(DeclList* block, ForStmt* loop, Effects* effects);
+
+STATIC void findCandidatesInList(ExprList list, ForStmt* loop, Effects* effects) {
+    FOREACH(ExprList, list, current) findCandidates(current, loop, effects);
+}
+
+STATIC void findCandidates(Expression* expr, ForStmt* loop, Effects* effects) {
+    switch (expr->tag) {
+        case ExprTag_Unary: {
+            findCandidates(expr->unary.operand, loop, effects);
+            break;
+        }
+        case ExprTag_Binary: {
+            findCandidates(expr->binary.a, loop, effects);
+            findCandidates(expr->binary.b, loop, effects);
+            break;
+        }
+        case ExprTag_Call: {
+            if (expr->call.tag == Call_GetMember) break;
+            if (
+                expr->call.tag == Call_Array &&
+                expr->call.callee->tag == ExprTag_Primary &&
+                expr->call.callee->primary.type == Tok_Identifier &&
+                !containsName(effects->assigned, expr->call.callee->primary)
+            ) {
+                for (int i = 0; i < expr->call.arguments.len && i < 32; i++) {
+                    int offset;
+                    if (iteratorOffset(&expr->call.arguments.root[i], loop->iterator, &offset)) {
+                        APPEND(loop->indexCandidates, ((IndexCandidate){
+                            .access = &expr->call,
+                            .dimension = i,
+                            .offset = offset
+                        }));
+                    }
+                }
+            }
+            findCandidates(expr->call.callee, loop, effects);
+            findCandidatesInList(expr->call.arguments, loop, effects);
+            break;
+        }
+        case ExprTag_Grouping: {
+            findCandidates(expr->grouping, loop, effects);
+            break;
+        }
+        case ExprTag_Cached: {
+            findCandidates(expr->cached.expr, loop, effects);
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void findCandidatesInConditionalBlock(ConditionalBlock* cb, ForStmt* loop, Effects* effects) {
+    findCandidates(&cb->condition, loop, effects);
+    findCandidatesInBlock(cb->block, loop, effects);
+}
+
+STATIC void findCandidatesInBlock(DeclList* block, ForStmt* loop, Effects* effects) {
+    FOREACH(DeclList, *block, decl) {
+        if (decl->tag != DeclTag_Stmt) continue;
+        Statement* stmt = &decl->stmt;
+        switch (stmt->tag) {
+            case StmtTag_Expr: {
+                findCandidates(&stmt->expr, loop, effects);
+                break;
+            }
+            case StmtTag_Global: {
+                findCandidates(&stmt->global.initializer, loop, effects);
+                break;
+            }
+            case StmtTag_For: {
+                findCandidates(&stmt->for_.min, loop, effects);
+                findCandidates(&stmt->for_.max, loop, effects);
+                findCandidatesInBlock(stmt->for_.block, loop, effects);
+                break;
+            }
+            case StmtTag_While: {
+                findCandidatesInConditionalBlock(&stmt->while_, loop, effects);
+                break;
+            }
+            case StmtTag_Do: {
+                findCandidatesInConditionalBlock(&stmt->do_, loop, effects);
+                break;
+            }
+            case StmtTag_If: {
+                findCandidatesInConditionalBlock(&stmt->if_.primary, loop, effects);
+                FOREACH(ElseIfList, stmt->if_.secondary, branch) findCandidatesInConditionalBlock(branch, loop, effects);
+                if (stmt->if_.hasElse) findCandidatesInConditionalBlock(&stmt->if_.else_, loop, effects);
+                break;
+            }
+            case StmtTag_Switch: {
+                findCandidates(&stmt->switch_.expr, loop, effects);
+                FOREACH(SwitchCaseList, stmt->switch_.cases, currentCase) findCandidatesInConditionalBlock(currentCase, loop, effects);
+                if (stmt->switch_.hasDefault) findCandidatesInBlock(stmt->switch_.default_, loop, effects);
+                break;
+            }
+            case StmtTag_Array: {
+                FOREACH(ArrayDimensions, stmt->array.dimensions, dim) findCandidates(dim, loop, effects);
+                break;
+            }
+        }
+    }
+}
+
+// Range analysis for `for i = min to max` - if nothing in the block can
+// change i, max or the arrays it indexes, every a[i] is in-bounds as long as
+// [min, max) fits inside a. That depends on runtime values, so the
+// interpreter does that check once before the loop starts.
+STATIC void analyseFor(ForStmt* loop) {
+    Effects effects;
+    INIT(effects.assigned);
+    INIT(effects.called);
+    effects.opaque = false;
+    effects.replacesArrays = false;
+
+    blockEffects(loop->block, &effects);
+
+    loop->rangeInvariant =
+        !effects.opaque &&
+        !containsName(effects.assigned, loop->iterator) &&
+        isInvariant(&loop->max, &effects);
+
+    if (loop->rangeInvariant && !effects.replacesArrays) {
+        APPEND_ALL(TokList, loop->calledNames, effects.called);
+        findCandidatesInBlock(loop->block, loop, &effects);
+    }
+
+    DESTROY(effects.assigned);
+    DESTROY(effects.called);
+}
+
+//* ---------------- common subexpressions ----------------
+
+// the slots are per thread too (see runtime.h), so it doesn't matter if two
+// programs optimised on different threads share numbers
+static _Thread_local int cacheSlotCount = 0;
+
+// No calls (which might be to a user function) & no assignments
+STATIC bool isPure(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: return expr->unary.operator.type != Tok_New && isPure(expr->unary.operand);
+        case ExprTag_Binary: return
+            !isAssignment(expr->binary.operator.type) &&
+            isPure(expr->binary.a) &&
+            isPure(expr->binary.b);
+        case ExprTag_Call: {
+            if (expr->call.tag != Call_Array) return false;
+            if (!isPure(expr->call.callee)) return false;
+            FOREACH(ExprList, expr->call.arguments, arg) {
+                if (!isPure(arg)) return false;
+            }
+            return true;
+        }
+        case ExprTag_Super: return false;
+        case ExprTag_Grouping: return isPure(expr->grouping);
+        case ExprTag_Primary: return true;
+        case ExprTag_Cached: return isPure(expr->cached.expr);
+    }
+}
+
+STATIC Expression* skipGroupings(Expression* expr) {
+    while (expr->tag == ExprTag_Grouping) expr = expr->grouping;
+    return expr;
+}
+
+STATIC bool sameExpr(Expression* a, Expression* b) {
+    a = skipGroupings(a);
+    b = skipGroupings(b);
+    if (a->tag != b->tag) return false;
+    switch (a->tag) {
+        case ExprTag_Unary: return
+            a->unary.operator.type == b->unary.operator.type &&
+            sameExpr(a->unary.operand, b->unary.operand);
+        case ExprTag_Binary: return
+            a->binary.operator.type == b->binary.operator.type &&
+            sameExpr(a->binary.a, b->binary.a) &&
+            sameExpr(a->binary.b, b->binary.b);
+        case ExprTag_Call: {
+            if (a->call.tag != Call_Array || b->call.tag != Call_Array) return false;
+            if (a->call.arguments.len != b->call.arguments.len) return false;
+            if (!sameExpr(a->call.callee, b->call.callee)) return false;
+            for (int i = 0; i < a->call.arguments.len; i++) {
+                if (!sameExpr(&a->call.arguments.root[i], &b->call.arguments.root[i])) return false;
+            }
+            return true;
+        }
+        case ExprTag_Primary: return
+            a->primary.type == b->primary.type &&
+            sameName(a->primary, b->primary);
+        default: return false;
+    }
+}
+
+// A sub-expression, in pre-order - the ones inside it are [index + 1, end)
+typedef struct {
+    Expression* expr;
+    int end;
+    bool candidate;
+    bool claimed;
+} SubExpr;
+
+DECL_VEC(SubExpr, SubExprList)
+
+STATIC void collectSubExprs(Expression* expr, SubExprList* out, Expression* target) {
+    int index = out->len;
+    // primaries are already as cheap as a lookup in the cache, and the
+    // target of an assignment has to stay an lvalue
+    bool candidate = expr != target && (
+        (expr->tag == ExprTag_Binary && !isAssignment(expr->binary.operator.type)) ||
+        (expr->tag == ExprTag_Call && expr->call.tag == Call_Array)
+    );
+    APPEND(*out, ((SubExpr){.expr = expr, .candidate = candidate, .claimed = false}));
+
+    switch (expr->tag) {
+        case ExprTag_Unary: {
+            collectSubExprs(expr->unary.operand, out, target);
+            break;
+        }
+        case ExprTag_Binary: {
+            collectSubExprs(expr->binary.a, out, target);
+            collectSubExprs(expr->binary.b, out, target);
+            break;
+        }
+        case ExprTag_Call: {
+            collectSubExprs(expr->call.callee, out, target);
+            if (expr->call.tag != Call_GetMember) {
+                FOREACH(ExprList, expr->call.arguments, arg) collectSubExprs(arg, out, target);
+            }
+            break;
+        }
+        case ExprTag_Grouping: {
+            collectSubExprs(expr->grouping, out, target);
+            break;
+        }
+        default: break;
+    }
+
+    out->root[index].end = out->len;
+}
+
+STATIC void claim(SubExprList* subExprs, int index) {
+    for (int i = index; i < subExprs->root[index].end; i++) subExprs->root[i].claimed = true;
+}
+
+STATIC void cacheExpr(Expression* expr, int slot) {
+    *expr = (Expression){
+        .tag = ExprTag_Cached,
+        .cached = (CachedExpr){
+            .expr = copyExpr(*expr),
+            .slot = slot
+        }
+    };
+}
+
+// Only the outermost assignment & call of a statement can be impure -
+// everything they depend on is evaluated before they run, so nothing can
+// change under a cached value.
+//
+//   x = (a - b) * (a - b)
+//   print(a[i] * a[i], a[i])
+STATIC bool pureBelowSpine(Expression* expr, Expression** target) {
+    expr = skipGroupings(expr);
+    if (expr->tag == ExprTag_Binary && isAssignment(expr->binary.operator.type) && *target == NULL) {
+        *target = expr->binary.a;
+        return isPure(expr->binary.a) && pureBelowSpine(expr->binary.b, target);
+    }
+    if (expr->tag == ExprTag_Call && expr->call.tag == Call_Call) {
+        if (!isPure(expr->call.callee)) return false;
+        FOREACH(ExprList, expr->call.arguments, arg) {
+            if (!isPure(arg)) return false;
+        }
+        return true;
+    }
+    return isPure(expr);
+}
+
+// Find pure sub-expressions which appear more than once in a statement, and
+// cache the first evaluation of each for the others. Bigger sub-expressions
+// win - in (a[i] - a[j]) * (a[i] - a[j]) the whole subtraction is cached,
+// not just a[i] and a[j].
+STATIC void eliminateCommonSubExprs(Expression* root) {
+    Expression* target = NULL;
+    if (!pureBelowSpine(root, &target)) return;
+
+    SubExprList subExprs;
+    INIT(subExprs);
+    collectSubExprs(root, &subExprs, target);
+
+    for (int i = 0; i < subExprs.len; i++) {
+        SubExpr* current = &subExprs.root[i];
+        if (!current->candidate || current->claimed) continue;
+
+        int slot = -1;
+        for (int j = current->end; j < subExprs.len; j++) {
+            SubExpr* other = &subExprs.root[j];
+            if (!other->candidate || other->claimed || !sameExpr(current->expr, other->expr)) continue;
+            if (slot == -1) slot = cacheSlotCount++;
+            claim(&subExprs, j);
+            cacheExpr(other->expr, slot);
+        }
+
+        if (slot != -1) {
+            claim(&subExprs, i);
+            cacheExpr(current->expr, slot);
+        }
+    }
+
+    DESTROY(subExprs);
+}
+
+STATIC void eliminateInConditionalBlock(ConditionalBlock* cb) {
+    eliminateCommonSubExprs(&cb->condition);
+}
+
+//* ---------------- traversal ----------------
+
+STATIC void optimiseBlock(DeclList* block);
+
+// Blocks are optimised before the loops around them are analysed - the
+// analysis keeps pointers into the tree, so the tree mustn't move after.
+STATIC void optimiseStmt(Statement* stmt) {
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            eliminateCommonSubExprs(&stmt->expr);
+            break;
+        }
+        case StmtTag_Global: {
+            eliminateCommonSubExprs(&stmt->global.initializer);
+            break;
+        }
+        case StmtTag_For: {
+            optimiseBlock(stmt->for_.block);
+            analyseFor(&stmt->for_);
+            break;
+        }
+        case StmtTag_While: {
+            eliminateInConditionalBlock(&stmt->while_);
+            optimiseBlock(stmt->while_.block);
+            break;
+        }
+        case StmtTag_Do: {
+            eliminateInConditionalBlock(&stmt->do_);
+            optimiseBlock(stmt->do_.block);
+            break;
+        }
+        case StmtTag_If: {
+            eliminateInConditionalBlock(&stmt->if_.primary);
+            optimiseBlock(stmt->if_.primary.block);
+            FOREACH(ElseIfList, stmt->if_.secondary, branch) {
+                eliminateInConditionalBlock(branch);
+                optimiseBlock(branch->block);
+            }
+            if (stmt->if_.hasElse) {
+                eliminateInConditionalBlock(&stmt->if_.else_);
+                optimiseBlock(stmt->if_.else_.block);
+            }
+            break;
+        }
+        case StmtTag_Switch: {
+            FOREACH(SwitchCaseList, stmt->switch_.cases, currentCase) optimiseBlock(currentCase->block);
+            if (stmt->switch_.hasDefault) optimiseBlock(stmt->switch_.default_);
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void optimiseDecl(Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            FOREACH(FuncDeclList, decl->fun.block, currentDOR) {
+                if (currentDOR->tag == DOR_decl) optimiseDecl(currentDOR->declaration);
+                else eliminateCommonSubExprs(&currentDOR->return_);
+            }
+            break;
+        }
+        case DeclTag_Proc: {
+            optimiseBlock(decl->proc.block);
+            break;
+        }
+        case DeclTag_Stmt: {
+            optimiseStmt(&decl->stmt);
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void optimiseBlock(DeclList* block) {
+    FOREACH(DeclList, *block, decl) optimiseDecl(decl);
+}
+
+void optimise(DeclList* program) {
+    optimiseBlock(program);
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "parser.h"
+
+// Static analysis over the AST, run between parsing & interpreting. It only
+// annotates the tree - anything which depends on runtime values (eg. the
+// size of an array) is checked by the interpreter using these annotations.
+void optimise(DeclList* program);
\ No newline at end of file
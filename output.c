@@ -0,0 +1,157 @@
+#include "output.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "numbers.h"
+
+//* ---------------- buffers ----------------
+
+void flushBuffer(OutputBuffer* out) {
+    if (out->used == 0 || out->target == NULL) return;
+    fwrite(out->data, 1, out->used, out->target);
+    fflush(out->target);
+    out->used = 0;
+}
+
+// Room for at least length more chars
+STATIC INLINE char* reserve(OutputBuffer* out, int length) {
+    if (out->used + length > out->size) {
+        if (out->target != NULL) {
+            flushBuffer(out);
+        } else {
+            while (out->used + length > out->size) out->size *= 2;
+            out->data = realloc(out->data, out->size);
+        }
+    }
+    return out->data + out->used;
+}
+
+void writeChars(OutputBuffer* out, char* chars, int length) {
+    if (out->target != NULL && length > out->size) {
+        // wouldn't fit anyway
+        flushBuffer(out);
+        fwrite(chars, 1, length, out->target);
+        return;
+    }
+    memcpy(reserve(out, length), chars, length);
+    out->used += length;
+}
+
+#define WRITE_LITERAL(out, str) writeChars(out, str, sizeof(str) - 1)
+
+void writeNewline(OutputBuffer* out) {
+    *reserve(out, 1) = '\n';
+    out->used++;
+    if (out->lineBuffered) flushBuffer(out);
+}
+
+// Nested brackets for each dimension - [[1, 2], [3, 4]]
+STATIC void writeArray(OutputBuffer* out, ArrayObj* array, int dim, int offset) {
+    WRITE_LITERAL(out, "[");
+    for (int i = 0; i < array->dims[dim]; i++) {
+        if (i != 0) WRITE_LITERAL(out, ", ");
+        int elemOffset = offset + i * array->strides[dim];
+        if (dim < array->rank - 1) {
+            writeArray(out, array, dim + 1, elemOffset);
+        } else {
+            InterpreterObj elem = arrayGet(array, elemOffset);
+            while (elem.tag == ObjType_Ref) elem = *elem.reference;
+            writeObj(out, elem);
+        }
+    }
+    WRITE_LITERAL(out, "]");
+}
+
+void writeObj(OutputBuffer* out, InterpreterObj obj) {
+    switch (obj.tag) {
+        case ObjType_Ref: WRITE_LITERAL(out, "<reference>"); break;
+        case ObjType_Class: WRITE_LITERAL(out, "<class>"); break;
+        case ObjType_Func: WRITE_LITERAL(out, "<func>"); break;
+        case ObjType_Proc: WRITE_LITERAL(out, "<proc>"); break;
+        case ObjType_NativeFunc: WRITE_LITERAL(out, "<native func>"); break;
+        case ObjType_NativeProc: WRITE_LITERAL(out, "<native proc>"); break;
+        case ObjType_Nil: WRITE_LITERAL(out, "nil"); break;
+        case ObjType_Instance: WRITE_LITERAL(out, "<class instance>"); break;
+        case ObjType_File: WRITE_LITERAL(out, "<file>"); break;
+        case ObjType_Dictionary: WRITE_LITERAL(out, "<dictionary>"); break;
+        case ObjType_Stack: WRITE_LITERAL(out, "<stack>"); break;
+        case ObjType_Queue: WRITE_LITERAL(out, "<queue>"); break;
+        case ObjType_Bool: {
+            if (obj.bool_) WRITE_LITERAL(out, "true");
+            else WRITE_LITERAL(out, "false");
+            break;
+        }
+        case ObjType_Int: {
+            out->used += formatInt(obj.int_, reserve(out, INT_CHARS));
+            break;
+        }
+        case ObjType_Float: {
+            out->used += formatFloat(obj.float_, reserve(out, FLOAT_CHARS));
+            break;
+        }
+        case ObjType_String: {
+            writeChars(out, obj.string.start, obj.string.length);
+            break;
+        }
+        case ObjType_Array: {
+            writeArray(out, obj.array, 0, 0);
+            break;
+        }
+    }
+}
+
+//* ---------------- stdout ----------------
+
+static char outputData[OUTPUT_BUFFER_SIZE];
+static OutputBuffer output = {.data = outputData, .size = OUTPUT_BUFFER_SIZE};
+
+STATIC void setTarget(FILE* file) {
+    output.target = file;
+    output.lineBuffered = isatty(fileno(file));
+}
+
+STATIC INLINE void initOutput() {
+    if (output.target != NULL) return;
+    setTarget(stdout);
+    atexit(outputFlush);
+}
+
+// see outputRedirect
+static _Thread_local OutputBuffer* redirected = NULL;
+
+STATIC INLINE OutputBuffer* currentOutput() {
+    if (redirected != NULL) return redirected;
+    initOutput();
+    return &output;
+}
+
+void outputFlush() {
+    flushBuffer(redirected != NULL ? redirected : &output);
+}
+
+void outputRedirect(OutputBuffer* out) {
+    redirected = out;
+}
+
+FILE* outputTarget(FILE* file) {
+    initOutput();
+    flushBuffer(&output);
+    FILE* old = output.target;
+    setTarget(file);
+    return old;
+}
+
+void outputObj(InterpreterObj obj) {
+    writeObj(currentOutput(), obj);
+}
+
+void outputChars(char* chars, int length) {
+    writeChars(currentOutput(), chars, length);
+}
+
+void outputNewline() {
+    writeNewline(currentOutput());
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "interpreter.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+
+// Text on its way out - values are formatted straight into data, & nothing's
+// allocated on the way. It's written to target when it fills up, or, with
+// no target, grows instead (for building strings).
+typedef struct {
+    char* data;
+    int size;
+    int used;
+    FILE* target;
+    // flush at the end of every line, rather than when it's full
+    bool lineBuffered;
+} OutputBuffer;
+
+// Format obj the way print shows it - arrays are streamed element by element
+void writeObj(OutputBuffer* out, InterpreterObj obj);
+void writeChars(OutputBuffer* out, char* chars, int length);
+void writeNewline(OutputBuffer* out);
+void flushBuffer(OutputBuffer* out);
+
+// Everything a program prints goes through one of these, which is flushed
+// at exit & before a panic's message, as well as when it's full or, when
+// stdout's a terminal, at the end of every line.
+void outputObj(InterpreterObj obj);
+void outputChars(char* chars, int length);
+void outputNewline();
+void outputFlush();
+
+// Where output goes from now on (stdout by default) - flushes first &
+// returns the old target
+FILE* outputTarget(FILE* target);
+// Send everything the calling thread prints to out instead of the shared
+// buffer, until it's called again with NULL - each program embedded with
+// ocrpi_vm.h has its own. outputFlush flushes it.
+void outputRedirect(OutputBuffer* out);
\ No newline at end of file
@@ -4,16 +4,46 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "vector.h"
+#include "output.h"
 
-jmp_buf _panicJump;
-static int catchLevel = 0;
+_Thread_local jmp_buf _panicJump;
+static _Thread_local int catchLevel = 0;
 
-void _catchPanic()   { catchLevel++; }
-void _releasePanic() { catchLevel--; }
+// see panicReturnTo
+static _Thread_local jmp_buf* returnTarget = NULL;
+static _Thread_local char* returnMessage;
+static _Thread_local size_t returnSize;
+// whatever PANIC_TRYs were in progress when the program started are the
+// only ones left after it's stopped
+static _Thread_local int returnCatchLevel;
+
+void _catchPanic(jmp_buf outer) {
+    catchLevel++;
+    memcpy(outer, _panicJump, sizeof(jmp_buf));
+}
+
+void _releasePanic(jmp_buf outer) {
+    catchLevel--;
+    memcpy(_panicJump, outer, sizeof(jmp_buf));
+}
+
+void panicReturnTo(jmp_buf* target, char* message, size_t size) {
+    returnTarget = target;
+    returnMessage = message;
+    returnSize = size;
+    returnCatchLevel = catchLevel;
+}
+
+bool panicsReturn() {
+    return returnTarget != NULL;
+}
 
 void _panicFailure(uint16_t code) {
+    if (returnTarget != NULL) panic(code & _PANIC_CODE_MASK, "--- UNCAUGHT ---");
+    outputFlush();
     printf("\033[0;31m--- UNCAUGHT ---\033[0m\n");
     exit(code & _PANIC_CODE_MASK);
 }
@@ -22,6 +52,19 @@ void panic(uint16_t code, char* fmt, ...) {
 #ifndef OCRPI_DEBUG
     if (catchLevel > 0 && (code & _PANIC_CATCHABLE_FLAG)) longjmp(_panicJump, code);
 #endif
+    if (returnTarget != NULL) {
+        if (catchLevel > 0 && (code & _PANIC_CATCHABLE_FLAG)) longjmp(_panicJump, code);
+        if (returnSize > 0) {
+            va_list va;
+            va_start(va, fmt);
+            vsnprintf(returnMessage, returnSize, fmt, va);
+            va_end(va);
+        }
+        catchLevel = returnCatchLevel;
+        longjmp(*returnTarget, code & _PANIC_CODE_MASK);
+    }
+    // whatever the program printed first comes out first
+    outputFlush();
     printf("\033[0;31m");
     va_list va;
     va_start(va, fmt);
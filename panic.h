@@ -1,6 +1,8 @@
 #pragma once
 
 #include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -17,7 +19,10 @@ typedef enum {
     Panic_Parser = 2,
     Panic_Interpreter = 3,
     Panic_Stdlib = 4,
-    Panic_Test = 5
+    Panic_Test = 5,
+    Panic_Transpiler = 6,
+    Panic_IR = 7,
+    Panic_Extension = 8
 } PanicCode;
 
 // max width 7 bits
@@ -32,13 +37,16 @@ typedef enum {
 
 #define PANIC_CATCHABLE(panicCode, catchCode) _PANIC_CATCHABLE_FLAG | (catchCode << 8) | panicCode
 
-extern jmp_buf _panicJump;
+// every thread catches its own panics
+extern _Thread_local jmp_buf _panicJump;
 
-#define PANIC_TRY { _catchPanic(); uint16_t _panicRet = setjmp(_panicJump); printU16(_panicRet); if (!_panicRet) {
+// the enclosing PANIC_TRY's jump is put back whichever way this one finishes,
+// so a panic after it ends goes where it would have before it started
+#define PANIC_TRY { jmp_buf _panicOuter; _catchPanic(_panicOuter); uint16_t _panicRet = setjmp(_panicJump); printU16(_panicRet); if (!_panicRet) {
 
-#define PANIC_CATCH(code) } else if ((_panicRet & _PANIC_CATCHABLE_CODE_MASK) == (code << 8)) { _releasePanic();
+#define PANIC_CATCH(code) _releasePanic(_panicOuter); } else if ((_panicRet & _PANIC_CATCHABLE_CODE_MASK) == (code << 8)) { _releasePanic(_panicOuter);
 
-#define PANIC_END_TRY _panicRet = 0; } if (_panicRet) _panicFailure(_panicRet); }
+#define PANIC_END_TRY _panicRet = 0; } if (_panicRet) { _releasePanic(_panicOuter); _panicFailure(_panicRet); } }
 
 // just in case 
 #if defined(OCRPI_DEBUG) && OCRPI_PRINT_PANIC_CODES
@@ -54,8 +62,17 @@ static void printU16(uint16_t val) {
 #define printU16(val)
 #endif
 
-void _catchPanic();
-void _releasePanic();
+void _catchPanic(jmp_buf outer);
+void _releasePanic(jmp_buf outer);
 void _panicFailure(uint16_t code);
 
-void panic(uint16_t code, char* msg, ...);
\ No newline at end of file
+void panic(uint16_t code, char* msg, ...);
+
+// Instead of exiting, panics on the calling thread longjmp to target with
+// their code, once the message has been written to message (cut short to
+// fit size, which includes the NUL) - nothing's printed. NULL target goes
+// back to exiting. For running programs inside someone else's, see
+// ocrpi_vm.h.
+void panicReturnTo(jmp_buf* target, char* message, size_t size);
+// True while the calling thread's panics return
+bool panicsReturn();
\ No newline at end of file
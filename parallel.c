@@ -0,0 +1,885 @@
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "array.h"
+#include "panic.h"
+#include "runtime.h"
+
+bool parallelRunning = false;
+
+STATIC bool assigns(TokType type) {
+    switch (type) {
+        case Tok_Equal:
+        case Tok_PlusEqual:
+        case Tok_MinusEqual:
+        case Tok_StarEqual:
+        case Tok_SlashEqual:
+        case Tok_ExpEqual:
+            return true;
+        default:
+            return false;
+    }
+}
+
+STATIC bool namesMatch(Token a, Token b) {
+    return a.length == b.length && strncmp(a.start, b.start, a.length) == 0;
+}
+
+STATIC bool nameIn(TokList names, Token name) {
+    FOREACH(TokList, names, current) {
+        if (namesMatch(*current, name)) return true;
+    }
+    return false;
+}
+
+STATIC void addNameTo(TokList* names, Token name) {
+    if (!nameIn(*names, name)) APPEND(*names, name);
+}
+
+STATIC Expression* unwrap(Expression* expr) {
+    while (expr->tag == ExprTag_Grouping || expr->tag == ExprTag_Cached) {
+        expr = expr->tag == ExprTag_Grouping ? expr->grouping : expr->cached.expr;
+    }
+    return expr;
+}
+
+STATIC bool isIdentifier(Expression* expr) {
+    return expr->tag == ExprTag_Primary && expr->primary.type == Tok_Identifier;
+}
+
+//* ---------------- writes ----------------
+
+// Everything some code could write to, without running it
+typedef struct {
+    // names which get assigned or declared (including loop iterators)
+    TokList assigned;
+    // names whose elements get assigned - a[...] = x
+    TokList elements;
+    // something that's never allowed, eg. declaring a function
+    bool unsafe;
+} Writes;
+
+STATIC void writesInExpr(Expression* expr, Writes* writes);
+STATIC void writesInBlock(DeclList* block, Writes* writes);
+
+STATIC void writesInExpr(Expression* expr, Writes* writes) {
+    switch (expr->tag) {
+        case ExprTag_Unary: {
+            if (expr->unary.operator.type == Tok_New) writes->unsafe = true;
+            writesInExpr(expr->unary.operand, writes);
+            break;
+        }
+        case ExprTag_Binary: {
+            if (assigns(expr->binary.operator.type)) {
+                Expression* target = unwrap(expr->binary.a);
+                if (isIdentifier(target)) {
+                    addNameTo(&writes->assigned, target->primary);
+                } else if (target->tag == ExprTag_Call && target->call.tag == Call_Array && isIdentifier(unwrap(target->call.callee))) {
+                    addNameTo(&writes->elements, unwrap(target->call.callee)->primary);
+                } else {
+                    // a[i][j] = x, or something stranger
+                    writes->unsafe = true;
+                }
+            }
+            writesInExpr(expr->binary.a, writes);
+            writesInExpr(expr->binary.b, writes);
+            break;
+        }
+        case ExprTag_Call: {
+            writesInExpr(expr->call.callee, writes);
+            if (expr->call.tag != Call_GetMember) {
+                FOREACH(ExprList, expr->call.arguments, arg) writesInExpr(arg, writes);
+            }
+            break;
+        }
+        case ExprTag_Super: {
+            writes->unsafe = true;
+            break;
+        }
+        case ExprTag_Grouping: {
+            writesInExpr(expr->grouping, writes);
+            break;
+        }
+        case ExprTag_Primary: break;
+        case ExprTag_Cached: {
+            writesInExpr(expr->cached.expr, writes);
+            break;
+        }
+    }
+}
+
+STATIC void writesInConditionalBlock(ConditionalBlock* cb, Writes* writes) {
+    writesInExpr(&cb->condition, writes);
+    writesInBlock(cb->block, writes);
+}
+
+STATIC void writesInDecl(Declaration* decl, Writes* writes) {
+    if (decl->tag != DeclTag_Stmt) {
+        writes->unsafe = true;
+        return;
+    }
+    Statement* stmt = &decl->stmt;
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            writesInExpr(&stmt->expr, writes);
+            break;
+        }
+        case StmtTag_For: {
+            addNameTo(&writes->assigned, stmt->for_.iterator);
+            writesInExpr(&stmt->for_.min, writes);
+            writesInExpr(&stmt->for_.max, writes);
+            writesInBlock(stmt->for_.block, writes);
+            break;
+        }
+        case StmtTag_While: {
+            writesInConditionalBlock(&stmt->while_, writes);
+            break;
+        }
+        case StmtTag_Do: {
+            writesInConditionalBlock(&stmt->do_, writes);
+            break;
+        }
+        case StmtTag_If: {
+            writesInConditionalBlock(&stmt->if_.primary, writes);
+            FOREACH(ElseIfList, stmt->if_.secondary, branch) writesInConditionalBlock(branch, writes);
+            if (stmt->if_.hasElse) writesInConditionalBlock(&stmt->if_.else_, writes);
+            break;
+        }
+        case StmtTag_Array: {
+            addNameTo(&writes->assigned, stmt->array.name);
+            FOREACH(ArrayDimensions, stmt->array.dimensions, dim) writesInExpr(dim, writes);
+            break;
+        }
+        // global writes outside of the thread, & the interpreter doesn't
+        // run switches
+        default: {
+            writes->unsafe = true;
+            break;
+        }
+    }
+}
+
+STATIC void writesInBlock(DeclList* block, Writes* writes) {
+    FOREACH(DeclList, *block, decl) writesInDecl(decl, writes);
+}
+
+STATIC void initWrites(Writes* writes) {
+    INIT(writes->assigned);
+    INIT(writes->elements);
+    writes->unsafe = false;
+}
+
+STATIC void destroyWrites(Writes* writes) {
+    DESTROY(writes->assigned);
+    DESTROY(writes->elements);
+}
+
+//* ---------------- checking a loop ----------------
+
+DECL_VEC(InterpreterObj*, SharedSlotList)
+DECL_VEC(int, DimMaskList)
+DECL_VEC(char*, CheckedFuncList)
+
+// What's been found out about a loop (& everything it calls) so far
+typedef struct {
+    Token iterator;
+    // the slots of the arrays the body writes elements of, & for each a
+    // mask of the dimensions every access so far has indexed with the
+    // iterator
+    SharedSlotList shared;
+    DimMaskList dims;
+    // functions which have been (or are being) checked - by where their
+    // name is in the source
+    CheckedFuncList funcs;
+    bool safe;
+} LoopCheck;
+
+// Where a check is - the loop's body, or a function it calls
+typedef struct {
+    LoopCheck* loop;
+    // NULL in the loop's body
+    FunDecl* func;
+    // the body: every name it assigns or declares. a function: its
+    // parameters & locals
+    TokList privates;
+    // the body only - the privates which are certain to have a value by now
+    TokList* defined;
+} Walk;
+
+// What name means where the walk is, following references - NULL if it
+// doesn't exist
+STATIC InterpreterObj* resolveName(Walk* walk, Token name) {
+    char* text = tokText(name);
+    // a function's scope only has the globals above it
+    InterpreterObj* slot = walk->func == NULL ? findObj(text) : ObjNSFind(&globalScope->objects, text);
+    free(text);
+    while (slot != NULL && slot->tag == ObjType_Ref) slot = slot->reference;
+    return slot;
+}
+
+STATIC int sharedIndex(LoopCheck* loop, InterpreterObj* slot) {
+    for (int i = 0; i < loop->shared.len; i++) {
+        if (loop->shared.root[i] == slot) return i;
+    }
+    return -1;
+}
+
+STATIC bool isByRefParam(Walk* walk, Token name) {
+    if (walk->func == NULL) return false;
+    FOREACH(ParamList, walk->func->params, param) {
+        if (namesMatch(param->name, name)) return param->passMode == Param_byRef;
+    }
+    return false;
+}
+
+STATIC void verifyExpr(Walk* walk, Expression* expr);
+STATIC void verifyBlock(Walk* walk, DeclList* block);
+STATIC void verifyFunction(LoopCheck* loop, FunDecl* func);
+
+// name on its own - not indexed, called or assigned to
+STATIC void verifyRead(Walk* walk, Token name) {
+    if (walk->defined != NULL && nameIn(walk->privates, name)) {
+        // the last iteration's value is on another thread
+        if (!nameIn(*walk->defined, name)) walk->loop->safe = false;
+        return;
+    }
+    if (nameIn(walk->privates, name)) return;
+    // the whole of an array the loop writes to includes everyone else's
+    // elements
+    InterpreterObj* slot = resolveName(walk, name);
+    if (slot != NULL && sharedIndex(walk->loop, slot) != -1) walk->loop->safe = false;
+}
+
+STATIC void verifyAssigned(Walk* walk, Token name) {
+    if (isByRefParam(walk, name)) walk->loop->safe = false;
+    if (walk->defined != NULL) addNameTo(walk->defined, name);
+}
+
+// name[...] - write if it's being assigned to
+STATIC void verifyIndex(Walk* walk, CallExpr* access, Token name, bool write) {
+    if (nameIn(walk->privates, name)) {
+        if (write && isByRefParam(walk, name)) walk->loop->safe = false;
+        verifyRead(walk, name);
+        return;
+    }
+    InterpreterObj* slot = resolveName(walk, name);
+    int index = slot == NULL ? -1 : sharedIndex(walk->loop, slot);
+    if (index == -1) {
+        // only the body itself writes to arrays that aren't private
+        if (write) walk->loop->safe = false;
+        return;
+    }
+    if (walk->func != NULL) {
+        walk->loop->safe = false;
+        return;
+    }
+    int mask = 0;
+    for (int i = 0; i < access->arguments.len; i++) {
+        Expression* index = unwrap(&access->arguments.root[i]);
+        if (index->tag == ExprTag_Primary && namesMatch(index->primary, walk->loop->iterator)) mask |= 1 << i;
+    }
+    walk->loop->dims.root[index] &= mask;
+}
+
+STATIC void verifyCallee(Walk* walk, Token name) {
+    InterpreterObj* slot = nameIn(walk->privates, name) ? NULL : resolveName(walk, name);
+    if (slot == NULL) {
+        walk->loop->safe = false;
+        return;
+    }
+    switch (slot->tag) {
+        case ObjType_NativeFunc: {
+            if (!slot->nativeFunc->signature.threadSafe) walk->loop->safe = false;
+            break;
+        }
+        case ObjType_NativeProc: {
+            if (!slot->nativeProc->signature.threadSafe) walk->loop->safe = false;
+            break;
+        }
+        case ObjType_Func: {
+            verifyFunction(walk->loop, &slot->func);
+            break;
+        }
+        default: {
+            walk->loop->safe = false;
+            break;
+        }
+    }
+}
+
+STATIC void verifyExpr(Walk* walk, Expression* expr) {
+    if (!walk->loop->safe) return;
+    switch (expr->tag) {
+        case ExprTag_Unary: {
+            verifyExpr(walk, expr->unary.operand);
+            break;
+        }
+        case ExprTag_Binary: {
+            TokType operator = expr->binary.operator.type;
+            if (!assigns(operator)) {
+                verifyExpr(walk, expr->binary.a);
+                verifyExpr(walk, expr->binary.b);
+                break;
+            }
+            // a += b reads a first
+            if (operator != Tok_Equal) verifyExpr(walk, expr->binary.a);
+            verifyExpr(walk, expr->binary.b);
+            Expression* target = unwrap(expr->binary.a);
+            if (target->tag == ExprTag_Primary) {
+                verifyAssigned(walk, target->primary);
+            } else {
+                verifyIndex(walk, &target->call, unwrap(target->call.callee)->primary, true);
+                FOREACH(ExprList, target->call.arguments, arg) verifyExpr(walk, arg);
+            }
+            break;
+        }
+        case ExprTag_Call: {
+            CallExpr* call = &expr->call;
+            Expression* callee = unwrap(call->callee);
+            switch (call->tag) {
+                case Call_Call: {
+                    if (call->callee->tag == ExprTag_Call && call->callee->call.tag == Call_GetMember) {
+                        verifyExpr(walk, call->callee);
+                    } else if (isIdentifier(callee)) {
+                        verifyCallee(walk, callee->primary);
+                    } else {
+                        walk->loop->safe = false;
+                    }
+                    FOREACH(ExprList, call->arguments, arg) verifyExpr(walk, arg);
+                    break;
+                }
+                case Call_Array: {
+                    if (isIdentifier(callee)) verifyIndex(walk, call, callee->primary, false);
+                    else verifyExpr(walk, call->callee);
+                    FOREACH(ExprList, call->arguments, arg) verifyExpr(walk, arg);
+                    break;
+                }
+                case Call_GetMember: {
+                    if (!methodThreadSafe(call->memberName.start, call->memberName.length)) walk->loop->safe = false;
+                    verifyExpr(walk, call->callee);
+                    break;
+                }
+            }
+            break;
+        }
+        case ExprTag_Super: {
+            walk->loop->safe = false;
+            break;
+        }
+        case ExprTag_Grouping: {
+            verifyExpr(walk, expr->grouping);
+            break;
+        }
+        case ExprTag_Primary: {
+            if (expr->primary.type == Tok_Identifier) verifyRead(walk, expr->primary);
+            break;
+        }
+        case ExprTag_Cached: {
+            verifyExpr(walk, expr->cached.expr);
+            break;
+        }
+    }
+}
+
+// A copy of what's defined, for code which might not run (or might run
+// again) - nothing it defines counts afterwards
+STATIC TokList* branchDefined(TokList* defined) {
+    if (defined == NULL) return NULL;
+    TokList* out = malloc(sizeof(TokList));
+    INIT(*out);
+    APPEND_ALL(TokList, *out, *defined);
+    return out;
+}
+
+STATIC void freeDefined(TokList* defined) {
+    if (defined == NULL) return;
+    DESTROY(*defined);
+    free(defined);
+}
+
+// Check a loop's body on its own copy of what's defined
+STATIC void verifyLoopBlock(Walk* walk, Token* iterator, Expression* condition, DeclList* block) {
+    TokList* outer = walk->defined;
+    walk->defined = branchDefined(outer);
+    if (iterator != NULL && walk->defined != NULL) addNameTo(walk->defined, *iterator);
+    if (condition != NULL) verifyExpr(walk, condition);
+    verifyBlock(walk, block);
+    freeDefined(walk->defined);
+    walk->defined = outer;
+}
+
+STATIC void verifyIf(Walk* walk, IfStmt* if_) {
+    verifyExpr(walk, &if_->primary.condition);
+    TokList* outer = walk->defined;
+    // defined in every branch - which counts afterwards if there's an else,
+    // since then one of them has to run
+    TokList* common = NULL;
+    int branches = 1 + if_->secondary.len + if_->hasElse;
+    for (int i = 0; i < branches; i++) {
+        ConditionalBlock* branch =
+            i == 0 ? &if_->primary :
+            i <= if_->secondary.len ? &if_->secondary.root[i - 1] :
+            &if_->else_;
+        walk->defined = branchDefined(outer);
+        if (i > 0) verifyExpr(walk, &branch->condition);
+        verifyBlock(walk, branch->block);
+        if (walk->defined != NULL && if_->hasElse) {
+            if (common == NULL) {
+                common = walk->defined;
+                walk->defined = NULL;
+            } else {
+                int kept = 0;
+                for (int j = 0; j < common->len; j++) {
+                    if (nameIn(*walk->defined, common->root[j])) common->root[kept++] = common->root[j];
+                }
+                common->len = kept;
+            }
+        }
+        freeDefined(walk->defined);
+    }
+    walk->defined = outer;
+    if (common != NULL) {
+        FOREACH(TokList, *common, name) addNameTo(outer, *name);
+        freeDefined(common);
+    }
+}
+
+STATIC void verifyDecl(Walk* walk, Declaration* decl) {
+    // everything else has already been ruled out by writesInDecl
+    if (decl->tag != DeclTag_Stmt) return;
+    Statement* stmt = &decl->stmt;
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            verifyExpr(walk, &stmt->expr);
+            break;
+        }
+        case StmtTag_For: {
+            verifyExpr(walk, &stmt->for_.min);
+            verifyExpr(walk, &stmt->for_.max);
+            verifyLoopBlock(walk, &stmt->for_.iterator, NULL, stmt->for_.block);
+            break;
+        }
+        case StmtTag_While: {
+            verifyLoopBlock(walk, NULL, &stmt->while_.condition, stmt->while_.block);
+            break;
+        }
+        case StmtTag_Do: {
+            verifyLoopBlock(walk, NULL, &stmt->do_.condition, stmt->do_.block);
+            break;
+        }
+        case StmtTag_If: {
+            verifyIf(walk, &stmt->if_);
+            break;
+        }
+        case StmtTag_Array: {
+            FOREACH(ArrayDimensions, stmt->array.dimensions, dim) verifyExpr(walk, dim);
+            if (walk->defined != NULL) addNameTo(walk->defined, stmt->array.name);
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void verifyBlock(Walk* walk, DeclList* block) {
+    FOREACH(DeclList, *block, decl) {
+        if (!walk->loop->safe) return;
+        verifyDecl(walk, decl);
+    }
+}
+
+// A function the loop calls can read anything but the arrays the loop
+// writes to, & only write to its own locals & by-value parameters
+STATIC void verifyFunction(LoopCheck* loop, FunDecl* func) {
+    FOREACH(CheckedFuncList, loop->funcs, checked) {
+        if (*checked == func->name.start) return;
+    }
+    APPEND(loop->funcs, func->name.start);
+
+    Writes writes;
+    initWrites(&writes);
+    FOREACH(FuncDeclList, func->block, dor) {
+        if (dor->tag == DOR_decl) writesInDecl(dor->declaration, &writes);
+        else writesInExpr(&dor->return_, &writes);
+    }
+    if (writes.unsafe) loop->safe = false;
+
+    Walk walk = {.loop = loop, .func = func, .defined = NULL};
+    INIT(walk.privates);
+    FOREACH(ParamList, func->params, param) addNameTo(&walk.privates, param->name);
+    FOREACH(TokList, writes.assigned, name) {
+        // assigning a global writes to it instead of making a local
+        if (!nameIn(walk.privates, *name) && resolveName(&walk, *name) != NULL) loop->safe = false;
+        addNameTo(&walk.privates, *name);
+    }
+
+    FOREACH(FuncDeclList, func->block, dor) {
+        if (!loop->safe) break;
+        if (dor->tag == DOR_decl) verifyDecl(&walk, dor->declaration);
+        else verifyExpr(&walk, &dor->return_);
+    }
+
+    DESTROY(walk.privates);
+    destroyWrites(&writes);
+}
+
+// No calls & no assignments - so evaluating it up front is the same as
+// evaluating it before every iteration, as long as the body can't change it
+STATIC bool boundIsPure(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: return expr->unary.operator.type != Tok_New && boundIsPure(expr->unary.operand);
+        case ExprTag_Binary: return
+            !assigns(expr->binary.operator.type) &&
+            boundIsPure(expr->binary.a) &&
+            boundIsPure(expr->binary.b);
+        case ExprTag_Call: {
+            if (expr->call.tag != Call_Array || !boundIsPure(expr->call.callee)) return false;
+            FOREACH(ExprList, expr->call.arguments, arg) {
+                if (!boundIsPure(arg)) return false;
+            }
+            return true;
+        }
+        case ExprTag_Super: return false;
+        case ExprTag_Grouping: return boundIsPure(expr->grouping);
+        case ExprTag_Primary: return true;
+        case ExprTag_Cached: return boundIsPure(expr->cached.expr);
+    }
+    return false;
+}
+
+STATIC bool checkLoop(ForStmt* loop, LoopCheck* check) {
+    check->iterator = loop->iterator;
+    check->safe = boundIsPure(&loop->min) && boundIsPure(&loop->max);
+    INIT(check->shared);
+    INIT(check->dims);
+    INIT(check->funcs);
+
+    Writes writes;
+    initWrites(&writes);
+    writesInBlock(loop->block, &writes);
+    if (writes.unsafe || nameIn(writes.assigned, loop->iterator)) check->safe = false;
+
+    TokList defined;
+    INIT(defined);
+    Walk walk = {.loop = check, .func = NULL, .defined = &defined};
+    INIT(walk.privates);
+    APPEND_ALL(TokList, walk.privates, writes.assigned);
+    addNameTo(&walk.privates, loop->iterator);
+
+    // every thread needs its own - so they can't be anything yet
+    FOREACH(TokList, walk.privates, name) {
+        if (resolveName(&walk, *name) != NULL) check->safe = false;
+    }
+    FOREACH(TokList, writes.elements, name) {
+        if (nameIn(walk.privates, *name)) continue;
+        InterpreterObj* slot = resolveName(&walk, *name);
+        if (slot == NULL || slot->tag != ObjType_Array) {
+            check->safe = false;
+        } else if (sharedIndex(check, slot) == -1) {
+            APPEND(check->shared, slot);
+            APPEND(check->dims, -1);
+        }
+    }
+
+    // the range is evaluated before anything's defined
+    verifyExpr(&walk, &loop->min);
+    verifyExpr(&walk, &loop->max);
+    addNameTo(&defined, loop->iterator);
+    verifyBlock(&walk, loop->block);
+
+    FOREACH(DimMaskList, check->dims, mask) {
+        if (*mask == 0) check->safe = false;
+    }
+
+    DESTROY(defined);
+    DESTROY(walk.privates);
+    destroyWrites(&writes);
+    return check->safe;
+}
+
+STATIC void destroyCheck(LoopCheck* check) {
+    DESTROY(check->shared);
+    DESTROY(check->dims);
+    DESTROY(check->funcs);
+}
+
+//* ---------------- the pool ----------------
+
+// A thread's part of the range - its owner takes chunks off the front, &
+// anyone who's run out of their own steals the back half
+typedef struct {
+    pthread_mutex_t lock;
+    int next, end;
+} __attribute__((aligned(64))) Share;
+
+// everything below is shared with the pool's threads - hold lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+// signalled when there's a new loop, or it's time to stop
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+// signalled whenever a thread stops for stopOtherThreads, starts again, or
+// finishes its part of a loop
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+static pthread_t* threads = NULL;
+static int started = 0;
+static bool stopping = false;
+// pending[n] - thread n hasn't started on the current loop yet (the
+// thread running the program is 0)
+static bool* pending = NULL;
+// threads which haven't finished the current loop, & how many of those
+// haven't stopped for stopOtherThreads
+static int active = 0;
+static int running = 0;
+// also read without the lock, before every iteration
+static bool stopRequested = false;
+
+// the current loop - only written while there isn't one
+static ForStmt* currentLoop;
+static ParallelBody currentRun;
+static void* currentBody;
+static Scope* loopScope;
+static Scope* loopGlobals;
+static Share* shares;
+static int shareCount;
+// how many iterations a thread takes from its own share at once
+static int grain;
+
+// 0 until it's asked for
+static int threadCount = 0;
+static ParallelStats stats = {0};
+
+// The next chunk of the loop for thread index - false once there's nothing
+// left anywhere
+STATIC bool takeWork(int index, int* from, int* to) {
+    Share* own = &shares[index];
+    pthread_mutex_lock(&own->lock);
+    bool found = own->next < own->end;
+    if (found) {
+        *from = own->next;
+        *to = own->end - own->next > grain ? own->next + grain : own->end;
+        own->next = *to;
+    }
+    pthread_mutex_unlock(&own->lock);
+    if (found) return true;
+
+    for (int i = 1; i < shareCount; i++) {
+        Share* victim = &shares[(index + i) % shareCount];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->next;
+        int start = victim->end - left / 2;
+        int end = victim->end;
+        // the last one's as good as taken
+        if (left >= 2) victim->end = start;
+        pthread_mutex_unlock(&victim->lock);
+        if (left < 2) continue;
+
+        *from = start;
+        *to = end - start > grain ? start + grain : end;
+        pthread_mutex_lock(&own->lock);
+        own->next = *to;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        return true;
+    }
+    return false;
+}
+
+// Wait for whoever's called stopOtherThreads - with lock held
+STATIC void waitForRestart() {
+    running--;
+    pthread_cond_broadcast(&changed);
+    while (stopRequested) pthread_cond_wait(&changed, &lock);
+    running++;
+}
+
+// Run thread index's part of the current loop, & anything it can steal -
+// called with lock held, which it's holding again when it returns
+STATIC void runShare(int index) {
+    while (stopRequested) pthread_cond_wait(&changed, &lock);
+    running++;
+    pthread_mutex_unlock(&lock);
+
+    globalScope = loopGlobals;
+    Scope* scope = newScope();
+    scope->parent = loopScope;
+    currentScope = scope;
+    char* iterator = tokText(currentLoop->iterator);
+    ObjNSSet(&scope->objects, iterator, IOBJ(.tag = ObjType_Int, ._nameAllocated = true));
+
+    int from, to;
+    while (takeWork(index, &from, &to)) {
+        for (int i = from; i < to; i++) {
+            if (__atomic_load_n(&stopRequested, __ATOMIC_ACQUIRE)) {
+                pthread_mutex_lock(&lock);
+                waitForRestart();
+                pthread_mutex_unlock(&lock);
+            }
+            // declarations in the body can move the iterator - look it up again
+            *ObjNSFind(&scope->objects, iterator) = IOBJ(.tag = ObjType_Int, .int_ = i, ._nameAllocated = true);
+            currentRun(currentBody);
+        }
+    }
+    destroyScope(scope);
+
+    pthread_mutex_lock(&lock);
+    running--;
+    active--;
+    pthread_cond_broadcast(&changed);
+}
+
+STATIC void* poolThread(void* arg) {
+    int index = (int)(intptr_t)arg;
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (!pending[index] && !stopping) pthread_cond_wait(&wake, &lock);
+        if (stopping) break;
+        pending[index] = false;
+        runShare(index);
+    }
+    pthread_mutex_unlock(&lock);
+    freeCache();
+    return NULL;
+}
+
+// With lock held
+STATIC void startPool() {
+    if (threads != NULL) return;
+    int count = parallelThreads() - 1;
+    threads = malloc(count * sizeof(pthread_t));
+    pending = calloc(count + 1, sizeof(bool));
+    // however many it gets - with none, every loop runs on this thread
+    while (started < count && pthread_create(&threads[started], NULL, poolThread, (void*)(intptr_t)(started + 1)) == 0) started++;
+}
+
+void stopOtherThreads() {
+    pthread_mutex_lock(&lock);
+    // someone else got there first - wait for them like everyone else
+    while (stopRequested) waitForRestart();
+    __atomic_store_n(&stopRequested, true, __ATOMIC_RELEASE);
+    while (running > 1) pthread_cond_wait(&changed, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void restartOtherThreads() {
+    pthread_mutex_lock(&lock);
+    __atomic_store_n(&stopRequested, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+}
+
+//* ---------------- loops ----------------
+
+// false if it isn't an int
+STATIC bool evaluateBound(Expression expr, int* out) {
+    InterpreterObj obj = interpretExpr(expr);
+    InterpreterObj value = IOAbs(obj);
+    *out = value.int_;
+    freeObj(obj);
+    return value.tag == ObjType_Int;
+}
+
+bool parallelFor(ForStmt* loop, ParallelBody run, void* body) {
+    // every thread's busy with the loop this one's inside
+    if (parallelRunning) return false;
+    // a panic on one of the pool's threads would exit, taking whoever's
+    // embedding us with it
+    if (panicsReturn()) return false;
+
+    pthread_mutex_lock(&lock);
+    if (parallelThreads() > 1) startPool();
+    bool safe = started > 0;
+    pthread_mutex_unlock(&lock);
+    if (!safe) {
+        stats.sequential++;
+        return false;
+    }
+
+    LoopCheck check;
+    int min, max;
+    safe = checkLoop(loop, &check) && evaluateBound(loop->min, &min) && evaluateBound(loop->max, &max) && max - min >= 2;
+    if (!safe) {
+        destroyCheck(&check);
+        stats.sequential++;
+        return false;
+    }
+
+    proveIndices(*loop, IOBJ(.tag = ObjType_Int, .int_ = min), IOBJ(.tag = ObjType_Int, .int_ = max));
+    // copy on write has to happen now, before anyone else can see the array
+    FOREACH(SharedSlotList, check.shared, slot) arrayForWrite(&(*slot)->array)->parallelWrites = true;
+
+    pthread_mutex_lock(&lock);
+    currentLoop = loop;
+    currentRun = run;
+    currentBody = body;
+    loopScope = currentScope;
+    loopGlobals = globalScope;
+    shareCount = started + 1;
+    shares = aligned_alloc(_Alignof(Share), shareCount * sizeof(Share));
+    int count = max - min;
+    grain = count / (shareCount * 16);
+    if (grain < 1) grain = 1;
+    for (int i = 0; i < shareCount; i++) {
+        pthread_mutex_init(&shares[i].lock, NULL);
+        shares[i].next = min + (int)((long long)count * i / shareCount);
+        shares[i].end = min + (int)((long long)count * (i + 1) / shareCount);
+        pending[i] = i > 0;
+    }
+    active = shareCount;
+    running = 0;
+    parallelRunning = true;
+    pthread_cond_broadcast(&wake);
+
+    runShare(0);
+    while (active > 0) pthread_cond_wait(&changed, &lock);
+    parallelRunning = false;
+    pthread_mutex_unlock(&lock);
+
+    currentScope = loopScope;
+    for (int i = 0; i < shareCount; i++) pthread_mutex_destroy(&shares[i].lock);
+    free(shares);
+    FOREACH(SharedSlotList, check.shared, slot) (*slot)->array->parallelWrites = false;
+    forgetIndices(*loop);
+    destroyCheck(&check);
+    stats.parallel++;
+    return true;
+}
+
+int parallelThreads() {
+    if (threadCount == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cores < 1 ? 1 : cores > 64 ? 64 : cores;
+    }
+    return threadCount;
+}
+
+void setParallelThreads(int count) {
+    parallelShutdown();
+    threadCount = count < 0 ? 0 : count;
+}
+
+void parallelShutdown() {
+    pthread_mutex_lock(&lock);
+    if (threads == NULL) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    stopping = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    free(pending);
+    threads = NULL;
+    pending = NULL;
+    started = 0;
+    stopping = false;
+}
+
+ParallelStats parallelStats() {
+    return stats;
+}
\ No newline at end of file
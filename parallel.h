@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "parser.h"
+
+// `parallel for i = min to max` runs its iterations across a pool of
+// threads - every thread starts with an even share of [min, max) & steals
+// half of someone else's once it runs out. It's only allowed to if no
+// iteration could tell that the others ran at the same time, which is
+// checked when the loop starts (the names in the body mean whatever they
+// mean at that point):
+//
+//   - every variable the body assigns or declares (including its own
+//     loops' iterators) is new, so each thread can have its own - & each
+//     iteration assigns them before it reads them
+//   - the only other things it writes are elements of arrays, & every
+//     access to one of those arrays indexes the same dimension with i
+//   - it only calls natives & methods which are threadSafe, & functions
+//     which don't write anything but their own locals (& their callees
+//     follow the same rules)
+//
+// Anything else - or a range that isn't a pair of ints - runs like any
+// other for loop, & so does a parallel loop inside one that's already
+// running in parallel, or in a program embedded with ocrpi_vm.h.
+
+// Run one iteration of the body - the iterator's already been set
+typedef void (*ParallelBody)(void* body);
+
+// Run loop in parallel, in the current scope - false if it's not safe to,
+// in which case nothing's been run (or evaluated, other than min & max
+// which don't have any side effects if it gets that far).
+bool parallelFor(ForStmt* loop, ParallelBody run, void* body);
+
+// How many threads (counting the one running the program) parallel loops
+// are spread over - it starts out as the number of cores (& goes back to it
+// for 0). Changing it stops the pool, & 1 runs every parallel loop like a
+// normal one.
+void setParallelThreads(int count);
+int parallelThreads();
+// Stop the pool's threads, if it was ever started
+void parallelShutdown();
+
+// How many loops have run in parallel, & how many couldn't - for the tests
+typedef struct {
+    int parallel;
+    int sequential;
+} ParallelStats;
+
+ParallelStats parallelStats();
+
+// True while a parallel loop's running. Reference counts are only atomic
+// then, & the tiers & the JIT leave their counters alone.
+extern bool parallelRunning;
+
+static inline void retainCount(int* count) {
+    if (parallelRunning) __atomic_add_fetch(count, 1, __ATOMIC_RELAXED);
+    else (*count)++;
+}
+
+// returns what's left
+static inline int releaseCount(int* count) {
+    if (parallelRunning) return __atomic_sub_fetch(count, 1, __ATOMIC_ACQ_REL);
+    return --*count;
+}
+
+// The storage of an array the loop writes to can't move while other
+// threads are using it - arraySet calls these around changing it, which
+// waits for every other thread to get to the end of its current iteration.
+void stopOtherThreads();
+void restartOtherThreads();
\ No newline at end of file
@@ -5,12 +5,15 @@
 #include "backtrace.h"
 #include "panic.h"
 
-int current;
-Token* toks;
-jmp_buf syncJump;
-ParseError currentError;
+// per thread, like the lexer's
+static _Thread_local int current;
+static _Thread_local Token* toks;
+static _Thread_local jmp_buf syncJump;
+static _Thread_local ParseError currentError;
 
 STATIC void printError(char* msg) {
+    // whoever's embedding us gets the errors from the ParseOutput instead
+    if (panicsReturn()) return;
     Token errorTok = toks[current];
     char* text = tokText(errorTok);
     printf("Parse error at token #%i (line %i, column %i)\n'%s':\n\x1b[31m%s\x1b[0m\n", current + 1, errorTok.line, errorTok.col, text, msg);
@@ -94,10 +97,12 @@ STATIC Expression primary() {
 
 STATIC Expression grouping() {
     if (match(Tok_LParen)) {
-        return (Expression){
+        Expression out = (Expression){
             .tag = ExprTag_Grouping,
             .grouping = copyExpr(expression())
         };
+        consume(Tok_RParen, "Expected ')' after expression");
+        return out;
     }
     return primary();
 }
@@ -360,6 +365,10 @@ STATIC FunDecl function() {
     FunDecl out;
     INIT(out.params);
     INIT(out.block);
+    out.compiled = NULL;
+    out.jit = NULL;
+    out.tier = NULL;
+    out.emitted = NULL;
     consume(Tok_Function, "Expected 'function'");
     out.name = consume(Tok_Identifier, "Expected function name");
     params(&out.params);
@@ -410,7 +419,12 @@ STATIC ForStmt for_() {
     ForStmt out;
 
     DECL_LIST_INIT(out.block);
+    out.rangeInvariant = false;
+    INIT(out.indexCandidates);
+    INIT(out.calledNames);
+    out.tier = NULL;
 
+    out.parallel = match(Tok_Parallel);
     consume(Tok_For, "Expected 'for'");
     out.iterator = consume(Tok_Identifier, "Expected iterator name");
     consume(Tok_Equal, "Expected '='");
@@ -437,6 +451,7 @@ STATIC WhileStmt while_() {
     WhileStmt out;
 
     DECL_LIST_INIT(out.block);
+    out.tier = NULL;
 
     consume(Tok_While, "Expected 'while'");
     out.condition = expression();
@@ -449,6 +464,7 @@ STATIC DoStmt do_() {
     DoStmt out;
 
     DECL_LIST_INIT(out.block);
+    out.tier = NULL;
 
     consume(Tok_Do, "Expected 'do'");
     block(out.block, Tok_Until);
@@ -578,6 +594,7 @@ STATIC Statement statement() {
             out.tag = StmtTag_Global;
             out.global = global();
             return out;
+        case Tok_Parallel:
         case Tok_For:
             out.tag = StmtTag_For;
             out.for_ = for_();
@@ -638,16 +655,23 @@ ParseOutput parse(LexOutput lo) {
     ParseOutput out;
     INIT(out.ast);
     INIT(out.errors);
+    INIT(out.imports);
 
     Declaration newDecl;
     while (!isAtEnd()) {
         if (! setjmp(syncJump)) {
-            APPEND(out.ast, declaration());
+            // modules are loaded before anything runs, so they can only be
+            // imported at the top level
+            if (match(Tok_Import)) {
+                consume(Tok_StringLit, "Expected a module path after 'import'");
+                APPEND(out.imports, previous());
+            } else APPEND(out.ast, declaration());
         } else {
             APPEND(out.errors, currentError);
             while (!(
                 peek().type == Tok_Global ||
                 peek().type == Tok_For ||
+                peek().type == Tok_Parallel ||
                 peek().type == Tok_While ||
                 peek().type == Tok_Do ||
                 peek().type == Tok_If ||
@@ -656,6 +680,7 @@ ParseOutput parse(LexOutput lo) {
                 peek().type == Tok_Function ||
                 peek().type == Tok_Procedure ||
                 peek().type == Tok_Class ||
+                peek().type == Tok_Import ||
                 isAtEnd()
             )) {
                 advance();
@@ -718,6 +743,10 @@ STATIC void destroyExpression(Expression expr) {
         case ExprTag_Primary: {
             break;
         }
+        case ExprTag_Cached: {
+            DESTROY_FREE(expr.cached.expr);
+            break;
+        }
     }
 }
 
@@ -736,6 +765,8 @@ STATIC void destroyStatement(Statement stmt) {
             destroyExpression(stmt.for_.min);
             destroyExpression(stmt.for_.max);
             destroyBlock(*stmt.for_.block);
+            DESTROY(stmt.for_.indexCandidates);
+            DESTROY(stmt.for_.calledNames);
             break;
         }
         case StmtTag_While: {
@@ -825,4 +856,5 @@ void destroyParseOutput(ParseOutput po) {
     destroyBlock(po.ast);
     DESTROY(po.ast);
     DESTROY(po.errors);
+    DESTROY(po.imports);
 }
\ No newline at end of file
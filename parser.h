@@ -30,6 +30,10 @@ typedef struct {
 typedef struct {
     Token operator;
     Expression* a, * b;
+    // filled in by the checker (.ocrx only) - both sides are proven to be
+    // ints or floats, so there's no need to check their tags. ObjType_Nil if
+    // nothing's proven.
+    ObjType operandType;
 } BinaryExpr;
 
 typedef struct {
@@ -39,6 +43,13 @@ typedef struct {
         ExprList arguments;
         Token memberName;
     };
+    // Call_Array - bit n set if index n has already been proven to be
+    // in-bounds by the enclosing for loop (see optimiser.c)
+    int uncheckedDims;
+    // Call_Call - the checker (.ocrx only) has proven the callee is a
+    // function which takes this many arguments, or a native whose
+    // signature the arguments match
+    bool arityProven;
 } CallExpr;
 
 typedef struct {
@@ -48,6 +59,13 @@ typedef struct {
 typedef Expression* GroupingExpr;
 typedef Token PrimaryExpr;
 
+// Added by the optimiser - a sub-expression which appears more than once in
+// the same statement. Every copy shares a slot, so it's only evaluated once.
+typedef struct {
+    Expression* expr;
+    int slot;
+} CachedExpr;
+
 struct Expression {
     ExprTag tag;
     union {
@@ -57,6 +75,7 @@ struct Expression {
         SuperExpr super;
         GroupingExpr grouping;
         PrimaryExpr primary;
+        CachedExpr cached;
     };
 };
 
@@ -67,16 +86,45 @@ typedef struct {
     Expression initializer;
 } GlobalStmt;
 
+// An array access inside a for loop which indexes dimension `dimension` with
+// `iterator + offset` - if the loop's range fits inside the array, the loop
+// can check it once up front instead of on every iteration.
+typedef struct {
+    CallExpr* access;
+    int dimension;
+    int offset;
+} IndexCandidate;
+
+DECL_VEC(IndexCandidate, IndexCandidateList)
+
+// see tier.h
+typedef struct TierFunction TierFunction;
+typedef struct TierLoop TierLoop;
+
 typedef struct {
     Token iterator;
     Expression min;
     Expression max;
     DeclList* block;
+    // `parallel for` - run across threads if it turns out to be safe (see
+    // parallel.h), otherwise just like any other for loop
+    bool parallel;
+    // filled in by the optimiser:
+    //   rangeInvariant - nothing in the block changes the iterator, the
+    //                    bound or the indexed arrays (as long as everything
+    //                    in calledNames turns out to be native)
+    bool rangeInvariant;
+    IndexCandidateList indexCandidates;
+    TokList calledNames;
+    // filled in by tierPrepare
+    TierLoop* tier;
 } ForStmt;
 
 typedef struct {
     Expression condition;
     DeclList* block;
+    // while & do loops - filled in by tierPrepare
+    TierLoop* tier;
 } ConditionalBlock;
 
 typedef ConditionalBlock WhileStmt;
@@ -143,10 +191,23 @@ typedef struct {
 
 DECL_VEC(DeclOrReturn, FuncDeclList)
 
+// see closure.h
+typedef struct Closure Closure;
+// see jit.h
+typedef struct JitFunction JitFunction;
+
 typedef struct {
     Token name;
     ParamList params;
     FuncDeclList block;
+    // filled in by the closure compiler
+    Closure* compiled;
+    // filled in by jitPrepare
+    JitFunction* jit;
+    // filled in by tierPrepare
+    TierFunction* tier;
+    // only in programs compiled with --emit-c - see transpiler.c
+    struct InterpreterObj (*emitted)(struct InterpreterObj* args);
 } FunDecl;
 
 typedef struct {
@@ -179,6 +240,8 @@ DECL_VEC_NO_TYPEDEF(Declaration, DeclList)
 typedef struct {
     DeclList ast;
     ParseErrList errors;
+    // the string literals of every top-level import "module.so"
+    TokList imports;
 } ParseOutput;
 
 ParseOutput parse(LexOutput lo);
@@ -0,0 +1,272 @@
+#include "reduce.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "panic.h"
+#include "runtime.h"
+#include "array.h"
+
+// Every kernel's built twice & the right one's picked from CPUID at load
+// time. They're written with 8-wide vectors either way, so the float sums
+// add up in the same order (& come out the same) on every CPU.
+#if defined(__x86_64__)
+#define REDUCE_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define REDUCE_CLONES
+#endif
+
+typedef int32_t Ints __attribute__((vector_size(32)));
+typedef int64_t Longs __attribute__((vector_size(64)));
+typedef float Floats __attribute__((vector_size(32)));
+typedef double Doubles __attribute__((vector_size(64)));
+
+#define LANES 8
+
+//* ---------------- kernels ----------------
+
+REDUCE_CLONES
+STATIC int64_t sumInts(int* ints, int length) {
+    Longs lanes = {0};
+    int i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        Ints block;
+        memcpy(&block, ints + i, sizeof(block));
+        lanes += __builtin_convertvector(block, Longs);
+    }
+    int64_t out = 0;
+    for (int lane = 0; lane < LANES; lane++) out += lanes[lane];
+    for (; i < length; i++) out += ints[i];
+    return out;
+}
+
+REDUCE_CLONES
+STATIC double sumFloats(float* floats, int length) {
+    Doubles lanes = {0};
+    int i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        Floats block;
+        memcpy(&block, floats + i, sizeof(block));
+        lanes += __builtin_convertvector(block, Doubles);
+    }
+    double out = 0;
+    for (int lane = 0; lane < LANES; lane++) out += lanes[lane];
+    for (; i < length; i++) out += floats[i];
+    return out;
+}
+
+REDUCE_CLONES
+STATIC int64_t dotInts(int* a, int* b, int length) {
+    Longs lanes = {0};
+    int i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        Ints blockA, blockB;
+        memcpy(&blockA, a + i, sizeof(blockA));
+        memcpy(&blockB, b + i, sizeof(blockB));
+        lanes += __builtin_convertvector(blockA, Longs) * __builtin_convertvector(blockB, Longs);
+    }
+    int64_t out = 0;
+    for (int lane = 0; lane < LANES; lane++) out += lanes[lane];
+    for (; i < length; i++) out += (int64_t)a[i] * b[i];
+    return out;
+}
+
+REDUCE_CLONES
+STATIC double dotFloats(float* a, float* b, int length) {
+    Doubles lanes = {0};
+    int i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        Floats blockA, blockB;
+        memcpy(&blockA, a + i, sizeof(blockA));
+        memcpy(&blockB, b + i, sizeof(blockB));
+        lanes += __builtin_convertvector(blockA, Doubles) * __builtin_convertvector(blockB, Doubles);
+    }
+    double out = 0;
+    for (int lane = 0; lane < LANES; lane++) out += lanes[lane];
+    for (; i < length; i++) out += (double)a[i] * b[i];
+    return out;
+}
+
+// Comparisons give -1 in the lanes where they're true, so the blends are
+// bitwise
+REDUCE_CLONES
+STATIC void rangeOfInts(int* ints, int length, int* min, int* max) {
+    Ints low = {0}, high = {0};
+    low += ints[0];
+    high += ints[0];
+    int i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        Ints block;
+        memcpy(&block, ints + i, sizeof(block));
+        Ints lower = block < low, higher = block > high;
+        low = (block & lower) | (low & ~lower);
+        high = (block & higher) | (high & ~higher);
+    }
+    *min = low[0];
+    *max = high[0];
+    for (int lane = 1; lane < LANES; lane++) {
+        if (low[lane] < *min) *min = low[lane];
+        if (high[lane] > *max) *max = high[lane];
+    }
+    for (; i < length; i++) {
+        if (ints[i] < *min) *min = ints[i];
+        if (ints[i] > *max) *max = ints[i];
+    }
+}
+
+REDUCE_CLONES
+STATIC void rangeOfFloats(float* floats, int length, float* min, float* max) {
+    Floats low = {0}, high = {0};
+    low += floats[0];
+    high += floats[0];
+    int i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        Floats block;
+        memcpy(&block, floats + i, sizeof(block));
+        Ints lower = block < low, higher = block > high;
+        low = (Floats)(((Ints)block & lower) | ((Ints)low & ~lower));
+        high = (Floats)(((Ints)block & higher) | ((Ints)high & ~higher));
+    }
+    *min = low[0];
+    *max = high[0];
+    for (int lane = 1; lane < LANES; lane++) {
+        if (low[lane] < *min) *min = low[lane];
+        if (high[lane] > *max) *max = high[lane];
+    }
+    for (; i < length; i++) {
+        if (floats[i] < *min) *min = floats[i];
+        if (floats[i] > *max) *max = floats[i];
+    }
+}
+
+//* ---------------- anything else ----------------
+
+// A number from an array that isn't all ints or all floats
+STATIC double numberAt(ArrayObj* array, int i, bool* isFloat, char* operation) {
+    InterpreterObj elem = IOAbs(arrayGet(array, i));
+    switch (elem.tag) {
+        case ObjType_Int: return elem.int_;
+        case ObjType_Float: {
+            *isFloat = true;
+            return elem.float_;
+        }
+        default: panic(Panic_Stdlib, "Can't %s an array with a %s in it!", operation, ObjTypeToString(elem.tag));
+    }
+}
+
+// The result's an int if every element was
+STATIC InterpreterObj asNumber(double value, bool isFloat) {
+    if (isFloat) return IOBJ(.tag = ObjType_Float, .float_ = value);
+    return IOBJ(.tag = ObjType_Int, .int_ = (int)(int64_t)value);
+}
+
+//* ---------------- builtins ----------------
+
+InterpreterObj arraySum(ArrayObj* array) {
+    switch (array->storage) {
+        case ArrayStorage_Int: return IOBJ(.tag = ObjType_Int, .int_ = (int)sumInts(array->ints, array->length));
+        case ArrayStorage_Float: return IOBJ(.tag = ObjType_Float, .float_ = sumFloats(array->floats, array->length));
+        default: {
+            bool isFloat = false;
+            int64_t ints = 0;
+            double floats = 0;
+            for (int i = 0; i < array->length; i++) {
+                bool wasFloat = false;
+                double value = numberAt(array, i, &wasFloat, "sum");
+                if (wasFloat) floats += value;
+                else ints += (int64_t)value;
+                isFloat = isFloat || wasFloat;
+            }
+            if (isFloat) return IOBJ(.tag = ObjType_Float, .float_ = floats + ints);
+            return IOBJ(.tag = ObjType_Int, .int_ = (int)ints);
+        }
+    }
+}
+
+float arrayMean(ArrayObj* array) {
+    switch (array->storage) {
+        case ArrayStorage_Int: return (double)sumInts(array->ints, array->length) / array->length;
+        case ArrayStorage_Float: return sumFloats(array->floats, array->length) / array->length;
+        default: {
+            bool isFloat = false;
+            double total = 0;
+            for (int i = 0; i < array->length; i++) total += numberAt(array, i, &isFloat, "take the mean of");
+            return total / array->length;
+        }
+    }
+}
+
+// Either end of the array, in less() order
+STATIC InterpreterObj extreme(ArrayObj* array, bool highest) {
+    switch (array->storage) {
+        case ArrayStorage_Int: {
+            int min, max;
+            rangeOfInts(array->ints, array->length, &min, &max);
+            return IOBJ(.tag = ObjType_Int, .int_ = highest ? max : min);
+        }
+        case ArrayStorage_Float: {
+            float min, max;
+            rangeOfFloats(array->floats, array->length, &min, &max);
+            return IOBJ(.tag = ObjType_Float, .float_ = highest ? max : min);
+        }
+        default: {
+            InterpreterObj out = IOAbs(arrayGet(array, 0));
+            for (int i = 1; i < array->length; i++) {
+                InterpreterObj elem = IOAbs(arrayGet(array, i));
+                if (highest ? less(out, elem) : less(elem, out)) out = elem;
+            }
+            return copyObj(out);
+        }
+    }
+}
+
+InterpreterObj arrayMin(ArrayObj* array) {
+    return extreme(array, false);
+}
+
+InterpreterObj arrayMax(ArrayObj* array) {
+    return extreme(array, true);
+}
+
+InterpreterObj arrayDot(ArrayObj* a, ArrayObj* b) {
+    if (a->length != b->length) panic(Panic_Stdlib, "Can't take the dot product of arrays with %i & %i elements!", a->length, b->length);
+    if (a->storage == ArrayStorage_Int && b->storage == ArrayStorage_Int)
+        return IOBJ(.tag = ObjType_Int, .int_ = (int)dotInts(a->ints, b->ints, a->length));
+    if (a->storage == ArrayStorage_Float && b->storage == ArrayStorage_Float)
+        return IOBJ(.tag = ObjType_Float, .float_ = dotFloats(a->floats, b->floats, a->length));
+
+    bool isFloat = false;
+    double total = 0;
+    for (int i = 0; i < a->length; i++) {
+        total += numberAt(a, i, &isFloat, "take the dot product of") * numberAt(b, i, &isFloat, "take the dot product of");
+    }
+    return asNumber(total, isFloat);
+}
+
+ArrayObj* filledArray(ArrayObj* array, InterpreterObj value) {
+    ArrayObj* out = newArray(array->rank, array->dims);
+    // the first store picks the storage
+    arraySet(out, 0, copyObj(value));
+    switch (out->storage) {
+        case ArrayStorage_Nil: break;
+        case ArrayStorage_Int: {
+            for (int i = 1; i < out->length; i++) out->ints[i] = value.int_;
+            break;
+        }
+        case ArrayStorage_Float: {
+            for (int i = 1; i < out->length; i++) out->floats[i] = value.float_;
+            break;
+        }
+        case ArrayStorage_Bool: {
+            memset(out->bits, value.bool_ ? 0xff : 0, (out->length + 7) / 8);
+            break;
+        }
+        case ArrayStorage_Boxed: {
+            for (int i = 1; i < out->length; i++) arraySet(out, i, copyObj(value));
+            break;
+        }
+    }
+    return out;
+}
\ No newline at end of file
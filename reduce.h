@@ -0,0 +1,23 @@
+#pragma once
+
+#include "interpreter.h"
+
+// sum, min, max, mean, dot & fill over arrays (of any shape - they're taken
+// as one flat run of elements). Int & float arrays go through vector loops,
+// built for AVX2 & for plain x86-64 & picked between when the program starts
+// (so both give the same answers); anything else is a loop which checks
+// every element's tag.
+//
+// Sums & dot products are exact for ints (wrapping round at the end, like
+// any other int that's too big) & are added up as doubles for floats.
+
+// An int if every element's an int, otherwise a float
+InterpreterObj arraySum(ArrayObj* array);
+float arrayMean(ArrayObj* array);
+// In less() order, so strings work too
+InterpreterObj arrayMin(ArrayObj* array);
+InterpreterObj arrayMax(ArrayObj* array);
+// The arrays have to be the same length
+InterpreterObj arrayDot(ArrayObj* a, ArrayObj* b);
+// A new array the same shape as array, with value everywhere
+ArrayObj* filledArray(ArrayObj* array, InterpreterObj value);
\ No newline at end of file
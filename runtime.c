@@ -0,0 +1,824 @@
+#include "runtime.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "panic.h"
+#include "ocrpi_stdlib.h"
+#include "array.h"
+#include "stringObj.h"
+#include "file.h"
+#include "collections.h"
+#include "stringSearch.h"
+#include "parallel.h"
+
+_Thread_local Scope* currentScope = NULL;
+_Thread_local Scope* globalScope = NULL;
+
+//* if it's a temporary, get rid!!
+//* this doesn't free references so you're ok to call it on var names etc
+//* but if you've called IOAbs on an object then make sure you're ok to free it!!
+void freeObj(InterpreterObj obj) {
+    switch (obj.tag) {
+        case ObjType_String: {
+            if (obj.string.owner != NULL) releaseBuffer(obj.string.owner);
+            break;
+        }
+        case ObjType_Array: {
+            releaseArray(obj.array);
+            break;
+        }
+        case ObjType_File: {
+            releaseFile(obj.file);
+            break;
+        }
+        case ObjType_Dictionary: {
+            releaseDictionary(obj.dictionary);
+            break;
+        }
+        case ObjType_Stack: {
+            releaseStack(obj.stack);
+            break;
+        }
+        case ObjType_Queue: {
+            releaseQueue(obj.queue);
+            break;
+        }
+    }
+}
+
+InterpreterObj copyObj(InterpreterObj obj) {
+    switch (obj.tag) {
+        case ObjType_String: {
+            // strings can't change, so they can share
+            if (obj.string.owner != NULL) retainBuffer(obj.string.owner);
+            return obj;
+        }
+        case ObjType_Array: {
+            // copy-on-write!
+            retainArray(obj.array);
+            return obj;
+        }
+        case ObjType_File: {
+            retainFile(obj.file);
+            return obj;
+        }
+        // shared, not copied on write
+        case ObjType_Dictionary: {
+            retainDictionary(obj.dictionary);
+            return obj;
+        }
+        case ObjType_Stack: {
+            retainStack(obj.stack);
+            return obj;
+        }
+        case ObjType_Queue: {
+            retainQueue(obj.queue);
+            return obj;
+        }
+        case ObjType_Func:
+        case ObjType_Proc:
+        case ObjType_NativeFunc:
+        case ObjType_NativeProc:
+        case ObjType_Nil:
+        case ObjType_Bool:
+        case ObjType_Int:
+        case ObjType_Float:
+        {
+            return obj;
+        }
+        default: panic(Panic_Interpreter, "Unable to copy object of type %s!", ObjTypeToString(obj.tag));
+    }
+}
+
+Scope* newScope() {
+    Scope* out = malloc(sizeof(Scope));
+    out->objects = NewObjNS();
+    return out;
+}
+
+void destroyScope(Scope* scope) {
+    FOREACH(ObjNS, scope->objects, object) {
+        if (object->value._nameAllocated) {
+            free(object->key);
+        }
+        freeObj(object->value);
+    }
+    DESTROY(scope->objects);
+    free(scope);
+}
+
+void pushScope() {
+    Scope* oldScope = currentScope;
+    currentScope = newScope();
+    currentScope->parent = oldScope;
+    if (oldScope == NULL) globalScope = currentScope;
+}
+
+void popScope() {
+    if (currentScope == NULL) panic(Panic_Interpreter, "Can't exit the root scope!");
+    Scope* parentScope = currentScope->parent;
+    destroyScope(currentScope);
+    currentScope = parentScope;
+}
+
+InterpreterObj* findObj(char* name) {
+    Scope* searchScope = currentScope;
+    InterpreterObj* obj = NULL;
+    while (searchScope != NULL) {
+        obj = ObjNSFind(&searchScope->objects, name);
+        if (obj != NULL) break;
+        searchScope = searchScope->parent;
+    }
+    return obj;
+}
+
+InterpreterObj* setVar(char* name, InterpreterObj value, bool nameAllocated) {
+    value._nameAllocated = nameAllocated;
+    InterpreterObj* obj = findObj(name);
+    if (obj != NULL) {
+        // the slot keeps its own key - a native's (function max(a, b)) is
+        // static, so it mustn't be marked for freeing, & this one's not needed
+        value._nameAllocated = obj->_nameAllocated;
+        if (nameAllocated) free(name);
+        *obj = value;
+        return obj;
+    }
+    // todo: searches, we already know it won't find anthing
+    else return ObjNSSet(&currentScope->objects, name, value);
+}
+
+bool equal(InterpreterObj a, InterpreterObj b) {
+    MAKE_ABS(a)
+    MAKE_ABS(b)
+
+    if (a.tag != b.tag) return false;
+    switch (a.tag) {
+        case ObjType_Class:
+        case ObjType_Func:
+        case ObjType_Proc:
+        case ObjType_NativeFunc:
+        case ObjType_NativeProc:
+        case ObjType_Instance: panic(Panic_Interpreter, "Can't check %s for equality yet!", ObjTypeToString(a.tag));
+
+        case ObjType_Nil: return true;
+        case ObjType_Bool: return a.bool_ == b.bool_;
+        case ObjType_Int: return a.int_ == b.int_;
+        case ObjType_String: {
+            if (a.string.length != b.string.length) return false;
+            return sameChars(a.string.start, b.string.start, a.string.length);
+        }
+        case ObjType_Float: return a.float_ == b.float_;
+        // the same one, not the same contents
+        case ObjType_File: return a.file == b.file;
+        case ObjType_Dictionary: return a.dictionary == b.dictionary;
+        case ObjType_Stack: return a.stack == b.stack;
+        case ObjType_Queue: return a.queue == b.queue;
+        case ObjType_Array: {
+            if (a.array == b.array) return true;
+            if (a.array->rank != b.array->rank) return false;
+            for (int i = 0; i < a.array->rank; i++) {
+                if (a.array->dims[i] != b.array->dims[i]) return false;
+            }
+            for (int i = 0; i < a.array->length; i++) {
+                if (!equal(arrayGet(a.array, i), arrayGet(b.array, i))) return false;
+            }
+            return true;
+        }
+    }
+}
+
+#define NUMERIC_OP(name, op) InterpreterObj name(InterpreterObj a, InterpreterObj b) { \
+    MAKE_ABS(a); \
+    MAKE_ABS(b); \
+    if (a.tag == ObjType_Float) { \
+        float aNum = a.float_; \
+        if (b.tag == ObjType_Float) { \
+            float bNum = b.float_; \
+            return (InterpreterObj){.tag = ObjType_Float, .float_ = op}; \
+        } else if (b.tag == ObjType_Int) { \
+            int bNum = b.int_; \
+            return (InterpreterObj){.tag = ObjType_Float, .float_ = op}; \
+        } \
+    } else if (a.tag == ObjType_Int) { \
+        float aNum = a.int_; \
+        if (b.tag == ObjType_Float) { \
+            float bNum = b.float_; \
+            return (InterpreterObj){.tag = ObjType_Int, .int_ = op}; \
+        } else if (b.tag == ObjType_Int) { \
+            int bNum = b.int_; \
+            return (InterpreterObj){.tag = ObjType_Int, .int_ = op}; \
+        } \
+    } \
+    panic(Panic_Interpreter, "Invalid operator between %s and %s", ObjTypeToString(a.tag), ObjTypeToString(b.tag)); \
+}
+
+NUMERIC_OP(iExponent, pow(aNum, bNum))
+NUMERIC_OP(multiply, aNum * bNum)
+NUMERIC_OP(divide, aNum / bNum)
+NUMERIC_OP(subtract, aNum - bNum)
+NUMERIC_OP(_addNum, aNum + bNum)
+
+InterpreterObj add(InterpreterObj a, InterpreterObj b) {
+    MAKE_ABS(a);
+    MAKE_ABS(b);
+
+    if (a.tag == ObjType_String && b.tag == ObjType_String) {
+        StringObj out = newString(a.string.length + b.string.length);
+        memcpy(out.start, a.string.start, a.string.length);
+        memcpy(out.start + a.string.length, b.string.start, b.string.length);
+        return (InterpreterObj){
+            .tag = ObjType_String,
+            .string = out
+        };
+    } else if (a.tag == ObjType_Array && b.tag == ObjType_Array) {
+        return (InterpreterObj){
+            .tag = ObjType_Array,
+            .array = concatArrays(a.array, b.array)
+        };
+    }
+    return _addNum(a, b);
+}
+
+bool less(InterpreterObj a, InterpreterObj b) {
+    MAKE_ABS(a);
+    MAKE_ABS(b);
+
+    if (a.tag == ObjType_Float) {
+        if (b.tag == ObjType_Float) return a.float_ < b.float_;
+        else if (b.tag == ObjType_Int) return a.float_ < b.int_;
+    } else if (a.tag == ObjType_Int) {
+        if (b.tag == ObjType_Float) return a.int_ < b.float_;
+        else if (b.tag == ObjType_Int) return a.int_ < b.int_;
+    } else if (a.tag == ObjType_String && b.tag == ObjType_String) {
+        // byte by byte, & a prefix comes first
+        int shorter = a.string.length < b.string.length ? a.string.length : b.string.length;
+        int order = memcmp(a.string.start, b.string.start, shorter);
+        return order != 0 ? order < 0 : a.string.length < b.string.length;
+    }
+    panic(Panic_Interpreter, "Invalid operator between %s and %s", ObjTypeToString(a.tag), ObjTypeToString(b.tag));
+}
+
+bool greaterEqual(InterpreterObj a, InterpreterObj b) {
+    return !less(a, b);
+}
+
+bool lessEqual(InterpreterObj a, InterpreterObj b) {
+    return less(a, b) || equal(a, b);
+}
+
+bool greater(InterpreterObj a, InterpreterObj b) {
+    return !lessEqual(a, b);
+}
+
+InterpreterObj typedBinary(TokType operator, ObjType operandType, InterpreterObj a, InterpreterObj b) {
+    MAKE_ABS(a);
+    MAKE_ABS(b);
+    bool ints = operandType == ObjType_Int;
+    float aNum = ints ? a.int_ : a.float_;
+    float bNum = ints ? b.int_ : b.float_;
+    bool isLess = ints ? a.int_ < b.int_ : a.float_ < b.float_;
+    bool isEqual = ints ? a.int_ == b.int_ : a.float_ == b.float_;
+
+#define NUMOBJ(val) (ints ? IOBJ(.tag = ObjType_Int, .int_ = (val)) : IOBJ(.tag = ObjType_Float, .float_ = (val)))
+#define BOOLOBJ(val) IOBJ(.tag = ObjType_Bool, .bool_ = (val))
+    switch (operator) {
+        case Tok_Plus: return NUMOBJ(aNum + bNum);
+        case Tok_Minus: return NUMOBJ(aNum - bNum);
+        case Tok_Star: return NUMOBJ(aNum * bNum);
+        case Tok_Slash: return NUMOBJ(aNum / bNum);
+        case Tok_EqualEqual: return BOOLOBJ(isEqual);
+        case Tok_BangEqual: return BOOLOBJ(!isEqual);
+        case Tok_Less: return BOOLOBJ(isLess);
+        case Tok_LessEqual: return BOOLOBJ(isLess || isEqual);
+        case Tok_Greater: return BOOLOBJ(!(isLess || isEqual));
+        case Tok_GreaterEqual: return BOOLOBJ(!isLess);
+        default: panic(Panic_Interpreter, "Can't use a typed operator here!");
+    }
+#undef NUMOBJ
+#undef BOOLOBJ
+}
+
+bool isTruthy(InterpreterObj obj) {
+    MAKE_ABS(obj);
+    switch (obj.tag) {
+        case ObjType_Class:
+        case ObjType_Func:
+        case ObjType_Proc:
+        case ObjType_NativeFunc:
+        case ObjType_NativeProc:
+        case ObjType_Instance: panic(Panic_Interpreter, "Can't (yet) use a %s as a boolean!", ObjTypeToString(obj.tag));
+
+        case ObjType_Nil: return false;
+        case ObjType_Bool: return obj.bool_;
+        case ObjType_Int: return obj.int_ > 0;
+        case ObjType_String: return obj.string.length > 0;
+        case ObjType_Float: return obj.float_ > 0;
+        case ObjType_Array: return obj.array->length > 0;
+        case ObjType_File: return true;
+        case ObjType_Dictionary: return obj.dictionary->count > 0;
+        case ObjType_Stack: return obj.stack->items.len > 0;
+        case ObjType_Queue: return obj.queue->count > 0;
+    }
+}
+
+DECL_VEC(IndexCandidateList, ProvenLoopList)
+
+// The loops whose checks are off right now, innermost last - see
+// forgetAllIndices
+static _Thread_local ProvenLoopList provenLoops;
+
+// The optimiser's found every a[i + n] in the loop which only depends on
+// the loop's range - if that range fits inside a we can drop the checks
+// for the whole loop.
+void proveIndices(ForStmt loop, InterpreterObj min, InterpreterObj max) {
+    if (!loop.rangeInvariant || loop.indexCandidates.len == 0 || parallelRunning) return;
+
+    // calling anything other than a native could change what we're relying on
+    // - & so could a native that calls back into the program
+    FOREACH(TokList, loop.calledNames, name) {
+        char* text = tokText(*name);
+        InterpreterObj* callee = findObj(text);
+        free(text);
+        if (callee == NULL) return;
+        InterpreterObj calleeObj = IOAbs(*callee);
+        if (calleeObj.tag == ObjType_NativeFunc) {
+            if (callsBack(calleeObj.nativeFunc->signature)) return;
+        } else if (calleeObj.tag == ObjType_NativeProc) {
+            if (callsBack(calleeObj.nativeProc->signature)) return;
+        } else return;
+    }
+
+    MAKE_ABS(min);
+    MAKE_ABS(max);
+    if (min.tag != ObjType_Int || max.tag != ObjType_Int || max.int_ <= min.int_) return;
+
+    bool proven = false;
+    FOREACH(IndexCandidateList, loop.indexCandidates, candidate) {
+        char* text = tokText(candidate->access->callee->primary);
+        InterpreterObj* arrayObj = findObj(text);
+        free(text);
+        // a byRef parameter - whatever it points at can be replaced under
+        // another name
+        if (arrayObj == NULL || arrayObj->tag == ObjType_Ref) continue;
+        InterpreterObj array = *arrayObj;
+        if (array.tag != ObjType_Array || array.array->rank != candidate->access->arguments.len) continue;
+
+        long long lowest = (long long)min.int_ + candidate->offset;
+        long long highest = (long long)max.int_ - 1 + candidate->offset;
+        // int arithmetic goes through floats (see NUMERIC_OP), so past 2^24
+        // i + n isn't necessarily exact
+        if (highest >= (1 << 24)) continue;
+        if (lowest >= 0 && highest < array.array->dims[candidate->dimension]) {
+            candidate->access->uncheckedDims |= 1 << candidate->dimension;
+            proven = true;
+        }
+    }
+    if (proven) {
+        if (provenLoops.root == NULL) INIT(provenLoops);
+        APPEND(provenLoops, loop.indexCandidates);
+    }
+}
+
+STATIC void checkIndicesAgain(IndexCandidateList candidates) {
+    FOREACH(IndexCandidateList, candidates, candidate) {
+        candidate->access->uncheckedDims &= ~(1 << candidate->dimension);
+    }
+}
+
+void forgetIndices(ForStmt loop) {
+    if (parallelRunning) return;
+    // every loop inside it (even in functions it called) has already been
+    // forgotten, so if it was proven it's on top
+    if (provenLoops.len > 0 && provenLoops.root[provenLoops.len - 1].root == loop.indexCandidates.root) provenLoops.len--;
+    checkIndicesAgain(loop.indexCandidates);
+}
+
+void forgetAllIndices() {
+    while (provenLoops.len > 0) checkIndicesAgain(provenLoops.root[--provenLoops.len]);
+}
+
+typedef struct {
+    unsigned long long generation;
+    InterpreterObj value;
+} CacheSlot;
+
+static _Thread_local CacheSlot* cacheSlots = NULL;
+static _Thread_local int cacheSlotCap = 0;
+static _Thread_local unsigned long long cacheGeneration = 1;
+
+void newCacheGeneration() {
+    cacheGeneration++;
+}
+
+bool cacheGet(int slot, InterpreterObj* out) {
+    if (slot >= cacheSlotCap || cacheSlots[slot].generation != cacheGeneration) return false;
+    *out = cacheSlots[slot].value;
+    return true;
+}
+
+void cacheSet(int slot, InterpreterObj value) {
+    // anything else is a temporary the caller will free - it can't be shared
+    switch (value.tag) {
+        case ObjType_Nil:
+        case ObjType_Bool:
+        case ObjType_Int:
+        case ObjType_Float:
+        case ObjType_Ref: break;
+        default: return;
+    }
+
+    if (slot >= cacheSlotCap) {
+        int newCap = cacheSlotCap == 0 ? 16 : cacheSlotCap;
+        while (newCap <= slot) newCap *= 2;
+        cacheSlots = realloc(cacheSlots, newCap * sizeof(CacheSlot));
+        memset(cacheSlots + cacheSlotCap, 0, (newCap - cacheSlotCap) * sizeof(CacheSlot));
+        cacheSlotCap = newCap;
+    }
+    cacheSlots[slot] = (CacheSlot){
+        .generation = cacheGeneration,
+        .value = value
+    };
+}
+
+void freeCache() {
+    free(cacheSlots);
+    cacheSlots = NULL;
+    cacheSlotCap = 0;
+}
+
+STATIC STLFuncDef stl_funcs[] = {
+    {"typeof", stl_typeof, {1, ObjType_String, {0}, true}},
+    {"bool", stl_bool, {1, ObjType_Bool, {0}, true}},
+    {"string", stl_string, {1, ObjType_String, {0}, true}},
+    {"float", stl_float, {1, ObjType_Float, {ACCEPTS(String) | ACCEPTS(Int) | ACCEPTS(Float) | ACCEPTS(Nil)}, true}},
+    {"int", stl_int, {1, ObjType_Int, {ACCEPTS(String) | ACCEPTS(Int) | ACCEPTS(Float) | ACCEPTS(Nil)}, true}},
+    {"random", stl_random, {0, ObjType_Float, {0}, true}},
+    {"ASC", stl_ASC, {1, ObjType_Int, {ACCEPTS(String)}, true}},
+    {"CHR", stl_CHR, {1, ObjType_String, {ACCEPTS(Int)}, true}},
+    {"sort", stl_sort, {1, ObjType_Array, {ACCEPTS(Array)}, true}},
+    {"sortBy", stl_sortBy, {2, ObjType_Array, {ACCEPTS(Array), ACCEPTS(Func) | ACCEPTS(NativeFunc)}}},
+    {"binarySearch", stl_binarySearch, {2, ObjType_Int, {ACCEPTS(Array)}, true}},
+    {"sum", stl_sum, {1, ObjType_Ref, {ACCEPTS(Array)}, true}},
+    {"min", stl_min, {1, ObjType_Ref, {ACCEPTS(Array)}, true}},
+    {"max", stl_max, {1, ObjType_Ref, {ACCEPTS(Array)}, true}},
+    {"mean", stl_mean, {1, ObjType_Float, {ACCEPTS(Array)}, true}},
+    {"dot", stl_dot, {2, ObjType_Ref, {ACCEPTS(Array), ACCEPTS(Array)}, true}},
+    {"fill", stl_fill, {2, ObjType_Array, {ACCEPTS(Array)}, true}},
+    {"newDictionary", stl_newDictionary, {0, ObjType_Dictionary, {0}, true}},
+    {"newStack", stl_newStack, {0, ObjType_Stack, {0}, true}},
+    {"newQueue", stl_newQueue, {0, ObjType_Queue, {0}, true}},
+    {"openRead", stl_openRead, {1, ObjType_File, {ACCEPTS(String)}}},
+    {"openWrite", stl_openWrite, {1, ObjType_File, {ACCEPTS(String)}}},
+    {"input", stl_input, {-1, ObjType_String}},
+    {"endOfInput", stl_endOfInput, {0, ObjType_Bool}},
+    {"inputLines", stl_inputLines, {0, ObjType_Array}},
+    {"", NULL}
+};
+
+STATIC STLProcDef stl_procs[] = {
+    {"print", stl_print, {-1, ObjType_Nil}},
+    {"", NULL}
+};
+
+#define COLLECTIONS (ACCEPTS(Dictionary) | ACCEPTS(Stack) | ACCEPTS(Queue))
+
+// The first parameter's the receiver - a method belongs to whatever types it accepts
+STATIC STLFuncDef stl_methods[] = {
+    {"length", stl_length, {1, ObjType_Int, {ACCEPTS(String) | COLLECTIONS}, true}},
+    {"isEmpty", stl_isEmpty, {1, ObjType_Bool, {ACCEPTS(String) | COLLECTIONS}, true}},
+    {"substring", stl_substring, {3, ObjType_String, {ACCEPTS(String), ACCEPTS(Int), ACCEPTS(Int)}, true}},
+    {"left", stl_left, {2, ObjType_String, {ACCEPTS(String), ACCEPTS(Int)}, true}},
+    {"right", stl_right, {2, ObjType_String, {ACCEPTS(String), ACCEPTS(Int)}, true}},
+    {"upper", stl_upper, {1, ObjType_String, {ACCEPTS(String)}, true}},
+    {"lower", stl_lower, {1, ObjType_String, {ACCEPTS(String)}, true}},
+    {"find", stl_find, {2, ObjType_Int, {ACCEPTS(String), ACCEPTS(String)}, true}},
+    {"contains", stl_contains, {2, ObjType_Bool, {ACCEPTS(String), ACCEPTS(String)}, true}},
+    {"count", stl_count, {2, ObjType_Int, {ACCEPTS(String), ACCEPTS(String)}, true}},
+    {"split", stl_split, {2, ObjType_Array, {ACCEPTS(String), ACCEPTS(String)}, true}},
+    {"set", stl_set, {3, ObjType_Nil, {ACCEPTS(Dictionary)}}},
+    {"get", stl_get, {2, ObjType_Ref, {ACCEPTS(Dictionary)}, true}},
+    {"has", stl_has, {2, ObjType_Bool, {ACCEPTS(Dictionary)}, true}},
+    {"remove", stl_remove, {2, ObjType_Nil, {ACCEPTS(Dictionary)}}},
+    {"keys", stl_keys, {1, ObjType_Array, {ACCEPTS(Dictionary)}, true}},
+    {"push", stl_push, {2, ObjType_Nil, {ACCEPTS(Stack)}}},
+    {"pop", stl_pop, {1, ObjType_Ref, {ACCEPTS(Stack)}}},
+    {"peek", stl_peek, {1, ObjType_Ref, {ACCEPTS(Stack)}, true}},
+    {"enqueue", stl_enqueue, {2, ObjType_Nil, {ACCEPTS(Queue)}}},
+    {"dequeue", stl_dequeue, {1, ObjType_Ref, {ACCEPTS(Queue)}}},
+    {"front", stl_front, {1, ObjType_Ref, {ACCEPTS(Queue)}, true}},
+    {"readLine", stl_readLine, {1, ObjType_String, {ACCEPTS(File)}}},
+    {"endOfFile", stl_endOfFile, {1, ObjType_Bool, {ACCEPTS(File)}}},
+    {"writeLine", stl_writeLine, {2, ObjType_Nil, {ACCEPTS(File)}}},
+    {"close", stl_close, {1, ObjType_Nil, {ACCEPTS(File)}}},
+    {"", NULL}
+};
+
+// The standard library & every extension module's natives
+typedef struct {
+    STLFuncDef* funcs;
+    STLProcDef* procs;
+} NativeTable;
+
+DECL_VEC(NativeTable, NativeTableList)
+
+static NativeTableList nativeTables;
+
+#define FOREACH_NATIVE(defs, def) for (typeof(defs) def = (defs); def != NULL && def->name[0] != '\0'; def++)
+
+STATIC bool findSignature(char* name, STLSignature* out) {
+    FOREACH(NativeTableList, nativeTables, table) {
+        FOREACH_NATIVE(table->funcs, func) {
+            if (strcmp(func->name, name) == 0) {
+                if (out != NULL) *out = func->signature;
+                return true;
+            }
+        }
+        FOREACH_NATIVE(table->procs, proc) {
+            if (strcmp(proc->name, name) == 0) {
+                if (out != NULL) *out = proc->signature;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+STATIC void checkSignature(char* name, STLSignature signature) {
+    if (signature.arity > STL_MAX_PARAMS) panic(Panic_Stdlib, "Native %s takes %i arguments - the most it can take is %i!", name, signature.arity, STL_MAX_PARAMS);
+    if (findSignature(name, NULL)) panic(Panic_Stdlib, "There's already a native called %s!", name);
+}
+
+STATIC void addNativeTable(STLFuncDef* funcs, STLProcDef* procs) {
+    FOREACH_NATIVE(funcs, func) checkSignature(func->name, func->signature);
+    FOREACH_NATIVE(procs, proc) checkSignature(proc->name, proc->signature);
+    APPEND(nativeTables, ((NativeTable){funcs, procs}));
+}
+
+STATIC void addStandardNatives() {
+    INIT(nativeTables);
+    addNativeTable(stl_funcs, stl_procs);
+}
+
+// several threads can be setting up VMs at once
+static pthread_once_t nativeTablesOnce = PTHREAD_ONCE_INIT;
+
+STATIC void initNativeTables() {
+    pthread_once(&nativeTablesOnce, addStandardNatives);
+}
+
+void addNatives(STLFuncDef* funcs, STLProcDef* procs) {
+    initNativeTables();
+    addNativeTable(funcs, procs);
+}
+
+bool stlSignature(char* name, STLSignature* out) {
+    initNativeTables();
+    return findSignature(name, out);
+}
+
+bool callsBack(STLSignature signature) {
+    for (int i = 0; i < signature.arity && i < STL_MAX_PARAMS; i++) {
+        if (signature.params[i] & (ACCEPTS(Func) | ACCEPTS(Proc))) return true;
+    }
+    return false;
+}
+
+void setupSTL() {
+    initNativeTables();
+    FOREACH(NativeTableList, nativeTables, table) {
+        FOREACH_NATIVE(table->funcs, func) {
+            setVar(func->name, (InterpreterObj){
+                .tag = ObjType_NativeFunc,
+                .nativeFunc = func
+            }, false);
+        }
+        FOREACH_NATIVE(table->procs, proc) {
+            setVar(proc->name, (InterpreterObj){
+                .tag = ObjType_NativeProc,
+                .nativeProc = proc
+            }, false);
+        }
+    }
+}
+
+STATIC void checkNativeArgs(char* name, STLSignature signature, InterpreterObj* values, int argc) {
+    if (signature.arity == -1) return;
+    if (argc != signature.arity) panic(Panic_Stdlib, "Called %s with %i args instead of %i!", name, argc, signature.arity);
+    for (int i = 0; i < argc; i++) {
+        int accepts = signature.params[i];
+        if (accepts != 0 && !(accepts & (1 << values[i].tag)))
+            panic(Panic_Stdlib, "Can't pass %s to %s! (argument %i)", ObjTypeToString(values[i].tag), name, i + 1);
+    }
+}
+
+InterpreterObj callNative(InterpreterObj native, InterpreterObj* args, int argc, bool proven) {
+    // the values are borrowed - they're just args with the references
+    // followed, so there's nothing to copy or free
+    InterpreterObj stackValues[NATIVE_STACK_ARGS];
+    InterpreterObj* values = argc <= NATIVE_STACK_ARGS ? stackValues : malloc(argc * sizeof(InterpreterObj));
+    for (int i = 0; i < argc; i++) values[i] = IOAbs(args[i]);
+
+    InterpreterObj out = IOBJ(.tag = ObjType_Nil);
+    if (native.tag == ObjType_NativeFunc) {
+        if (!proven) checkNativeArgs(native.nativeFunc->name, native.nativeFunc->signature, values, argc);
+        out = native.nativeFunc->func(values, argc);
+    } else {
+        if (!proven) checkNativeArgs(native.nativeProc->name, native.nativeProc->signature, values, argc);
+        native.nativeProc->proc(values, argc);
+    }
+
+    // references don't need freeing - only temporaries
+    for (int i = 0; i < argc; i++) freeObj(args[i]);
+    if (values != stackValues) free(values);
+    return out;
+}
+
+STATIC STLFuncDef* findMethod(ObjType type, char* name, int length) {
+    STLFuncDef* methods = stl_methods;
+    FOREACH_NATIVE(methods, method) {
+        if (!(method->signature.params[0] & (1 << type))) continue;
+        if (strncmp(method->name, name, length) == 0 && method->name[length] == '\0') return method;
+    }
+    return NULL;
+}
+
+bool methodThreadSafe(char* name, int length) {
+    bool found = false;
+    STLFuncDef* methods = stl_methods;
+    FOREACH_NATIVE(methods, method) {
+        if (strncmp(method->name, name, length) != 0 || method->name[length] != '\0') continue;
+        if (!method->signature.threadSafe) return false;
+        found = true;
+    }
+    return found;
+}
+
+InterpreterObj callMethod(char* name, int length, InterpreterObj* args, int argc) {
+    InterpreterObj receiver = IOAbs(args[0]);
+    STLFuncDef* method = findMethod(receiver.tag, name, length);
+    if (method == NULL) panic(Panic_Interpreter, "A %s doesn't have a method called %.*s!", ObjTypeToString(receiver.tag), length, name);
+    return callNative(IOBJ(.tag = ObjType_NativeFunc, .nativeFunc = method), args, argc, false);
+}
+
+//* ---------------- compiled programs ----------------
+
+InterpreterObj loadVar(char* name) {
+    InterpreterObj* obj = findObj(name);
+    if (obj == NULL) panic(PANIC_CATCHABLE(Panic_Interpreter, PCC_InterpreterUnknownVar), "Unknown variable!");
+    return IOBJ(.tag = ObjType_Ref, .reference = obj);
+}
+
+InterpreterObj storedValue(InterpreterObj value) {
+    if (value.tag == ObjType_Ref && isShared(IOAbs(value).tag)) return copyObj(IOAbs(value));
+    return IOAbs(value);
+}
+
+// see assign in interpreter.c
+void assignVar(char* name, InterpreterObj value) {
+    value = storedValue(value);
+    InterpreterObj* obj = findObj(name);
+    if (obj != NULL) {
+        freeObj(*obj);
+        *obj = value;
+    } else {
+        setVar(strdup(name), value, true);
+    }
+}
+
+void assignRef(InterpreterObj target, InterpreterObj value) {
+    value = storedValue(value);
+    if (target.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't assign - not an lvalue!");
+    freeObj(*target.reference);
+    *target.reference = value;
+}
+
+STATIC int elementOffsetOf(ArrayObj* array, InterpreterObj* indices, int count) {
+    if (count > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Too many array indices! (%i)", count);
+    int evaluated[ARRAY_MAX_RANK];
+    for (int i = 0; i < count; i++) {
+        InterpreterObj index = IOAbs(indices[i]);
+        if (index.tag != ObjType_Int) panic(Panic_Interpreter, "Array indices must be ints, not %s!", ObjTypeToString(index.tag));
+        evaluated[i] = index.int_;
+    }
+    return arrayOffset(array, evaluated, count, 0);
+}
+
+InterpreterObj loadElement(InterpreterObj array, InterpreterObj* indices, int count) {
+    MAKE_ABS(array);
+    if (array.tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(array.tag));
+    return arrayGet(array.array, elementOffsetOf(array.array, indices, count));
+}
+
+STATIC ArrayObj* writableSlot(InterpreterObj* slot) {
+    while (slot->tag == ObjType_Ref) slot = slot->reference;
+    if (slot->tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(slot->tag));
+    return arrayForWrite(&slot->array);
+}
+
+// see arrayForWriteFromExpr in interpreter.c
+ArrayObj* writableArray(InterpreterObj array) {
+    // a temporary - nobody else can see it
+    if (array.tag != ObjType_Ref) {
+        if (array.tag != ObjType_Array) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(array.tag));
+        return array.array;
+    }
+    return writableSlot(array.reference);
+}
+
+ArrayObj* writableElementArray(ArrayObj* outer, InterpreterObj* indices, int count) {
+    InterpreterObj elem = arrayGet(outer, elementOffsetOf(outer, indices, count));
+    // arrays can only live in boxed storage
+    if (elem.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't index a %s!", ObjTypeToString(elem.tag));
+    return writableSlot(elem.reference);
+}
+
+void storeElement(ArrayObj* array, InterpreterObj* indices, int count, InterpreterObj value) {
+    arraySet(array, elementOffsetOf(array, indices, count), value);
+}
+
+void declareArray(char* name, InterpreterObj* dims, int count) {
+    if (count > ARRAY_MAX_RANK) panic(Panic_Interpreter, "Arrays can have at most %i dimensions!", ARRAY_MAX_RANK);
+    int evaluated[ARRAY_MAX_RANK];
+    for (int i = 0; i < count; i++) {
+        InterpreterObj dim = IOAbs(dims[i]);
+        if (dim.tag != ObjType_Int) panic(Panic_Interpreter, "Array dimensions must be ints, not %s!", ObjTypeToString(dim.tag));
+        evaluated[i] = dim.int_;
+    }
+    // redeclaring - get rid of the old one
+    InterpreterObj* existing = findObj(name);
+    if (existing != NULL) freeObj(*existing);
+    setVar(strdup(name), IOBJ(
+        .tag = ObjType_Array,
+        .array = newArray(count, evaluated)
+    ), true);
+}
+
+void checkCall(InterpreterObj callee, int argc) {
+    MAKE_ABS(callee);
+    switch (callee.tag) {
+        case ObjType_Func: {
+            if (argc != callee.func.params.len)
+                panic(Panic_Interpreter, "Called function %s with %i args instead of %i", tokText(callee.func.name), argc, callee.func.params.len);
+            break;
+        }
+        case ObjType_Proc:
+        case ObjType_NativeFunc:
+        case ObjType_NativeProc: break;
+        default: panic(Panic_Interpreter, "Can't call this object!");
+    }
+}
+
+InterpreterObj callObj(InterpreterObj callee, InterpreterObj* args, int argc) {
+    MAKE_ABS(callee);
+    switch (callee.tag) {
+        case ObjType_Func: {
+            if (callee.func.emitted != NULL) return callee.func.emitted(args);
+            // a native calling back into a program that's being interpreted
+            return interpretCall(callee.func, NULL, args);
+        }
+        case ObjType_NativeFunc:
+        case ObjType_NativeProc: return callNative(callee, args, argc, false);
+        default: return IOBJ(.tag = ObjType_Nil);
+    }
+}
+
+Scope* enterFunction(FunDecl func, InterpreterObj* args) {
+    Scope* executionScope = newScope();
+    // no closures for you!!
+    executionScope->parent = globalScope;
+
+    for (int i = 0; i < func.params.len; i++) {
+        InterpreterObj arg = args[i];
+        if (func.params.root[i].passMode == Param_byRef) {
+            if (arg.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't pass a temporary by reference!");
+        } else {
+            InterpreterObj value = copyObj(IOAbs(arg));
+            freeObj(arg);
+            arg = value;
+        }
+        arg._nameAllocated = true;
+        ObjNSSet(&executionScope->objects, tokText(func.params.root[i].name), arg);
+    }
+
+    Scope* callerScope = currentScope;
+    currentScope = executionScope;
+    return callerScope;
+}
+
+InterpreterObj leaveFunction(Scope* callerScope, InterpreterObj returned) {
+    // returning a local - it needs to outlive the scope!
+    if (returned.tag == ObjType_Ref) returned = copyObj(IOAbs(returned));
+    destroyScope(currentScope);
+    currentScope = callerScope;
+    return returned;
+}
+
+bool condition(InterpreterObj value) {
+    bool out = isTruthy(value);
+    freeObj(value);
+    return out;
+}
\ No newline at end of file
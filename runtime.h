@@ -0,0 +1,195 @@
+#pragma once
+
+#include "interpreter.h"
+
+// Everything the execution engines share - scopes, variables & the
+// operations on values. The engines only differ in how they walk the
+// program; what a + b or print(x) means lives here.
+
+DECL_MAP(InterpreterObj, ObjNS);
+
+typedef struct Scope Scope;
+
+#define IOBJ(...) (InterpreterObj){__VA_ARGS__}
+
+struct Scope {
+    ObjNS objects;
+    Scope* parent;
+};
+
+// Every thread has its own - a parallel loop's threads start off in the
+// scope the loop's in (see parallel.h)
+extern _Thread_local Scope* currentScope;
+extern _Thread_local Scope* globalScope;
+
+Scope* newScope();
+void destroyScope(Scope* scope);
+void pushScope();
+void popScope();
+
+InterpreterObj* findObj(char* name);
+// Takes name - if the variable already exists it keeps its own, & name is
+// freed if nameAllocated
+InterpreterObj* setVar(char* name, InterpreterObj value, bool nameAllocated);
+
+static inline InterpreterObj IOAbs(InterpreterObj obj) {
+    while (obj.tag == ObjType_Ref) obj = *obj.reference;
+    return obj;
+}
+
+#define MAKE_ABS(obj) obj = IOAbs(obj);
+
+// Values which are reference counted - a copy's another reference to the
+// same thing, which has to be taken before the original can be stored
+// anywhere else
+static inline bool isShared(ObjType type) {
+    return type == ObjType_String || type == ObjType_Array || type == ObjType_File ||
+        type == ObjType_Dictionary || type == ObjType_Stack || type == ObjType_Queue;
+}
+
+bool equal(InterpreterObj a, InterpreterObj b);
+bool less(InterpreterObj a, InterpreterObj b);
+bool lessEqual(InterpreterObj a, InterpreterObj b);
+bool greater(InterpreterObj a, InterpreterObj b);
+bool greaterEqual(InterpreterObj a, InterpreterObj b);
+
+InterpreterObj add(InterpreterObj a, InterpreterObj b);
+InterpreterObj subtract(InterpreterObj a, InterpreterObj b);
+InterpreterObj multiply(InterpreterObj a, InterpreterObj b);
+InterpreterObj divide(InterpreterObj a, InterpreterObj b);
+InterpreterObj iExponent(InterpreterObj a, InterpreterObj b);
+
+// Both operands have been proven to be operandType (ints or floats) by the
+// checker - the same maths as the operations above, without checking any
+// tags
+InterpreterObj typedBinary(TokType operator, ObjType operandType, InterpreterObj a, InterpreterObj b);
+
+// Values of ExprTag_Cached sub-expressions (see optimiser.c). A slot's only
+// valid for the statement it was filled in - starting a new statement bumps
+// the generation, which throws away everything at once.
+void newCacheGeneration();
+// false if the slot hasn't been filled in this generation
+bool cacheGet(int slot, InterpreterObj* out);
+// only keeps values which aren't temporaries - anything else is ignored
+void cacheSet(int slot, InterpreterObj value);
+// Every thread has its own slots - free the calling thread's
+void freeCache();
+
+// Drop the bounds checks the optimiser's found for the loop, if its range
+// [min, max) fits inside the arrays - forgetIndices puts them back. Loops
+// inside a parallel loop keep their checks, since the threads share them.
+void proveIndices(ForStmt loop, InterpreterObj min, InterpreterObj max);
+void forgetIndices(ForStmt loop);
+// Put back the checks of every loop on this thread that's still proven - for
+// when a panic's jumped out of the middle of them (see ocrpi_vm.c), & the
+// program's AST is going to be run again
+void forgetAllIndices();
+
+// Declare the natives in the current scope - the standard library's, &
+// everything that's been added since
+void setupSTL();
+// Add more natives, checking their signatures - either can be NULL, & each
+// ends with an entry whose name is ""
+void addNatives(STLFuncDef* funcs, STLProcDef* procs);
+
+// False if there's no native called name
+bool stlSignature(char* name, STLSignature* out);
+// Whether a native takes a function - it might call it, so anything that
+// relies on it not running OCR code has to treat it like a function call
+bool callsBack(STLSignature signature);
+
+// Natives with at most this many arguments get them on the C stack
+#define NATIVE_STACK_ARGS 8
+
+// Call a native (ObjType_NativeFunc or ObjType_NativeProc) with arguments
+// which have already been evaluated, & free them afterwards - the native
+// only sees their values. proven skips checking them against its signature.
+InterpreterObj callNative(InterpreterObj native, InterpreterObj* args, int argc, bool proven);
+
+// False if there's no method called name, or one of the methods called name
+// (for any type) isn't threadSafe
+bool methodThreadSafe(char* name, int length);
+
+// receiver.name(...) - methods are natives for the built-in types (a file's
+// readLine), which take the receiver as args[0]. A method that only takes
+// the receiver can be called without brackets (receiver.name). Like
+// callNative, the arguments are freed afterwards.
+InterpreterObj callMethod(char* name, int length, InterpreterObj* args, int argc);
+
+//* ---------------- compiled programs ----------------
+
+// What programs from --emit-c (see transpiler.c) are made of - each one does
+// exactly what the interpreter does for the same bit of the AST, so the
+// compiled program behaves like interpret() would.
+
+// Panics if it doesn't exist
+InterpreterObj loadVar(char* name);
+// a = value, creating a if it doesn't exist yet
+void assignVar(char* name, InterpreterObj value);
+// assignment to anything else which evaluates to a reference
+void assignRef(InterpreterObj target, InterpreterObj value);
+// What an assignment stores - never a reference, & b = a means both names
+// share the string or array (until one of them writes to the array)
+InterpreterObj storedValue(InterpreterObj value);
+
+InterpreterObj loadElement(InterpreterObj array, InterpreterObj* indices, int count);
+// The array to write to for an assignment to array[...] - array is the
+// result of evaluating the thing being indexed
+ArrayObj* writableArray(InterpreterObj array);
+// Same, for an element of outer which is itself an array (a[i][j] = x)
+ArrayObj* writableElementArray(ArrayObj* outer, InterpreterObj* indices, int count);
+void storeElement(ArrayObj* array, InterpreterObj* indices, int count, InterpreterObj value);
+void declareArray(char* name, InterpreterObj* dims, int count);
+
+// Panics if callee can't be called with argc arguments - before any of them
+// are evaluated
+void checkCall(InterpreterObj callee, int argc);
+// Consumes args - OCR functions run on the interpreter, unless they were
+// compiled by --emit-c
+InterpreterObj callObj(InterpreterObj callee, InterpreterObj* args, int argc);
+// Set up the scope for a call to func - returns the caller's scope, which
+// leaveFunction puts back. Takes ownership of args.
+Scope* enterFunction(FunDecl func, InterpreterObj* args);
+InterpreterObj leaveFunction(Scope* callerScope, InterpreterObj returned);
+
+bool condition(InterpreterObj value);
+
+// What the engines which can't run unary expressions yet panic with
+#define UNARY_UNSUPPORTED "Unary expressions aren't supported yet!"
+
+// Arithmetic & comparisons with a fast path for two ints - the same as the
+// generic operations (including the trip through floats), just without the
+// call. Both operands are freed.
+#define _INT_FAST_OP(name, generic, op) static inline InterpreterObj name##Fast(InterpreterObj a, InterpreterObj b) { \
+    InterpreterObj aAbs = IOAbs(a); \
+    InterpreterObj bAbs = IOAbs(b); \
+    if (aAbs.tag == ObjType_Int && bAbs.tag == ObjType_Int) { \
+        float aNum = aAbs.int_; \
+        int bNum = bAbs.int_; \
+        return IOBJ(.tag = ObjType_Int, .int_ = op); \
+    } \
+    InterpreterObj out = generic(a, b); \
+    freeObj(a); \
+    freeObj(b); \
+    return out; \
+}
+
+_INT_FAST_OP(add, add, aNum + bNum)
+_INT_FAST_OP(subtract, subtract, aNum - bNum)
+_INT_FAST_OP(multiply, multiply, aNum * bNum)
+
+#define _INT_FAST_COMPARISON(name, generic, op) static inline bool name##Fast(InterpreterObj a, InterpreterObj b) { \
+    InterpreterObj aAbs = IOAbs(a); \
+    InterpreterObj bAbs = IOAbs(b); \
+    if (aAbs.tag == ObjType_Int && bAbs.tag == ObjType_Int) return aAbs.int_ op bAbs.int_; \
+    bool out = generic(a, b); \
+    freeObj(a); \
+    freeObj(b); \
+    return out; \
+}
+
+_INT_FAST_COMPARISON(equal, equal, ==)
+_INT_FAST_COMPARISON(less, less, <)
+_INT_FAST_COMPARISON(lessEqual, lessEqual, <=)
+_INT_FAST_COMPARISON(greater, greater, >)
+_INT_FAST_COMPARISON(greaterEqual, greaterEqual, >=)
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "sort.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "panic.h"
+#include "runtime.h"
+#include "array.h"
+
+// Runs shorter than this are insertion sorted
+#define INSERTION_THRESHOLD 16
+
+#define SIGN_BIT 0x80000000u
+
+//* ---------------- radix sort ----------------
+
+// A byte at a time, least significant first - keys which all have the same
+// byte skip that pass
+STATIC void radixSort(uint32_t* keys, int count) {
+    int counts[4][256] = {0};
+    for (int i = 0; i < count; i++) {
+        for (int byte = 0; byte < 4; byte++) counts[byte][(keys[i] >> (byte * 8)) & 0xff]++;
+    }
+
+    uint32_t* scratch = malloc(count * sizeof(uint32_t));
+    uint32_t* from = keys;
+    uint32_t* to = scratch;
+    for (int byte = 0; byte < 4; byte++) {
+        int shift = byte * 8;
+        if (counts[byte][(from[0] >> shift) & 0xff] == count) continue;
+        int offsets[256];
+        for (int bucket = 0, total = 0; bucket < 256; bucket++) {
+            offsets[bucket] = total;
+            total += counts[byte][bucket];
+        }
+        for (int i = 0; i < count; i++) to[offsets[(from[i] >> shift) & 0xff]++] = from[i];
+        uint32_t* swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != keys) memcpy(keys, from, count * sizeof(uint32_t));
+    free(scratch);
+}
+
+// Flipping the sign bit puts negative ints before positive ones
+STATIC void sortInts(int* ints, int count) {
+    uint32_t* keys = (uint32_t*)ints;
+    for (int i = 0; i < count; i++) keys[i] ^= SIGN_BIT;
+    radixSort(keys, count);
+    for (int i = 0; i < count; i++) keys[i] ^= SIGN_BIT;
+}
+
+// Negative floats get every bit flipped (so bigger magnitudes come first),
+// & positive ones just the sign bit
+STATIC void sortFloats(float* floats, int count) {
+    uint32_t* keys = (uint32_t*)floats;
+    for (int i = 0; i < count; i++) keys[i] = keys[i] & SIGN_BIT ? ~keys[i] : keys[i] | SIGN_BIT;
+    radixSort(keys, count);
+    for (int i = 0; i < count; i++) keys[i] = keys[i] & SIGN_BIT ? keys[i] & ~SIGN_BIT : ~keys[i];
+}
+
+//* ---------------- introsort ----------------
+
+STATIC bool before(InterpreterObj a, InterpreterObj b, InterpreterObj* compare) {
+    if (compare == NULL) return less(a, b);
+    // the function gets its own copies
+    InterpreterObj args[] = {copyObj(a), copyObj(b)};
+    InterpreterObj out = IOAbs(callObj(*compare, args, 2));
+    if (out.tag != ObjType_Bool) panic(Panic_Stdlib, "sortBy's function returned a %s instead of a bool!", ObjTypeToString(out.tag));
+    return out.bool_;
+}
+
+#define SWAP(items, i, j) do { \
+    InterpreterObj swap = (items)[i]; \
+    (items)[i] = (items)[j]; \
+    (items)[j] = swap; \
+} while (0)
+
+STATIC void insertionSort(InterpreterObj* items, int count, InterpreterObj* compare) {
+    for (int i = 1; i < count; i++) {
+        InterpreterObj item = items[i];
+        int j = i;
+        for (; j > 0 && before(item, items[j - 1], compare); j--) items[j] = items[j - 1];
+        items[j] = item;
+    }
+}
+
+STATIC void siftDown(InterpreterObj* items, int root, int count, InterpreterObj* compare) {
+    InterpreterObj item = items[root];
+    while (root * 2 + 1 < count) {
+        int child = root * 2 + 1;
+        if (child + 1 < count && before(items[child], items[child + 1], compare)) child++;
+        if (!before(item, items[child], compare)) break;
+        items[root] = items[child];
+        root = child;
+    }
+    items[root] = item;
+}
+
+STATIC void heapSort(InterpreterObj* items, int count, InterpreterObj* compare) {
+    for (int i = count / 2 - 1; i >= 0; i--) siftDown(items, i, count, compare);
+    for (int end = count - 1; end > 0; end--) {
+        SWAP(items, 0, end);
+        siftDown(items, 0, end, compare);
+    }
+}
+
+// Every index is bounds-checked, so a compare that contradicts itself gets
+// a strange order rather than a crash
+STATIC void introSort(InterpreterObj* items, int count, int depth, InterpreterObj* compare) {
+    while (count > INSERTION_THRESHOLD) {
+        if (depth-- == 0) {
+            heapSort(items, count, compare);
+            return;
+        }
+
+        // median of three
+        int middle = count / 2;
+        if (before(items[middle], items[0], compare)) SWAP(items, middle, 0);
+        if (before(items[count - 1], items[0], compare)) SWAP(items, count - 1, 0);
+        if (before(items[count - 1], items[middle], compare)) SWAP(items, count - 1, middle);
+        InterpreterObj pivot = items[middle];
+
+        int i = -1, j = count;
+        while (true) {
+            do i++; while (i < count - 1 && before(items[i], pivot, compare));
+            do j--; while (j > 0 && before(pivot, items[j], compare));
+            if (i >= j) break;
+            SWAP(items, i, j);
+        }
+
+        // recursing on the smaller half keeps the C stack shallow
+        int left = j + 1;
+        if (left < count - left) {
+            introSort(items, left, depth, compare);
+            items += left;
+            count -= left;
+        } else {
+            introSort(items + left, count - left, depth, compare);
+            count = left;
+        }
+    }
+    insertionSort(items, count, compare);
+}
+
+//* ---------------- builtins ----------------
+
+ArrayObj* sortedArray(ArrayObj* array, InterpreterObj* compare) {
+    if (array->rank != 1) panic(Panic_Stdlib, "Can only sort 1-dimensional arrays!");
+    ArrayObj* out = cloneArray(array);
+    if (compare == NULL && out->storage == ArrayStorage_Int) sortInts(out->ints, out->length);
+    else if (compare == NULL && out->storage == ArrayStorage_Float) sortFloats(out->floats, out->length);
+    else {
+        if (out->storage != ArrayStorage_Boxed) promoteArray(out);
+        int depth = 0;
+        for (int length = out->length; length > 1; length >>= 1) depth += 2;
+        introSort(out->boxed, out->length, depth, compare);
+    }
+    return out;
+}
+
+int searchArray(ArrayObj* array, InterpreterObj value) {
+    if (array->rank != 1) panic(Panic_Stdlib, "Can only search 1-dimensional arrays!");
+    // the first element that isn't less than value
+    int low = 0, high = array->length;
+    if (array->storage == ArrayStorage_Int && value.tag == ObjType_Int) {
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            if (array->ints[middle] < value.int_) low = middle + 1;
+            else high = middle;
+        }
+        return low < array->length && array->ints[low] == value.int_ ? low : -1;
+    }
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (less(arrayGet(array, middle), value)) low = middle + 1;
+        else high = middle;
+    }
+    return low < array->length && equal(arrayGet(array, low), value) ? low : -1;
+}
\ No newline at end of file
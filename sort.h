@@ -0,0 +1,14 @@
+#pragma once
+
+#include "interpreter.h"
+
+// sort, sortBy & binarySearch. Int & float arrays are radix sorted (floats
+// by their bits, flipped so they order like the numbers), & everything else
+// is boxed & introsorted - quicksort, falling back to heapsort if it's
+// going quadratic, & insertion sort on short runs.
+
+// A sorted copy of a 1-dimensional array, in the order less() gives - or
+// compare(a, b)'s, if compare isn't NULL (true if a goes before b)
+ArrayObj* sortedArray(ArrayObj* array, InterpreterObj* compare);
+// Where value is in a sorted 1-dimensional array, or -1
+int searchArray(ArrayObj* array, InterpreterObj value);
\ No newline at end of file
@@ -0,0 +1,700 @@
+#include "stackless.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "panic.h"
+#include "runtime.h"
+#include "array.h"
+
+// Everything the machine hasn't finished yet. Each frame runs its node a
+// step at a time - it pushes a frame for whatever it needs evaluated next,
+// & picks the result up off the value stack next time it's on top.
+//
+// An expression frame always leaves exactly one value behind, & a
+// statement, declaration or block frame leaves none.
+typedef enum {
+    Frame_Expr,
+    // Frame_Expr becomes this for =, += & friends
+    Frame_Assign,
+    // the array inside expr which an assignment to expr[...] writes to -
+    // leaves an ObjType_Array behind which isn't a temporary, so mustn't be
+    // freed
+    Frame_WritableArray,
+    Frame_Decl,
+    Frame_Block,
+    // Frame_Expr becomes this when it calls an OCR function - leaves the
+    // return value behind
+    Frame_Function
+} FrameKind;
+
+typedef struct {
+    FrameKind kind;
+    // how far through its node the frame is - each kind counts in its own
+    // way
+    int step;
+    // the height of the value stack when the frame was pushed - everything
+    // above it is the frame's operands so far
+    int base;
+    union {
+        Expression* expr;
+        Declaration* decl;
+        DeclList* block;
+    };
+    union {
+        // Frame_Function
+        struct {
+            FuncDeclList body;
+            Token name;
+            Scope* callerScope;
+        };
+        // Frame_Decl, for loops - allocated
+        char* iterator;
+    };
+} Frame;
+
+DECL_VEC(Frame, FrameList)
+
+struct Machine {
+    FrameList frames;
+    ObjList values;
+    int callDepth;
+};
+
+#define BOOLOBJ(val) IOBJ(.tag = ObjType_Bool, .bool_ = (val))
+
+//* ---------------- stacks ----------------
+
+// Invalidates any Frame* into the machine - push last
+STATIC void pushFrame(Machine* machine, FrameKind kind, void* node) {
+    Frame frame = (Frame){
+        .kind = kind,
+        .step = 0,
+        .base = machine->values.len,
+        .expr = node
+    };
+    APPEND(machine->frames, frame);
+}
+
+STATIC INLINE Frame* topFrame(Machine* machine) {
+    return &machine->frames.root[machine->frames.len - 1];
+}
+
+STATIC INLINE InterpreterObj popValue(Machine* machine) {
+    return machine->values.root[--machine->values.len];
+}
+
+STATIC INLINE InterpreterObj* frameOperands(Machine* machine, Frame* frame) {
+    return &machine->values.root[frame->base];
+}
+
+// Pop the top frame, leaving value behind - its operands should already
+// have been freed or handed on
+STATIC void finishExpr(Machine* machine, InterpreterObj value) {
+    machine->values.len = topFrame(machine)->base;
+    machine->frames.len--;
+    APPEND(machine->values, value);
+}
+
+STATIC void finishStmt(Machine* machine) {
+    machine->values.len = topFrame(machine)->base;
+    machine->frames.len--;
+}
+
+// Turn the top frame into one which runs block - it'll finish as soon as
+// the block does
+STATIC void becomeBlock(Frame* frame, DeclList* block) {
+    frame->kind = Frame_Block;
+    frame->block = block;
+    frame->step = 0;
+}
+
+//* ---------------- values ----------------
+
+// see interpretExpr in interpreter.c
+STATIC InterpreterObj primaryValue(Token primary) {
+    switch (primary.type) {
+        case Tok_True:
+        case Tok_False: return BOOLOBJ(primary.type == Tok_True);
+        case Tok_StringLit: {
+            // strip leading & trailing quotes!
+            return IOBJ(
+                .tag = ObjType_String,
+                .string = (StringObj){
+                    .start = primary.start + 1,
+                    .length = primary.length - 2
+                }
+            );
+        }
+        case Tok_IntLit:
+        case Tok_FloatLit: {
+            char* text = tokText(primary);
+            InterpreterObj out = primary.type == Tok_IntLit
+                ? IOBJ(.tag = ObjType_Int, .int_ = atoi(text))
+                : IOBJ(.tag = ObjType_Float, .float_ = strtof(text, NULL));
+            free(text);
+            return out;
+        }
+        case Tok_Identifier: {
+            char* text = tokText(primary);
+            InterpreterObj out = loadVar(text);
+            free(text);
+            return out;
+        }
+        // todo: handle self
+        default: return IOBJ(.tag = ObjType_Nil);
+    }
+}
+
+// a op b for everything but assignments, AND & OR - frees both
+STATIC InterpreterObj applyOperator(TokType operator, ObjType operandType, InterpreterObj a, InterpreterObj b) {
+    if (operandType != ObjType_Nil) return typedBinary(operator, operandType, a, b);
+    InterpreterObj out;
+    switch (operator) {
+        case Tok_EqualEqual: out = BOOLOBJ(equal(a, b)); break;
+        case Tok_BangEqual: out = BOOLOBJ(!equal(a, b)); break;
+        case Tok_Less: out = BOOLOBJ(less(a, b)); break;
+        case Tok_LessEqual: out = BOOLOBJ(lessEqual(a, b)); break;
+        case Tok_Greater: out = BOOLOBJ(greater(a, b)); break;
+        case Tok_GreaterEqual: out = BOOLOBJ(greaterEqual(a, b)); break;
+        case Tok_Exp: out = iExponent(a, b); break;
+        case Tok_Star: out = multiply(a, b); break;
+        case Tok_Slash: out = divide(a, b); break;
+        case Tok_Plus: out = add(a, b); break;
+        case Tok_Minus: out = subtract(a, b); break;
+        default: panic(Panic_Interpreter, "Not a binary operator!");
+    }
+    freeObj(a);
+    freeObj(b);
+    return out;
+}
+
+// False if operator isn't an assignment - otherwise applied is what a
+// compound assignment does before it stores (Tok_Equal if it's just =)
+STATIC bool assignmentOperator(TokType operator, TokType* applied) {
+    switch (operator) {
+        case Tok_Equal: *applied = Tok_Equal; return true;
+        case Tok_ExpEqual: *applied = Tok_Exp; return true;
+        case Tok_StarEqual: *applied = Tok_Star; return true;
+        case Tok_SlashEqual: *applied = Tok_Slash; return true;
+        case Tok_PlusEqual: *applied = Tok_Plus; return true;
+        case Tok_MinusEqual: *applied = Tok_Minus; return true;
+        default: return false;
+    }
+}
+
+// Overwrite a variable, keeping hold of whether its name needs freeing
+STATIC void storeInVar(InterpreterObj* slot, InterpreterObj value) {
+    value._nameAllocated = slot->_nameAllocated;
+    freeObj(*slot);
+    *slot = value;
+}
+
+// Evaluate expr - a leaf's value goes straight onto the value stack, without
+// needing a frame of its own
+STATIC void pushExpr(Machine* machine, Expression* expr) {
+    if (expr->tag == ExprTag_Primary) APPEND(machine->values, primaryValue(expr->primary));
+    else pushFrame(machine, Frame_Expr, expr);
+}
+
+//* ---------------- expressions ----------------
+
+STATIC void stepBinary(Machine* machine, Frame* frame) {
+    BinaryExpr* binary = &frame->expr->binary;
+    TokType operator = binary->operator.type;
+    TokType applied;
+    if (assignmentOperator(operator, &applied)) {
+        frame->kind = Frame_Assign;
+        return;
+    }
+
+    int step = frame->step++;
+    if (operator == Tok_And || operator == Tok_Or) {
+        if (step == 0) pushExpr(machine, binary->a);
+        else if (step == 1) {
+            // short circuit
+            bool a = condition(popValue(machine));
+            if (a == (operator == Tok_Or)) finishExpr(machine, BOOLOBJ(a));
+            else pushExpr(machine, binary->b);
+        } else finishExpr(machine, BOOLOBJ(condition(popValue(machine))));
+        return;
+    }
+
+    if (step == 0) pushExpr(machine, binary->a);
+    else if (step == 1) pushExpr(machine, binary->b);
+    else {
+        InterpreterObj b = popValue(machine);
+        InterpreterObj a = popValue(machine);
+        finishExpr(machine, applyOperator(operator, binary->operandType, a, b));
+    }
+}
+
+// see assign in interpreter.c - the value's worked out first, then where it
+// goes
+STATIC void stepAssign(Machine* machine, Frame* frame) {
+    BinaryExpr* binary = &frame->expr->binary;
+    Expression* target = binary->a;
+    TokType operator;
+    assignmentOperator(binary->operator.type, &operator);
+
+    switch (frame->step) {
+        case 0: {
+            frame->step = 1;
+            if (operator != Tok_Equal) {
+                pushExpr(machine, target);
+                return;
+            }
+        }
+        // fallthrough
+        case 1: {
+            frame->step = 2;
+            pushExpr(machine, binary->b);
+            return;
+        }
+        case 2: {
+            if (operator != Tok_Equal) {
+                InterpreterObj b = popValue(machine);
+                InterpreterObj a = popValue(machine);
+                APPEND(machine->values, applyOperator(operator, ObjType_Nil, a, b));
+            }
+            InterpreterObj* value = frameOperands(machine, frame);
+            *value = storedValue(*value);
+
+            if (target->tag == ExprTag_Call && target->call.tag == Call_Array) {
+                frame->step = 3;
+                pushFrame(machine, Frame_WritableArray, target->call.callee);
+            } else if (target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier) {
+                char* name = tokText(target->primary);
+                InterpreterObj* slot = findObj(name);
+                if (slot == NULL) setVar(name, *value, true);
+                else {
+                    free(name);
+                    storeInVar(slot, *value);
+                }
+                finishExpr(machine, IOBJ(.tag = ObjType_Nil));
+            } else {
+                // anything else has to evaluate to a reference
+                frame->step = -1;
+                pushExpr(machine, target);
+            }
+            return;
+        }
+        case -1: {
+            InterpreterObj ref = popValue(machine);
+            if (ref.tag != ObjType_Ref) panic(Panic_Interpreter, "Can't assign - not an lvalue! (%s)", ExprTagToString(target->tag));
+            storeInVar(ref.reference, *frameOperands(machine, frame));
+            finishExpr(machine, IOBJ(.tag = ObjType_Nil));
+            return;
+        }
+    }
+
+    // array elements - the value, the array & then the indices
+    ExprList indices = target->call.arguments;
+    int evaluated = frame->step - 3;
+    if (evaluated < indices.len) {
+        frame->step++;
+        pushExpr(machine, &indices.root[evaluated]);
+        return;
+    }
+    InterpreterObj* operands = frameOperands(machine, frame);
+    storeElement(operands[1].array, operands + 2, indices.len, operands[0]);
+    finishExpr(machine, IOBJ(.tag = ObjType_Nil));
+}
+
+// see arrayForWriteFromExpr in interpreter.c
+STATIC void stepWritableArray(Machine* machine, Frame* frame) {
+    Expression* expr = frame->expr;
+    int step = frame->step++;
+    if (!(expr->tag == ExprTag_Call && expr->call.tag == Call_Array)) {
+        if (step == 0) pushExpr(machine, expr);
+        else finishExpr(machine, IOBJ(.tag = ObjType_Array, .array = writableArray(popValue(machine))));
+        return;
+    }
+
+    // a[i][j] = x - a[i] has to be writable too
+    ExprList indices = expr->call.arguments;
+    if (step == 0) pushFrame(machine, Frame_WritableArray, expr->call.callee);
+    else if (step <= indices.len) pushExpr(machine, &indices.root[step - 1]);
+    else {
+        InterpreterObj* operands = frameOperands(machine, frame);
+        ArrayObj* array = writableElementArray(operands[0].array, operands + 1, indices.len);
+        finishExpr(machine, IOBJ(.tag = ObjType_Array, .array = array));
+    }
+}
+
+// receiver.name(arguments) - see callMethod
+STATIC void stepMethodCall(Machine* machine, Frame* frame, CallExpr* member, ExprList arguments) {
+    int step = frame->step++;
+    if (step == 0) pushExpr(machine, member->callee);
+    else if (step <= arguments.len) pushExpr(machine, &arguments.root[step - 1]);
+    else finishExpr(machine, callMethod(member->memberName.start, member->memberName.length, frameOperands(machine, frame), arguments.len + 1));
+}
+
+STATIC void stepCall(Machine* machine, Frame* frame) {
+    CallExpr* call = &frame->expr->call;
+    int argc = call->arguments.len;
+    int step = frame->step++;
+
+    if (step == 0) {
+        pushExpr(machine, call->callee);
+        return;
+    }
+    // the callee's checked before any arguments are evaluated
+    if (step == 1) {
+        InterpreterObj callee = IOAbs(*frameOperands(machine, frame));
+        if (!(callee.tag == ObjType_Func && call->arityProven)) checkCall(callee, argc);
+    }
+    if (step <= argc) {
+        pushExpr(machine, &call->arguments.root[step - 1]);
+        return;
+    }
+
+    InterpreterObj callee = IOAbs(*frameOperands(machine, frame));
+    InterpreterObj* args = frameOperands(machine, frame) + 1;
+    if (callee.tag != ObjType_Func) {
+        finishExpr(machine, callObj(callee, args, argc));
+        return;
+    }
+
+    // the arguments belong to the function's scope now
+    Scope* callerScope = enterFunction(callee.func, args);
+    machine->values.len = frame->base;
+    frame->kind = Frame_Function;
+    frame->step = 0;
+    frame->body = callee.func.block;
+    frame->name = callee.func.name;
+    frame->callerScope = callerScope;
+    machine->callDepth++;
+}
+
+STATIC void stepFunction(Machine* machine, Frame* frame) {
+    if (frame->step == -1) {
+        InterpreterObj returned = leaveFunction(frame->callerScope, popValue(machine));
+        machine->callDepth--;
+        finishExpr(machine, returned);
+        return;
+    }
+
+    // we've run everything in the func - why haven't we returned!!
+    if (frame->step == frame->body.len) panic(Panic_Interpreter, "Function %s must return a value!", tokText(frame->name));
+
+    DeclOrReturn* current = &frame->body.root[frame->step++];
+    if (current->tag == DOR_return) {
+        frame->step = -1;
+        newCacheGeneration();
+        pushExpr(machine, &current->return_);
+    } else pushFrame(machine, Frame_Decl, current->declaration);
+}
+
+STATIC void stepExpr(Machine* machine, Frame* frame) {
+    Expression* expr = frame->expr;
+    switch (expr->tag) {
+        case ExprTag_Unary: panic(Panic_Interpreter, UNARY_UNSUPPORTED);
+        case ExprTag_Binary: {
+            stepBinary(machine, frame);
+            break;
+        }
+        case ExprTag_Call: {
+            switch (expr->call.tag) {
+                case Call_Call: {
+                    Expression* callee = expr->call.callee;
+                    if (callee->tag == ExprTag_Call && callee->call.tag == Call_GetMember) stepMethodCall(machine, frame, &callee->call, expr->call.arguments);
+                    else stepCall(machine, frame);
+                    break;
+                }
+                case Call_Array: {
+                    int step = frame->step++;
+                    ExprList indices = expr->call.arguments;
+                    if (step == 0) pushExpr(machine, expr->call.callee);
+                    else if (step <= indices.len) pushExpr(machine, &indices.root[step - 1]);
+                    else {
+                        InterpreterObj* operands = frameOperands(machine, frame);
+                        finishExpr(machine, loadElement(operands[0], operands + 1, indices.len));
+                    }
+                    break;
+                }
+                case Call_GetMember: {
+                    stepMethodCall(machine, frame, &expr->call, (ExprList){0});
+                    break;
+                }
+            }
+            break;
+        }
+        case ExprTag_Super: {
+            finishExpr(machine, IOBJ(.tag = ObjType_Nil));
+            break;
+        }
+        case ExprTag_Grouping: {
+            // nothing to do afterwards - just evaluate the inside instead
+            frame->expr = expr->grouping;
+            break;
+        }
+        case ExprTag_Cached: {
+            InterpreterObj out;
+            if (frame->step == 0) {
+                if (cacheGet(expr->cached.slot, &out)) finishExpr(machine, out);
+                else {
+                    frame->step = 1;
+                    pushExpr(machine, expr->cached.expr);
+                }
+            } else {
+                out = popValue(machine);
+                cacheSet(expr->cached.slot, out);
+                finishExpr(machine, out);
+            }
+            break;
+        }
+        case ExprTag_Primary: {
+            finishExpr(machine, primaryValue(expr->primary));
+            break;
+        }
+    }
+}
+
+//* ---------------- statements ----------------
+
+// The branches of an if in the order the interpreter tries them - NULL
+// once there aren't any left
+STATIC ConditionalBlock* ifBranch(IfStmt* if_, int branch) {
+    if (branch == 0) return &if_->primary;
+    if (branch <= if_->secondary.len) return &if_->secondary.root[branch - 1];
+    if (branch == if_->secondary.len + 1 && if_->hasElse) return &if_->else_;
+    return NULL;
+}
+
+STATIC void stepIf(Machine* machine, Frame* frame) {
+    IfStmt* if_ = &frame->decl->stmt.if_;
+    // two steps per branch - check it, then maybe run it
+    int branch = frame->step / 2;
+    ConditionalBlock* current = ifBranch(if_, branch);
+
+    if (frame->step % 2 == 0) {
+        if (current == NULL) finishStmt(machine);
+        else {
+            frame->step++;
+            newCacheGeneration();
+            pushExpr(machine, &current->condition);
+        }
+        return;
+    }
+
+    if (!condition(popValue(machine))) {
+        frame->step++;
+        return;
+    }
+    // the interpreter checks the else even if an elseif matched
+    bool elseIf = branch > 0 && branch <= if_->secondary.len;
+    if (elseIf) {
+        frame->step = 2 * (if_->secondary.len + 1);
+        pushFrame(machine, Frame_Block, current->block);
+    } else becomeBlock(frame, current->block);
+}
+
+STATIC void stepFor(Machine* machine, Frame* frame) {
+    ForStmt* for_ = &frame->decl->stmt.for_;
+    switch (frame->step) {
+        case 0: {
+            pushScope();
+            frame->iterator = tokText(for_->iterator);
+            frame->step = 1;
+            pushExpr(machine, &for_->min);
+            return;
+        }
+        case 1: {
+            setVar(strdup(frame->iterator), storedValue(popValue(machine)), true);
+            frame->step = 2;
+            return;
+        }
+        // check the bound - it's evaluated every time round
+        case 2: {
+            frame->step = 3;
+            pushExpr(machine, &for_->max);
+            return;
+        }
+        case 3: {
+            InterpreterObj max = popValue(machine);
+            // declarations in the block can move the iterator - look it up again
+            bool inRange = less(*findObj(frame->iterator), max);
+            freeObj(max);
+            if (inRange) {
+                frame->step = 4;
+                pushFrame(machine, Frame_Block, for_->block);
+            } else {
+                free(frame->iterator);
+                popScope();
+                finishStmt(machine);
+            }
+            return;
+        }
+        case 4: {
+            InterpreterObj* iterator = findObj(frame->iterator);
+            storeInVar(iterator, add(*iterator, IOBJ(.tag = ObjType_Int, .int_ = 1)));
+            frame->step = 2;
+            return;
+        }
+    }
+}
+
+STATIC void stepStmt(Machine* machine, Frame* frame) {
+    Statement* stmt = &frame->decl->stmt;
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            if (frame->step++ == 0) {
+                newCacheGeneration();
+                pushExpr(machine, &stmt->expr);
+            } else {
+                freeObj(popValue(machine));
+                finishStmt(machine);
+            }
+            break;
+        }
+        case StmtTag_Global: {
+            if (frame->step++ == 0) {
+                newCacheGeneration();
+                pushExpr(machine, &stmt->global.initializer);
+            } else {
+                ObjNSSet(&globalScope->objects, tokText(stmt->global.name), popValue(machine));
+                finishStmt(machine);
+            }
+            break;
+        }
+        case StmtTag_For: {
+            stepFor(machine, frame);
+            break;
+        }
+        case StmtTag_While:
+        case StmtTag_Do: {
+            bool isWhile = stmt->tag == StmtTag_While;
+            ConditionalBlock* loop = isWhile ? &stmt->while_ : &stmt->do_;
+            if (frame->step == 0) {
+                frame->step = 1;
+                newCacheGeneration();
+                pushExpr(machine, &loop->condition);
+            //* yikes!! not a do-while but a do-until!
+            } else if (condition(popValue(machine)) == isWhile) {
+                frame->step = 0;
+                pushFrame(machine, Frame_Block, loop->block);
+            } else finishStmt(machine);
+            break;
+        }
+        case StmtTag_If: {
+            stepIf(machine, frame);
+            break;
+        }
+        case StmtTag_Switch: {
+            finishStmt(machine);
+            break;
+        }
+        case StmtTag_Array: {
+            ArrayDimensions dimensions = stmt->array.dimensions;
+            int step = frame->step++;
+            if (step < dimensions.len) pushExpr(machine, &dimensions.root[step]);
+            else {
+                char* name = tokText(stmt->array.name);
+                declareArray(name, frameOperands(machine, frame), dimensions.len);
+                free(name);
+                finishStmt(machine);
+            }
+            break;
+        }
+    }
+}
+
+STATIC void stepDecl(Machine* machine, Frame* frame) {
+    Declaration* decl = frame->decl;
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            setVar(tokText(decl->fun.name), IOBJ(.tag = ObjType_Func, .func = decl->fun), true);
+            finishStmt(machine);
+            break;
+        }
+        case DeclTag_Proc: {
+            setVar(tokText(decl->proc.name), IOBJ(.tag = ObjType_Proc, .proc = decl->proc), true);
+            finishStmt(machine);
+            break;
+        }
+        case DeclTag_Class: {
+            finishStmt(machine);
+            break;
+        }
+        case DeclTag_Stmt: {
+            stepStmt(machine, frame);
+            break;
+        }
+    }
+}
+
+//* ---------------- machine ----------------
+
+Machine* newMachine(DeclList* program) {
+    Machine* out = malloc(sizeof(Machine));
+    INIT(out->frames);
+    INIT(out->values);
+    out->callDepth = 0;
+    pushFrame(out, Frame_Block, program);
+    return out;
+}
+
+bool resumeMachine(Machine* machine, int steps) {
+    while (machine->frames.len > 0) {
+        if (steps == 0) return false;
+        if (steps > 0) steps--;
+
+        Frame* frame = topFrame(machine);
+        switch (frame->kind) {
+            case Frame_Expr: {
+                stepExpr(machine, frame);
+                break;
+            }
+            case Frame_Assign: {
+                stepAssign(machine, frame);
+                break;
+            }
+            case Frame_WritableArray: {
+                stepWritableArray(machine, frame);
+                break;
+            }
+            case Frame_Decl: {
+                stepDecl(machine, frame);
+                break;
+            }
+            case Frame_Block: {
+                if (frame->step == frame->block->len) finishStmt(machine);
+                else {
+                    Declaration* next = &frame->block->root[frame->step++];
+                    pushFrame(machine, Frame_Decl, next);
+                }
+                break;
+            }
+            case Frame_Function: {
+                stepFunction(machine, frame);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+int machineCallDepth(Machine* machine) {
+    return machine->callDepth;
+}
+
+void destroyMachine(Machine* machine) {
+    FOREACH(FrameList, machine->frames, frame) {
+        if (frame->kind == Frame_Decl && frame->decl->tag == DeclTag_Stmt && frame->decl->stmt.tag == StmtTag_For && frame->step > 0)
+            free(frame->iterator);
+    }
+    DESTROY(machine->frames);
+    DESTROY(machine->values);
+    free(machine);
+}
+
+void interpretStackless(ParseOutput po) {
+    pushScope();
+    setupSTL();
+    Machine* machine = newMachine(&po.ast);
+    resumeMachine(machine, -1);
+    destroyMachine(machine);
+    popScope();
+}
\ No newline at end of file
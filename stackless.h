@@ -0,0 +1,29 @@
+#pragma once
+
+#include "parser.h"
+#include "interpreter.h"
+
+// The stackless engine walks the same AST as interpret(), but never
+// recurses on the C stack - every pending expression, statement, block &
+// OCR call is a Frame on a growable stack on the heap, & every
+// intermediate value waits on a value stack. Recursion's only limited by
+// memory, & the machine can stop after any step & carry on later.
+//
+// It doesn't use the JIT or the tiers (both of which would recurse
+// natively), so it's slower than interpret() - it's for programs which
+// need the depth.
+
+typedef struct Machine Machine;
+
+// A machine that's about to run program in the current scope. Only one
+// machine can be running at a time - they share the scopes.
+Machine* newMachine(DeclList* program);
+// Run at most steps steps (or everything, if steps is -1) - returns true
+// once the program's finished
+bool resumeMachine(Machine* machine, int steps);
+// How many OCR calls are in progress
+int machineCallDepth(Machine* machine);
+void destroyMachine(Machine* machine);
+
+// Alternative to interpret() - run the whole program on a machine
+void interpretStackless(ParseOutput po);
\ No newline at end of file
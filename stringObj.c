@@ -0,0 +1,99 @@
+#include "stringObj.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "file.h"
+#include "parallel.h"
+
+StringObj newString(int length) {
+    // the chars come straight after the buffer - one allocation
+    StringBuffer* buffer = malloc(sizeof(StringBuffer) + length);
+    buffer->refCount = 1;
+    buffer->mappedSize = 0;
+    buffer->chars = (char*)(buffer + 1);
+    return (StringObj){
+        .start = buffer->chars,
+        .length = length,
+        .owner = buffer
+    };
+}
+
+StringObj copyString(char* chars, int length) {
+    StringObj out = newString(length);
+    memcpy(out.start, chars, length);
+    return out;
+}
+
+StringObj stringView(StringBuffer* owner, char* chars, int length) {
+    if (owner != NULL) retainBuffer(owner);
+    return (StringObj){
+        .start = chars,
+        .length = length,
+        .owner = owner
+    };
+}
+
+// every byte set to b
+#define BYTES(b) (0x0101010101010101ull * (b))
+
+StringObj changeCase(StringObj string, bool upper) {
+    StringObj out = newString(string.length);
+    // the letters that need changing
+    unsigned char from = upper ? 'a' : 'A', to = upper ? 'z' : 'Z';
+    int i = 0;
+    // 8 chars at a time - adding 0x80 - from to a byte's low 7 bits sets its
+    // top bit if it's >= from, & likewise for > to, so the bytes that are
+    // between the two (& ASCII) are the ones that flip 0x20
+    for (; i + 8 <= string.length; i += 8) {
+        uint64_t chars;
+        memcpy(&chars, string.start + i, 8);
+        uint64_t low = chars & BYTES(0x7f);
+        uint64_t letters = ((low + BYTES(0x80 - from)) ^ (low + BYTES(0x80 - to - 1))) & ~chars & BYTES(0x80);
+        chars ^= letters >> 2;
+        memcpy(out.start + i, &chars, 8);
+    }
+    for (; i < string.length; i++) {
+        unsigned char c = string.start[i];
+        out.start[i] = c >= from && c <= to ? c ^ 0x20 : c;
+    }
+    return out;
+}
+
+#define CHARS4(n) (n), (n) + 1, (n) + 2, (n) + 3
+#define CHARS16(n) CHARS4(n), CHARS4((n) + 4), CHARS4((n) + 8), CHARS4((n) + 12)
+#define CHARS64(n) CHARS16(n), CHARS16((n) + 16), CHARS16((n) + 32), CHARS16((n) + 48)
+
+// never written - it's only not const because StringObj.start isn't
+static unsigned char allChars[256] = {CHARS64(0), CHARS64(64), CHARS64(128), CHARS64(192)};
+
+StringObj charString(unsigned char c) {
+    return (StringObj){
+        .start = (char*)&allChars[c],
+        .length = 1,
+        .owner = NULL
+    };
+}
+
+StringBuffer* mappedBuffer(char* chars, size_t size) {
+    StringBuffer* out = malloc(sizeof(StringBuffer));
+    out->refCount = 1;
+    out->mappedSize = size;
+    out->chars = chars;
+    return out;
+}
+
+void retainBuffer(StringBuffer* buffer) {
+    retainCount(&buffer->refCount);
+}
+
+void releaseBuffer(StringBuffer* buffer) {
+    if (releaseCount(&buffer->refCount) != 0) return;
+    if (buffer->mappedSize != 0) {
+        forgetMapping(buffer);
+        munmap(buffer->chars, buffer->mappedSize);
+    }
+    free(buffer);
+}
\ No newline at end of file
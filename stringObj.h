@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "interpreter.h"
+
+// Strings are never changed once they've been made, so any number of them
+// can share the chars behind them - b = a, or a line read from a file, is
+// just another reference to the same buffer. Literals don't have one (their
+// chars are the program's source, which lives forever).
+struct StringBuffer {
+    int refCount;
+    // non-zero if chars is a file that's been mapped in - it's munmap'd
+    // rather than freed
+    size_t mappedSize;
+    char* chars;
+};
+
+// A string length chars long, for the caller to fill in through start
+StringObj newString(int length);
+StringObj copyString(char* chars, int length);
+// Chars which are already inside owner's buffer (a slice of another string,
+// or a line of a file) - shares it
+StringObj stringView(StringBuffer* owner, char* chars, int length);
+
+// A new string with every ASCII letter in string upper (or lower) cased -
+// anything else, UTF-8 included, is left alone
+StringObj changeCase(StringObj string, bool upper);
+// The one-character string for c - they're static, so it never allocates
+StringObj charString(unsigned char c);
+
+// A buffer for size bytes that have been mmap'd at chars - nothing uses it
+// until there are views of it
+StringBuffer* mappedBuffer(char* chars, size_t size);
+void retainBuffer(StringBuffer* buffer);
+void releaseBuffer(StringBuffer* buffer);
\ No newline at end of file
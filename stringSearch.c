@@ -0,0 +1,186 @@
+#include "stringSearch.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+#ifdef STRING_SEARCH_SIMD
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    int (*find)(char* haystack, int length, char* needle, int needleLength);
+    int (*count)(char* chars, int length, char c);
+    bool (*same)(char* a, char* b, int length);
+} Kernels;
+
+//* ---------------- scalar ----------------
+
+STATIC int findScalar(char* haystack, int length, char* needle, int needleLength) {
+    char* end = haystack + length - needleLength + 1;
+    for (char* current = haystack; current < end; current++) {
+        current = memchr(current, needle[0], end - current);
+        if (current == NULL) return -1;
+        if (memcmp(current + 1, needle + 1, needleLength - 1) == 0) return current - haystack;
+    }
+    return -1;
+}
+
+STATIC int countScalar(char* chars, int length, char c) {
+    int out = 0;
+    for (int i = 0; i < length; i++) out += chars[i] == c;
+    return out;
+}
+
+STATIC bool sameScalar(char* a, char* b, int length) {
+    return memcmp(a, b, length) == 0;
+}
+
+//* ---------------- SSE2 & AVX2 ----------------
+
+#ifdef STRING_SEARCH_SIMD
+
+// Whether the needle's at bit of mask, for a block starting at start - the
+// first & last chars are already known to match
+STATIC INLINE int checkCandidates(uint32_t mask, char* start, char* needle, int needleLength) {
+    while (mask != 0) {
+        int bit = __builtin_ctz(mask);
+        if (needleLength <= 2 || memcmp(start + bit + 1, needle + 1, needleLength - 2) == 0) return bit;
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+STATIC int findSSE2(char* haystack, int length, char* needle, int needleLength) {
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    int i = 0;
+    for (; i + needleLength - 1 + 16 <= length; i += 16) {
+        __m128i starts = _mm_loadu_si128((__m128i*)(haystack + i));
+        __m128i ends = _mm_loadu_si128((__m128i*)(haystack + i + needleLength - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(ends, last)));
+        int found = checkCandidates(mask, haystack + i, needle, needleLength);
+        if (found >= 0) return i + found;
+    }
+    int rest = findScalar(haystack + i, length - i, needle, needleLength);
+    return rest < 0 ? -1 : i + rest;
+}
+
+STATIC int countSSE2(char* chars, int length, char c) {
+    __m128i wanted = _mm_set1_epi8(c);
+    int out = 0;
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((__m128i*)(chars + i));
+        out += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, wanted)));
+    }
+    return out + countScalar(chars + i, length - i, c);
+}
+
+STATIC bool sameSSE2(char* a, char* b, int length) {
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i blockA = _mm_loadu_si128((__m128i*)(a + i));
+        __m128i blockB = _mm_loadu_si128((__m128i*)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB)) != 0xffff) return false;
+    }
+    return sameScalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2")))
+STATIC int findAVX2(char* haystack, int length, char* needle, int needleLength) {
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    int i = 0;
+    for (; i + needleLength - 1 + 32 <= length; i += 32) {
+        __m256i starts = _mm256_loadu_si256((__m256i*)(haystack + i));
+        __m256i ends = _mm256_loadu_si256((__m256i*)(haystack + i + needleLength - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(starts, first), _mm256_cmpeq_epi8(ends, last)));
+        int found = checkCandidates(mask, haystack + i, needle, needleLength);
+        if (found >= 0) return i + found;
+    }
+    int rest = findSSE2(haystack + i, length - i, needle, needleLength);
+    return rest < 0 ? -1 : i + rest;
+}
+
+__attribute__((target("avx2,popcnt")))
+STATIC int countAVX2(char* chars, int length, char c) {
+    __m256i wanted = _mm256_set1_epi8(c);
+    int out = 0;
+    int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((__m256i*)(chars + i));
+        out += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wanted)));
+    }
+    return out + countSSE2(chars + i, length - i, c);
+}
+
+__attribute__((target("avx2")))
+STATIC bool sameAVX2(char* a, char* b, int length) {
+    int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i blockA = _mm256_loadu_si256((__m256i*)(a + i));
+        __m256i blockB = _mm256_loadu_si256((__m256i*)(b + i));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(blockA, blockB)) != 0xffffffff) return false;
+    }
+    return sameSSE2(a + i, b + i, length - i);
+}
+
+#endif
+
+//* ---------------- dispatch ----------------
+
+static Kernels allKernels[] = {
+    [Search_Scalar] = {findScalar, countScalar, sameScalar},
+#ifdef STRING_SEARCH_SIMD
+    [Search_SSE2] = {findSSE2, countSSE2, sameSSE2},
+    [Search_AVX2] = {findAVX2, countAVX2, sameAVX2},
+#endif
+};
+
+// NULL until something's searched for - set once, but any thread could be
+// the one to do it
+static Kernels* kernels = NULL;
+
+SearchKernel bestSearchKernel() {
+#ifdef STRING_SEARCH_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return Search_AVX2;
+    // every x86-64 CPU has it
+    return Search_SSE2;
+#else
+    return Search_Scalar;
+#endif
+}
+
+bool useSearchKernel(SearchKernel kernel) {
+    if (kernel > bestSearchKernel()) return false;
+    __atomic_store_n(&kernels, &allKernels[kernel], __ATOMIC_RELEASE);
+    return true;
+}
+
+STATIC INLINE Kernels* currentKernels() {
+    Kernels* out = __atomic_load_n(&kernels, __ATOMIC_ACQUIRE);
+    if (out == NULL) {
+        useSearchKernel(bestSearchKernel());
+        out = __atomic_load_n(&kernels, __ATOMIC_ACQUIRE);
+    }
+    return out;
+}
+
+int findChars(char* haystack, int length, char* needle, int needleLength) {
+    if (needleLength == 0) return 0;
+    if (needleLength > length) return -1;
+    return currentKernels()->find(haystack, length, needle, needleLength);
+}
+
+int countChar(char* chars, int length, char c) {
+    return currentKernels()->count(chars, length, c);
+}
+
+bool sameChars(char* a, char* b, int length) {
+    // two views of the same chars
+    if (a == b) return true;
+    return currentKernels()->same(a, b, length);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Scanning text for the string methods (find, contains, count & split) &
+// for string equality. On x86-64 there are SSE2 & AVX2 kernels - which one
+// runs is picked from CPUID the first time one's needed - & everywhere else
+// (or on a CPU without either) it falls back to memchr & memcmp.
+//
+// Substrings are found by comparing the needle's first & last chars against
+// a block of positions at once, & only checking the middle of the positions
+// where both match - so the needle's length barely matters.
+
+#if defined(__x86_64__)
+#define STRING_SEARCH_SIMD
+#endif
+
+// Where needle first appears in haystack, or -1 - an empty needle's at 0
+int findChars(char* haystack, int length, char* needle, int needleLength);
+// How many times c appears in chars
+int countChar(char* chars, int length, char c);
+bool sameChars(char* a, char* b, int length);
+
+typedef enum {
+    Search_Scalar,
+    Search_SSE2,
+    Search_AVX2
+} SearchKernel;
+
+// The best kernels this CPU can run
+SearchKernel bestSearchKernel();
+// Swap the kernels (to test or time them) - false if the CPU can't run them
+bool useSearchKernel(SearchKernel kernel);
\ No newline at end of file
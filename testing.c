@@ -3,11 +3,38 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "lexer.h"
 #include "parser.h"
+#include "optimiser.h"
 #include "interpreter.h"
+#include "runtime.h"
+#include "closure.h"
+#include "tier.h"
+#include "parallel.h"
+#include "stackless.h"
+#include "extension.h"
+#include "jit.h"
+#include "transpiler.h"
+#include "ir.h"
+#include "checker.h"
+#include "array.h"
+#include "output.h"
+#include "numbers.h"
+#include "stringObj.h"
+#include "stringSearch.h"
+#include "file.h"
+#include "sort.h"
+#include "collections.h"
+#include "reduce.h"
+#include "ocrpi_stdlib.h"
 #include "panic.h"
+#include "ocrpi_vm.h"
 
 #include "readFile.h"
 #include "map.h"
@@ -44,7 +71,7 @@ static void _expect(bool expression, char* expressionString) {
 }
 
 static void _expectStr(char* expression, char* expressionStr, char* expected) {
-    char* buf = malloc(strlen(expressionStr) + strlen(expression) + strlen(expected) + 13);
+    char* buf = malloc(strlen(expressionStr) + strlen(expression) + strlen(expected) + 15);
     sprintf(buf, "%s (-> \"%s\") == \"%s\"", expressionStr, expression, expected);
     _expect(strcmp(expression, expected) == 0, buf);
     free(buf);
@@ -275,6 +302,1167 @@ static void test_interpreter() {
     expect(result.int_ == 8);
 }
 
+static void test_natives() {
+    pushScope();
+    setupSTL();
+    // setVar can move it
+    InterpreterObj string = *findObj("string");
+    expect(string.tag == ObjType_NativeFunc);
+    expect(string.nativeFunc->signature.arity == 1);
+
+    // natives borrow their arguments - a variable passed by reference is
+    // still intact afterwards, & what comes back is the native's own (a
+    // string's another reference to the same chars)
+    InterpreterObj* name = setVar("name", IOBJ(.tag = ObjType_String, .string = copyString("ocr", 3)), false);
+    InterpreterObj args[] = {IOBJ(.tag = ObjType_Ref, .reference = name)};
+    InterpreterObj out = callNative(string, args, 1, false);
+    expectNStr(out.string.start, out.string.length, "ocr");
+    expect(out.string.owner == name->string.owner && name->string.owner->refCount == 2);
+    freeObj(out);
+    expectNStr(name->string.start, name->string.length, "ocr");
+    expect(name->string.owner->refCount == 1);
+
+    InterpreterObj typeofArgs[] = {IOBJ(.tag = ObjType_Int, .int_ = 1)};
+    out = callNative(*findObj("typeof"), typeofArgs, 1, false);
+    expectNStr(out.string.start, out.string.length, "Int");
+    popScope();
+
+    // a program can take a native's name - its scope still comes apart
+    char* source = readFile("test/shadow.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    char* expected = "5\n6\n7\n8\n9\n11\n";
+    for (int engine = 0; engine < 3; engine++) {
+        char* text;
+        size_t length;
+        FILE* memory = open_memstream(&text, &length);
+        FILE* old = outputTarget(memory);
+        if (engine == 0) interpret(po);
+        else if (engine == 1) runClosures(po);
+        else interpretStackless(po);
+        expect(outputTarget(old) == memory);
+        fclose(memory);
+        expectNStr(text, length, expected);
+        free(text);
+    }
+    OcrpiVM* vm = ocrpi_vm_new();
+    char output[64];
+    OcrpiCapture capture = {output, sizeof(output), 0, NULL, 0};
+    expect(ocrpi_run_source(vm, source, &capture) == OCRPI_OK);
+    expectStr(output, expected);
+    ocrpi_vm_free(vm);
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_output() {
+    char* text;
+    size_t length;
+    FILE* memory = open_memstream(&text, &length);
+    FILE* old = outputTarget(memory);
+
+    int dims[] = {2, 2};
+    ArrayObj* grid = newArray(2, dims);
+    for (int i = 0; i < 4; i++) arraySet(grid, i, IOBJ(.tag = ObjType_Int, .int_ = i * 10));
+    outputObj(IOBJ(.tag = ObjType_Array, .array = grid));
+    outputChars(" ", 1);
+    outputObj(IOBJ(.tag = ObjType_Bool, .bool_ = false));
+    outputNewline();
+    // bigger than the buffer - goes straight through
+    char* big = malloc(OUTPUT_BUFFER_SIZE + 1);
+    memset(big, 'x', OUTPUT_BUFFER_SIZE + 1);
+    outputChars(big, OUTPUT_BUFFER_SIZE + 1);
+    free(big);
+    releaseArray(grid);
+
+    expect(outputTarget(old) == memory);
+    fclose(memory);
+    expect(length == 26 + OUTPUT_BUFFER_SIZE + 1);
+    expectNStr(text, 26, "[[0, 10], [20, 30]] false\n");
+    expect(text[length - 1] == 'x');
+    free(text);
+}
+
+static void test_numbers() {
+    char text[FLOAT_CHARS];
+    expectNStr(text, formatInt(0, text), "0");
+    expectNStr(text, formatInt(-1234567, text), "-1234567");
+    expectNStr(text, formatInt(-2147483647 - 1, text), "-2147483648");
+    expectNStr(text, formatFloat(0.1f, text), "0.1");
+    expectNStr(text, formatFloat(2.5f, text), "2.5");
+    expectNStr(text, formatFloat(-3.0f, text), "-3.0");
+    expectNStr(text, formatFloat(16777216.0f, text), "16777216.0");
+    expectNStr(text, formatFloat(0.0001f, text), "0.0001");
+    expectNStr(text, formatFloat(0.00001f, text), "1e-05");
+    expectNStr(text, formatFloat(3.4028235e38f, text), "3.4028235e+38");
+    expectNStr(text, formatFloat(1e-45f, text), "1e-45");
+
+    // slices of a bigger string - nothing after them is read
+    char* line = "  42,-7.25e1,0x10";
+    expect(parseInt(line, 4) == 42);
+    expect(parseInt(line, 3) == 4);
+    expect(parseFloat(line + 5, 7) == -72.5f);
+    expect(parseFloat(line + 5, 3) == -7.0f);
+    expect(parseFloat(line + 13, 4) == 16.0f);
+    expect(parseInt("", 0) == 0);
+}
+
+static void expectFilesOutput() {
+    char* written = readFile("test/files.out");
+    expectStr(written, "second line\n42\n45\n");
+    free(written);
+    remove("test/files.out");
+}
+
+static void test_strings() {
+    // slices share the string's buffer
+    StringObj string = copyString("Hello, World!", 13);
+    InterpreterObj args[] = {IOBJ(.tag = ObjType_String, .string = string), IOBJ(.tag = ObjType_Int, .int_ = 7), IOBJ(.tag = ObjType_Int, .int_ = 5)};
+    InterpreterObj world = stl_substring(args, 3);
+    expect(world.string.owner == string.owner && string.owner->refCount == 2);
+    expectNStr(world.string.start, world.string.length, "World");
+    freeObj(world);
+    InterpreterObj left = stl_left((InterpreterObj[]){args[0], args[2]}, 2);
+    expectNStr(left.string.start, left.string.length, "Hello");
+    freeObj(left);
+    InterpreterObj right = stl_right((InterpreterObj[]){args[0], args[2]}, 2);
+    expectNStr(right.string.start, right.string.length, "orld!");
+    freeObj(right);
+    expect(stl_length(args, 1).int_ == 13);
+    expect(string.owner->refCount == 1);
+    releaseBuffer(string.owner);
+
+    // single characters are never allocated
+    StringObj a = charString('a');
+    expect(a.owner == NULL && a.length == 1 && a.start[0] == 'a');
+    expect(charString(200).start[0] == (char)200);
+
+    // 8 at a time has to agree with 1 at a time, wherever the letters land
+    char chars[256 + 7];
+    for (int i = 0; i < 256 + 7; i++) chars[i] = i;
+    bool matched = true;
+    for (int offset = 0; offset < 8; offset++) {
+        StringObj upper = changeCase((StringObj){.start = chars + offset, .length = 256}, true);
+        StringObj lower = changeCase((StringObj){.start = chars + offset, .length = 256}, false);
+        for (int i = 0; i < 256; i++) {
+            unsigned char c = chars[offset + i];
+            matched = matched && (unsigned char)upper.start[i] == (c >= 'a' && c <= 'z' ? c - 32 : c);
+            matched = matched && (unsigned char)lower.start[i] == (c >= 'A' && c <= 'Z' ? c + 32 : c);
+        }
+        releaseBuffer(upper.owner);
+        releaseBuffer(lower.owner);
+    }
+    expect(matched);
+}
+
+static int naiveFind(char* haystack, int length, char* needle, int needleLength) {
+    for (int i = 0; i + needleLength <= length; i++) {
+        if (memcmp(haystack + i, needle, needleLength) == 0) return i;
+    }
+    return -1;
+}
+
+static void test_search() {
+    // every kernel the CPU can run has to agree with the obvious loop, on
+    // needles that straddle blocks & end right at the end
+    unsigned seed = 1;
+    char haystack[300], needle[40];
+    bool matched = true;
+    for (SearchKernel kernel = Search_Scalar; kernel <= bestSearchKernel(); kernel++) {
+        expect(useSearchKernel(kernel));
+        for (int round = 0; round < 2000; round++) {
+            int length = (seed = seed * 1103515245 + 12345) % 300;
+            for (int i = 0; i < length; i++) haystack[i] = 'a' + (seed = seed * 1103515245 + 12345) / 65536 % 3;
+            int needleLength = 1 + (seed = seed * 1103515245 + 12345) / 65536 % 40;
+            // usually somewhere in the haystack, so it's found
+            int from = length > needleLength ? (seed = seed * 1103515245 + 12345) / 65536 % (length - needleLength) : 0;
+            for (int i = 0; i < needleLength; i++) needle[i] = from + i < length && round % 4 != 0 ? haystack[from + i] : 'a' + i % 3;
+            matched = matched && findChars(haystack, length, needle, needleLength) == naiveFind(haystack, length, needle, needleLength);
+
+            int count = 0;
+            for (int i = 0; i < length; i++) count += haystack[i] == needle[0];
+            matched = matched && countChar(haystack, length, needle[0]) == count;
+            int same = length < needleLength ? length : needleLength;
+            matched = matched && sameChars(haystack, needle, same) == (memcmp(haystack, needle, same) == 0);
+        }
+    }
+    useSearchKernel(bestSearchKernel());
+    expect(matched);
+    expect(findChars("abc", 3, "", 0) == 0);
+    expect(findChars("ab", 2, "abc", 3) == -1);
+
+    // split's pieces are views of the string
+    StringObj string = copyString("a,,b,", 5);
+    InterpreterObj args[] = {IOBJ(.tag = ObjType_String, .string = string), IOBJ(.tag = ObjType_String, .string = charString(','))};
+    InterpreterObj pieces = stl_split(args, 2);
+    expect(pieces.array->length == 4 && string.owner->refCount == 5);
+    StringObj third = arrayGet(pieces.array, 2).reference->string;
+    expectNStr(third.start, third.length, "b");
+    expect(arrayGet(pieces.array, 3).reference->string.length == 0);
+    freeObj(pieces);
+    expect(stl_count(args, 2).int_ == 3);
+    releaseBuffer(string.owner);
+}
+
+static void test_files() {
+    // lines are views of the mapping, which outlive the file
+    FileObj* file = openFile("test/files.txt", 14, false);
+    StringObj first = readLine(file);
+    StringObj second = readLine(file);
+    expect(first.owner == file->contents && second.owner == file->contents);
+    expect(!endOfFile(file));
+    releaseFile(file);
+    expectNStr(first.start, first.length, "first line");
+    expectNStr(second.start, second.length, "second line");
+    releaseBuffer(first.owner);
+    releaseBuffer(second.owner);
+
+    // writing over a file doesn't change the lines already read from it,
+    // whether it's been closed or not - even ones past its new end
+    FILE* old = fopen("test/files.out", "w");
+    fputs("hello world\nsecond\nthird\n", old);
+    fclose(old);
+    file = openFile("test/files.out", 14, false);
+    first = readLine(file);
+    closeFile(file);
+    releaseFile(file);
+    file = openFile("test/files.out", 14, false);
+    readLine(file);
+    second = readLine(file);
+    FileObj* writer = openFile("test/files.out", 14, true);
+    writeLine(writer, IOBJ(.tag = ObjType_String, .string = charString('a')));
+    releaseFile(writer);
+    expectNStr(first.start, first.length, "hello world");
+    expectNStr(second.start, second.length, "second");
+    StringObj third = readLine(file);
+    expectNStr(third.start, third.length, "third");
+    releaseFile(file);
+    releaseBuffer(first.owner);
+    releaseBuffer(second.owner);
+    releaseBuffer(third.owner);
+    char* written = readFile("test/files.out");
+    expectStr(written, "a\n");
+    free(written);
+    remove("test/files.out");
+
+    // & from a program, on every engine
+    char* source = readFile("test/files.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    interpret(po);
+    expectFilesOutput();
+    runClosures(po);
+    expectFilesOutput();
+    interpretStackless(po);
+    expectFilesOutput();
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_input() {
+    // a pipe can't be mapped, so it's streamed a chunk at a time
+    int fds[2];
+    expect(pipe(fds) == 0);
+    pid_t writer = fork();
+    if (writer == 0) {
+        close(fds[0]);
+        FILE* out = fdopen(fds[1], "w");
+        for (int i = 0; i < 20000; i++) fprintf(out, "line %i\n", i);
+        // longer than a chunk
+        for (int i = 0; i < FILE_CHUNK_SIZE * 3; i++) fputc('x', out);
+        fputs("\r\nend", out);
+        fclose(out);
+        _exit(0);
+    }
+    close(fds[1]);
+    char path[32];
+    int length = snprintf(path, sizeof(path), "/dev/fd/%i", fds[0]);
+    FileObj* file = openFile(path, length, false);
+    expect(file->fd >= 0);
+    StringObj first = readLine(file);
+    bool matched = true;
+    char expected[16];
+    for (int i = 1; i < 20000; i++) {
+        StringObj line = readLine(file);
+        int n = snprintf(expected, sizeof(expected), "line %i", i);
+        matched = matched && line.length == n && memcmp(line.start, expected, n) == 0;
+        releaseBuffer(line.owner);
+    }
+    expect(matched);
+    StringObj longLine = readLine(file);
+    expect(longLine.length == FILE_CHUNK_SIZE * 3 && longLine.start[0] == 'x' && longLine.start[longLine.length - 1] == 'x');
+    releaseBuffer(longLine.owner);
+    StringObj last = readLine(file);
+    expectNStr(last.start, last.length, "end");
+    expect(endOfFile(file));
+    releaseBuffer(last.owner);
+    closeFile(file);
+    releaseFile(file);
+    // its chunk's still alive
+    expectNStr(first.start, first.length, "line 0");
+    releaseBuffer(first.owner);
+    close(fds[0]);
+    waitpid(writer, NULL, 0);
+
+    // stdin - a regular file here, so it's mapped
+    int savedStdin = dup(STDIN_FILENO);
+    int fd = open("test/files.txt", O_RDONLY);
+    dup2(fd, STDIN_FILENO);
+    close(fd);
+    InterpreterObj line = stl_input(NULL, 0);
+    expectNStr(line.string.start, line.string.length, "first line");
+    freeObj(line);
+    InterpreterObj rest = stl_inputLines(NULL, 0);
+    expect(rest.tag == ObjType_Array && rest.array->length == 2);
+    StringObj second = arrayGet(rest.array, 0).reference->string;
+    expectNStr(second.start, second.length, "second line");
+    StringObj third = arrayGet(rest.array, 1).reference->string;
+    expectNStr(third.start, third.length, "42");
+    freeObj(rest);
+    expect(stl_endOfInput(NULL, 0).bool_);
+    expect(stl_inputLines(NULL, 0).tag == ObjType_Nil);
+    dup2(savedStdin, STDIN_FILENO);
+    close(savedStdin);
+}
+
+static void test_extensions() {
+    LexOutput lo = lex("import \"extensions/stats.so\"\nx = 1");
+    expect(lo.root[0].type == Tok_Import);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    expect(po.imports.len == 1);
+    expect(po.ast.len == 1);
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+
+    // built by make test
+    loadExtension("extensions/stats.so");
+    loadExtension("./extensions/../extensions/stats.so");
+    expect(extensionCount() == 1);
+    STLSignature signature;
+    expect(stlSignature("stddev", &signature));
+    expect(signature.arity == 1 && signature.params[0] == ACCEPTS(Array));
+
+    pushScope();
+    setupSTL();
+    int dims[] = {2};
+    InterpreterObj array = IOBJ(.tag = ObjType_Array, .array = newArray(1, dims));
+    for (int i = 0; i < 2; i++) arraySet(array.array, i, IOBJ(.tag = ObjType_Int, .int_ = i * 2 + 1));
+    InterpreterObj args[] = {array};
+    InterpreterObj stddev = callNative(*findObj("stddev"), args, 1, false);
+    expect(stddev.tag == ObjType_Float && stddev.float_ == 1);
+    popScope();
+}
+
+static void test_array() {
+    ArrayObj* array = newArray(2, (int[]){2, 3});
+    expect(array->length == 6);
+    expect(array->strides[0] == 3);
+    expect(array->strides[1] == 1);
+    expect(arrayOffset(array, (int[]){1, 2}, 2, 0) == 5);
+    expect(array->storage == ArrayStorage_Nil);
+    expect(arrayGet(array, 4).tag == ObjType_Nil);
+
+    arraySet(array, 5, (InterpreterObj){.tag = ObjType_Int, .int_ = 7});
+    expect(array->storage == ArrayStorage_Int);
+    expect(arrayGet(array, 5).int_ == 7);
+    expect(arrayGet(array, 0).int_ == 0);
+
+    // heterogeneous store - should be boxed now
+    arraySet(array, 0, (InterpreterObj){.tag = ObjType_Float, .float_ = 1.5});
+    expect(array->storage == ArrayStorage_Boxed);
+    InterpreterObj elem = arrayGet(array, 0);
+    expect(elem.tag == ObjType_Ref);
+    expect(elem.reference->tag == ObjType_Float);
+    expect(arrayGet(array, 5).reference->int_ == 7);
+    // never written - still the first type's zero, not nil
+    expect(arrayGet(array, 1).reference->tag == ObjType_Int);
+    expect(arrayGet(array, 1).reference->int_ == 0);
+    destroyArray(array);
+
+    // a string first means boxed straight away, so they're nil
+    ArrayObj* strings = newArray(1, (int[]){3});
+    arraySet(strings, 0, (InterpreterObj){.tag = ObjType_String, .string = {.start = "x", .length = 1}});
+    expect(arrayGet(strings, 1).reference->tag == ObjType_Nil);
+    destroyArray(strings);
+
+    ArrayObj* bools = newArray(1, (int[]){10});
+    arraySet(bools, 9, (InterpreterObj){.tag = ObjType_Bool, .bool_ = true});
+    expect(bools->storage == ArrayStorage_Bool);
+    expect(arrayGet(bools, 9).bool_);
+    expect(!arrayGet(bools, 8).bool_);
+    arraySet(bools, 9, (InterpreterObj){.tag = ObjType_Bool, .bool_ = false});
+    expect(!arrayGet(bools, 9).bool_);
+    destroyArray(bools);
+
+    // copy-on-write
+    ArrayObj* original = newArray(1, (int[]){4});
+    arraySet(original, 0, (InterpreterObj){.tag = ObjType_Int, .int_ = 1});
+    ArrayObj* alias = original;
+    retainArray(alias);
+    expect(original->refCount == 2);
+    expect(arrayForWrite(&alias) != original);
+    expect(original->refCount == 1);
+    arraySet(alias, 0, (InterpreterObj){.tag = ObjType_Int, .int_ = 2});
+    expect(arrayGet(original, 0).int_ == 1);
+    expect(arrayGet(alias, 0).int_ == 2);
+    // nobody else has it now - no copy
+    expect(arrayForWrite(&alias) == alias);
+    releaseArray(alias);
+    releaseArray(original);
+}
+
+static bool sortedInts(ArrayObj* array) {
+    for (int i = 1; i < array->length; i++) {
+        if (array->ints[i - 1] > array->ints[i]) return false;
+    }
+    return true;
+}
+
+static void test_sort() {
+    // radix sorted ints, negatives first
+    int length = 5000;
+    ArrayObj* ints = newArray(1, &length);
+    unsigned seed = 7;
+    long long total = 0;
+    for (int i = 0; i < length; i++) {
+        int value = (int)(seed = seed * 1103515245 + 12345) >> (i % 20);
+        total += value;
+        arraySet(ints, i, IOBJ(.tag = ObjType_Int, .int_ = value));
+    }
+    ArrayObj* sorted = sortedArray(ints, NULL);
+    expect(sorted != ints && sorted->storage == ArrayStorage_Int && sortedInts(sorted));
+    long long sortedTotal = 0;
+    for (int i = 0; i < length; i++) sortedTotal += sorted->ints[i];
+    expect(sortedTotal == total);
+    expect(searchArray(sorted, IOBJ(.tag = ObjType_Int, .int_ = sorted->ints[1234])) <= 1234);
+    expect(sorted->ints[searchArray(sorted, IOBJ(.tag = ObjType_Int, .int_ = sorted->ints[1234]))] == sorted->ints[1234]);
+    releaseArray(sorted);
+
+    // boxed once there's a float in there - introsorted with less()
+    arraySet(ints, 0, IOBJ(.tag = ObjType_Float, .float_ = -0.5));
+    sorted = sortedArray(ints, NULL);
+    expect(sorted->storage == ArrayStorage_Boxed);
+    bool ordered = true;
+    for (int i = 1; i < length; i++) ordered = ordered && !less(sorted->boxed[i], sorted->boxed[i - 1]);
+    expect(ordered);
+    releaseArray(sorted);
+    releaseArray(ints);
+
+    // floats by their bits
+    length = 6;
+    ArrayObj* floats = newArray(1, &length);
+    float values[] = {2.5, -1, 0, -1000.25, 1e-10, -1e-10};
+    for (int i = 0; i < length; i++) arraySet(floats, i, IOBJ(.tag = ObjType_Float, .float_ = values[i]));
+    sorted = sortedArray(floats, NULL);
+    expect(sorted->floats[0] == -1000.25 && sorted->floats[1] == -1 && sorted->floats[2] == -1e-10f);
+    expect(sorted->floats[3] == 0 && sorted->floats[4] == 1e-10f && sorted->floats[5] == 2.5);
+    expect(searchArray(sorted, IOBJ(.tag = ObjType_Float, .float_ = -1)) == 1);
+    expect(searchArray(sorted, IOBJ(.tag = ObjType_Float, .float_ = 1)) == -1);
+    releaseArray(sorted);
+    releaseArray(floats);
+
+    // sortBy calls back into the program
+    char* source = readFile("test/sort.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    pushScope();
+    setupSTL();
+    Machine* machine = newMachine(&po.ast);
+    expect(resumeMachine(machine, -1));
+    expectNStr(findObj("longest")->string.start, findObj("longest")->string.length, "banana");
+    expectNStr(findObj("shortest")->string.start, findObj("shortest")->string.length, "fig");
+    expectNStr(findObj("first")->string.start, findObj("first")->string.length, "apple");
+    expect(findObj("kiwi")->int_ == 3);
+    expect(findObj("lime")->int_ == -1);
+    expectNStr(findObj("unsorted")->string.start, findObj("unsorted")->string.length, "pear");
+    destroyMachine(machine);
+    popScope();
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+
+    // a comparator can move the iterator out of range, so the loop keeps its
+    // bounds checks - it panics rather than writing past the end
+    source = readFile("test/sortCallback.ocr");
+    lo = lex(source);
+    po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    for (int closures = 0; closures < 2; closures++) {
+        pid_t child = fork();
+        if (child == 0) {
+            freopen("/dev/null", "w", stdout);
+            if (closures) runClosures(po);
+            else interpret(po);
+            _exit(0);
+        }
+        int status;
+        waitpid(child, &status, 0);
+        expect(WIFEXITED(status) && WEXITSTATUS(status) == Panic_Interpreter);
+    }
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_collections() {
+    // churn through enough sets & removes to grow & clear out removed entries
+    DictionaryObj* dictionary = newDictionary();
+    bool present[3000] = {false};
+    unsigned seed = 3;
+    bool matched = true;
+    for (int round = 0; round < 20000; round++) {
+        int key = (seed = seed * 1103515245 + 12345) / 65536 % 3000;
+        InterpreterObj keyObj = IOBJ(.tag = ObjType_Int, .int_ = key);
+        if (round % 3 == 0) {
+            matched = matched && dictionaryRemove(dictionary, keyObj) == present[key];
+            present[key] = false;
+        } else {
+            dictionarySet(dictionary, keyObj, IOBJ(.tag = ObjType_Int, .int_ = key * 2));
+            present[key] = true;
+        }
+    }
+    int count = 0;
+    for (int key = 0; key < 3000; key++) {
+        InterpreterObj* value = dictionaryGet(dictionary, IOBJ(.tag = ObjType_Int, .int_ = key));
+        matched = matched && (value != NULL) == present[key] && (value == NULL || value->int_ == key * 2);
+        count += present[key];
+    }
+    expect(matched);
+    expect(dictionary->count == count && dictionary->used * 4 <= dictionary->capacity * 3);
+
+    // keys of different types don't collide, & string keys share their chars
+    StringObj name = copyString("one", 3);
+    dictionarySet(dictionary, IOBJ(.tag = ObjType_String, .string = name), IOBJ(.tag = ObjType_Int, .int_ = 1));
+    expect(name.owner->refCount == 2);
+    expect(dictionaryGet(dictionary, IOBJ(.tag = ObjType_String, .string = {.start = "one", .length = 3}))->int_ == 1);
+    expect(dictionaryGet(dictionary, IOBJ(.tag = ObjType_Float, .float_ = 1)) == NULL);
+    releaseBuffer(name.owner);
+    releaseDictionary(dictionary);
+
+    StackObj* stack = newStack();
+    for (int i = 0; i < 100; i++) stackPush(stack, IOBJ(.tag = ObjType_Int, .int_ = i));
+    expect(stackPeek(stack)->int_ == 99);
+    expect(stackPop(stack).int_ == 99 && stackPop(stack).int_ == 98 && stack->items.len == 98);
+    releaseStack(stack);
+
+    // wraps round the ring before it has to grow
+    QueueObj* queue = newQueue();
+    int next = 0, front = 0;
+    matched = true;
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 5; i++) queuePush(queue, IOBJ(.tag = ObjType_Int, .int_ = next++));
+        for (int i = 0; i < 3; i++) matched = matched && queuePop(queue).int_ == front++;
+    }
+    expect(matched);
+    expect(queue->count == 100 && queueFront(queue)->int_ == front);
+    releaseQueue(queue);
+}
+
+static void test_reduce() {
+    // long enough for whole vectors & a tail, against plain loops
+    int length = 1003;
+    ArrayObj* ints = newArray(1, &length);
+    ArrayObj* floats = newArray(1, &length);
+    long long total = 0, dot = 0;
+    int lowest = 0, highest = 0;
+    double floatTotal = 0;
+    unsigned seed = 11;
+    for (int i = 0; i < length; i++) {
+        int value = (int)(seed = seed * 1103515245 + 12345) >> 16;
+        total += value;
+        dot += (long long)value * value;
+        if (i == 0 || value < lowest) lowest = value;
+        if (i == 0 || value > highest) highest = value;
+        arraySet(ints, i, IOBJ(.tag = ObjType_Int, .int_ = value));
+        arraySet(floats, i, IOBJ(.tag = ObjType_Float, .float_ = i * 0.25f));
+        floatTotal += i * 0.25f;
+    }
+    InterpreterObj sum = arraySum(ints);
+    expect(sum.tag == ObjType_Int && sum.int_ == (int)total);
+    expect(arrayDot(ints, ints).int_ == (int)dot);
+    expect(arrayMin(ints).int_ == lowest && arrayMax(ints).int_ == highest);
+    expect(arrayMean(ints) == (float)((double)total / length));
+    sum = arraySum(floats);
+    expect(sum.tag == ObjType_Float && sum.float_ == (float)floatTotal);
+    expect(arrayMin(floats).float_ == 0 && arrayMax(floats).float_ == 250.5);
+
+    // a float anywhere makes it boxed, & the answer a float
+    arraySet(ints, 500, IOBJ(.tag = ObjType_Float, .float_ = 0.5));
+    expect(ints->storage == ArrayStorage_Boxed);
+    sum = arraySum(ints);
+    expect(sum.tag == ObjType_Float);
+    releaseArray(ints);
+
+    ArrayObj* filled = filledArray(floats, IOBJ(.tag = ObjType_Bool, .bool_ = true));
+    bool all = filled->length == length;
+    for (int i = 0; i < length; i++) all = all && arrayGet(filled, i).bool_;
+    expect(all);
+    releaseArray(filled);
+    releaseArray(floats);
+
+    // strings go by less()
+    length = 3;
+    ArrayObj* words = newArray(1, &length);
+    char* names[] = {"pear", "apple", "zoo"};
+    for (int i = 0; i < length; i++) arraySet(words, i, IOBJ(.tag = ObjType_String, .string = copyString(names[i], strlen(names[i]))));
+    InterpreterObj first = arrayMin(words);
+    InterpreterObj last = arrayMax(words);
+    expectNStr(first.string.start, first.string.length, "apple");
+    expectNStr(last.string.start, last.string.length, "zoo");
+    freeObj(first);
+    freeObj(last);
+    filled = filledArray(words, IOBJ(.tag = ObjType_Int, .int_ = 7));
+    expect(filled->storage == ArrayStorage_Int && filled->ints[2] == 7);
+    releaseArray(filled);
+    releaseArray(words);
+}
+
+static void test_optimiser() {
+    char* source = readFile("test/optimise.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+
+    expect(po.ast.root[1].stmt.tag == StmtTag_For);
+    ForStmt outer = po.ast.root[1].stmt.for_;
+    expect(outer.rangeInvariant);
+    // grid[i, j], grid[i - 1, j], grid[i + 1, j]
+    expect(outer.indexCandidates.len == 3);
+    expect(outer.indexCandidates.root[0].dimension == 0);
+    expect(outer.indexCandidates.root[0].offset == 0);
+    expect(outer.indexCandidates.root[1].offset == -1);
+    expect(outer.indexCandidates.root[2].offset == 1);
+
+    ForStmt inner = outer.block->root[0].stmt.for_;
+    expect(inner.rangeInvariant);
+    expect(inner.indexCandidates.len == 3);
+    expect(inner.indexCandidates.root[0].dimension == 1);
+
+    // assigns to the iterator
+    expect(!po.ast.root[2].stmt.for_.rangeInvariant);
+    // assigns to the bound
+    expect(!po.ast.root[3].stmt.for_.rangeInvariant);
+
+    // d = (grid[1, 2] - b) * (grid[1, 2] - b)
+    Expression product = *po.ast.root[4].stmt.expr.binary.b;
+    Expression* left = product.binary.a->grouping;
+    Expression* right = product.binary.b->grouping;
+    expect(left->tag == ExprTag_Cached);
+    expect(right->tag == ExprTag_Cached);
+    expect(left->cached.slot == right->cached.slot);
+    // the whole subtraction is cached, not just grid[1, 2]
+    expect(left->cached.expr->binary.a->tag == ExprTag_Call);
+
+    // f(x) + 1 calls a function which might not be pure
+    Expression print = po.ast.root[5].stmt.expr;
+    expect(print.call.arguments.root[0].tag == ExprTag_Binary);
+    expect(print.call.arguments.root[1].tag == ExprTag_Binary);
+
+    // redeclaring b shrinks the array a refers to, so the loop keeps its
+    // bounds checks - it panics rather than writing past the end
+    source = readFile("test/byRefBounds.ocr");
+    lo = lex(source);
+    po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    ForStmt fill = po.ast.root[1].fun.block.root[0].declaration->stmt.for_;
+    expect(fill.rangeInvariant);
+    expect(fill.indexCandidates.len == 0);
+    for (int closures = 0; closures < 2; closures++) {
+        pid_t child = fork();
+        if (child == 0) {
+            freopen("/dev/null", "w", stdout);
+            if (closures) runClosures(po);
+            else interpret(po);
+            _exit(0);
+        }
+        int status;
+        waitpid(child, &status, 0);
+        expect(WIFEXITED(status) && WEXITSTATUS(status) == Panic_Interpreter);
+    }
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_closures() {
+    char* source = readFile("test/closures.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    Closure* program = compileBlock(&po.ast);
+
+    // y = x * 3
+    Closure* assignment = program->children[1]->a;
+    expectStr(assignment->name, "store_var");
+    expectStr(assignment->b->name, "multiply_int_const");
+    // y += 1
+    expectStr(program->children[2]->a->b->name, "add_int_const");
+    // z = (x + y) * (x + y)
+    expectStr(program->children[3]->a->b->name, "binary_any");
+    expectStr(program->children[3]->a->b->a->name, "cached_value");
+    // w = y - x
+    expectStr(program->children[4]->a->b->name, "binary_any");
+
+    char* text;
+    size_t length;
+    FILE* memory = open_memstream(&text, &length);
+    FILE* old = outputTarget(memory);
+    pushScope();
+    setupSTL();
+    runClosure(program);
+    expect(findObj("y")->int_ == 13);
+    expect(findObj("z")->int_ == 289);
+    expect(findObj("w")->int_ == 9);
+    popScope();
+
+    // the interpreter's what the closures have to match
+    interpret(po);
+    expect(outputTarget(old) == memory);
+    fclose(memory);
+    expectNStr(text, length, "1\n5\n1\n5\n");
+    free(text);
+
+    destroyClosure(program);
+}
+
+static void test_tier() {
+    char* source = readFile("test/tier.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    tierPrepare(&po.ast);
+    FunDecl square = po.ast.root[0].fun;
+    TierLoop* loop = po.ast.root[3].stmt.while_.tier;
+    expect(square.tier != NULL);
+    expect(loop != NULL);
+
+    // cold until it's been run enough, & then only once the thread's done
+    for (int i = 0; i < TIER_CALL_THRESHOLD; i++) {
+        expect(tierFunction(square) == NULL);
+    }
+    for (int i = 0; i < TIER_LOOP_THRESHOLD; i++) {
+        expect(tierLoop(loop) == NULL);
+    }
+    tierFlush();
+    expect(tierFunction(square) != NULL);
+    expect(tierLoop(loop) != NULL);
+    tierShutdown();
+    expect(po.ast.root[0].fun.tier == NULL);
+    expect(po.ast.root[3].stmt.while_.tier == NULL);
+
+    // & the whole thing - without the tier, compiled before it starts,
+    // switching tiers halfway through & on the closures alone
+    for (int engine = 0; engine < 4; engine++) {
+        char* text;
+        size_t length;
+        FILE* memory = open_memstream(&text, &length);
+        FILE* old = outputTarget(memory);
+        if (engine == 1 || engine == 2) tierPrepare(&po.ast);
+        if (engine == 1) {
+            FunDecl inc = po.ast.root[4].fun;
+            for (int i = 0; i <= TIER_CALL_THRESHOLD; i++) tierFunction(inc);
+            tierFlush();
+            expect(tierFunction(inc) != NULL);
+        }
+        if (engine == 3) runClosures(po);
+        else interpret(po);
+        expect(po.ast.root[0].fun.tier == NULL);
+        expect(outputTarget(old) == memory);
+        fclose(memory);
+        expectNStr(text, length, "0\n");
+        free(text);
+    }
+
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+// Both engines, with more threads than there might be cores so the pool
+// gets used regardless - the output's the same as running every loop
+// normally
+static void test_parallel() {
+    char* source = readFile("test/parallel.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    char* expected = "368115\ntrue\n312375.0\n699\n15150\n45\n0\n1\n2\n45\n36\n";
+
+    for (int threads = 4; threads >= 1; threads -= 3) {
+        setParallelThreads(threads);
+        for (int closures = 0; closures < 2; closures++) {
+            char* text;
+            size_t length;
+            FILE* memory = open_memstream(&text, &length);
+            FILE* old = outputTarget(memory);
+            ParallelStats before = parallelStats();
+            if (closures) {
+                runClosures(po);
+            } else {
+                // tiering up while the loops run
+                tierPrepare(&po.ast);
+                interpret(po);
+            }
+            ParallelStats after = parallelStats();
+            expect(outputTarget(old) == memory);
+            fclose(memory);
+            expect(length == strlen(expected));
+            expectNStr(text, length, expected);
+            free(text);
+            // the last four write a shared scalar, print, read another
+            // iteration's element & read the last iteration's value
+            expect(after.parallel - before.parallel == (threads > 1 ? 5 : 0));
+            expect(after.sequential - before.sequential == (threads > 1 ? 4 : 9));
+        }
+    }
+    setParallelThreads(0);
+
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_stackless() {
+    char* source = readFile("test/stackless.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+
+    pushScope();
+    setupSTL();
+    Machine* machine = newMachine(&po.ast);
+    // stops whenever it's told to...
+    expect(!resumeMachine(machine, 1000));
+    expect(machineCallDepth(machine) > 0);
+    int deepest = 0;
+    while (!resumeMachine(machine, 1)) {
+        if (machineCallDepth(machine) > deepest) deepest = machineCallDepth(machine);
+    }
+    // ...& goes a lot deeper than the C stack would
+    expect(deepest == 50001);
+    expect(machineCallDepth(machine) == 0);
+    expect(findObj("deepest")->int_ == 50000);
+    expect(findObj("total")->int_ == 7);
+    destroyMachine(machine);
+    popScope();
+
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+#ifdef JIT_SUPPORTED
+static void test_jit() {
+    char* source = readFile("test/jit.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    jitPrepare(&po.ast);
+    FunDecl sumTo = po.ast.root[0].fun;
+    FunDecl shout = po.ast.root[1].fun;
+
+    pushScope();
+    InterpreterObj args[] = {IOBJ(ObjType_Int, .int_ = 10)};
+    InterpreterObj out;
+    // cold until it's been called enough
+    for (int i = 1; i < JIT_THRESHOLD; i++) {
+        expect(!jitCall(sumTo, args, 1, &out));
+    }
+    expect(jitCall(sumTo, args, 1, &out));
+    expect(sumTo.jit->state == Jit_Compiled);
+    expect(out.tag == ObjType_Int && out.int_ == 45);
+    // guards
+    InterpreterObj floatArgs[] = {IOBJ(ObjType_Float, .float_ = 10)};
+    expect(!jitCall(sumTo, floatArgs, 1, &out));
+    setVar("total", IOBJ(ObjType_Int, .int_ = 1), false);
+    expect(!jitCall(sumTo, args, 1, &out));
+
+    for (int i = 0; i < JIT_THRESHOLD; i++) {
+        expect(!jitCall(shout, args, 1, &out));
+    }
+    expect(shout.jit->state == Jit_Unsupported);
+    popScope();
+
+    // the code's unmapped along with everything else
+    void* code = sumTo.jit->code;
+    jitRelease(&po.ast);
+    expect(po.ast.root[0].fun.jit == NULL);
+    expect(po.ast.root[1].fun.jit == NULL);
+    expect(msync(code, 1, MS_ASYNC) == -1);
+
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+#endif
+
+static void test_transpiler() {
+    char* source = readFile("test/transpile.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+
+    FILE* out = tmpfile();
+    transpile(po, out);
+    long length = ftell(out);
+    rewind(out);
+    char* c = calloc(length + 1, 1);
+    fread(c, 1, length, out);
+    fclose(out);
+
+    expect(strstr(c, "static InterpreterObj fn_1_double(InterpreterObj* args) {") != NULL);
+    expect(strstr(c, "Scope* callerScope = enterFunction(fn_1_decl, args);") != NULL);
+    expect(strstr(c, "multiplyFast(") != NULL);
+    expect(strstr(c, "assignVar(\"x\", ") != NULL);
+    expect(strstr(c, "checkCall(") != NULL);
+    expect(strstr(c, "int main() {") != NULL);
+
+    free(c);
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_ir() {
+    char* source = readFile("test/ir.ocr");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+
+    IRProgram ir = buildIR(&po.ast);
+    expect(ir.functions.len == 3);
+    FOREACH(IRFunctionList, ir.functions, func) expect(verifyIR(*func) == 0);
+
+    IRFunction* sumTo = ir.functions.root[1];
+    expect(strcmp(sumTo->name, "sumTo") == 0);
+    expect(sumTo->paramCount == 1);
+    // total & i both need a phi at the top of the loop, & they're both ints
+    IRBlock* header = sumTo->blocks.root[1];
+    expect(header->preds.len == 2);
+    expect(header->instrs.root[0]->op == IROp_Phi && header->instrs.root[0]->type == IRType_Int);
+    expect(header->instrs.root[1]->op == IROp_Phi && header->instrs.root[1]->type == IRType_Int);
+    // nothing's known about the parameter, so comparing it is all we can say
+    IRInstr* compare = header->instrs.root[2];
+    expect(compare->op == IROp_Less && compare->type == IRType_Bool);
+    expect(compare->operands.root[1]->op == IROp_Param && compare->operands.root[1]->type == IRType_Any);
+
+    // a string plus anything else could be anything
+    IRFunction* shout = ir.functions.root[2];
+    IRBlock* entry = shout->blocks.root[0];
+    IRInstr* ret = entry->instrs.root[entry->instrs.len - 1];
+    expect(ret->op == IROp_Return && ret->operands.root[0]->type == IRType_Any);
+
+    // the AND's value comes from both sides
+    bool joined = false;
+    FOREACH(IRBlockList, ir.functions.root[0]->blocks, b) {
+        FOREACH(IRInstrList, (*b)->instrs, instr) joined |= (*instr)->op == IROp_Phi && (*instr)->operands.len == 2;
+    }
+    expect(joined);
+
+    // break it & make sure the verifier notices
+    IRInstr* terminator = header->instrs.root[header->instrs.len - 1];
+    header->instrs.len--;
+    expect(verifyIR(sumTo) > 0);
+    header->instrs.len++;
+    IRInstr* phi = header->instrs.root[0];
+    IRInstr* operand = phi->operands.root[1];
+    phi->operands.len--;
+    expect(verifyIR(sumTo) > 0);
+    APPEND(phi->operands, operand);
+    expect(verifyIR(sumTo) == 0);
+    expect(terminator->op == IROp_Branch);
+
+    FILE* out = tmpfile();
+    dumpIR(ir, out);
+    long length = ftell(out);
+    rewind(out);
+    char* text = calloc(length + 1, 1);
+    fread(text, 1, length, out);
+    fclose(out);
+    expect(strstr(text, "function sumTo:") != NULL);
+    expect(strstr(text, "  bb1: ; preds bb0, bb2") != NULL);
+    expect(strstr(text, "= Param 0 : Any") != NULL);
+    free(text);
+
+    destroyIR(ir);
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+static void test_checker() {
+    char* source = readFile("test/check.ocrx");
+    LexOutput lo = lex(source);
+    ParseOutput po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    CheckOutput co = check(&po.ast);
+    expect(co.errors.len == 0);
+    destroyCheckOutput(co);
+
+    // total = total + i - both ints
+    FunDecl sumTo = po.ast.root[0].fun;
+    Expression assignment = sumTo.block.root[1].declaration->stmt.for_.block->root[0].stmt.expr;
+    expect(assignment.binary.operandType == ObjType_Nil);
+    expect(assignment.binary.b->binary.operandType == ObjType_Int);
+    // "hello " + name - strings don't get the fast path
+    FunDecl greet = po.ast.root[1].fun;
+    expect(greet.block.root[0].return_.binary.operandType == ObjType_Nil);
+    // x = sumTo(squares[3])
+    Expression call = *po.ast.root[4].stmt.expr.binary.b;
+    expect(call.call.arityProven);
+    // int("42") - a String's something int takes
+    Expression native = *po.ast.root[6].stmt.expr.binary.b->binary.a;
+    expect(native.call.arityProven);
+    // a - b in before - sortBy passes it strings
+    FunDecl before = po.ast.root[7].fun;
+    expect(before.block.root[0].return_.binary.a->binary.operandType == ObjType_Nil);
+
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+
+    source = readFile("test/checkErrors.ocrx");
+    lo = lex(source);
+    po = parse(lo);
+    expect(po.errors.len == 0);
+    optimise(&po.ast);
+    co = check(&po.ast);
+    expect(co.errors.len == 7);
+    expectStr(co.errors.root[0].msg, "x is String here, but it's Int elsewhere!");
+    expectStr(co.errors.root[1].msg, "Called function add with 1 args instead of 2!");
+    expectStr(co.errors.root[2].msg, "Can't subtract String and Int!");
+    expectStr(co.errors.root[3].msg, "Array indices must be Int, not String!");
+    expectStr(co.errors.root[4].msg, "Can't call Int!");
+    expectStr(co.errors.root[5].msg, "Unknown variable nowhere!");
+    expectStr(co.errors.root[6].msg, "Can't pass Bool to int!");
+    expect(co.errors.root[0].tok.line == 6);
+    destroyCheckOutput(co);
+
+    destroyParseOutput(po);
+    destroyLexOutput(lo);
+    free(source);
+}
+
+// Each thread's VM counts up its own globals, & panics part way through
+STATIC void* runVMThread(void* arg) {
+    int n = (int)(intptr_t)arg;
+    OcrpiVM* vm = ocrpi_vm_new();
+    char output[256], error[128];
+    OcrpiCapture capture = {output, sizeof(output), 0, error, sizeof(error)};
+    char source[64];
+    snprintf(source, sizeof(source), "n = %i\ntotal = 0", n);
+    bool ok = ocrpi_run_source(vm, source, &capture) == OCRPI_OK;
+    char* add =
+        "function triangle(k)\n"
+        "    t = 0\n"
+        "    for i = 0 to k + 1\n"
+        "        t = t + i\n"
+        "    next i\n"
+        "    return t\n"
+        "endfunction\n"
+        "parallel for j = 0 to 200\n"
+        "    total = total + triangle(n)\n"
+        "next j\n"
+        "print(total)";
+    for (int i = 0; i < 5; i++) ok = ok && ocrpi_run_source(vm, add, &capture) == OCRPI_OK;
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%i\n", 1000 * (n * (n + 1) / 2));
+    ok = ok && strcmp(output, expected) == 0;
+    ok = ok && ocrpi_run_source(vm, "for i = 0 to 3\n    print(triangle(i))\n    if i == 1 then\n        print(nowhere)\n    endif\nnext i", &capture) == OCRPI_RUNTIME_ERROR;
+    ok = ok && strcmp(output, "0\n1\n") == 0 && strcmp(error, "Unknown variable nowhere!") == 0;
+    ok = ok && ocrpi_run_source(vm, "print(n)", &capture) == OCRPI_OK;
+    snprintf(expected, sizeof(expected), "%i\n", n);
+    ok = ok && strcmp(output, expected) == 0;
+    ocrpi_vm_free(vm);
+    return (void*)(intptr_t)ok;
+}
+
+static void test_vm() {
+    OcrpiVM* vm = ocrpi_vm_new();
+    char output[16], error[128];
+    OcrpiCapture capture = {output, sizeof(output), 0, error, sizeof(error)};
+    expect(ocrpi_run_source(vm, "x = 20\nprint(x + 1)", &capture) == OCRPI_OK);
+    expectStr(output, "21\n");
+    expect(capture.outputLength == 3);
+    expectStr(error, "");
+
+    // the globals are still there...
+    expect(ocrpi_run_source(vm, "function double(y)\n    return y * 2\nendfunction\nprint(double(x))", &capture) == OCRPI_OK);
+    expectStr(output, "40\n");
+    // ...& what doesn't fit is cut off, but still counted
+    expect(ocrpi_run_source(vm, "for i = 0 to 10\n    print(double(i))\nnext i", &capture) == OCRPI_OK);
+    expectStr(output, "0\n2\n4\n6\n8\n10\n12");
+    expect(capture.outputLength == 25);
+
+    expect(ocrpi_run_source(vm, "print(1)\nprint(", &capture) == OCRPI_SYNTAX_ERROR);
+    expectStr(output, "");
+    expectStr(error, "Parse error at line 2, column 6: Unexpected token!");
+    expect(ocrpi_run_source(vm, "import \"extensions/stats.so\"\nprint(1)", &capture) == OCRPI_IMPORT_ERROR);
+    expectStr(output, "");
+    expectStr(error, "Can't import modules into an embedded program!");
+
+    // a panic only stops the run - the output up to it is kept, & the VM
+    // carries on
+    expect(ocrpi_run_source(vm, "array a[2]\na[1] = 3\nprint(x)\na[2] = 1", &capture) == OCRPI_RUNTIME_ERROR);
+    expectStr(output, "20\n");
+    expectStr(error, "Index 2 is out of bounds for dimension 1 (size 2)!");
+    expect(ocrpi_run_source(vm, "print(double(a[1]))", &capture) == OCRPI_OK);
+    expectStr(output, "6\n");
+    expectStr(error, "");
+
+    // neither buffer's needed
+    OcrpiCapture discard = {0};
+    expect(ocrpi_run_source(vm, "print(x)\nprint(nowhere)", &discard) == OCRPI_RUNTIME_ERROR);
+    expect(discard.outputLength == 3);
+
+    // panicking in the middle of a loop whose bounds checks are off turns
+    // them back on, for the next call to the function it's in
+    char* paint =
+        "function paint(a, n)\n"
+        "    for i = 0 to n\n"
+        "        a[i] = 7\n"
+        "        if i == n - 1 then\n"
+        "            z = \"s\" - 1\n"
+        "        endif\n"
+        "    next i\n"
+        "    return 0\n"
+        "endfunction\n"
+        "array big[100]\n"
+        "r = paint(big, 100)";
+    expect(ocrpi_run_source(vm, paint, &capture) == OCRPI_RUNTIME_ERROR);
+    expect(ocrpi_run_source(vm, "array small[2]\nr = paint(small, 5000000)", &capture) == OCRPI_RUNTIME_ERROR);
+    expectStr(error, "Index 2 is out of bounds for dimension 1 (size 2)!");
+    ocrpi_vm_free(vm);
+
+    // the VMs don't share anything, so they can all run at once
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, runVMThread, (void*)(intptr_t)(i + 3));
+    for (int i = 0; i < 4; i++) {
+        void* ok;
+        pthread_join(threads[i], &ok);
+        expect(ok != NULL);
+    }
+}
+
 static void panickingFunc() {
     printf("panicking\n");
     panic(PANIC_CATCHABLE(Panic_Test, PCC_Test), "balls!!!!!!!");
@@ -312,6 +1500,30 @@ void testAll() {
     TEST_MODULE(parser_error_reporting);
     TEST_MODULE(map);
     TEST_MODULE(interpreter);
+    TEST_MODULE(natives);
+    TEST_MODULE(output);
+    TEST_MODULE(numbers);
+    TEST_MODULE(strings);
+    TEST_MODULE(search);
+    TEST_MODULE(files);
+    TEST_MODULE(input);
+    TEST_MODULE(extensions);
+    TEST_MODULE(array);
+    TEST_MODULE(sort);
+    TEST_MODULE(collections);
+    TEST_MODULE(reduce);
+    TEST_MODULE(optimiser);
+    TEST_MODULE(closures);
+    TEST_MODULE(tier);
+    TEST_MODULE(parallel);
+    TEST_MODULE(stackless);
+#ifdef JIT_SUPPORTED
+    TEST_MODULE(jit);
+#endif
+    TEST_MODULE(transpiler);
+    TEST_MODULE(ir);
+    TEST_MODULE(checker);
+    TEST_MODULE(vm);
     TEST_MODULE(panic);
     TEST_MODULE(vector);   
     printf("\n ! \033[0;32m%i tests passed!! <333333\033[0m\n", testCount);
@@ -0,0 +1,209 @@
+#include "tier.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "parallel.h"
+
+typedef struct {
+    // one or the other
+    TierFunction* function;
+    TierLoop* loop;
+} TierJob;
+
+DECL_VEC(TierJob, TierJobList)
+DECL_VEC(TierFunction*, TierFunctionList)
+// where each loop's TierLoop lives in the AST
+DECL_VEC(TierLoop**, TierLoopList)
+
+// everything tierPrepare handed out, to free at shutdown
+static TierFunctionList tierFunctions;
+static TierLoopList tierLoops;
+
+// everything below is shared with the compiler thread - hold lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+// signalled when there's a new job, or it's time to stop
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+// signalled whenever a job's finished
+static pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+static pthread_t thread;
+static bool started = false;
+static bool stopping = false;
+static bool compiling = false;
+static TierJobList jobs;
+
+//* ---------------- profiling ----------------
+
+STATIC void newTierLoop(TierLoop** loop, DeclList* block) {
+    *loop = calloc(1, sizeof(TierLoop));
+    (*loop)->block = block;
+    APPEND(tierLoops, loop);
+}
+
+STATIC void tierBlock(DeclList* block);
+
+STATIC void tierDecl(Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            decl->fun.tier = calloc(1, sizeof(TierFunction));
+            decl->fun.tier->decl = &decl->fun;
+            APPEND(tierFunctions, decl->fun.tier);
+            FOREACH(FuncDeclList, decl->fun.block, currentDOR) {
+                if (currentDOR->tag == DOR_decl) tierDecl(currentDOR->declaration);
+            }
+            break;
+        }
+        case DeclTag_Stmt: {
+            Statement* stmt = &decl->stmt;
+            switch (stmt->tag) {
+                case StmtTag_For: {
+                    newTierLoop(&stmt->for_.tier, stmt->for_.block);
+                    tierBlock(stmt->for_.block);
+                    break;
+                }
+                case StmtTag_While: {
+                    newTierLoop(&stmt->while_.tier, stmt->while_.block);
+                    tierBlock(stmt->while_.block);
+                    break;
+                }
+                case StmtTag_Do: {
+                    newTierLoop(&stmt->do_.tier, stmt->do_.block);
+                    tierBlock(stmt->do_.block);
+                    break;
+                }
+                case StmtTag_If: {
+                    tierBlock(stmt->if_.primary.block);
+                    FOREACH(ElseIfList, stmt->if_.secondary, branch) tierBlock(branch->block);
+                    if (stmt->if_.hasElse) tierBlock(stmt->if_.else_.block);
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+        default: break;
+    }
+}
+
+STATIC void tierBlock(DeclList* block) {
+    FOREACH(DeclList, *block, decl) tierDecl(decl);
+}
+
+void tierPrepare(DeclList* program) {
+    INIT(tierFunctions);
+    INIT(tierLoops);
+    tierBlock(program);
+}
+
+//* ---------------- compiler thread ----------------
+
+STATIC void* compilerThread(void* unused) {
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (jobs.len == 0 && !stopping) pthread_cond_wait(&wake, &lock);
+        if (stopping) break;
+        TierJob job = jobs.root[0];
+        REMOVE(jobs, 0);
+        compiling = true;
+        pthread_mutex_unlock(&lock);
+
+        // the interpreter can pick it up as soon as it's published
+        if (job.function != NULL) __atomic_store_n(&job.function->body, compileFunctionBody(job.function->decl), __ATOMIC_RELEASE);
+        else __atomic_store_n(&job.loop->body, compileBlock(job.loop->block), __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&lock);
+        compiling = false;
+        pthread_cond_broadcast(&finished);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+STATIC void enqueue(TierJob job) {
+    pthread_mutex_lock(&lock);
+    if (!started) {
+        INIT(jobs);
+        started = pthread_create(&thread, NULL, compilerThread, NULL) == 0;
+    }
+    // no thread - everything stays on the interpreter
+    if (started) {
+        APPEND(jobs, job);
+        pthread_cond_signal(&wake);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+//* ---------------- tiers ----------------
+
+// A parallel loop's threads all count the same functions & loops - see
+// parallel.h
+STATIC INLINE int countRun(int* counter) {
+    if (parallelRunning) return __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+    return ++*counter;
+}
+
+// True for only one of them
+STATIC INLINE bool claimQueue(bool* queued) {
+    if (parallelRunning) return !__atomic_exchange_n(queued, true, __ATOMIC_RELAXED);
+    *queued = true;
+    return true;
+}
+
+Closure* tierFunction(FunDecl func) {
+    TierFunction* tier = func.tier;
+    if (tier == NULL) return NULL;
+    Closure* body = __atomic_load_n(&tier->body, __ATOMIC_ACQUIRE);
+    if (body != NULL || __atomic_load_n(&tier->queued, __ATOMIC_RELAXED)) return body;
+    if (countRun(&tier->calls) >= TIER_CALL_THRESHOLD && claimQueue(&tier->queued)) {
+        enqueue((TierJob){.function = tier});
+    }
+    return NULL;
+}
+
+Closure* tierLoop(TierLoop* loop) {
+    if (loop == NULL) return NULL;
+    Closure* body = __atomic_load_n(&loop->body, __ATOMIC_ACQUIRE);
+    if (body != NULL || __atomic_load_n(&loop->queued, __ATOMIC_RELAXED)) return body;
+    if (countRun(&loop->iterations) >= TIER_LOOP_THRESHOLD && claimQueue(&loop->queued)) {
+        enqueue((TierJob){.loop = loop});
+    }
+    return NULL;
+}
+
+void tierFlush() {
+    pthread_mutex_lock(&lock);
+    while (started && (jobs.len > 0 || compiling)) pthread_cond_wait(&finished, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void tierShutdown() {
+    pthread_mutex_lock(&lock);
+    bool running = started;
+    // nobody's going to run anything that's still queued
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    if (running) {
+        pthread_join(thread, NULL);
+        DESTROY(jobs);
+    }
+    started = false;
+    stopping = false;
+
+    FOREACH(TierFunctionList, tierFunctions, tier) {
+        if ((*tier)->body != NULL) destroyClosure((*tier)->body);
+        (*tier)->decl->tier = NULL;
+        free(*tier);
+    }
+    DESTROY(tierFunctions);
+    // interpret() shuts down whether or not anything was prepared
+    tierFunctions = (TierFunctionList){0};
+    FOREACH(TierLoopList, tierLoops, loop) {
+        if ((**loop)->body != NULL) destroyClosure((**loop)->body);
+        free(**loop);
+        **loop = NULL;
+    }
+    DESTROY(tierLoops);
+    tierLoops = (TierLoopList){0};
+}
\ No newline at end of file
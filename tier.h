@@ -0,0 +1,44 @@
+#pragma once
+
+#include "parser.h"
+#include "closure.h"
+
+// A function is queued for compilation after this many calls, & a loop
+// after this many iterations
+#define TIER_CALL_THRESHOLD 8
+#define TIER_LOOP_THRESHOLD 256
+
+// Tiered execution for the AST interpreter. Every function & loop counts how
+// often it runs; once one's hot it's queued for a background thread to put
+// through the closure compiler, & the next call (or iteration) after that
+// finishes runs the closures instead. Programs which never get hot never
+// start the thread, & the interpreter never waits for it.
+//
+// body is only written once, by the compiler thread - read it with
+// tierFunction/tierLoop.
+struct TierFunction {
+    FunDecl* decl;
+    int calls;
+    bool queued;
+    Closure* body;
+};
+
+struct TierLoop {
+    DeclList* block;
+    int iterations;
+    bool queued;
+    Closure* body;
+};
+
+// Give every function & loop in the program a counter - if this never runs,
+// nothing gets compiled.
+void tierPrepare(DeclList* program);
+// Count a call - returns the compiled body, once there is one
+Closure* tierFunction(FunDecl func);
+// Count an iteration - returns the compiled loop body, once there is one
+Closure* tierLoop(TierLoop* loop);
+
+// Wait for everything that's been queued to be compiled
+void tierFlush();
+// Stop the compiler thread, if it was ever started
+void tierShutdown();
\ No newline at end of file
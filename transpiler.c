@@ -0,0 +1,609 @@
+#include "transpiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#include "common.h"
+#include "panic.h"
+#include "extension.h"
+
+// Every expression is flattened into a sequence of C statements, one per
+// node, each leaving its value in a new temporary (t1, t2...) - so operands
+// are always evaluated in the same order as the interpreter evaluates them,
+// which a nested C expression wouldn't guarantee.
+
+typedef struct {
+    char* text;
+    int len, cap;
+} CBuffer;
+
+// forward declarations & the FunDecls for each function
+static CBuffer prototypes;
+static CBuffer functions;
+// where the function being generated goes
+static CBuffer* body;
+static int indent;
+// temporaries are numbered per C function
+static int tempCount;
+// & C functions across the whole program - OCR functions can share names
+static int functionCount;
+
+STATIC void vbufferf(CBuffer* buffer, char* fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    while (buffer->len + length + 1 > buffer->cap) {
+        buffer->cap = buffer->cap == 0 ? 256 : buffer->cap * 2;
+        buffer->text = realloc(buffer->text, buffer->cap);
+    }
+    vsnprintf(buffer->text + buffer->len, length + 1, fmt, args);
+    buffer->len += length;
+}
+
+STATIC void bufferf(CBuffer* buffer, char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vbufferf(buffer, fmt, args);
+    va_end(args);
+}
+
+// One line of the current function
+STATIC void line(char* fmt, ...) {
+    for (int i = 0; i < indent; i++) bufferf(body, "    ");
+    va_list args;
+    va_start(args, fmt);
+    vbufferf(body, fmt, args);
+    va_end(args);
+    bufferf(body, "\n");
+}
+
+STATIC int newTemp() {
+    return ++tempCount;
+}
+
+//* needs freeing!
+//
+// A C string literal with exactly these chars in
+STATIC char* quote(char* start, int length) {
+    CBuffer out = {0};
+    bufferf(&out, "\"");
+    for (int i = 0; i < length; i++) {
+        unsigned char c = start[i];
+        if (c == '"' || c == '\\') bufferf(&out, "\\%c", c);
+        else if (c >= ' ' && c <= '~') bufferf(&out, "%c", c);
+        // always 3 digits, so a digit after it can't be read as part of it
+        else bufferf(&out, "\\%03o", c);
+    }
+    bufferf(&out, "\"");
+    return out.text;
+}
+
+STATIC char* quoteTok(Token tok) {
+    return quote(tok.start, tok.length);
+}
+
+// A Token initializer - only the name's ever looked at
+STATIC char* tokenLiteral(Token tok) {
+    char* text = quoteTok(tok);
+    CBuffer out = {0};
+    bufferf(&out, "{.type = Tok_Identifier, .start = %s, .length = %i}", text, tok.length);
+    free(text);
+    return out.text;
+}
+
+STATIC void unsupportedNode(char* what) {
+    panic(Panic_Transpiler, "%s can't be compiled to C yet!", what);
+}
+
+//* ---------------- expressions ----------------
+
+STATIC int transpileExpr(Expression* expr);
+
+// Evaluate each expression into its own temporary, then collect them into an
+// array - the temporary returned is the array (or NULL if there's nothing in it)
+STATIC int transpileList(Expression* exprs, int count) {
+    int values[count];
+    for (int i = 0; i < count; i++) values[i] = transpileExpr(&exprs[i]);
+
+    int out = newTemp();
+    if (count == 0) {
+        line("InterpreterObj* t%i = NULL;", out);
+        return out;
+    }
+    CBuffer elements = {0};
+    for (int i = 0; i < count; i++) bufferf(&elements, i == 0 ? "t%i" : ", t%i", values[i]);
+    line("InterpreterObj t%i[] = {%s};", out, elements.text);
+    free(elements.text);
+    return out;
+}
+
+STATIC int transpilePrimary(Token primary) {
+    int out = newTemp();
+    switch (primary.type) {
+        case Tok_Identifier: {
+            char* name = quoteTok(primary);
+            line("InterpreterObj t%i = loadVar(%s);", out, name);
+            free(name);
+            break;
+        }
+        case Tok_Nil: {
+            line("InterpreterObj t%i = IOBJ(.tag = ObjType_Nil);", out);
+            break;
+        }
+        case Tok_True:
+        case Tok_False: {
+            line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = %s);", out, primary.type == Tok_True ? "true" : "false");
+            break;
+        }
+        case Tok_StringLit: {
+            // strip leading & trailing quotes!
+            char* text = quote(primary.start + 1, primary.length - 2);
+            line("InterpreterObj t%i = IOBJ(.tag = ObjType_String, .string = (StringObj){.start = %s, .length = %i});", out, text, primary.length - 2);
+            free(text);
+            break;
+        }
+        case Tok_IntLit: {
+            char* text = tokText(primary);
+            line("InterpreterObj t%i = IOBJ(.tag = ObjType_Int, .int_ = %i);", out, atoi(text));
+            free(text);
+            break;
+        }
+        case Tok_FloatLit: {
+            char* text = tokText(primary);
+            float value = strtof(text, NULL);
+            free(text);
+            // hex floats are exact
+            if (isinf(value)) line("InterpreterObj t%i = IOBJ(.tag = ObjType_Float, .float_ = INFINITY);", out);
+            else line("InterpreterObj t%i = IOBJ(.tag = ObjType_Float, .float_ = %a);", out, value);
+            break;
+        }
+        // todo: handle self
+        default: unsupportedNode("self");
+    }
+    return out;
+}
+
+// Binary operators which aren't assignments or short-circuiting
+STATIC int transpileOperation(TokType operator, Expression* a, Expression* b) {
+    int aTemp = transpileExpr(a);
+    int bTemp = transpileExpr(b);
+    int out = newTemp();
+    switch (operator) {
+        case Tok_Exp:
+        case Tok_Slash: {
+            line("InterpreterObj t%i = %s(t%i, t%i);", out, operator == Tok_Exp ? "iExponent" : "divide", aTemp, bTemp);
+            line("freeObj(t%i);", aTemp);
+            line("freeObj(t%i);", bTemp);
+            break;
+        }
+        case Tok_Star: line("InterpreterObj t%i = multiplyFast(t%i, t%i);", out, aTemp, bTemp); break;
+        case Tok_Plus: line("InterpreterObj t%i = addFast(t%i, t%i);", out, aTemp, bTemp); break;
+        case Tok_Minus: line("InterpreterObj t%i = subtractFast(t%i, t%i);", out, aTemp, bTemp); break;
+
+        case Tok_EqualEqual: line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = equalFast(t%i, t%i));", out, aTemp, bTemp); break;
+        case Tok_BangEqual: line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = !equalFast(t%i, t%i));", out, aTemp, bTemp); break;
+        case Tok_Less: line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = lessFast(t%i, t%i));", out, aTemp, bTemp); break;
+        case Tok_LessEqual: line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = lessEqualFast(t%i, t%i));", out, aTemp, bTemp); break;
+        case Tok_Greater: line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = greaterFast(t%i, t%i));", out, aTemp, bTemp); break;
+        case Tok_GreaterEqual: line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = greaterEqualFast(t%i, t%i));", out, aTemp, bTemp); break;
+
+        default: panic(Panic_Transpiler, "Unknown binary operator!");
+    }
+    return out;
+}
+
+// The array to write to for an assignment to expr[...] - see
+// arrayForWriteFromExpr
+STATIC int transpileWritableArray(Expression* expr) {
+    int out;
+    if (expr->tag == ExprTag_Call && expr->call.tag == Call_Array) {
+        int outer = transpileWritableArray(expr->call.callee);
+        int indices = transpileList(expr->call.arguments.root, expr->call.arguments.len);
+        out = newTemp();
+        line("ArrayObj* t%i = writableElementArray(t%i, t%i, %i);", out, outer, indices, expr->call.arguments.len);
+    } else {
+        int array = transpileExpr(expr);
+        out = newTemp();
+        line("ArrayObj* t%i = writableArray(t%i);", out, array);
+    }
+    return out;
+}
+
+// target = the value in the temporary value
+STATIC void transpileAssignment(Expression* target, int value) {
+    if (target->tag == ExprTag_Primary && target->primary.type == Tok_Identifier) {
+        char* name = quoteTok(target->primary);
+        line("assignVar(%s, t%i);", name, value);
+        free(name);
+    } else if (target->tag == ExprTag_Call && target->call.tag == Call_Array) {
+        // array elements aren't (necessarily) InterpreterObjs, so they can't be refs
+        line("t%i = storedValue(t%i);", value, value);
+        int array = transpileWritableArray(target->call.callee);
+        int indices = transpileList(target->call.arguments.root, target->call.arguments.len);
+        line("storeElement(t%i, t%i, %i, t%i);", array, indices, target->call.arguments.len, value);
+    } else {
+        line("assignRef(t%i, t%i);", transpileExpr(target), value);
+    }
+}
+
+// The operator a compound assignment applies (+ for +=)
+STATIC TokType compoundOperation(TokType operator) {
+    switch (operator) {
+        case Tok_ExpEqual: return Tok_Exp;
+        case Tok_StarEqual: return Tok_Star;
+        case Tok_SlashEqual: return Tok_Slash;
+        case Tok_PlusEqual: return Tok_Plus;
+        case Tok_MinusEqual: return Tok_Minus;
+        default: return operator;
+    }
+}
+
+STATIC bool isAssignmentExpr(Expression* expr) {
+    if (expr->tag != ExprTag_Binary) return false;
+    switch (expr->binary.operator.type) {
+        case Tok_Equal:
+        case Tok_ExpEqual:
+        case Tok_StarEqual:
+        case Tok_SlashEqual:
+        case Tok_PlusEqual:
+        case Tok_MinusEqual: return true;
+        default: return false;
+    }
+}
+
+STATIC void transpileAssignmentExpr(BinaryExpr binary) {
+    TokType operator = binary.operator.type;
+    int value = operator == Tok_Equal
+        ? transpileExpr(binary.b)
+        : transpileOperation(compoundOperation(operator), binary.a, binary.b);
+    transpileAssignment(binary.a, value);
+}
+
+STATIC int transpileBinary(Expression* expr) {
+    BinaryExpr binary = expr->binary;
+    TokType operator = binary.operator.type;
+    if (isAssignmentExpr(expr)) {
+        transpileAssignmentExpr(binary);
+        // assignments don't have a value
+        int out = newTemp();
+        line("InterpreterObj t%i = IOBJ(.tag = ObjType_Nil);", out);
+        return out;
+    }
+
+    switch (operator) {
+        case Tok_And:
+        case Tok_Or: {
+            int a = transpileExpr(binary.a);
+            int out = newTemp();
+            line("InterpreterObj t%i = IOBJ(.tag = ObjType_Bool, .bool_ = condition(t%i));", out, a);
+            line("if (%st%i.bool_) {", operator == Tok_And ? "" : "!", out);
+            indent++;
+            int b = transpileExpr(binary.b);
+            line("t%i.bool_ = condition(t%i);", out, b);
+            indent--;
+            line("}");
+            return out;
+        }
+
+        default: return transpileOperation(operator, binary.a, binary.b);
+    }
+}
+
+// receiver.name(arguments) - see callMethod
+STATIC int transpileMethodCall(CallExpr* member, ExprList arguments) {
+    int receiver = transpileExpr(member->callee);
+    int values[arguments.len];
+    for (int i = 0; i < arguments.len; i++) values[i] = transpileExpr(&arguments.root[i]);
+
+    int args = newTemp();
+    CBuffer elements = {0};
+    bufferf(&elements, "t%i", receiver);
+    for (int i = 0; i < arguments.len; i++) bufferf(&elements, ", t%i", values[i]);
+    line("InterpreterObj t%i[] = {%s};", args, elements.text);
+    free(elements.text);
+
+    int out = newTemp();
+    char* name = quoteTok(member->memberName);
+    line("InterpreterObj t%i = callMethod(%s, %i, t%i, %i);", out, name, member->memberName.length, args, arguments.len + 1);
+    free(name);
+    return out;
+}
+
+STATIC int transpileCall(CallExpr call) {
+    switch (call.tag) {
+        case Call_Call: {
+            if (call.callee->tag == ExprTag_Call && call.callee->call.tag == Call_GetMember) return transpileMethodCall(&call.callee->call, call.arguments);
+            int callee = transpileExpr(call.callee);
+            line("checkCall(t%i, %i);", callee, call.arguments.len);
+            int args = transpileList(call.arguments.root, call.arguments.len);
+            int out = newTemp();
+            line("InterpreterObj t%i = callObj(t%i, t%i, %i);", out, callee, args, call.arguments.len);
+            return out;
+        }
+        case Call_Array: {
+            int array = transpileExpr(call.callee);
+            int indices = transpileList(call.arguments.root, call.arguments.len);
+            int out = newTemp();
+            line("InterpreterObj t%i = loadElement(t%i, t%i, %i);", out, array, indices, call.arguments.len);
+            return out;
+        }
+        case Call_GetMember: return transpileMethodCall(&call, (ExprList){0});
+    }
+}
+
+STATIC int transpileExpr(Expression* expr) {
+    switch (expr->tag) {
+        case ExprTag_Unary: unsupportedNode("Unary expressions");
+        case ExprTag_Binary: return transpileBinary(expr);
+        case ExprTag_Call: return transpileCall(expr->call);
+        case ExprTag_Super: unsupportedNode("super");
+        case ExprTag_Grouping: return transpileExpr(expr->grouping);
+        case ExprTag_Cached: {
+            int out = newTemp();
+            line("InterpreterObj t%i;", out);
+            line("if (!cacheGet(%i, &t%i)) {", expr->cached.slot, out);
+            indent++;
+            int value = transpileExpr(expr->cached.expr);
+            line("t%i = t%i;", out, value);
+            line("cacheSet(%i, t%i);", expr->cached.slot, out);
+            indent--;
+            line("}");
+            return out;
+        }
+        case ExprTag_Primary: return transpilePrimary(expr->primary);
+    }
+}
+
+// The value of a statement's expression
+STATIC int transpileRootExpr(Expression* expr) {
+    line("newCacheGeneration();");
+    return transpileExpr(expr);
+}
+
+//* ---------------- statements ----------------
+
+STATIC void transpileBlock(DeclList* block);
+STATIC void transpileDecl(Declaration* decl);
+
+STATIC void transpileFor(ForStmt* for_) {
+    char* name = quoteTok(for_->iterator);
+    line("{");
+    indent++;
+    line("pushScope();");
+    line("setVar(strdup(%s), t%i, true);", name, transpileExpr(&for_->min));
+    // the interpreter evaluates max once up front to check array bounds
+    line("freeObj(t%i);", transpileExpr(&for_->max));
+    line("while (true) {");
+    indent++;
+    int iterator = transpilePrimary(for_->iterator);
+    int max = transpileExpr(&for_->max);
+    line("if (!lessFast(t%i, t%i)) break;", iterator, max);
+    transpileBlock(for_->block);
+    // i += 1
+    int current = transpilePrimary(for_->iterator);
+    int next = newTemp();
+    line("InterpreterObj t%i = addFast(t%i, IOBJ(.tag = ObjType_Int, .int_ = 1));", next, current);
+    line("assignVar(%s, t%i);", name, next);
+    indent--;
+    line("}");
+    line("popScope();");
+    indent--;
+    line("}");
+    free(name);
+}
+
+STATIC void transpileIf(IfStmt* if_) {
+    line("if (condition(t%i)) {", transpileRootExpr(&if_->primary.condition));
+    indent++;
+    transpileBlock(if_->primary.block);
+    indent--;
+    line("} else {");
+    indent++;
+    if (if_->secondary.len > 0) {
+        // the first elseif which matches - break skips the rest
+        line("do {");
+        indent++;
+        FOREACH(ElseIfList, if_->secondary, branch) {
+            line("if (condition(t%i)) {", transpileRootExpr(&branch->condition));
+            indent++;
+            transpileBlock(branch->block);
+            line("break;");
+            indent--;
+            line("}");
+        }
+        indent--;
+        line("} while (false);");
+    }
+    // the interpreter checks the else even if an elseif matched
+    if (if_->hasElse) {
+        line("if (condition(t%i)) {", transpileRootExpr(&if_->else_.condition));
+        indent++;
+        transpileBlock(if_->else_.block);
+        indent--;
+        line("}");
+    }
+    indent--;
+    line("}");
+}
+
+STATIC void transpileStmt(Statement* stmt) {
+    switch (stmt->tag) {
+        case StmtTag_Expr: {
+            if (isAssignmentExpr(&stmt->expr)) {
+                line("newCacheGeneration();");
+                transpileAssignmentExpr(stmt->expr.binary);
+            } else {
+                line("freeObj(t%i);", transpileRootExpr(&stmt->expr));
+            }
+            break;
+        }
+        case StmtTag_Global: {
+            int value = transpileRootExpr(&stmt->global.initializer);
+            char* name = quoteTok(stmt->global.name);
+            line("ObjNSSet(&globalScope->objects, strdup(%s), t%i);", name, value);
+            free(name);
+            break;
+        }
+        case StmtTag_For: {
+            transpileFor(&stmt->for_);
+            break;
+        }
+        case StmtTag_While:
+        case StmtTag_Do: {
+            ConditionalBlock* loop = stmt->tag == StmtTag_While ? &stmt->while_ : &stmt->do_;
+            line("while (true) {");
+            indent++;
+            //* yikes!! not a do-while but a do-until!
+            line("if (%scondition(t%i)) break;", stmt->tag == StmtTag_While ? "!" : "", transpileRootExpr(&loop->condition));
+            transpileBlock(loop->block);
+            indent--;
+            line("}");
+            break;
+        }
+        case StmtTag_If: {
+            transpileIf(&stmt->if_);
+            break;
+        }
+        case StmtTag_Switch: {
+            break;
+        }
+        case StmtTag_Array: {
+            int dims = transpileList(stmt->array.dimensions.root, stmt->array.dimensions.len);
+            char* name = quoteTok(stmt->array.name);
+            line("declareArray(%s, t%i, %i);", name, dims, stmt->array.dimensions.len);
+            free(name);
+            break;
+        }
+    }
+}
+
+// Emit func as a C function & its FunDecl - returns the C function's number
+STATIC int transpileFunction(FunDecl* func) {
+    int id = ++functionCount;
+    char* name = tokText(func->name);
+
+    bufferf(&prototypes, "static InterpreterObj fn_%i_%s(InterpreterObj* args);\n", id, name);
+    if (func->params.len > 0) {
+        bufferf(&prototypes, "static Parameter fn_%i_params[] = {\n", id);
+        FOREACH(ParamList, func->params, param) {
+            char* paramName = tokenLiteral(param->name);
+            bufferf(&prototypes, "    {.name = %s, .passMode = %s},\n", paramName, param->passMode == Param_byRef ? "Param_byRef" : "Param_byVal");
+            free(paramName);
+        }
+        bufferf(&prototypes, "};\n");
+    }
+    char* nameLiteral = tokenLiteral(func->name);
+    bufferf(&prototypes, "static FunDecl fn_%i_decl = {\n", id);
+    bufferf(&prototypes, "    .name = %s,\n", nameLiteral);
+    if (func->params.len > 0) bufferf(&prototypes, "    .params = {.root = fn_%i_params, .len = %i, .cap = %i},\n", id, func->params.len, func->params.len);
+    bufferf(&prototypes, "    .emitted = fn_%i_%s\n", id, name);
+    bufferf(&prototypes, "};\n\n");
+    free(nameLiteral);
+
+    // nested functions get their own C function
+    CBuffer* outerBody = body;
+    int outerIndent = indent;
+    int outerTempCount = tempCount;
+    CBuffer functionBody = {0};
+    body = &functionBody;
+    indent = 0;
+    tempCount = 0;
+
+    line("static InterpreterObj fn_%i_%s(InterpreterObj* args) {", id, name);
+    indent++;
+    line("Scope* callerScope = enterFunction(fn_%i_decl, args);", id);
+    bool returns = false;
+    FOREACH(FuncDeclList, func->block, currentDOR) {
+        // nothing after the first return can ever run
+        if (currentDOR->tag == DOR_return) {
+            line("return leaveFunction(callerScope, t%i);", transpileRootExpr(&currentDOR->return_));
+            returns = true;
+            break;
+        }
+        transpileDecl(currentDOR->declaration);
+    }
+    if (!returns) {
+        char* quoted = quoteTok(func->name);
+        line("panic(Panic_Interpreter, \"Function %%s must return a value!\", %s);", quoted);
+        line("return IOBJ(.tag = ObjType_Nil);");
+        free(quoted);
+    }
+    indent--;
+    line("}");
+    line("");
+
+    bufferf(&functions, "%s", functionBody.text);
+    free(functionBody.text);
+    body = outerBody;
+    indent = outerIndent;
+    tempCount = outerTempCount;
+
+    free(name);
+    return id;
+}
+
+STATIC void transpileDecl(Declaration* decl) {
+    switch (decl->tag) {
+        case DeclTag_Fun: {
+            int id = transpileFunction(&decl->fun);
+            char* name = quoteTok(decl->fun.name);
+            line("setVar(strdup(%s), IOBJ(.tag = ObjType_Func, .func = fn_%i_decl), true);", name, id);
+            free(name);
+            break;
+        }
+        case DeclTag_Proc: {
+            char* name = quoteTok(decl->proc.name);
+            char* token = tokenLiteral(decl->proc.name);
+            line("setVar(strdup(%s), IOBJ(.tag = ObjType_Proc, .proc = (ProcDecl){.name = %s}), true);", name, token);
+            free(name);
+            free(token);
+            break;
+        }
+        case DeclTag_Stmt: {
+            transpileStmt(&decl->stmt);
+            break;
+        }
+        case DeclTag_Class: break;
+    }
+}
+
+STATIC void transpileBlock(DeclList* block) {
+    for (int i = 0; i < block->len; i++) transpileDecl(&block->root[i]);
+}
+
+void transpile(ParseOutput po, FILE* out) {
+    prototypes = (CBuffer){0};
+    functions = (CBuffer){0};
+    CBuffer mainBody = {0};
+    body = &mainBody;
+    indent = 0;
+    tempCount = 0;
+    functionCount = 0;
+
+    line("int main() {");
+    indent++;
+    // by absolute path, so the compiled program finds them from anywhere
+    for (int i = 0; i < extensionCount(); i++) line("loadExtension(\"%s\");", extensionPath(i));
+    line("pushScope();");
+    line("setupSTL();");
+    transpileBlock(&po.ast);
+    line("popScope();");
+    indent--;
+    line("}");
+
+    fprintf(out, "// Generated by ocrpi --emit-c\n\n");
+    fprintf(out, "#include <stdlib.h>\n#include <string.h>\n#include <math.h>\n\n");
+    fprintf(out, "#include \"runtime.h\"\n#include \"panic.h\"\n");
+    if (extensionCount() > 0) fprintf(out, "#include \"extension.h\"\n");
+    fprintf(out, "\n");
+    if (prototypes.len > 0) fprintf(out, "%s", prototypes.text);
+    if (functions.len > 0) fprintf(out, "%s", functions.text);
+    fprintf(out, "%s", mainBody.text);
+
+    free(prototypes.text);
+    free(functions.text);
+    free(mainBody.text);
+}
\ No newline at end of file
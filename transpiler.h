@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "parser.h"
+
+// Translate the program into a standalone C program which does exactly what
+// interpret() would - see the "compiled programs" part of runtime.h. It needs
+// linking against the runtime library (make runtime), eg:
+//
+//   ocrpi --emit-c prog.ocr > prog.c
+//   gcc -O2 -I<ocrpi> prog.c <ocrpi>/libocrpi-runtime.a -lm -o prog
+void transpile(ParseOutput po, FILE* out);
\ No newline at end of file